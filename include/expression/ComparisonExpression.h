@@ -1,6 +1,7 @@
 #pragma once
 #include <memory>
 #include "expression_common.h"
+#include "ExpressionProgram.h"
 #include "NumberExpression.h"
 namespace expression
 {
@@ -48,6 +49,34 @@ namespace expression
 		{
 			return EvalInternal(left_->Eval(), right_->Eval(), type_) ? 1 : 0;
 		}
+		virtual void Compile(ExpressionCompiler& compiler) const override
+		{
+			left_->Compile(compiler);
+			right_->Compile(compiler);
+			switch (type_)
+			{
+			case type_equal:
+				compiler.EmitOperation(ExpressionProgram::op_equal);
+				break;
+			case type_not_equal:
+				compiler.EmitOperation(ExpressionProgram::op_not_equal);
+				break;
+			case type_greater:
+				compiler.EmitOperation(ExpressionProgram::op_greater);
+				break;
+			case type_greater_equal:
+				compiler.EmitOperation(ExpressionProgram::op_greater_equal);
+				break;
+			case type_less:
+				compiler.EmitOperation(ExpressionProgram::op_less);
+				break;
+			case type_less_equal:
+				compiler.EmitOperation(ExpressionProgram::op_less_equal);
+				break;
+			default:
+				throw std::exception("Type of comparison operation internally unknown.");
+			}
+		}
 		virtual std::unique_ptr<IExpression> Clone() const override
 		{
 			return std::make_unique<ComparisonExpression>(left_->Clone(), right_->Clone(), type_);
@@ -1,6 +1,7 @@
 #pragma once
 #include <memory>
 #include "expression_common.h"
+#include "ExpressionProgram.h"
 #include "NumberExpression.h"
 namespace expression
 {
@@ -25,6 +26,18 @@ namespace expression
 			else
 				return expressionIfFalse_->Eval();
 		}
+		virtual void Compile(ExpressionCompiler& compiler) const override
+		{
+			condition_->Compile(compiler);
+			size_t ifFalse = compiler.EmitJump(ExpressionProgram::op_jump_if_false);
+			const size_t depth = compiler.GetDepth();
+			expressionIfTrue_->Compile(compiler);
+			size_t end = compiler.EmitJump(ExpressionProgram::op_jump);
+			compiler.SetDepth(depth);
+			compiler.SetJumpTarget(ifFalse);
+			expressionIfFalse_->Compile(compiler);
+			compiler.SetJumpTarget(end);
+		}
 		virtual std::unique_ptr<IExpression> Clone() const override
 		{
 			return std::make_unique<ConditionalExpression>(condition_->Clone(), expressionIfTrue_->Clone(), expressionIfFalse_->Clone());
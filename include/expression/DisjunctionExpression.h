@@ -1,6 +1,7 @@
 #pragma once
 #include <memory>
 #include "expression_common.h"
+#include "ExpressionProgram.h"
 #include "UnaryNotExpression.h"
 #include "NumberExpression.h"
 namespace expression
@@ -39,6 +40,31 @@ namespace expression
 			}
 			return value ? number_true : number_false;
 		}
+		virtual void Compile(ExpressionCompiler& compiler) const override
+		{
+			if (isTrue(baseValue_))
+			{
+				compiler.EmitConstant(number_true);
+				return;
+			}
+			// Short-circuit evaluation: jump to the end as soon as the value is determined.
+			std::vector<size_t> shortCircuits;
+			for (auto& elem : elems_)
+			{
+				elem.GetExpression()->Compile(compiler);
+				shortCircuits.push_back(compiler.EmitJump(elem.IsNotInverse() ? ExpressionProgram::op_jump_if_true : ExpressionProgram::op_jump_if_false));
+			}
+			const size_t depth = compiler.GetDepth();
+			compiler.EmitConstant(number_false);
+			size_t end = compiler.EmitJump(ExpressionProgram::op_jump);
+			compiler.SetDepth(depth);
+			for (auto label : shortCircuits)
+			{
+				compiler.SetJumpTarget(label);
+			}
+			compiler.EmitConstant(number_true);
+			compiler.SetJumpTarget(end);
+		}
 		virtual std::unique_ptr<IExpression> Simplify(const VariableRegister& variableRegister) const override
 		{
 			bool value = isTrue(baseValue_);
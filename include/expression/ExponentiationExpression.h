@@ -1,6 +1,7 @@
 #pragma once
 #include <memory>
 #include "expression_common.h"
+#include "ExpressionProgram.h"
 #include "NumberExpression.h"
 #include "ProductExpression.h"
 namespace expression
@@ -22,6 +23,12 @@ namespace expression
 		{
 			return ::pow(base_->Eval(), exponent_->Eval());
 		}
+		virtual void Compile(ExpressionCompiler& compiler) const override
+		{
+			base_->Compile(compiler);
+			exponent_->Compile(compiler);
+			compiler.EmitOperation(ExpressionProgram::op_power);
+		}
 		virtual std::unique_ptr<IExpression> Clone() const override
 		{
 			return std::make_unique<ExponentiationExpression>(base_->Clone(), exponent_->Clone());
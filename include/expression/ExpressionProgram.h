@@ -0,0 +1,488 @@
+#pragma once
+#include <vector>
+#include <functional>
+#include <cmath>
+#include "expression_common.h"
+#include "Interval.h"
+namespace expression
+{
+	/// <summary>
+	/// Compiled form of an expression. The expression tree is flattened into a sequence of instructions for a stack machine, which are evaluated in a single loop
+	/// without virtual function calls and without heap allocations. Variables can be compiled into direct loads from memory locations or into calls of plain functions
+	/// (see SlotRegister), instead of going through their bindings.
+	/// Programs can also be evaluated in interval arithmetic (see EvalInterval), e.g. to bound the value of an expression for all values of its variables in given intervals.
+	/// Programs are created by ExpressionCompiler, and reference (but do not own) the expression they were compiled from. Thus, the expression must neither be destroyed
+	/// nor be rebound while the program is in use.
+	/// </summary>
+	class ExpressionProgram
+	{
+	public:
+		/// <summary>
+		/// Function returning the value of a variable given a context pointer, e.g. the current molecular number of a state.
+		/// </summary>
+		typedef number(*ExternalFunction)(const void* context);
+		typedef number(*UnaryFunction)(number);
+		typedef number(*BinaryFunction)(number, number);
+		enum opcode : unsigned char
+		{
+			// Pushes value.
+			op_constant,
+			// Pushes *variable.
+			op_load,
+			// Pushes external(context).
+			op_load_external,
+			// Pushes *interval in interval arithmetic (see EvalInterval), and its lower bound otherwise.
+			op_load_interval,
+			// Pushes expression->Eval().
+			op_evaluate,
+			// Replaces the two topmost values by the result of the respective operation.
+			op_add,
+			op_subtract,
+			op_multiply,
+			op_divide,
+			op_power,
+			op_equal,
+			op_not_equal,
+			op_greater,
+			op_greater_equal,
+			op_less,
+			op_less_equal,
+			op_binary_function,
+			// Replaces the topmost value by the result of the respective operation.
+			op_negate,
+			op_reciprocal,
+			op_not,
+			op_unary_function,
+			// Continues at instruction target.
+			op_jump,
+			// Pops the topmost value, and continues at instruction target if it is false, respectively true.
+			op_jump_if_false,
+			op_jump_if_true
+		};
+		/// <summary>
+		/// Single instruction of a program.
+		/// </summary>
+		struct Instruction
+		{
+			opcode code;
+			/// <summary>
+			/// Index of the instruction to continue with for jumps.
+			/// </summary>
+			unsigned int target;
+			union
+			{
+				number value;
+				const number* variable;
+				const Interval* interval;
+				const IExpression* expression;
+				ExternalFunction external;
+				UnaryFunction unaryFunction;
+				BinaryFunction binaryFunction;
+			};
+			/// <summary>
+			/// Context passed to the external function.
+			/// </summary>
+			const void* context;
+
+			Instruction(opcode code = op_constant) noexcept : code(code), target(0), value(0), context(nullptr)
+			{
+			}
+		};
+
+		ExpressionProgram() noexcept
+		{
+		}
+		/// <summary>
+		/// Returns true if the program contains any instruction.
+		/// </summary>
+		operator bool() const noexcept
+		{
+			return !code_.empty();
+		}
+		/// <summary>
+		/// Returns the instructions of the program.
+		/// </summary>
+		const std::vector<Instruction>& GetInstructions() const noexcept
+		{
+			return code_;
+		}
+		/// <summary>
+		/// Evaluates the program. Yields the same result as calling Eval on the expression the program was compiled from.
+		/// </summary>
+		/// <returns>Value of the expression.</returns>
+		number Eval() const
+		{
+			// top points to the next free entry of the stack, i.e. top[-1] is the topmost value.
+			number* top = stack_.data();
+			const Instruction* const code = code_.data();
+			const Instruction* const end = code + code_.size();
+			for (const Instruction* instruction = code; instruction != end; instruction++)
+			{
+				switch (instruction->code)
+				{
+				case op_constant:
+					*top++ = instruction->value;
+					break;
+				case op_load:
+					*top++ = *instruction->variable;
+					break;
+				case op_load_external:
+					*top++ = instruction->external(instruction->context);
+					break;
+				case op_load_interval:
+					*top++ = instruction->interval->lower;
+					break;
+				case op_evaluate:
+					*top++ = instruction->expression->Eval();
+					break;
+				case op_add:
+					top--;
+					top[-1] += top[0];
+					break;
+				case op_subtract:
+					top--;
+					top[-1] -= top[0];
+					break;
+				case op_multiply:
+					top--;
+					top[-1] *= top[0];
+					break;
+				case op_divide:
+					top--;
+					top[-1] /= top[0];
+					break;
+				case op_power:
+					top--;
+					top[-1] = ::pow(top[-1], top[0]);
+					break;
+				case op_equal:
+					top--;
+					top[-1] = top[-1] == top[0] ? 1 : 0;
+					break;
+				case op_not_equal:
+					top--;
+					top[-1] = top[-1] != top[0] ? 1 : 0;
+					break;
+				case op_greater:
+					top--;
+					top[-1] = top[-1] > top[0] ? 1 : 0;
+					break;
+				case op_greater_equal:
+					top--;
+					top[-1] = top[-1] >= top[0] ? 1 : 0;
+					break;
+				case op_less:
+					top--;
+					top[-1] = top[-1] < top[0] ? 1 : 0;
+					break;
+				case op_less_equal:
+					top--;
+					top[-1] = top[-1] <= top[0] ? 1 : 0;
+					break;
+				case op_binary_function:
+					top--;
+					top[-1] = instruction->binaryFunction(top[-1], top[0]);
+					break;
+				case op_negate:
+					top[-1] = -top[-1];
+					break;
+				case op_reciprocal:
+					top[-1] = 1 / top[-1];
+					break;
+				case op_not:
+					top[-1] = isTrue(top[-1]) ? number_false : number_true;
+					break;
+				case op_unary_function:
+					top[-1] = instruction->unaryFunction(top[-1]);
+					break;
+				case op_jump:
+					// the loop increments the instruction pointer.
+					instruction = code + instruction->target - 1;
+					break;
+				case op_jump_if_false:
+					if (isFalse(*--top))
+						instruction = code + instruction->target - 1;
+					break;
+				case op_jump_if_true:
+					if (isTrue(*--top))
+						instruction = code + instruction->target - 1;
+					break;
+				}
+			}
+			return top[-1];
+		}
+		/// <summary>
+		/// Evaluates the program in interval arithmetic, and returns an interval containing all values the expression can take when the variables loaded by op_load_interval
+		/// instructions take any value in their respective intervals. All other variables, as well as sub-expressions evaluated via their bindings, are considered to be constant.
+		/// When a condition cannot be decided, both branches are evaluated and the hull of their results is returned. If conditions are nested too deeply for this, the entire interval is returned.
+		/// </summary>
+		/// <returns>Interval containing the value of the expression.</returns>
+		Interval EvalInterval() const
+		{
+			if (intervalStack_.empty())
+				intervalStack_.resize(stack_.size() * (maxBranchDepth_ + 1));
+			return EvalInterval(0, intervalStack_.data(), intervalStack_.data(), 0);
+		}
+	private:
+		friend class ExpressionCompiler;
+		/// <summary>
+		/// Maximal number of undecided conditions which are followed in both directions during interval evaluation.
+		/// </summary>
+		static constexpr size_t maxBranchDepth_ = 8;
+		std::vector<Instruction> code_;
+		/// <summary>
+		/// Stack of the program, allocated once with the maximal depth reached during evaluation.
+		/// </summary>
+		mutable std::vector<number> stack_;
+		/// <summary>
+		/// Stack for the interval evaluation, allocated at the first interval evaluation. Contains one segment with the size of stack_ for every level of undecided conditions.
+		/// </summary>
+		mutable std::vector<Interval> intervalStack_;
+
+		/// <summary>
+		/// Evaluates the program in interval arithmetic starting at the given instruction, with the values between stack and top already on the stack.
+		/// </summary>
+		Interval EvalInterval(size_t start, Interval* stack, Interval* top, size_t branchDepth) const
+		{
+			const Instruction* const code = code_.data();
+			const Instruction* const end = code + code_.size();
+			// Hull of the results of the branches not taken at undecided conditions, if any.
+			bool hasAlternative = false;
+			Interval alternative;
+			for (const Instruction* instruction = code + start; instruction != end; instruction++)
+			{
+				switch (instruction->code)
+				{
+				case op_constant:
+					*top++ = Interval(instruction->value);
+					break;
+				case op_load:
+					*top++ = Interval(*instruction->variable);
+					break;
+				case op_load_external:
+					*top++ = Interval(instruction->external(instruction->context));
+					break;
+				case op_load_interval:
+					*top++ = *instruction->interval;
+					break;
+				case op_evaluate:
+					*top++ = Interval(instruction->expression->Eval());
+					break;
+				case op_add:
+					top--;
+					top[-1] = top[-1] + top[0];
+					break;
+				case op_subtract:
+					top--;
+					top[-1] = top[-1] - top[0];
+					break;
+				case op_multiply:
+					top--;
+					top[-1] = top[-1] * top[0];
+					break;
+				case op_divide:
+					top--;
+					top[-1] = top[-1] / top[0];
+					break;
+				case op_power:
+					top--;
+					top[-1] = power(top[-1], top[0]);
+					break;
+				case op_equal:
+					top--;
+					top[-1] = top[-1] == top[0];
+					break;
+				case op_not_equal:
+					top--;
+					top[-1] = top[-1] != top[0];
+					break;
+				case op_greater:
+					top--;
+					top[-1] = top[-1] > top[0];
+					break;
+				case op_greater_equal:
+					top--;
+					top[-1] = top[-1] >= top[0];
+					break;
+				case op_less:
+					top--;
+					top[-1] = top[-1] < top[0];
+					break;
+				case op_less_equal:
+					top--;
+					top[-1] = top[-1] <= top[0];
+					break;
+				case op_binary_function:
+					top--;
+					top[-1] = evalInterval(instruction->binaryFunction, top[-1], top[0]);
+					break;
+				case op_negate:
+					top[-1] = -top[-1];
+					break;
+				case op_reciprocal:
+					top[-1] = reciprocal(top[-1]);
+					break;
+				case op_not:
+					top[-1] = !top[-1];
+					break;
+				case op_unary_function:
+					top[-1] = evalInterval(instruction->unaryFunction, top[-1]);
+					break;
+				case op_jump:
+					instruction = code + instruction->target - 1;
+					break;
+				case op_jump_if_false:
+				case op_jump_if_true:
+				{
+					const Interval condition = *--top;
+					if (condition.IsTrue() || condition.IsFalse())
+					{
+						if (condition.IsTrue() == (instruction->code == op_jump_if_true))
+							instruction = code + instruction->target - 1;
+						break;
+					}
+					// Undecided condition: evaluate the jump target on a copy of the stack, and continue with the next instruction.
+					if (branchDepth >= maxBranchDepth_)
+						return Interval::Entire();
+					Interval* const branchStack = stack + stack_.size();
+					Interval* const branchTop = std::copy(stack, top, branchStack);
+					const Interval branchResult = EvalInterval(instruction->target, branchStack, branchTop, branchDepth + 1);
+					alternative = hasAlternative ? Interval::Hull(alternative, branchResult) : branchResult;
+					hasAlternative = true;
+					break;
+				}
+				}
+			}
+			return hasAlternative ? Interval::Hull(alternative, top[-1]) : top[-1];
+		}
+	};
+
+	/// <summary>
+	/// Takes the name of a variable, or of a function without arguments (suceeded by round brackets, see BindingRegister), and sets the instruction to load its value,
+	/// typically an op_load or op_load_external instruction. Returns false if the variable or function is not known to the register, in which case it is evaluated via its binding.
+	/// </summary>
+	typedef std::function<bool(const identifier& name, ExpressionProgram::Instruction& instruction)> SlotRegister;
+
+	/// <summary>
+	/// Compiles expressions into programs (see ExpressionProgram). The individual expressions append their instructions by overriding IExpression::Compile.
+	/// Example:
+	/// <code>
+	///		ExpressionCompiler compiler;
+	///		ExpressionProgram program = compiler.Compile(*expression);
+	///		number value = program.Eval();
+	/// </code>
+	/// </summary>
+	class ExpressionCompiler
+	{
+	public:
+		/// <summary>
+		/// Compiles the given expression, which must stay valid and must not be rebound while the program is in use.
+		/// </summary>
+		/// <param name="expression">Expression to compile.</param>
+		/// <param name="slotRegister">Register determining how variables are loaded. If empty, all variables are evaluated via their bindings.</param>
+		/// <returns>Compiled expression.</returns>
+		ExpressionProgram Compile(const IExpression& expression, SlotRegister slotRegister = nullptr)
+		{
+			program_ = ExpressionProgram();
+			slotRegister_ = std::move(slotRegister);
+			depth_ = 0;
+			maxDepth_ = 0;
+			expression.Compile(*this);
+			program_.stack_.assign(maxDepth_ > 0 ? maxDepth_ : 1, 0);
+			slotRegister_ = nullptr;
+			return std::move(program_);
+		}
+
+		void EmitConstant(number value)
+		{
+			ExpressionProgram::Instruction instruction(ExpressionProgram::op_constant);
+			instruction.value = value;
+			Emit(instruction, 1);
+		}
+		/// <summary>
+		/// Emits an instruction calling Eval on the expression, e.g. for expressions which cannot be compiled.
+		/// </summary>
+		void EmitEvaluate(const IExpression& expression)
+		{
+			ExpressionProgram::Instruction instruction(ExpressionProgram::op_evaluate);
+			instruction.expression = &expression;
+			Emit(instruction, 1);
+		}
+		/// <summary>
+		/// Emits the instructions to load the variable with the given name if it is known to the slot register, and returns true. Otherwise, returns false without emitting anything.
+		/// </summary>
+		bool EmitVariable(const identifier& name)
+		{
+			ExpressionProgram::Instruction instruction;
+			if (!slotRegister_ || !slotRegister_(name, instruction))
+				return false;
+			Emit(instruction, 1);
+			return true;
+		}
+		/// <summary>
+		/// Emits an operation taking the two topmost values, or the topmost value, of the stack as arguments.
+		/// </summary>
+		void EmitOperation(ExpressionProgram::opcode code)
+		{
+			Emit(ExpressionProgram::Instruction(code), code < ExpressionProgram::op_negate ? -1 : 0);
+		}
+		/// <summary>
+		/// Emits a call of the plain function taking one argument.
+		/// </summary>
+		void EmitFunction(ExpressionProgram::UnaryFunction function)
+		{
+			ExpressionProgram::Instruction instruction(ExpressionProgram::op_unary_function);
+			instruction.unaryFunction = function;
+			Emit(instruction, 0);
+		}
+		/// <summary>
+		/// Emits a call of the plain function taking two arguments.
+		/// </summary>
+		void EmitFunction(ExpressionProgram::BinaryFunction function)
+		{
+			ExpressionProgram::Instruction instruction(ExpressionProgram::op_binary_function);
+			instruction.binaryFunction = function;
+			Emit(instruction, -1);
+		}
+		/// <summary>
+		/// Emits a jump (op_jump, op_jump_if_false or op_jump_if_true) whose target is set later by calling SetJumpTarget with the returned label.
+		/// </summary>
+		size_t EmitJump(ExpressionProgram::opcode code)
+		{
+			Emit(ExpressionProgram::Instruction(code), code == ExpressionProgram::op_jump ? 0 : -1);
+			return program_.code_.size() - 1;
+		}
+		/// <summary>
+		/// Lets the jump with the given label continue at the next emitted instruction.
+		/// </summary>
+		void SetJumpTarget(size_t label)
+		{
+			program_.code_[label].target = static_cast<unsigned int>(program_.code_.size());
+		}
+		/// <summary>
+		/// Returns the number of values currently on the stack. Code paths joined by a jump must leave the same number of values on the stack. Thus, branches which are not executed
+		/// after a jump must reset the depth to the one at the jump.
+		/// </summary>
+		size_t GetDepth() const noexcept
+		{
+			return depth_;
+		}
+		void SetDepth(size_t depth) noexcept
+		{
+			depth_ = depth;
+		}
+	private:
+		ExpressionProgram program_;
+		SlotRegister slotRegister_;
+		size_t depth_ = 0;
+		size_t maxDepth_ = 0;
+
+		void Emit(const ExpressionProgram::Instruction& instruction, int stackChange)
+		{
+			program_.code_.push_back(instruction);
+			depth_ += stackChange;
+			if (depth_ > maxDepth_)
+				maxDepth_ = depth_;
+		}
+	};
+}
@@ -1,6 +1,7 @@
 #pragma once
 #include <memory>
 #include "expression_common.h"
+#include "ExpressionProgram.h"
 #include "NumberExpression.h"
 namespace expression
 {
@@ -37,6 +38,26 @@ namespace expression
 			errorMessage << "Function with name \"" << name_ << "\" is unknown.";
 			throw std::exception(errorMessage.str().c_str());
 		}
+		virtual void Compile(ExpressionCompiler& compiler) const override
+		{
+			if (elems_.empty() && compiler.EmitVariable(name_ + "()"))
+				return;
+			auto nativeFunction = evalFunction_ && evalFunction_->GetNumArguments() == elems_.size() ? evalFunction_->GetNativeFunction() : nullptr;
+			if (nativeFunction && (elems_.size() == 1 || elems_.size() == 2))
+			{
+				for (auto& elem : elems_)
+				{
+					elem->Compile(compiler);
+				}
+				if (elems_.size() == 1)
+					compiler.EmitFunction(reinterpret_cast<ExpressionProgram::UnaryFunction>(nativeFunction));
+				else
+					compiler.EmitFunction(reinterpret_cast<ExpressionProgram::BinaryFunction>(nativeFunction));
+				return;
+			}
+			// Functions with other numbers of arguments, or which are not plain functions, are evaluated via their bindings.
+			compiler.EmitEvaluate(*this);
+		}
 		virtual std::unique_ptr<IExpression> Simplify(const VariableRegister& variableRegister) const override
 		{
 			std::vector<std::unique_ptr<IExpression>> simElems;
@@ -0,0 +1,202 @@
+#pragma once
+#include <limits>
+#include <algorithm>
+#include <cmath>
+#include "expression_common.h"
+namespace expression
+{
+	/// <summary>
+	/// Closed interval [lower, upper] of numbers, used to evaluate expressions in interval arithmetic (see ExpressionProgram::EvalInterval). The result of an operation on intervals contains
+	/// the results of the operation for all numbers in the argument intervals. Intervals with lower == upper represent single numbers, for which the operations yield exactly the same
+	/// results as the respective operations on numbers.
+	/// </summary>
+	struct Interval
+	{
+		number lower;
+		number upper;
+
+		Interval() noexcept : lower(0), upper(0)
+		{
+		}
+		Interval(number value) noexcept : lower(value), upper(value)
+		{
+		}
+		Interval(number lower, number upper) noexcept : lower(lower), upper(upper)
+		{
+		}
+		/// <summary>
+		/// Returns the interval containing all numbers, which is the result of operations which cannot be bounded.
+		/// </summary>
+		static Interval Entire() noexcept
+		{
+			return Interval(-std::numeric_limits<number>::infinity(), std::numeric_limits<number>::infinity());
+		}
+		/// <summary>
+		/// Returns the smallest interval containing the intervals a and b.
+		/// </summary>
+		static Interval Hull(const Interval& a, const Interval& b) noexcept
+		{
+			return Interval(std::min(a.lower, b.lower), std::max(a.upper, b.upper));
+		}
+		/// <summary>
+		/// Returns the smallest interval containing all of the given values. If any of the values is NaN, the entire interval is returned.
+		/// </summary>
+		static Interval Hull(number a, number b, number c, number d) noexcept
+		{
+			if (std::isnan(a) || std::isnan(b) || std::isnan(c) || std::isnan(d))
+				return Entire();
+			return Interval(std::min(std::min(a, b), std::min(c, d)), std::max(std::max(a, b), std::max(c, d)));
+		}
+		bool IsPoint() const noexcept
+		{
+			return lower == upper;
+		}
+		bool Contains(number value) const noexcept
+		{
+			return lower <= value && value <= upper;
+		}
+		/// <summary>
+		/// Returns true if all numbers in the interval are true, i.e. differ from number_false.
+		/// </summary>
+		bool IsTrue() const noexcept
+		{
+			return !Contains(number_false);
+		}
+		/// <summary>
+		/// Returns true if all numbers in the interval are false.
+		/// </summary>
+		bool IsFalse() const noexcept
+		{
+			return lower == number_false && upper == number_false;
+		}
+	};
+
+	/// <summary>
+	/// Interval representing a boolean which is true, false, or unknown.
+	/// </summary>
+	inline Interval makeBooleanInterval(bool certainlyTrue, bool certainlyFalse) noexcept
+	{
+		if (certainlyTrue)
+			return Interval(number_true);
+		else if (certainlyFalse)
+			return Interval(number_false);
+		return Interval(std::min(number_false, number_true), std::max(number_false, number_true));
+	}
+	/// <summary>
+	/// Product of two bounds, where zero times infinity is zero, since the infinite bound is never attained.
+	/// </summary>
+	inline number multiplyBounds(number a, number b) noexcept
+	{
+		return a == 0 || b == 0 ? 0 : a * b;
+	}
+
+	inline Interval operator+(const Interval& a, const Interval& b) noexcept
+	{
+		return Interval(a.lower + b.lower, a.upper + b.upper);
+	}
+	inline Interval operator-(const Interval& a) noexcept
+	{
+		return Interval(-a.upper, -a.lower);
+	}
+	inline Interval operator-(const Interval& a, const Interval& b) noexcept
+	{
+		return Interval(a.lower - b.upper, a.upper - b.lower);
+	}
+	inline Interval operator*(const Interval& a, const Interval& b) noexcept
+	{
+		if (a.IsPoint() && b.IsPoint())
+			return Interval(a.lower * b.lower);
+		if (a.lower >= 0 && b.lower >= 0)
+			return Interval(multiplyBounds(a.lower, b.lower), multiplyBounds(a.upper, b.upper));
+		return Interval::Hull(multiplyBounds(a.lower, b.lower), multiplyBounds(a.lower, b.upper), multiplyBounds(a.upper, b.lower), multiplyBounds(a.upper, b.upper));
+	}
+	/// <summary>
+	/// Returns the interval containing 1/x for all x in the argument. If the argument contains zero, the entire interval is returned.
+	/// </summary>
+	inline Interval reciprocal(const Interval& a) noexcept
+	{
+		if (a.IsPoint())
+			return Interval(1 / a.lower);
+		if (a.Contains(0))
+			return Interval::Entire();
+		return Interval(1 / a.upper, 1 / a.lower);
+	}
+	inline Interval operator/(const Interval& a, const Interval& b) noexcept
+	{
+		if (a.IsPoint() && b.IsPoint())
+			return Interval(a.lower / b.lower);
+		return a * reciprocal(b);
+	}
+	/// <summary>
+	/// Returns the interval containing pow(x, y) for all x in base and y in exponent.
+	/// </summary>
+	inline Interval power(const Interval& base, const Interval& exponent) noexcept
+	{
+		if (base.IsPoint() && exponent.IsPoint())
+			return Interval(::pow(base.lower, exponent.lower));
+		// For non-negative bases, pow is monotonic in both arguments, such that the extrema are attained at the corners.
+		if (base.lower >= 0)
+			return Interval::Hull(::pow(base.lower, exponent.lower), ::pow(base.lower, exponent.upper), ::pow(base.upper, exponent.lower), ::pow(base.upper, exponent.upper));
+		// Negative bases are only defined for integer exponents.
+		if (!exponent.IsPoint() || exponent.lower != ::floor(exponent.lower))
+			return Interval::Entire();
+		if (exponent.lower == 0)
+			return Interval(1);
+		const number lowerPow = ::pow(base.lower, exponent.lower);
+		const number upperPow = ::pow(base.upper, exponent.lower);
+		if (!base.Contains(0))
+			return Interval::Hull(lowerPow, upperPow, lowerPow, upperPow);
+		// Negative exponents have their pole, and positive even exponents their minimum, at zero.
+		if (exponent.lower < 0)
+			return Interval::Entire();
+		if (::fmod(exponent.lower, 2) == 0)
+			return Interval(0, std::max(lowerPow, upperPow));
+		return Interval(lowerPow, upperPow);
+	}
+	inline Interval operator==(const Interval& a, const Interval& b) noexcept
+	{
+		return makeBooleanInterval(a.IsPoint() && b.IsPoint() && a.lower == b.lower, a.upper < b.lower || b.upper < a.lower);
+	}
+	inline Interval operator!=(const Interval& a, const Interval& b) noexcept
+	{
+		return makeBooleanInterval(a.upper < b.lower || b.upper < a.lower, a.IsPoint() && b.IsPoint() && a.lower == b.lower);
+	}
+	inline Interval operator>(const Interval& a, const Interval& b) noexcept
+	{
+		return makeBooleanInterval(a.lower > b.upper, a.upper <= b.lower);
+	}
+	inline Interval operator>=(const Interval& a, const Interval& b) noexcept
+	{
+		return makeBooleanInterval(a.lower >= b.upper, a.upper < b.lower);
+	}
+	inline Interval operator<(const Interval& a, const Interval& b) noexcept
+	{
+		return b > a;
+	}
+	inline Interval operator<=(const Interval& a, const Interval& b) noexcept
+	{
+		return b >= a;
+	}
+	inline Interval operator!(const Interval& a) noexcept
+	{
+		return makeBooleanInterval(a.IsFalse(), a.IsTrue());
+	}
+
+	/// <summary>
+	/// Returns the interval containing function(x) for all x in argument. Intervals can be computed for all functions returned by makeDefaultFunctions. For unknown functions,
+	/// the entire interval is returned, unless the argument is a single number.
+	/// </summary>
+	/// <param name="function">Function to evaluate.</param>
+	/// <param name="argument">Interval of the argument.</param>
+	/// <returns>Interval of the function value.</returns>
+	Interval evalInterval(number(*function)(number), const Interval& argument) noexcept;
+	/// <summary>
+	/// Returns the interval containing function(x, y) for all x in first and y in second. Intervals can be computed for all functions returned by makeDefaultFunctions. For unknown functions,
+	/// the entire interval is returned, unless both arguments are single numbers.
+	/// </summary>
+	/// <param name="function">Function to evaluate.</param>
+	/// <param name="first">Interval of the first argument.</param>
+	/// <param name="second">Interval of the second argument.</param>
+	/// <returns>Interval of the function value.</returns>
+	Interval evalInterval(number(*function)(number, number), const Interval& first, const Interval& second) noexcept;
+}
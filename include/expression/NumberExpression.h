@@ -1,6 +1,7 @@
 #pragma once
 #include <memory>
 #include "expression_common.h"
+#include "ExpressionProgram.h"
 namespace expression
 {
 	/// <summary>
@@ -16,6 +17,10 @@ namespace expression
 		{
 			return number_;
 		}
+		virtual void Compile(ExpressionCompiler& compiler) const override
+		{
+			compiler.EmitConstant(number_);
+		}
 		virtual std::unique_ptr<IExpression> Clone() const override
 		{
 			return std::make_unique<NumberExpression>(number_);
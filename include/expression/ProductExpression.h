@@ -1,6 +1,7 @@
 #pragma once
 #include <memory>
 #include "expression_common.h"
+#include "ExpressionProgram.h"
 #include "NumberExpression.h"
 #include "UnaryDivideExpression.h"
 namespace expression
@@ -37,6 +38,16 @@ namespace expression
 			}
 			return sum;
 		}
+		virtual void Compile(ExpressionCompiler& compiler) const override
+		{
+			// Same order of operations as Eval, such that the program yields bit-identical results.
+			compiler.EmitConstant(baseValue_);
+			for (auto& elem : elems_)
+			{
+				elem.GetExpression()->Compile(compiler);
+				compiler.EmitOperation(elem.IsNotInverse() ? ExpressionProgram::op_multiply : ExpressionProgram::op_divide);
+			}
+		}
 		virtual std::unique_ptr<IExpression> Simplify(const VariableRegister& variableRegister) const override
 		{
 			auto value = baseValue_;
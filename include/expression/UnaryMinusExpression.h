@@ -1,6 +1,7 @@
 #pragma once
 #include <memory>
 #include "expression_common.h"
+#include "ExpressionProgram.h"
 #include "NumberExpression.h"
 namespace expression
 {
@@ -19,6 +20,11 @@ namespace expression
 		{
 			return -expression_->Eval();
 		}
+		virtual void Compile(ExpressionCompiler& compiler) const override
+		{
+			expression_->Compile(compiler);
+			compiler.EmitOperation(ExpressionProgram::op_negate);
+		}
 		virtual std::unique_ptr<IExpression> Clone() const override
 		{
 			return std::make_unique<UnaryMinusExpression>(expression_->Clone());
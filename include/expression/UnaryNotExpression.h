@@ -1,6 +1,7 @@
 #pragma once
 #include <memory>
 #include "expression_common.h"
+#include "ExpressionProgram.h"
 #include "NumberExpression.h"
 namespace expression
 {
@@ -19,6 +20,11 @@ namespace expression
 		{
 			return isTrue(expression_->Eval()) ? number_false : number_true;
 		}
+		virtual void Compile(ExpressionCompiler& compiler) const override
+		{
+			expression_->Compile(compiler);
+			compiler.EmitOperation(ExpressionProgram::op_not);
+		}
 		virtual std::unique_ptr<IExpression> Clone() const override
 		{
 			return std::make_unique<UnaryNotExpression>(expression_->Clone());
@@ -1,6 +1,7 @@
 #pragma once
 #include <memory>
 #include "expression_common.h"
+#include "ExpressionProgram.h"
 #include "NumberExpression.h"
 namespace expression
 {
@@ -24,6 +25,11 @@ namespace expression
 			errorMessage << "Expression contains unbound variable with name \"" << name_ << "\".";
 			throw std::exception(errorMessage.str().c_str());
 		}
+		virtual void Compile(ExpressionCompiler& compiler) const override
+		{
+			if (!compiler.EmitVariable(name_))
+				compiler.EmitEvaluate(*this);
+		}
 		virtual std::unique_ptr<IExpression> Simplify(const VariableRegister& variableRegister) const override
 		{
 			auto newVal = variableRegister(name_);
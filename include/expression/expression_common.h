@@ -10,6 +10,7 @@
 namespace expression
 {
 	class IExpression;
+	class ExpressionCompiler;
 
 	typedef double number;
 	typedef std::string identifier;
@@ -153,6 +154,19 @@ namespace expression
 		/// </summary>
 		/// <returns>True if value might be different when called with the same arguments at different times, false if the result is guaranteed to always be the same.</returns>
 		virtual bool IsMutable() const noexcept = 0;
+		/// <summary>
+		/// Generic function pointer type, which has to be cast back to the actual signature number(*)(number, ...) before being called.
+		/// </summary>
+		typedef void(*NativeFunction)();
+		/// <summary>
+		/// Returns a pointer to the function hold by this object if it is a plain function taking GetNumArguments() numbers and returning a number,
+		/// such that it can be called directly without packing the arguments into a vector. Returns nullptr otherwise.
+		/// </summary>
+		/// <returns>Pointer to plain function, or nullptr.</returns>
+		virtual NativeFunction GetNativeFunction() const noexcept
+		{
+			return nullptr;
+		}
 	};
 	/// <summary>
 	/// Specialization of function_holder_base to hold a function having a specific number of arguments, parametrized by Args.
@@ -165,14 +179,23 @@ namespace expression
 		/// Creates a function holder for the given function, which simply stores the function.
 		/// </summary>
 		/// <param name="function">Function to be stored.</param>
-		FunctionHolderImpl(std::function<number(Args...)>&& function, bool mutableFunction) : function_(std::move(function)), mutableFunction_(mutableFunction)
+		FunctionHolderImpl(std::function<number(Args...)>&& function, bool mutableFunction) : function_(std::move(function)), mutableFunction_(mutableFunction), nativeFunction_(nullptr)
+		{
+		}
+		FunctionHolderImpl(const std::function<number(Args...)>& function, bool mutableFunction) : function_(function), mutableFunction_(mutableFunction), nativeFunction_(nullptr)
 		{
 		}
-		FunctionHolderImpl(const std::function<number(Args...)>& function, bool mutableFunction) : function_(function), mutableFunction_(mutableFunction)
+		/// <summary>
+		/// Creates a function holder for the given plain function.
+		/// </summary>
+		/// <param name="function">Function to be stored.</param>
+		FunctionHolderImpl(number(*function)(Args...), bool mutableFunction) : function_(function), mutableFunction_(mutableFunction), nativeFunction_(function)
 		{
 		}
 		virtual std::unique_ptr<IFunctionHolder> Clone() const override
 		{
+			if (nativeFunction_)
+				return std::unique_ptr<IFunctionHolder>(new FunctionHolderImpl<Args...>(nativeFunction_, mutableFunction_));
 			return std::unique_ptr<IFunctionHolder>(new FunctionHolderImpl<Args...>(function_, mutableFunction_));
 		}
 		virtual number Eval(const std::vector<number>& arguments) const override
@@ -193,10 +216,15 @@ namespace expression
 		{
 			return mutableFunction_;
 		}
+		virtual NativeFunction GetNativeFunction() const noexcept override
+		{
+			return reinterpret_cast<NativeFunction>(nativeFunction_);
+		}
 
 	private:
 		std::function<number(Args...)> function_;
 		bool mutableFunction_;
+		number(*nativeFunction_)(Args...);
 		template<size_t... Is> number CallHelper(const std::vector<number>& args, Indices<Is...>) const
 		{
 			// expand the indices pack Is, resulting in the function being called with args[0], args[1], ..., args[sizeof...(Args)-1].
@@ -244,8 +272,7 @@ namespace expression
 	template<typename ...Args> std::unique_ptr<IFunctionHolder> makeFunctionHolder(number (*function)(Args...), bool mutableFunction)
 	{
 		static_assert(IsNumbers<Args...>::value, "All function arguments must be of type stochsim::expression::number.");
-		std::function<number(Args...)> temp = function;
-		return std::unique_ptr<IFunctionHolder>(new FunctionHolderImpl<Args...>(std::move(temp), mutableFunction));
+		return std::unique_ptr<IFunctionHolder>(new FunctionHolderImpl<Args...>(function, mutableFunction));
 	}
 
 	/// <summary>
@@ -321,6 +348,12 @@ namespace expression
 		/// </summary>
 		/// <param name="bindingRegister">Register to determine binding function given a function or variable name.</param>
 		virtual void Bind(const BindingRegister& bindingRegister) = 0;
+		/// <summary>
+		/// Appends instructions to the compiler which evaluate this expression and push its value onto the stack of the program (see ExpressionProgram).
+		/// The default implementation emits a single instruction calling Eval, such that expressions which do not override this method can still be compiled.
+		/// </summary>
+		/// <param name="compiler">Compiler to which the instructions are appended.</param>
+		virtual void Compile(ExpressionCompiler& compiler) const;
 
 		/// <summary>
 		/// Prints a string representation in CMDL of this expression to the stream.
@@ -0,0 +1,209 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <fstream>
+#include "stochsim_common.h"
+namespace stochsim
+{
+	/// <summary>
+	/// Layout of the binary trajectory files written by BinaryStateLogger and read by BinaryTrajectoryReader. All numbers are stored in the byte order of the machine which wrote the file.
+	/// The file starts with a header:
+	///     char[8]   magic_ (without terminating zero)
+	///     uint32    version_
+	///     uint32    number of states
+	///     double    log period
+	///     uint64    number of rows per chunk
+	///     for each state: uint32 length of the name, followed by the characters of the name (not zero terminated)
+	///     zero bytes padding the header to a multiple of 8 bytes
+	/// The header is followed by the chunks, each holding the rows logged at consecutive times in columnar form:
+	///     uint64    number of rows in this chunk
+	///     double    time of each row
+	///     for each state: uint64 molecular number of the state in each row
+	/// All chunks except the last one contain exactly the number of rows per chunk specified in the header, such that the position of every row can be computed directly.
+	/// </summary>
+	struct BinaryTrajectoryFormat
+	{
+		static constexpr const char* magic_ = "STOCHTRJ";
+		static constexpr size_t magicLength_ = 8;
+		static constexpr uint32_t version_ = 1;
+	};
+
+	/// <summary>
+	/// A logger task which writes the concentration of all its supplied states to the disk in a chunked columnar binary format (see BinaryTrajectoryFormat). In contrast to the StateLogger,
+	/// the rows are collected in memory and written one chunk at a time, and no text has to be formatted or parsed, which makes fine grained logging and reading the results back much faster.
+	/// Typically, the resulting file is read with a BinaryTrajectoryReader.
+	/// </summary>
+	class BinaryStateLogger :
+		public ISnapshotLogger
+	{
+	public:
+		/// <summary>
+		/// Constructor.
+		/// </summary>
+		/// <param name="fileName">Name of the file, relative to the save folder of the simulation.</param>
+		/// <param name="rowsPerChunk">Number of rows collected in memory before they are written to the file. Set to zero to choose the number such that each chunk has approximately one megabyte.</param>
+		BinaryStateLogger(std::string fileName, size_t rowsPerChunk = 0) : fileName_(fileName), requestedRowsPerChunk_(rowsPerChunk), rowsPerChunk_(0), numRows_(0)
+		{
+		}
+		template <typename... T> BinaryStateLogger(std::string fileName, std::shared_ptr<IState> state, T... others) : BinaryStateLogger(fileName)
+		{
+			AddState(state, others...);
+		}
+		virtual ~BinaryStateLogger()
+		{
+			if (file_)
+			{
+				file_->close();
+				file_.reset();
+			}
+		}
+		virtual bool WritesToDisk() const override
+		{
+			return true;
+		}
+		virtual void WriteLog(ISimInfo& simInfo, double time) override
+		{
+			times_[numRows_] = time;
+			for (size_t s = 0; s < states_.size(); s++)
+			{
+				values_[s * rowsPerChunk_ + numRows_] = static_cast<uint64_t>(states_[s]->Num(simInfo));
+			}
+			if (++numRows_ == rowsPerChunk_)
+				WriteChunk();
+		}
+		virtual void WriteLog(double time, const size_t* values) override
+		{
+			times_[numRows_] = time;
+			for (size_t s = 0; s < states_.size(); s++)
+			{
+				values_[s * rowsPerChunk_ + numRows_] = static_cast<uint64_t>(values[s]);
+			}
+			if (++numRows_ == rowsPerChunk_)
+				WriteChunk();
+		}
+		virtual std::vector<std::shared_ptr<IState>> GetLoggedStates() const override
+		{
+			return states_;
+		}
+		std::string GetFileName() const
+		{
+			return fileName_;
+		}
+		void AddState(std::shared_ptr<IState> state)
+		{
+			states_.push_back(std::move(state));
+		}
+		template <typename... T> void AddState(std::shared_ptr<IState> state, T... others)
+		{
+			AddState(state);
+			AddState(others...);
+		}
+		virtual void Initialize(ISimInfo& simInfo) override
+		{
+			if (file_)
+			{
+				file_->close();
+				file_.reset();
+			}
+			std::string fileName = simInfo.GetSaveFolder();
+			fileName += "/";
+			fileName += fileName_;
+
+			file_ = std::make_unique<std::ofstream>();
+			file_->open(fileName, std::ios::out | std::ios::binary | std::ios::trunc);
+			if (!file_->is_open())
+			{
+				std::string errorMessage = "Could not open file ";
+				errorMessage += fileName;
+				throw std::exception(errorMessage.c_str());
+			}
+
+			rowsPerChunk_ = requestedRowsPerChunk_;
+			if (rowsPerChunk_ == 0)
+			{
+				rowsPerChunk_ = defaultChunkBytes_ / (sizeof(double) * (states_.size() + 1));
+				if (rowsPerChunk_ == 0)
+					rowsPerChunk_ = 1;
+			}
+			times_.assign(rowsPerChunk_, 0);
+			values_.assign(rowsPerChunk_ * states_.size(), 0);
+			numRows_ = 0;
+
+			std::vector<char> header(BinaryTrajectoryFormat::magic_, BinaryTrajectoryFormat::magic_ + BinaryTrajectoryFormat::magicLength_);
+			Append(header, BinaryTrajectoryFormat::version_);
+			Append(header, static_cast<uint32_t>(states_.size()));
+			Append(header, simInfo.GetLogPeriod());
+			Append(header, static_cast<uint64_t>(rowsPerChunk_));
+			for (const auto& state : states_)
+			{
+				std::string name = state->GetName();
+				Append(header, static_cast<uint32_t>(name.size()));
+				header.insert(header.end(), name.begin(), name.end());
+			}
+			// Align the chunks to 8 bytes, such that their columns can be accessed in place when the file is memory mapped.
+			header.resize((header.size() + 7) / 8 * 8, 0);
+			file_->write(header.data(), header.size());
+		}
+		virtual void Uninitialize(ISimInfo& simInfo) override
+		{
+			if (file_)
+			{
+				if (numRows_ > 0)
+					WriteChunk();
+				file_->close();
+				file_.reset();
+			}
+		}
+
+	private:
+		/// <summary>
+		/// Default size of a chunk if the number of rows per chunk is not specified.
+		/// </summary>
+		static constexpr size_t defaultChunkBytes_ = 1 << 20;
+
+		template<typename T> static void Append(std::vector<char>& buffer, T value)
+		{
+			const char* bytes = reinterpret_cast<const char*>(&value);
+			buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+		}
+		/// <summary>
+		/// Writes the rows collected so far as one chunk, and starts a new chunk. If the chunk is not full, which can only happen for the last chunk, the columns are written without gaps.
+		/// </summary>
+		void WriteChunk()
+		{
+			const uint64_t numRows = numRows_;
+			file_->write(reinterpret_cast<const char*>(&numRows), sizeof(numRows));
+			file_->write(reinterpret_cast<const char*>(times_.data()), numRows_ * sizeof(double));
+			if (numRows_ == rowsPerChunk_)
+			{
+				file_->write(reinterpret_cast<const char*>(values_.data()), values_.size() * sizeof(uint64_t));
+			}
+			else
+			{
+				for (size_t s = 0; s < states_.size(); s++)
+				{
+					file_->write(reinterpret_cast<const char*>(values_.data() + s * rowsPerChunk_), numRows_ * sizeof(uint64_t));
+				}
+			}
+			if (!*file_)
+			{
+				throw std::exception(("Could not write to file " + fileName_ + ".").c_str());
+			}
+			numRows_ = 0;
+		}
+
+		std::vector<std::shared_ptr<IState>> states_;
+		std::unique_ptr<std::ofstream> file_;
+		std::string fileName_;
+		/// <summary>
+		/// Times and molecular numbers of the rows of the current chunk. The molecular numbers are stored state by state, with rowsPerChunk_ entries per state.
+		/// </summary>
+		std::vector<double> times_;
+		std::vector<uint64_t> values_;
+		size_t requestedRowsPerChunk_;
+		size_t rowsPerChunk_;
+		size_t numRows_;
+	};
+}
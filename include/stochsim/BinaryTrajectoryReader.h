@@ -0,0 +1,172 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <cstdint>
+#include "BinaryStateLogger.h"
+namespace stochsim
+{
+	/// <summary>
+	/// Reads trajectories written by a BinaryStateLogger. The file is memory mapped instead of being read into memory, such that opening even large files is fast, and the columns
+	/// of the trajectory can be accessed in place without copying. Only the pages actually accessed are loaded by the operating system.
+	/// Usage:
+	/// <code>
+	///		BinaryTrajectoryReader reader("simulations/states.bin");
+	///		for (size_t chunk = 0; chunk < reader.GetNumChunks(); chunk++)
+	///		{
+	///			const double* times = reader.GetChunkTimes(chunk);
+	///			const uint64_t* values = reader.GetChunkValues(chunk, 0);
+	///			for (size_t row = 0; row < reader.GetNumRows(chunk); row++)
+	///				std::cout << times[row] << ": " << values[row] << std::endl;
+	///		}
+	/// </code>
+	/// </summary>
+	class BinaryTrajectoryReader
+	{
+	public:
+		/// <summary>
+		/// Opens and memory maps the given file, and reads its header. Throws an exception if the file cannot be opened or is not a valid trajectory file.
+		/// A last chunk which was only partially written, e.g. because the simulation was aborted, is ignored.
+		/// </summary>
+		/// <param name="fileName">Path of the file.</param>
+		explicit BinaryTrajectoryReader(const std::string& fileName);
+		virtual ~BinaryTrajectoryReader();
+		BinaryTrajectoryReader(const BinaryTrajectoryReader&) = delete;
+		BinaryTrajectoryReader& operator=(const BinaryTrajectoryReader&) = delete;
+
+		/// <summary>
+		/// Returns the names of the states, in the order of the columns.
+		/// </summary>
+		/// <returns>Names of the states.</returns>
+		const std::vector<std::string>& GetStateNames() const noexcept
+		{
+			return stateNames_;
+		}
+		/// <summary>
+		/// Returns the number of states, i.e. the number of columns without the time column.
+		/// </summary>
+		/// <returns>Number of states.</returns>
+		size_t GetNumStates() const noexcept
+		{
+			return stateNames_.size();
+		}
+		/// <summary>
+		/// Returns the index of the column of the state with the given name. Throws an exception if no such state exists.
+		/// </summary>
+		/// <param name="name">Name of the state.</param>
+		/// <returns>Index of the column of the state.</returns>
+		size_t GetStateIndex(const std::string& name) const;
+		/// <summary>
+		/// Returns the log period of the simulation which wrote the file.
+		/// </summary>
+		/// <returns>Log period.</returns>
+		double GetLogPeriod() const noexcept
+		{
+			return logPeriod_;
+		}
+		/// <summary>
+		/// Returns the total number of rows, i.e. of logged time points.
+		/// </summary>
+		/// <returns>Number of rows.</returns>
+		size_t GetNumRows() const noexcept
+		{
+			return numRows_;
+		}
+		/// <summary>
+		/// Returns the time of the given row.
+		/// </summary>
+		/// <param name="row">Index of the row. Must be smaller than GetNumRows().</param>
+		/// <returns>Time of the row.</returns>
+		double GetTime(size_t row) const noexcept
+		{
+			return GetChunkTimes(row / rowsPerChunk_)[row % rowsPerChunk_];
+		}
+		/// <summary>
+		/// Returns the molecular number of the given state in the given row.
+		/// </summary>
+		/// <param name="row">Index of the row. Must be smaller than GetNumRows().</param>
+		/// <param name="state">Index of the column of the state. Must be smaller than GetNumStates().</param>
+		/// <returns>Molecular number of the state.</returns>
+		uint64_t GetValue(size_t row, size_t state) const noexcept
+		{
+			return GetChunkValues(row / rowsPerChunk_, state)[row % rowsPerChunk_];
+		}
+		/// <summary>
+		/// Returns the number of chunks. All chunks except the last one contain GetRowsPerChunk() rows.
+		/// </summary>
+		/// <returns>Number of chunks.</returns>
+		size_t GetNumChunks() const noexcept
+		{
+			return (numRows_ + rowsPerChunk_ - 1) / rowsPerChunk_;
+		}
+		/// <summary>
+		/// Returns the number of rows of all chunks except the last one.
+		/// </summary>
+		/// <returns>Number of rows per chunk.</returns>
+		size_t GetRowsPerChunk() const noexcept
+		{
+			return rowsPerChunk_;
+		}
+		/// <summary>
+		/// Returns the number of rows of the given chunk.
+		/// </summary>
+		/// <param name="chunk">Index of the chunk. Must be smaller than GetNumChunks().</param>
+		/// <returns>Number of rows of the chunk.</returns>
+		size_t GetNumRows(size_t chunk) const noexcept
+		{
+			return chunk + 1 < GetNumChunks() ? rowsPerChunk_ : numRows_ - chunk * rowsPerChunk_;
+		}
+		/// <summary>
+		/// Returns a pointer to the times of the rows of the given chunk, pointing directly into the mapped file. Valid as long as the reader exists.
+		/// </summary>
+		/// <param name="chunk">Index of the chunk. Must be smaller than GetNumChunks().</param>
+		/// <returns>Times of the rows of the chunk, GetNumRows(chunk) values.</returns>
+		const double* GetChunkTimes(size_t chunk) const noexcept
+		{
+			return reinterpret_cast<const double*>(data_ + ChunkOffset(chunk) + sizeof(uint64_t));
+		}
+		/// <summary>
+		/// Returns a pointer to the molecular numbers of the given state in the rows of the given chunk, pointing directly into the mapped file. Valid as long as the reader exists.
+		/// </summary>
+		/// <param name="chunk">Index of the chunk. Must be smaller than GetNumChunks().</param>
+		/// <param name="state">Index of the column of the state. Must be smaller than GetNumStates().</param>
+		/// <returns>Molecular numbers of the state in the rows of the chunk, GetNumRows(chunk) values.</returns>
+		const uint64_t* GetChunkValues(size_t chunk, size_t state) const noexcept
+		{
+			return reinterpret_cast<const uint64_t*>(data_ + ChunkOffset(chunk) + sizeof(uint64_t) + (state + 1) * GetNumRows(chunk) * sizeof(uint64_t));
+		}
+
+	private:
+		/// <summary>
+		/// Returns the offset of the given chunk from the beginning of the file.
+		/// </summary>
+		inline size_t ChunkOffset(size_t chunk) const noexcept
+		{
+			return dataOffset_ + chunk * (sizeof(uint64_t) + rowsPerChunk_ * (GetNumStates() + 1) * sizeof(uint64_t));
+		}
+		/// <summary>
+		/// Maps the given file into memory, setting data_ and size_.
+		/// </summary>
+		void Map(const std::string& fileName);
+		/// <summary>
+		/// Releases the mapping of the file, if any.
+		/// </summary>
+		void Unmap() noexcept;
+		/// <summary>
+		/// Reads the header and determines the number of complete rows.
+		/// </summary>
+		void ReadHeader(const std::string& fileName);
+
+		const char* data_;
+		size_t size_;
+		/// <summary>
+		/// Platform specific handles of the file and the mapping.
+		/// </summary>
+		void* fileHandle_;
+		void* mappingHandle_;
+		std::vector<std::string> stateNames_;
+		double logPeriod_;
+		size_t rowsPerChunk_;
+		size_t dataOffset_;
+		size_t numRows_;
+	};
+}
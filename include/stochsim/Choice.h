@@ -58,7 +58,19 @@ namespace stochsim
 						propertyExpression.Uninitialize(simInfo);
 				}
 			}
-			inline Molecule operator() (ISimInfo& simInfo, const std::vector<Variable>& variables = {}) const
+			/// <summary>
+			/// Returns true if any property of the produced molecules is set by an expression, i.e. if the produced molecules might differ.
+			/// </summary>
+			inline bool HasPropertyExpressions() const noexcept
+			{
+				for (const auto& propertyExpression : propertyExpressions_)
+				{
+					if (propertyExpression)
+						return true;
+				}
+				return false;
+			}
+			inline Molecule operator() (ISimInfo& simInfo, const Variables& variables = {}) const
 			{
 				Molecule molecule;
 				for (size_t i = 0; i < Molecule::size_; i++)
@@ -108,41 +120,33 @@ namespace stochsim
 		}
 		virtual void Add(ISimInfo& simInfo, const Molecule& molecule = defaultMolecule, const Variables& variables = {}) override
 		{
+			AddN(simInfo, 1, molecule, variables);
+		}
+		virtual void AddN(ISimInfo& simInfo, size_t num, const Molecule& molecule = defaultMolecule, const Variables& variables = {}) override
+		{
+			if (num == 0)
+				return;
 			if (!addListeners_.empty())
 			{
 				double time = simInfo.GetSimTime();
 				for (auto& addListener : addListeners_)
 				{
-					addListener(molecule, time);
+					addListener(molecule, time, num);
 				}
 			}
 
-			// Find out which choice was made by evaluating the formula with the current variable values.
-			expression::number choice = choiceEquation_(simInfo, variables);
-			
-			// Depending of the choice, either increase one or the other sets of products.
-			if (choice != 0)
+			// Find out which choice was made for each molecule by evaluating the formula with the current variable values. Since the formula might contain random numbers,
+			// it has to be evaluated once per molecule, but the products of both sets can then be increased in bulk.
+			size_t numTrue = 0;
+			for (size_t i = 0; i < num; i++)
 			{
-				for (const auto& product : elementsIfTrue_)
-				{
-					Molecule molecule = product(simInfo, variables);
-					for (size_t i = 0; i < product.stochiometry_; i++)
-					{
-						product.state_->Add(simInfo, molecule, variables);
-					}
-				}
-			}
-			else
-			{
-				for (const auto& product : elementsIfFalse_)
-				{
-					Molecule molecule = product(simInfo, variables);
-					for (size_t i = 0; i < product.stochiometry_; i++)
-					{
-						product.state_->Add(simInfo, molecule, variables);
-					}
-				}
+				if (choiceEquation_(simInfo, variables) != 0)
+					numTrue++;
 			}
+			
+			// Depending of the choices, increase one or the other sets of products.
+			AddProducts(simInfo, elementsIfTrue_, numTrue, variables);
+			AddProducts(simInfo, elementsIfFalse_, num - numTrue, variables);
 		}
 		virtual const Molecule& Peak(ISimInfo& simInfo) const override
 		{
@@ -156,6 +160,14 @@ namespace stochsim
 		{
 			throw std::exception("Choices must only be used as products of a reaction, not as transformees (i.e. Transform must not be called).");
 		}
+		virtual void RemoveN(ISimInfo& simInfo, size_t num, const Variables& variables = {}) override
+		{
+			throw std::exception("Choices must only be used as products of a reaction, not as reactants (i.e. RemoveN must not be called).");
+		}
+		virtual void TransformN(ISimInfo& simInfo, size_t num, std::vector<Molecule*>& molecules, const Variables& variables = {}) override
+		{
+			throw std::exception("Choices must only be used as products of a reaction, not as transformees (i.e. TransformN must not be called).");
+		}
 		virtual void Initialize(ISimInfo& simInfo) override
 		{
 			for (auto& product : elementsIfTrue_)
@@ -329,6 +341,29 @@ namespace stochsim
 		}
 
 	private:
+		/// <summary>
+		/// Increases the given products according to their stochiometry, as if the choice was made num times with the same outcome.
+		/// </summary>
+		inline void AddProducts(ISimInfo& simInfo, const std::vector<Product>& products, size_t num, const Variables& variables)
+		{
+			if (num == 0)
+				return;
+			for (const auto& product : products)
+			{
+				if (!product.HasPropertyExpressions())
+				{
+					product.state_->AddN(simInfo, num * product.stochiometry_, defaultMolecule, variables);
+					continue;
+				}
+				// The property expressions might contain random numbers, such that they have to be evaluated for every choice separately.
+				for (size_t i = 0; i < num; i++)
+				{
+					Molecule molecule = product(simInfo, variables);
+					product.state_->AddN(simInfo, product.stochiometry_, molecule, variables);
+				}
+			}
+		}
+
 		const std::string name_;
 		ExpressionHolder choiceEquation_;
 		std::vector<Product> elementsIfTrue_;
@@ -9,10 +9,12 @@ namespace stochsim
 
 	/// <summary>
 	/// An implementation of a circular buffer which automatically doubles its capacity when it is full.
+	/// The capacity is always a power of two, such that positions wrap around by masking instead of by a division. When the buffer grows, the two contiguous parts of the
+	/// buffer (from the first element to the end of the storage, and from the beginning of the storage to the last element) are moved as two blocks, which for trivially copyable
+	/// elements amounts to two memory copies.
 	/// </summary>
 	template<class T> class CircularBuffer
 	{
-		constexpr static double sizeChangeFactor = 1.5;
 	public:
 		typedef CircularBufferIterator<T> iterator;
 		typedef CircularBufferIterator<const T> const_iterator;
@@ -35,36 +37,31 @@ namespace stochsim
 			return const_iterator(this, Size()); 
 		}
 
-		CircularBuffer(size_type initialCapacity = 1000) : capacity_(initialCapacity), elements_(initialCapacity), start_(0), end_(0)
+		CircularBuffer(size_type initialCapacity = 1000) : elements_(RoundUpCapacity(initialCapacity)), mask_(elements_.size() - 1), start_(0), size_(0)
 		{
 		}
 		inline void Clear()
 		{
 			start_ = 0;
-			end_ = 0;
+			size_ = 0;
 		}
 		inline size_type Size() const
 		{
-			return (end_ + capacity_ - start_) % capacity_;
+			return size_;
 		}
 		inline T& PushTail()
 		{
-			size_type oldEnd = end_;
-			end_ = (end_ + 1) % capacity_;
-			if (end_ == start_)
-			{
-				doupleCapacity();
-				return elements_[end_-1];
-			}
-			else
-				return elements_[oldEnd];
+			if (size_ > mask_)
+				DoubleCapacity();
+			return elements_[(start_ + size_++) & mask_];
 		}
 
 		inline void PopTop(size_type num=1)
 		{
-			if (end_ == start_)
+			if (num > size_)
 				throw std::exception("Circular buffer empty!");
-			start_ = (start_ + num) % capacity_;
+			start_ = (start_ + num) & mask_;
+			size_ -= num;
 		}
 		/// <summary>
 		/// Returns the pos^th element in the buffer. 
@@ -73,7 +70,7 @@ namespace stochsim
 		/// <returns>pos^th element in the buffer.</returns>
 		inline T& operator[](size_type pos)
 		{
-			return elements_[(start_ + pos) % capacity_];
+			return elements_[(start_ + pos) & mask_];
 		}
 
 		/// <summary>
@@ -83,7 +80,7 @@ namespace stochsim
 		/// <returns>pos^th element in the buffer.</returns>
 		inline const T& operator[](size_type pos) const
 		{
-			return elements_[(start_ + pos) % capacity_];
+			return elements_[(start_ + pos) & mask_];
 		}
 
 		/// <summary>
@@ -93,7 +90,7 @@ namespace stochsim
 		/// <returns>pos^th element in the buffer.</returns>
 		inline T& Get(size_type pos)
 		{
-			return elements_[(start_ + pos) % capacity_];
+			return elements_[(start_ + pos) & mask_];
 		}
 
 		/// <summary>
@@ -103,7 +100,7 @@ namespace stochsim
 		/// <returns>pos^th element in the buffer.</returns>
 		inline const T& Get(size_type pos) const
 		{
-			return elements_[(start_ + pos) % capacity_];
+			return elements_[(start_ + pos) & mask_];
 		}
 
 		/// <summary>
@@ -113,7 +110,7 @@ namespace stochsim
 		/// <param name="other">New value of pos^th element.</param>
 		inline void Set(size_type pos, const T& other)
 		{
-			elements_[(start_ + pos) % capacity_] = other;
+			elements_[(start_ + pos) & mask_] = other;
 		}
 		/// <summary>
 		/// Sets the pos^th element in the buffer
@@ -122,7 +119,7 @@ namespace stochsim
 		/// <param name="other">New value of pos^th element.</param>
 		inline void Set(size_type pos, T&& other)
 		{
-			elements_[(start_ + pos) % capacity_] = std::move(other);
+			elements_[(start_ + pos) & mask_] = std::move(other);
 		}
 
 		/// <summary>
@@ -138,27 +135,38 @@ namespace stochsim
 		}
 
 	private:
-		size_type start_;
-		size_type end_;
 		std::vector<T> elements_;
-		size_type capacity_;
+		/// <summary>
+		/// Capacity minus one, i.e. the mask mapping positions to indices in elements_.
+		/// </summary>
+		size_type mask_;
+		size_type start_;
+		size_type size_;
 
 		/// <summary>
-		/// Should only be called if vector is completely full.
+		/// Returns the smallest power of two which is at least the requested capacity, and at least two.
 		/// </summary>
-		void doupleCapacity()
+		static size_type RoundUpCapacity(size_type capacity) noexcept
 		{
-			assert(start_ == end_);
-			size_t newCapacity = static_cast<size_t>(capacity_ * sizeChangeFactor);
-			std::vector<T> temp(newCapacity);
-			for (size_type i = 0; i < capacity_; i++)
+			size_type result = 2;
+			while (result < capacity)
 			{
-				temp[i] = std::move(elements_[(start_ + i) % capacity_]);
+				result <<= 1;
 			}
+			return result;
+		}
+		/// <summary>
+		/// Should only be called if vector is completely full.
+		/// </summary>
+		void DoubleCapacity()
+		{
+			std::vector<T> temp(2 * elements_.size());
+			// The elements from start_ to the end of the storage come first, followed by the elements at the beginning of the storage.
+			auto middle = std::move(elements_.begin() + start_, elements_.end(), temp.begin());
+			std::move(elements_.begin(), elements_.begin() + start_, middle);
 			elements_ = std::move(temp);
+			mask_ = elements_.size() - 1;
 			start_ = 0;
-			end_ = capacity_;
-			capacity_ = newCapacity;
 		}
 	};
 
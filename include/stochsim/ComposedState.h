@@ -1,12 +1,14 @@
 #pragma once
 #include <vector>
+#include <deque>
+#include <sstream>
+#include <algorithm>
 #include <list>
 #include <string>
 #include <memory>
 #include <functional>
 #include <cassert>
 #include "stochsim_common.h"
-#include "CircularBuffer.h"
 namespace stochsim
 {	
 	/// <summary>
@@ -14,21 +16,20 @@ namespace stochsim
 	/// class represents something like a meta-state.
 	/// </summary>
 	class ComposedState:
-		public IState
+		public ITimedState
 	{
 	private:
 		struct MoleculeHolder
 		{
-			Molecule molecule;
 			/// <summary>
 			/// The simulation time when the molecule was created.
 			/// </summary>
 			double creationTime;
 			/// <summary>
-			/// True if the molecule is already deleted. Keeping this variable is necessary due to implementation details.
-			/// Molecules which are returned must always have invalidated=false.
+			/// Index of the next older, respectively newer, molecule, or none_ if this is the oldest, respectively newest, molecule.
 			/// </summary>
-			bool invalidated;
+			size_t older;
+			size_t newer;
 		};
 	public:
 		/// <summary>
@@ -36,34 +37,37 @@ namespace stochsim
 		/// </summary>
 		/// <param name="name">Name of the state.</param>
 		/// <param name="initialCondition">Initial number of molecules which are there when the simulation starts.</param>
-		/// <param name="initialCapacity">Initial maximum amount of molecules which are expected to be hold by this state. If the number of molecules increases over the maximum, the maximum is doubled which requires reallocation of space.</param>
-		/// <param name="initializer">Function which initilize the properties of a molecule whenever a new molecule of the species represented by this state is produced.</param>
-		/// <param name="modifier">Function which modifies the properties of a molecule whenever a molecule of the species represented by this state is modified, i.e.
-		/// when State::Modify is called on this state and a given molecule represented by this state was chosen to be modified.</param>
-		ComposedState(std::string name, size_t initialCondition, size_t initialCapacity = 1000) : name_(name), size_(0), initialCondition_(initialCondition), buffer_(initialCapacity>initialCondition ? initialCapacity : initialCondition)
+		/// <param name="initialCapacity">Initial maximum amount of molecules which are expected to be hold by this state. If the number of molecules increases over the maximum, the maximum is increased which requires reallocation of space.</param>
+		/// <param name="numProperties">Number of properties stored for each molecule. Must be smaller or equal to Molecule::size_. Properties with a higher index are always zero, and changes to them are discarded. Default = 2.</param>
+		ComposedState(std::string name, size_t initialCondition, size_t initialCapacity = 1000, size_t numProperties = 2) : name_(name), initialCondition_(initialCondition), numProperties_(numProperties), oldest_(none_), newest_(none_)
 		{
+			if (numProperties_ > Molecule::size_)
+			{
+				std::stringstream errorMessage;
+				errorMessage << "Composed state " << name_ << " cannot store " << numProperties_ << " properties per molecule (maximally allowed " << Molecule::size_ << ").";
+				throw std::exception(errorMessage.str().c_str());
+			}
+			const size_t capacity = initialCapacity > initialCondition ? initialCapacity : initialCondition;
+			molecules_.reserve(capacity);
+			properties_.reserve(capacity * numProperties_);
 		}
 
 		virtual void Initialize(ISimInfo& simInfo) override
 		{
-			buffer_.Clear();
-			size_ = GetInitialCondition();
-			for (size_t i = 0; i < size_; i++)
+			Clear();
+			double time = simInfo.GetSimTime();
+			for (size_t i = 0; i < GetInitialCondition(); i++)
 			{
-				MoleculeHolder& holder = buffer_.PushTail();
-				holder.molecule.Reset();
-				holder.creationTime = simInfo.GetSimTime();
-				holder.invalidated = false;
+				PushNewest(defaultMolecule, time);
 			}
 		}
 		virtual void Uninitialize(ISimInfo& simInfo) override
 		{
-			buffer_.Clear();
-			size_ = 0;
+			Clear();
 		}
 		virtual inline size_t Num(ISimInfo& simInfo) const override
 		{
-			return size_;
+			return molecules_.size();
 		}
 		virtual inline void AddDecreaseListener(StateListener stateListener) override
 		{
@@ -75,82 +79,87 @@ namespace stochsim
 		}
 		virtual void Add(ISimInfo& simInfo, const Molecule& molecule = defaultMolecule, const Variables& variables = {}) override
 		{
+			FlushTransformed();
 			if (!addListeners_.empty())
 			{
 				double time = simInfo.GetSimTime();
 				for (auto& addListener : addListeners_)
 				{
-					addListener(molecule, time);
+					addListener(molecule, time, 1);
 				}
 			}
-
-			MoleculeHolder& holder = buffer_.PushTail();
-			holder.molecule = molecule;
-			holder.creationTime = simInfo.GetSimTime();
-			holder.invalidated = false;
-			size_ ++;
+			PushNewest(molecule, simInfo.GetSimTime());
 		}
 
 		virtual Molecule Remove(ISimInfo& simInfo, const Variables& variables = {}) override
 		{
-			size_t idx = randomBufferIndex(simInfo);
-			if (idx == 0)
+			FlushTransformed();
+			return RemoveAt(simInfo, RandomIndex(simInfo));
+		}
+
+		virtual Molecule RemoveFirst(ISimInfo& simInfo, const Variables& variables = {}) override
+		{
+			FlushTransformed();
+			return RemoveAt(simInfo, oldest_);
+		}
+		virtual void AddN(ISimInfo& simInfo, size_t num, const Molecule& molecule = defaultMolecule, const Variables& variables = {}) override
+		{
+			if (num == 0)
+				return;
+			FlushTransformed();
+			double time = simInfo.GetSimTime();
+			for (auto& addListener : addListeners_)
 			{
-				return RemoveFirst(simInfo, variables);
+				addListener(molecule, time, num);
 			}
-			else
+			molecules_.reserve(molecules_.size() + num);
+			properties_.reserve(properties_.size() + num * numProperties_);
+			for (size_t i = 0; i < num; i++)
 			{
-				MoleculeHolder& holder = buffer_[idx];
-				if (!removeListeners_.empty())
-				{
-					double time = simInfo.GetSimTime();
-					for (auto& removeListener : removeListeners_)
-					{
-						removeListener(holder.molecule, time);
-					}
-				}
-				holder.invalidated = true;
-				size_--;
-				return holder.molecule;
+				PushNewest(molecule, time);
 			}
 		}
-
-		Molecule RemoveFirst(ISimInfo& simInfo, const Variables& variables = {})
+		virtual void RemoveN(ISimInfo& simInfo, size_t num, const Variables& variables = {}) override
 		{
-			Molecule molecule = buffer_[0].molecule;
-			if (!removeListeners_.empty())
+			FlushTransformed();
+			for (size_t i = 0; i < num; i++)
 			{
-				double time = simInfo.GetSimTime();
-				for (auto& removeListener : removeListeners_)
-				{
-					removeListener(molecule, time);
-				}
+				RemoveAt(simInfo, RandomIndex(simInfo));
 			}
-			// First element guaranteed to be valid.
-			buffer_.PopTop();
-			size_--;
-			// Remove new first element if it happens to be invalid to guarantee that first element is always valid.
-			while (buffer_.Size() > 0 && buffer_[0].invalidated)
+		}
+		virtual inline double PeakFirstCreationTime(ISimInfo& simInfo) const override
+		{
+			return molecules_[oldest_].creationTime;
+		}
+		virtual const Molecule& Peak(ISimInfo& simInfo) const
+		{
+			const size_t index = RandomIndex(simInfo);
+			// A molecule which is currently transformed has not yet been written back.
+			for (const auto& transformed : transformed_)
 			{
-				buffer_.PopTop();
+				if (transformed.first == index)
+					return transformed.second;
 			}
-			return molecule;
+			peaked_ = Load(index);
+			return peaked_;
 		}
 		/// <summary>
-		/// Returns the creation time of the first, that is, oldest molecule. Behavior undefined if size is zero.
+		/// Returns a copy of a random molecule. Changes to the copy are written back to the state before the next call to any other function modifying or reading the molecules of this state,
+		/// i.e. the returned reference stays valid at least until then.
 		/// </summary>
-		/// <returns>Creation time of oldest element</returns>
-		inline double PeakFirstCreationTime(ISimInfo& simInfo) const
+		virtual Molecule& Transform(ISimInfo& simInfo, const Variables& variables = {}) override
 		{
-			return buffer_[0].creationTime;
+			FlushTransformed();
+			return TransformNext(simInfo);
 		}
-		virtual const Molecule& Peak(ISimInfo& simInfo) const
-		{
-			return buffer_[randomBufferIndex(simInfo)].molecule;
-		}
-		virtual inline Molecule& Transform(ISimInfo& simInfo, const Variables& variables = {}) override
+		virtual void TransformN(ISimInfo& simInfo, size_t num, std::vector<Molecule*>& molecules, const Variables& variables = {}) override
 		{
-			return buffer_[randomBufferIndex(simInfo)].molecule;
+			// The copies of the previous firing are written back first, such that transformed_ never holds more molecules than the stochiometry of a single firing.
+			FlushTransformed();
+			for (size_t i = 0; i < num; i++)
+			{
+				molecules[i] = &TransformNext(simInfo);
+			}
 		}
 
 		virtual std::string GetName() const noexcept override
@@ -173,39 +182,170 @@ namespace stochsim
 		{
 			initialCondition_ = initialCondition;
 		}
+		/// <summary>
+		/// Returns the number of properties stored for each molecule.
+		/// </summary>
+		/// <returns>Number of properties per molecule.</returns>
+		size_t GetNumProperties() const noexcept
+		{
+			return numProperties_;
+		}
 	private:
 		/// <summary>
-		/// Returns a (uniform) random index in the buffer. Since the buffer might contain already invalidated elements,
-		/// the random index might be drawn from a broader range.
+		/// Index marking the absence of an older or newer molecule.
+		/// </summary>
+		static constexpr size_t none_ = static_cast<size_t>(-1);
+
+		/// <summary>
+		/// Returns a uniform random index of a molecule. Behavior undefined if there are no molecules.
 		/// </summary>
-		/// <returns>A uniform random index to a valid buffer element.</returns>
-		inline size_t randomBufferIndex(ISimInfo& simInfo) const
+		inline size_t RandomIndex(ISimInfo& simInfo) const
 		{
-			size_t idx;
-			// try three times to draw a valid random number. If this fails, clean up the buffer.
-			for (int trial = 0; trial < 3; trial++)
+			return simInfo.Rand(0, molecules_.size() - 1);
+		}
+		inline void Clear() noexcept
+		{
+			transformed_.clear();
+			molecules_.clear();
+			properties_.clear();
+			oldest_ = none_;
+			newest_ = none_;
+		}
+		/// <summary>
+		/// Returns the molecule with the given index, with all properties which are not stored set to zero.
+		/// </summary>
+		inline Molecule Load(size_t index) const
+		{
+			Molecule molecule;
+			const double* properties = properties_.data() + index * numProperties_;
+			for (size_t p = 0; p < numProperties_; p++)
 			{
-				idx = simInfo.Rand(0, buffer_.Size() - 1);
-				if (!buffer_[idx].invalidated)
-					return idx;
+				molecule[p] = properties[p];
 			}
-			// Remove all invalidated molecules.
-			// first, sort buffer by creation time, however, with all invalidated molecules coming first.
-			buffer_.Sort([](const MoleculeHolder& a, const MoleculeHolder& b) -> bool
+			return molecule;
+		}
+		/// <summary>
+		/// Stores the properties of the given molecule in the slot of the molecule with the given index.
+		/// </summary>
+		inline void Store(size_t index, const Molecule& molecule) noexcept
+		{
+			double* properties = properties_.data() + index * numProperties_;
+			for (size_t p = 0; p < numProperties_; p++)
+			{
+				properties[p] = molecule[p];
+			}
+		}
+		/// <summary>
+		/// Writes the molecules returned by Transform back to the state.
+		/// </summary>
+		inline void FlushTransformed()
+		{
+			if (transformed_.empty())
+				return;
+			for (const auto& transformed : transformed_)
+			{
+				Store(transformed.first, transformed.second);
+			}
+			transformed_.clear();
+		}
+		/// <summary>
+		/// Returns a copy of a random molecule, without writing back the molecules transformed before. If the same molecule is chosen twice before being written back, the same copy is returned such
+		/// that both transformations are applied to it.
+		/// </summary>
+		Molecule& TransformNext(ISimInfo& simInfo)
+		{
+			const size_t index = RandomIndex(simInfo);
+			for (auto& transformed : transformed_)
+			{
+				if (transformed.first == index)
+					return transformed.second;
+			}
+			transformed_.emplace_back(index, Load(index));
+			return transformed_.back().second;
+		}
+		/// <summary>
+		/// Appends a molecule, which becomes the newest molecule.
+		/// </summary>
+		inline void PushNewest(const Molecule& molecule, double time)
+		{
+			const size_t index = molecules_.size();
+			molecules_.push_back(MoleculeHolder{ time, newest_, none_ });
+			for (size_t p = 0; p < numProperties_; p++)
+			{
+				properties_.push_back(molecule[p]);
+			}
+			if (newest_ != none_)
+				molecules_[newest_].newer = index;
+			else
+				oldest_ = index;
+			newest_ = index;
+		}
+		/// <summary>
+		/// Removes the molecule with the given index by unlinking it from the creation order and moving the last molecule into its place. Takes constant time.
+		/// </summary>
+		/// <returns>The removed molecule.</returns>
+		Molecule RemoveAt(ISimInfo& simInfo, size_t index)
+		{
+			MoleculeHolder& holder = molecules_[index];
+			Molecule molecule = Load(index);
+			if (!removeListeners_.empty())
 			{
-				return !b.invalidated && (a.invalidated || a.creationTime < b.creationTime);
-			});
-			// remove all invalidated elements, which are now at the front.
-			buffer_.PopTop(buffer_.Size() - size_);
-			// return just a uniformly sampled index. Since all elements are now valid, this index is valid, too.
-			return simInfo.Rand(0, buffer_.Size() - 1);
+				double time = simInfo.GetSimTime();
+				for (auto& removeListener : removeListeners_)
+				{
+					removeListener(molecule, time, 1);
+				}
+			}
+			if (holder.older != none_)
+				molecules_[holder.older].newer = holder.newer;
+			else
+				oldest_ = holder.newer;
+			if (holder.newer != none_)
+				molecules_[holder.newer].older = holder.older;
+			else
+				newest_ = holder.older;
+
+			const size_t last = molecules_.size() - 1;
+			if (index != last)
+			{
+				holder = molecules_[last];
+				std::copy(properties_.begin() + last * numProperties_, properties_.end(), properties_.begin() + index * numProperties_);
+				if (holder.older != none_)
+					molecules_[holder.older].newer = index;
+				else
+					oldest_ = index;
+				if (holder.newer != none_)
+					molecules_[holder.newer].older = index;
+				else
+					newest_ = index;
+			}
+			molecules_.pop_back();
+			properties_.resize(last * numProperties_);
+			return molecule;
 		}
 
-		mutable CircularBuffer<MoleculeHolder> buffer_;
+		/// <summary>
+		/// Creation times and creation order of the molecules, in no particular order, such that a random molecule can be chosen and removed in constant time. The creation order is kept by a doubly linked list through the molecules.
+		/// </summary>
+		std::vector<MoleculeHolder> molecules_;
+		/// <summary>
+		/// Properties of the molecules, numProperties_ values per molecule in the same order as molecules_. Kept separately such that each molecule only needs the memory for the properties which are actually used.
+		/// </summary>
+		std::vector<double> properties_;
+		/// <summary>
+		/// Copies of the molecules returned by Transform, together with their indices, which still have to be written back. A deque such that references to its elements stay valid when further molecules are transformed.
+		/// </summary>
+		std::deque<std::pair<size_t, Molecule>> transformed_;
+		/// <summary>
+		/// Copy of the molecule returned by Peak.
+		/// </summary>
+		mutable Molecule peaked_;
 		std::list<StateListener> removeListeners_;
 		std::list<StateListener> addListeners_;
 		const std::string name_;
 		size_t initialCondition_;
-		size_t size_;
+		const size_t numProperties_;
+		size_t oldest_;
+		size_t newest_;
 	};
 }
@@ -0,0 +1,269 @@
+#pragma once
+#include <streambuf>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <limits>
+#include <exception>
+namespace stochsim
+{
+	/// <summary>
+	/// Writes text, typically comma separated values, to a file. Text and numbers are formatted directly into a large buffer, which is only written to the file when it is full or when the file is closed.
+	/// Numbers are formatted by hand instead of by iostreams: integers digit by digit, and doubles with the shortest number of significant digits which still reads back as the same double.
+	/// The writer is also a stream buffer, such that it can be wrapped into an std::ostream for code which expects a stream. Flushing such a stream (e.g. by std::endl) does not write the buffer to the file.
+	/// </summary>
+	class CsvWriter :
+		public std::streambuf
+	{
+	public:
+		/// <summary>
+		/// Constructor.
+		/// </summary>
+		/// <param name="bufferSize">Number of characters buffered before they are written to the file.</param>
+		explicit CsvWriter(size_t bufferSize = defaultBufferSize_) : buffer_(bufferSize > maxNumberLength_ ? bufferSize : static_cast<size_t>(maxNumberLength_))
+		{
+			setp(buffer_.data(), buffer_.data() + buffer_.size());
+		}
+		virtual ~CsvWriter()
+		{
+			if (file_.is_open())
+			{
+				file_.write(pbase(), pptr() - pbase());
+				file_.close();
+			}
+		}
+		CsvWriter(const CsvWriter&) = delete;
+		CsvWriter& operator=(const CsvWriter&) = delete;
+
+		/// <summary>
+		/// Opens the given file for writing, closing the currently open file, if any. Throws an exception if the file cannot be opened.
+		/// </summary>
+		/// <param name="fileName">Path of the file.</param>
+		void Open(const std::string& fileName)
+		{
+			Close();
+			file_.open(fileName);
+			if (!file_.is_open())
+			{
+				std::string errorMessage = "Could not open file ";
+				errorMessage += fileName;
+				throw std::exception(errorMessage.c_str());
+			}
+		}
+		/// <summary>
+		/// Writes all buffered text to the file, and closes it.
+		/// </summary>
+		void Close()
+		{
+			if (!file_.is_open())
+				return;
+			WriteBuffer();
+			file_.close();
+		}
+		bool IsOpen() const
+		{
+			return file_.is_open();
+		}
+		CsvWriter& Write(char value)
+		{
+			Reserve(1);
+			*pptr() = value;
+			pbump(1);
+			return *this;
+		}
+		CsvWriter& Write(const char* value)
+		{
+			for (; *value != '\0'; value++)
+			{
+				Write(*value);
+			}
+			return *this;
+		}
+		CsvWriter& Write(const std::string& value)
+		{
+			for (char c : value)
+			{
+				Write(c);
+			}
+			return *this;
+		}
+		CsvWriter& Write(size_t value)
+		{
+			Reserve(maxNumberLength_);
+			pbump(static_cast<int>(FormatInteger(value, pptr()) - pptr()));
+			return *this;
+		}
+		CsvWriter& Write(double value)
+		{
+			Reserve(maxNumberLength_);
+			pbump(static_cast<int>(FormatDouble(value, pptr()) - pptr()));
+			return *this;
+		}
+		/// <summary>
+		/// Ends the current line.
+		/// </summary>
+		CsvWriter& EndLine()
+		{
+			return Write('\n');
+		}
+		/// <summary>
+		/// Formats the given double with the least number of significant digits such that reading the result back yields the same double. Values between 1e-4 and 1e15 are written in
+		/// fixed notation, all other values in scientific notation.
+		/// </summary>
+		/// <param name="value">Value to format.</param>
+		/// <param name="out">Buffer with room for at least maxNumberLength_ characters.</param>
+		/// <returns>Pointer behind the last written character.</returns>
+		static char* FormatDouble(double value, char* out)
+		{
+			double absValue = std::fabs(value);
+			if (absValue >= 1e-4 && absValue < 1e15)
+			{
+				// Find the least number of decimals for which value, rounded to these decimals, is converted back to value. Since the rounded value and the power of ten are both
+				// exactly representable, their quotient is the double closest to the decimal number, i.e. the same double as when reading the decimal number back.
+				for (int decimals = 0; decimals < numPowersOfTen_; decimals++)
+				{
+					const double scaled = absValue * PowerOfTen(decimals);
+					if (scaled >= maxExactInteger_)
+						break;
+					const double rounded = std::floor(scaled + 0.5);
+					if (rounded / PowerOfTen(decimals) == absValue)
+					{
+						if (value < 0)
+							*out++ = '-';
+						return FormatFixed(static_cast<unsigned long long>(rounded), decimals, out);
+					}
+				}
+			}
+			else if (value == 0)
+			{
+				if (std::signbit(value))
+					*out++ = '-';
+				*out++ = '0';
+				return out;
+			}
+			// Slow path for very small or large numbers, numbers with many significant digits, infinity and NaN. 17 significant digits are always sufficient, and, except for
+			// subnormal numbers which have less precision, rounding to 15 significant digits yields the shortest representation if it has at most 15 digits.
+			int length = 0;
+			for (int precision = absValue < std::numeric_limits<double>::min() ? 1 : 15; precision <= 17; precision++)
+			{
+				length = std::snprintf(out, maxNumberLength_, "%.*g", precision, value);
+				if (!std::isfinite(value) || std::strtod(out, nullptr) == value)
+					break;
+			}
+			return out + length;
+		}
+		/// <summary>
+		/// Formats the given integer.
+		/// </summary>
+		/// <param name="value">Value to format.</param>
+		/// <param name="out">Buffer with room for at least maxNumberLength_ characters.</param>
+		/// <returns>Pointer behind the last written character.</returns>
+		static char* FormatInteger(unsigned long long value, char* out)
+		{
+			char digits[maxNumberLength_];
+			char* begin = digits + maxNumberLength_;
+			do
+			{
+				*--begin = static_cast<char>('0' + value % 10);
+				value /= 10;
+			} while (value != 0);
+			while (begin != digits + maxNumberLength_)
+			{
+				*out++ = *begin++;
+			}
+			return out;
+		}
+
+		/// <summary>
+		/// Maximal number of characters of a formatted number.
+		/// </summary>
+		static constexpr size_t maxNumberLength_ = 32;
+	protected:
+		virtual int_type overflow(int_type c) override
+		{
+			WriteBuffer();
+			if (traits_type::eq_int_type(c, traits_type::eof()))
+				return traits_type::not_eof(c);
+			*pptr() = traits_type::to_char_type(c);
+			pbump(1);
+			return c;
+		}
+		/// <summary>
+		/// Called when a stream wrapping the writer is flushed. The buffer is only written to the file when it is full, or when the file is closed.
+		/// </summary>
+		virtual int sync() override
+		{
+			return 0;
+		}
+	private:
+		static constexpr size_t defaultBufferSize_ = 1 << 16;
+		static constexpr int numPowersOfTen_ = 23;
+		/// <summary>
+		/// Integers up to 2^53 are exactly representable as doubles.
+		/// </summary>
+		static constexpr double maxExactInteger_ = 9007199254740992.0;
+
+		/// <summary>
+		/// Returns 10^exponent, which is exactly representable for exponent &lt; numPowersOfTen_.
+		/// </summary>
+		static inline double PowerOfTen(int exponent) noexcept
+		{
+			static const double powers[numPowersOfTen_] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+			return powers[exponent];
+		}
+		/// <summary>
+		/// Formats mantissa * 10^-decimals in fixed notation.
+		/// </summary>
+		static char* FormatFixed(unsigned long long mantissa, int decimals, char* out)
+		{
+			char digits[maxNumberLength_];
+			char* end = FormatInteger(mantissa, digits);
+			const int numDigits = static_cast<int>(end - digits);
+			if (numDigits <= decimals)
+			{
+				*out++ = '0';
+				*out++ = '.';
+				for (int i = numDigits; i < decimals; i++)
+				{
+					*out++ = '0';
+				}
+				for (int i = 0; i < numDigits; i++)
+				{
+					*out++ = digits[i];
+				}
+				return out;
+			}
+			for (int i = 0; i < numDigits; i++)
+			{
+				if (i == numDigits - decimals)
+					*out++ = '.';
+				*out++ = digits[i];
+			}
+			return out;
+		}
+		/// <summary>
+		/// Reserves room for the given number of characters in the buffer, writing the buffer to the file if necessary.
+		/// </summary>
+		inline void Reserve(size_t numChars)
+		{
+			if (static_cast<size_t>(epptr() - pptr()) < numChars)
+				WriteBuffer();
+		}
+		void WriteBuffer()
+		{
+			if (pptr() != pbase())
+			{
+				file_.write(pbase(), pptr() - pbase());
+				if (!file_)
+					throw std::exception("Could not write to file.");
+			}
+			setp(buffer_.data(), buffer_.data() + buffer_.size());
+		}
+
+		std::vector<char> buffer_;
+		std::ofstream file_;
+	};
+}
@@ -2,7 +2,8 @@
 #include "stochsim_common.h"
 #include <functional>
 #include <memory>
-#include <fstream>
+#include <ostream>
+#include "CsvWriter.h"
 namespace stochsim
 {
 	class CustomLogger :
@@ -12,16 +13,11 @@ namespace stochsim
 		typedef std::function<void(std::ostream& out)> HeaderFunc;
 		typedef std::function<void(std::ostream& out, double time)> LogFunc;
 
-		CustomLogger(std::string fileName, HeaderFunc headerFunc, LogFunc logFunc) : headerFunc_(headerFunc), logFunc_(logFunc), fileName_(fileName)
+		CustomLogger(std::string fileName, HeaderFunc headerFunc, LogFunc logFunc) : headerFunc_(headerFunc), logFunc_(logFunc), stream_(&file_), fileName_(fileName)
 		{
 		}
 		virtual ~CustomLogger()
 		{
-			if (file_)
-			{
-				file_->close();
-				file_.reset();
-			}
 		}
 		virtual bool WritesToDisk() const override
 		{
@@ -29,43 +25,31 @@ namespace stochsim
 		}
 		virtual void WriteLog(ISimInfo& simInfo, double time) override
 		{
-			logFunc_(*file_, time);
+			logFunc_(stream_, time);
 		}
 		virtual void Initialize(ISimInfo& simInfo) override
 		{
-			if (file_)
-			{
-				file_->close();
-				file_.reset();
-			}
 			std::string fileName = simInfo.GetSaveFolder();
 			fileName += "/";
 			fileName += fileName_;
+			file_.Open(fileName);
+			stream_.clear();
 
-			file_ = std::make_unique<std::ofstream>();
-			file_->open(fileName);
-			if (!file_->is_open())
-			{
-				std::string errorMessage = "Could not open file ";
-				errorMessage += fileName;
-				throw new std::exception(errorMessage.c_str());
-			}
-
-			headerFunc_(*file_);
+			headerFunc_(stream_);
 		}
 		virtual void Uninitialize(ISimInfo& simInfo) override
 		{
-			if (file_)
-			{
-				file_->close();
-				file_.reset();
-			}
+			file_.Close();
 		}
 
 	private:
 		HeaderFunc headerFunc_;
 		LogFunc logFunc_;
-		std::unique_ptr<std::ofstream> file_;
+		CsvWriter file_;
+		/// <summary>
+		/// Stream passed to the header and log functions, which formats into the buffer of file_. Flushing it, e.g. by std::endl, does not write the buffer to the disk.
+		/// </summary>
+		std::ostream stream_;
 		std::string fileName_;
 	};
 }
@@ -8,8 +8,9 @@
 namespace stochsim
 {
 	/// <summary>
-	/// A reaction which fires at a specific time (instead of having a propensity), with the time when the reaction fires next being determined by the properties of the first molecule of a ComplexState.
-	/// Since the first molecule of a complex state is also the oldest molecule, this type of reaction typically represents a reaction firing a fixed delay after a molecule of a given species was created.
+	/// A reaction which fires at a specific time (instead of having a propensity), with the time when the reaction fires next being determined by the creation time of the first molecule of a timed state
+	/// (e.g. ComposedState or TimestampQueueState).
+	/// Since the first molecule of a timed state is also the oldest molecule, this type of reaction typically represents a reaction firing a fixed delay after a molecule of a given species was created.
 	/// </summary>
 	class DelayReaction : public IEventReaction
 	{
@@ -17,18 +18,19 @@ namespace stochsim
 		class Reactant
 		{
 		public:
-			const std::shared_ptr<ComposedState> state_;
+			const std::shared_ptr<ITimedState> state_;
 			const Molecule::PropertyNames propertyNames_;
-			Reactant(std::shared_ptr<ComposedState> state, Molecule::PropertyNames propertyNames) noexcept : state_(std::move(state)), propertyNames_(std::move(propertyNames))
+			PropertySlots propertySlots_;
+			Reactant(std::shared_ptr<ITimedState> state, Molecule::PropertyNames propertyNames) noexcept : state_(std::move(state)), propertyNames_(std::move(propertyNames))
 			{
 			}
-			inline void Initialize(ISimInfo& simInfo)
+			inline void Initialize(ISimInfo& simInfo, Variables& variables)
 			{
-				// do nothing.
+				propertySlots_.Declare(variables, propertyNames_, 1);
 			}
 			inline void Uninitialize(ISimInfo& simInfo)
 			{
-				// do nothing.
+				propertySlots_.Clear();
 			}
 		};
 		class Product
@@ -44,12 +46,15 @@ namespace stochsim
 					propertyExpressions_[i].SetExpression(std::move(propertyExpressions[i]));
 				}
 			}
-			inline void Initialize(ISimInfo& simInfo)
+			inline void Initialize(ISimInfo& simInfo, const Variables& variables)
 			{
 				for (auto& propertyExpression : propertyExpressions_)
 				{
 					if (propertyExpression)
+					{
 						propertyExpression.Initialize(simInfo);
+						propertyExpression.Prepare(simInfo, variables);
+					}
 				}
 			}
 			inline void Uninitialize(ISimInfo& simInfo)
@@ -60,7 +65,7 @@ namespace stochsim
 						propertyExpression.Uninitialize(simInfo);
 				}
 			}
-			inline Molecule operator() (ISimInfo& simInfo, const std::vector<Variable>& variables = {}) const
+			inline Molecule operator() (ISimInfo& simInfo, const Variables& variables = {}) const
 			{
 				Molecule molecule;
 				for (size_t i = 0; i < Molecule::size_; i++)
@@ -72,7 +77,7 @@ namespace stochsim
 			}
 		};
 	public:
-		DelayReaction(std::string name, double delay, std::shared_ptr<ComposedState> reactant, Molecule::PropertyNames propertyNames = Molecule::PropertyNames()) : reactant_(std::move(reactant), std::move(propertyNames)), delay_(delay), name_(std::move(name))
+		DelayReaction(std::string name, double delay, std::shared_ptr<ITimedState> reactant, Molecule::PropertyNames propertyNames = Molecule::PropertyNames()) : reactant_(std::move(reactant), std::move(propertyNames)), delay_(delay), name_(std::move(name))
 		{
 		}
 		virtual double NextReactionTime(ISimInfo& simInfo) const override
@@ -81,23 +86,12 @@ namespace stochsim
 		}
 		virtual void Fire(ISimInfo& simInfo) override
 		{
-			Variables variables;
 			Molecule molecule = reactant_.state_->RemoveFirst(simInfo);
-			for (size_t p = 0; p < molecule.Size(); p++)
-			{
-				if (!reactant_.propertyNames_[p].empty())
-				{
-					variables.push_back(Variable(reactant_.propertyNames_[p], molecule[p]));
-
-				}
-			}
+			reactant_.propertySlots_.Set(variables_, 0, molecule);
 			for (const auto& product : products_)
 			{
-				molecule = product(simInfo, variables);
-				for (size_t i = 0; i < product.stochiometry_; i++)
-				{
-					product.state_->Add(simInfo, molecule, variables);
-				}
+				molecule = product(simInfo, variables_);
+				product.state_->AddN(simInfo, product.stochiometry_, molecule, variables_);
 			}
 		}
 		virtual std::string GetName() const override
@@ -106,9 +100,11 @@ namespace stochsim
 		}
 		virtual void Initialize(ISimInfo& simInfo) override
 		{
+			variables_.Clear();
+			reactant_.Initialize(simInfo, variables_);
 			for (auto& product : products_)
 			{
-				product.Initialize(simInfo);
+				product.Initialize(simInfo, variables_);
 			}
 		}
 		virtual void Uninitialize(ISimInfo& simInfo) override
@@ -117,6 +113,8 @@ namespace stochsim
 			{
 				product.Uninitialize(simInfo);
 			}
+			reactant_.Uninitialize(simInfo);
+			variables_.Clear();
 		}
 
 		/// <summary>
@@ -222,6 +220,10 @@ namespace stochsim
 		Reactant reactant_;
 		const std::string name_;
 		std::vector<Product> products_;
+		/// <summary>
+		/// Variables representing the named properties of the molecule removed when the reaction fires.
+		/// </summary>
+		Variables variables_;
 	};
 }
 
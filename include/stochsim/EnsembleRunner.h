@@ -0,0 +1,290 @@
+#pragma once
+#include <memory>
+#include <functional>
+#include <vector>
+#include <string>
+#include "stochsim_common.h"
+#include "Simulation.h"
+namespace stochsim
+{
+	/// <summary>
+	/// Summary statistics of the molecule numbers of all states over an ensemble of simulation runs, evaluated at every log time.
+	/// </summary>
+	class EnsembleStatistics
+	{
+	public:
+		EnsembleStatistics() : numReplicates_(0)
+		{
+		}
+		/// <summary>
+		/// Returns the number of replicates which contributed to the statistics.
+		/// </summary>
+		/// <returns>Number of replicates.</returns>
+		size_t GetNumReplicates() const
+		{
+			return numReplicates_;
+		}
+		/// <summary>
+		/// Returns the names of the states, in the order of the columns of the statistics.
+		/// </summary>
+		/// <returns>Names of the states.</returns>
+		const std::vector<std::string>& GetStateNames() const
+		{
+			return stateNames_;
+		}
+		/// <summary>
+		/// Returns the times at which the states were logged, in the order of the rows of the statistics.
+		/// </summary>
+		/// <returns>Log times.</returns>
+		const std::vector<double>& GetTimes() const
+		{
+			return times_;
+		}
+		/// <summary>
+		/// Returns the mean molecule number of the given state at the given log time over all replicates.
+		/// </summary>
+		/// <param name="row">Index of the log time.</param>
+		/// <param name="column">Index of the state.</param>
+		/// <returns>Mean molecule number.</returns>
+		double GetMean(size_t row, size_t column) const
+		{
+			return mean_[row * stateNames_.size() + column];
+		}
+		/// <summary>
+		/// Returns the (unbiased) sample variance of the molecule number of the given state at the given log time over all replicates.
+		/// </summary>
+		/// <param name="row">Index of the log time.</param>
+		/// <param name="column">Index of the state.</param>
+		/// <returns>Variance of the molecule number.</returns>
+		double GetVariance(size_t row, size_t column) const
+		{
+			return numReplicates_ > 1 ? m2_[row * stateNames_.size() + column] / (numReplicates_ - 1) : 0;
+		}
+		/// <summary>
+		/// Returns the minimal molecule number of the given state at the given log time over all replicates.
+		/// </summary>
+		/// <param name="row">Index of the log time.</param>
+		/// <param name="column">Index of the state.</param>
+		/// <returns>Minimal molecule number.</returns>
+		double GetMin(size_t row, size_t column) const
+		{
+			return min_[row * stateNames_.size() + column];
+		}
+		/// <summary>
+		/// Returns the maximal molecule number of the given state at the given log time over all replicates.
+		/// </summary>
+		/// <param name="row">Index of the log time.</param>
+		/// <param name="column">Index of the state.</param>
+		/// <returns>Maximal molecule number.</returns>
+		double GetMax(size_t row, size_t column) const
+		{
+			return max_[row * stateNames_.size() + column];
+		}
+
+		/// <summary>
+		/// Initializes empty statistics for the given states and log times.
+		/// </summary>
+		void Initialize(std::vector<std::string> stateNames, std::vector<double> times)
+		{
+			stateNames_ = std::move(stateNames);
+			times_ = std::move(times);
+			size_t size = stateNames_.size() * times_.size();
+			numReplicates_ = 0;
+			mean_.assign(size, 0);
+			m2_.assign(size, 0);
+			min_.assign(size, stochsim::inf);
+			max_.assign(size, -stochsim::inf);
+		}
+		/// <summary>
+		/// Adds the trajectory of one replicate, given row-wise with one row per log time and one column per state, to the statistics (Welford's algorithm).
+		/// </summary>
+		void Add(const std::vector<double>& values)
+		{
+			numReplicates_++;
+			for (size_t i = 0; i < mean_.size(); i++)
+			{
+				double value = values[i];
+				double delta = value - mean_[i];
+				mean_[i] += delta / numReplicates_;
+				m2_[i] += delta * (value - mean_[i]);
+				if (value < min_[i])
+					min_[i] = value;
+				if (value > max_[i])
+					max_[i] = value;
+			}
+		}
+		/// <summary>
+		/// Adds the statistics of a disjoint set of replicates to these statistics (parallel algorithm of Chan et al.).
+		/// </summary>
+		void Add(const EnsembleStatistics& other)
+		{
+			if (other.numReplicates_ == 0)
+				return;
+			if (numReplicates_ == 0)
+			{
+				*this = other;
+				return;
+			}
+			double n1 = static_cast<double>(numReplicates_);
+			double n2 = static_cast<double>(other.numReplicates_);
+			double n = n1 + n2;
+			for (size_t i = 0; i < mean_.size(); i++)
+			{
+				double delta = other.mean_[i] - mean_[i];
+				mean_[i] += delta * n2 / n;
+				m2_[i] += other.m2_[i] + delta * delta * n1 * n2 / n;
+				if (other.min_[i] < min_[i])
+					min_[i] = other.min_[i];
+				if (other.max_[i] > max_[i])
+					max_[i] = other.max_[i];
+			}
+			numReplicates_ += other.numReplicates_;
+		}
+	private:
+		size_t numReplicates_;
+		std::vector<std::string> stateNames_;
+		std::vector<double> times_;
+		std::vector<double> mean_;
+		std::vector<double> m2_;
+		std::vector<double> min_;
+		std::vector<double> max_;
+	};
+
+	/// <summary>
+	/// Runs an ensemble of independent replicates of a simulation in parallel.
+	/// Every worker thread constructs its own instance of the model by calling the model builder on an empty simulation, and then runs the replicates assigned to it one after the other.
+	/// Thus, no states or reactions are shared between threads. Every replicate uses its own random number stream, derived from the seed of the ensemble and the index
+	/// of the replicate, such that the results of a replicate do not depend on the number of threads or on which thread ran it.
+	/// Example:
+	/// <code>
+	///		EnsembleRunner runner([](Simulation&amp; sim)
+	///		{
+	///			cmdlparser::CmdlParser parser;
+	///			parser.Parse("model.cmdl", sim);
+	///		});
+	///		runner.Run(10000, 100);
+	/// </code>
+	/// </summary>
+	class EnsembleRunner
+	{
+	public:
+		/// <summary>
+		/// Function which defines the model by adding states, reactions and (optionally) loggers to the provided, empty simulation.
+		/// Called once per worker thread, potentially concurrently, and thus must not modify data shared between calls.
+		/// </summary>
+		typedef std::function<void(Simulation& sim)> ModelBuilder;
+		/// <summary>
+		/// Function called after a replicate finished. Calls are serialized, but happen in the worker threads.
+		/// </summary>
+		typedef std::function<void(size_t replicate, size_t numFinished, size_t numReplicates)> ReplicateListener;
+
+		explicit EnsembleRunner(ModelBuilder modelBuilder);
+		virtual ~EnsembleRunner();
+		/// <summary>
+		/// Runs numReplicates replicates of the simulation, each for maxTime time units.
+		/// If any replicate throws an exception, the remaining replicates are cancelled and the exception is re-thrown after all threads have finished.
+		/// </summary>
+		/// <param name="numReplicates">Number of replicates.</param>
+		/// <param name="maxTime">Simulation time when each replicate should stop.</param>
+		virtual void Run(size_t numReplicates, double maxTime);
+		/// <summary>
+		/// Sets the number of worker threads. Zero (default) corresponds to the number of concurrent threads supported by the hardware.
+		/// </summary>
+		/// <param name="numThreads">Number of worker threads.</param>
+		virtual void SetNumThreads(size_t numThreads);
+		/// <summary>
+		/// Returns the number of worker threads. Zero (default) corresponds to the number of concurrent threads supported by the hardware.
+		/// </summary>
+		/// <returns>Number of worker threads.</returns>
+		virtual size_t GetNumThreads() const;
+		/// <summary>
+		/// Sets the seed from which the random number streams of all replicates are derived. Default: seeded non-deterministically at construction.
+		/// </summary>
+		/// <param name="seed">Seed of the ensemble.</param>
+		virtual void SetSeed(unsigned long long seed);
+		/// <summary>
+		/// Returns the seed from which the random number streams of all replicates are derived.
+		/// </summary>
+		/// <returns>Seed of the ensemble.</returns>
+		virtual unsigned long long GetSeed() const;
+		/// <summary>
+		/// Sets the time period of logging of all replicates. Default = 1.
+		/// </summary>
+		/// <param name="logPeriod">Log period in simulation time units</param>
+		virtual void SetLogPeriod(double logPeriod);
+		/// <summary>
+		/// Returns the time period of logging of all replicates. Default = 1.
+		/// </summary>
+		/// <returns>Log period in simulation time units</returns>
+		virtual double GetLogPeriod() const;
+		/// <summary>
+		/// Sets the simulation engine used by all replicates. Default = Simulation::engine_direct.
+		/// </summary>
+		/// <param name="engine">Simulation engine to use.</param>
+		virtual void SetEngine(Simulation::engine engine);
+		/// <summary>
+		/// Returns the simulation engine used by all replicates. Default = Simulation::engine_direct.
+		/// </summary>
+		/// <returns>Simulation engine used.</returns>
+		virtual Simulation::engine GetEngine() const;
+		/// <summary>
+		/// Sets the folder under which the results of the ensemble are saved. The results of replicate i are saved in the sub-folder "replicate_i". An additional sub-folder is created
+		/// with the name indicating the current date and time to prevent overwriting old simulation results if IsUniqueSubfolder()==true.
+		/// </summary>
+		/// <param name="baseFolder">Base folder where simulation results are saved.</param>
+		virtual void SetBaseFolder(std::string baseFolder);
+		/// <summary>
+		/// Returns the folder under which the results of the ensemble are saved.
+		/// </summary>
+		/// <returns>Base folder where simulation results are saved.</returns>
+		virtual std::string GetBaseFolder() const;
+		/// <summary>
+		/// Set to true to create an additional sub-folder under the base folder with the name indicating the current date and time to prevent overwriting old simulation results.
+		/// </summary>
+		/// <param name="uniqueSubFolder">True if sub-folder should be created, false if results should be saved directly in the base folder.</param>
+		virtual void SetUniqueSubfolder(bool uniqueSubFolder);
+		/// <summary>
+		/// Returns true if an additional sub-folder under the base folder is created with the name indicating the current date and time to prevent overwriting old simulation results.
+		/// </summary>
+		/// <returns>True if sub-folder is created, false if results are saved directly in the base folder.</returns>
+		virtual bool IsUniqueSubfolder() const;
+		/// <summary>
+		/// Set to true to save the molecule numbers of all states of every replicate to the file "states.csv" in the folder of the replicate, in the same format as the StateLogger. Default = false.
+		/// </summary>
+		/// <param name="saveReplicates">True if the trajectories of all replicates should be saved.</param>
+		virtual void SetSaveReplicates(bool saveReplicates);
+		/// <summary>
+		/// Returns true if the molecule numbers of all states of every replicate are saved to the file "states.csv" in the folder of the replicate.
+		/// </summary>
+		/// <returns>True if the trajectories of all replicates are saved.</returns>
+		virtual bool IsSaveReplicates() const;
+		/// <summary>
+		/// Set to true to save the mean and standard deviation of the molecule numbers of all states over all replicates to the file "statistics.csv". Default = true.
+		/// </summary>
+		/// <param name="saveStatistics">True if the statistics of the ensemble should be saved.</param>
+		virtual void SetSaveStatistics(bool saveStatistics);
+		/// <summary>
+		/// Returns true if the mean and standard deviation of the molecule numbers of all states over all replicates are saved to the file "statistics.csv".
+		/// </summary>
+		/// <returns>True if the statistics of the ensemble are saved.</returns>
+		virtual bool IsSaveStatistics() const;
+		/// <summary>
+		/// Sets a function which is called every time a replicate finished, e.g. to display the progress of the ensemble.
+		/// </summary>
+		/// <param name="listener">Function to call when a replicate finished, or nullptr.</param>
+		virtual void SetReplicateListener(ReplicateListener listener);
+		/// <summary>
+		/// Returns the summary statistics of the molecule numbers of all states over all replicates of the last call to Run.
+		/// </summary>
+		/// <returns>Summary statistics of the ensemble.</returns>
+		virtual const EnsembleStatistics& GetStatistics() const;
+
+	private:
+		// Make this object be non-copyable
+		EnsembleRunner(const EnsembleRunner&) = delete;
+		EnsembleRunner& operator=(const EnsembleRunner&) = delete;
+
+		class Impl;
+		Impl* const impl_;
+	};
+}
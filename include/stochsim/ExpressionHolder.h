@@ -4,22 +4,35 @@
 #include <codecvt>
 #include <memory>
 #include "expression_common.h"
+#include "ExpressionProgram.h"
+#include "State.h"
 #include <map>
 #include <unordered_map>
+#include <typeinfo>
+#include <functional>
 namespace stochsim
 {
 	/// <summary>
 	/// Holds a mathematical expression, binds free variables upon initialization, and allows to evaluate the expression.
+	/// Upon initialization, the bound and simplified expression is compiled into a program (see expression::ExpressionProgram), which loads the molecular numbers of states,
+	/// the simulation time and temporary variables directly, instead of calling the bindings of the respective variables.
 	/// </summary>
 	class ExpressionHolder
 	{
 	private:
-		typedef std::unordered_map<expression::identifier, std::unique_ptr<expression::number>> TemporaryVariables;
+		/// <summary>
+		/// Context of the program instructions loading the molecular number of a state, the simulation time or a random number.
+		/// </summary>
+		struct LoadContext
+		{
+			const IState* state;
+			ISimInfo* simInfo;
+		};
 	public:
 		/// <summary>
 		/// Constructor.
 		/// </summary>
-		ExpressionHolder() noexcept : temporaryVariables_(10)
+		ExpressionHolder() noexcept : lastLayout_(0), lastProgram_(nullptr)
 		{
 		}
 
@@ -47,54 +60,206 @@ namespace stochsim
 		/// <summary>
 		/// Calculates the current rate of the reaction by solving the rate equation with the current species concentrations.
 		/// Throws a std::exception if rate could not be calculated.
+		/// Variables with the same name as a variable in the expression take precedence over states with the same name. The expression is compiled once for every set of variables it is evaluated with,
+		/// such that subsequent evaluations read the values of the variables directly from their slots.
 		/// </summary>
 		/// <param name="simInfo">Simulation context.</param>
+		/// <param name="variables">Variables which are currently defined.</param>
 		/// <returns>The current rate of the reaction.</returns>
-		double operator()(ISimInfo& simInfo, const std::vector<Variable>& variables = {}) const
+		double operator()(ISimInfo& simInfo, const Variables& variables = {}) const
 		{
 			if (!operator bool())
 				throw std::exception("Expression not set.");
+			if (variables.Size() == 0)
+				return program_.Eval();
 
-			// Set temporary variables
-			bool rebind = false;
-			for (auto& variable : variables)
-			{
-				auto& valuePtr = temporaryVariables_[static_cast<expression::identifier>(variable.first)];
-				if (!valuePtr)
-				{
-					valuePtr = std::make_unique<expression::number>(static_cast<expression::number>(variable.second));
-					rebind = true;
-				}
-				else
-				{
-					*valuePtr = static_cast<expression::number>(variable.second);
-				}
-			}
-			if (rebind)
-				rebindTemporaryVariables();
-
-
-			return boundExpession_->Eval();
+			// Typically, the expression is evaluated repeatedly with the variables of the same reaction.
+			if (variables.GetLayout() == lastLayout_)
+				return lastProgram_->Eval();
+			auto variableProgram = variablePrograms_.find(variables.GetLayout());
+			// Only reached the first time the expression is evaluated with the given variables, if they were not prepared.
+			if (variableProgram == variablePrograms_.end())
+				variableProgram = variablePrograms_.emplace(variables.GetLayout(), compile(simInfo, variables)).first;
+			lastLayout_ = variables.GetLayout();
+			lastProgram_ = &variableProgram->second;
+			return lastProgram_->Eval();
+		}
+		/// <summary>
+		/// Compiles the expression for the given variables, such that evaluating the expression with them neither compiles nor allocates memory. Must be called after Initialize, and after all variables are declared.
+		/// Typically called by the reaction owning the variables when it is initialized.
+		/// </summary>
+		/// <param name="simInfo">Simulation context.</param>
+		/// <param name="variables">Variables the expression will be evaluated with.</param>
+		void Prepare(ISimInfo& simInfo, const Variables& variables)
+		{
+			if (!boundExpession_)
+				throw std::exception("Expression not initialized.");
+			if (variables.Size() == 0 || variablePrograms_.find(variables.GetLayout()) != variablePrograms_.end())
+				return;
+			variablePrograms_.emplace(variables.GetLayout(), compile(simInfo, variables));
 		}
 
 		void Initialize(ISimInfo& simInfo)
 		{
 			if (!operator bool())
 				throw std::exception("Expression not set.");
-			temporaryVariables_.clear();
+			variablePrograms_.clear();
+			lastLayout_ = 0;
+			lastProgram_ = nullptr;
+			loadContexts_.clear();
 			boundExpession_ = expression_->Clone();
 			bindVariables(simInfo);
 			boundExpession_ = boundExpession_->Simplify();
+			program_ = compile(simInfo, Variables());
+		}
+		/// <summary>
+		/// Compiles the expression for the evaluation in interval arithmetic (see expression::ExpressionProgram::EvalInterval), such that the evaluation yields bounds for the value of the expression
+		/// for all molecular numbers of the states in their respective intervals. Must be called after Initialize.
+		/// Returns an empty program if the expression depends on anything else than constants and the molecular numbers of states for which an interval is known, e.g. on the simulation time or on random numbers.
+		/// </summary>
+		/// <param name="simInfo">Simulation context.</param>
+		/// <param name="stateInterval">Returns the interval containing the molecular number of the given state, or nullptr if unknown. The interval must stay valid while the program is in use.</param>
+		/// <returns>Program evaluating the bounds of the expression, or an empty program.</returns>
+		expression::ExpressionProgram CompileInterval(ISimInfo& simInfo, const std::function<const expression::Interval*(const IState* state)>& stateInterval) const
+		{
+			if (!boundExpession_)
+				throw std::exception("Expression not initialized.");
+			expression::SlotRegister slotRegister = [&simInfo, &stateInterval](const expression::identifier& name, expression::ExpressionProgram::Instruction& instruction) -> bool
+			{
+				if (name.empty() || name[name.size() - 1] == ')')
+					return false;
+				for (auto& state : simInfo.GetStates())
+				{
+					if (state->GetName() == name)
+					{
+						const expression::Interval* interval = stateInterval(state.get());
+						if (!interval)
+							return false;
+						instruction.code = expression::ExpressionProgram::op_load_interval;
+						instruction.interval = interval;
+						return true;
+					}
+				}
+				return false;
+			};
+			expression::ExpressionCompiler compiler;
+			expression::ExpressionProgram program = compiler.Compile(*boundExpession_, slotRegister);
+			// Everything not loaded from an interval might change without the bounds being recomputed.
+			for (auto& instruction : program.GetInstructions())
+			{
+				if (instruction.code == expression::ExpressionProgram::op_load || instruction.code == expression::ExpressionProgram::op_load_external || instruction.code == expression::ExpressionProgram::op_evaluate)
+					return expression::ExpressionProgram();
+			}
+			return program;
 		}
 		void Uninitialize(ISimInfo& simInfo)
 		{
+			program_ = expression::ExpressionProgram();
+			variablePrograms_.clear();
+			lastLayout_ = 0;
+			lastProgram_ = nullptr;
+			loadContexts_.clear();
 			boundExpession_ = nullptr;
-			temporaryVariables_.clear();
 		}
 	private:
 		std::unique_ptr<expression::IExpression> boundExpession_;
 		std::unique_ptr<expression::IExpression> expression_;
-		mutable TemporaryVariables temporaryVariables_;
+		/// <summary>
+		/// Program evaluating the expression without variables.
+		/// </summary>
+		expression::ExpressionProgram program_;
+		/// <summary>
+		/// Programs evaluating the expression with a given set of variables, identified by its layout (see Variables::GetLayout). Never evicted, since the layouts of the variables of the reactions
+		/// do not change after they are initialized, such that there is at most one program per reaction evaluating the expression.
+		/// </summary>
+		mutable std::unordered_map<size_t, expression::ExpressionProgram> variablePrograms_;
+		/// <summary>
+		/// Layout of the variables the expression was last evaluated with, and the respective program.
+		/// </summary>
+		mutable size_t lastLayout_;
+		mutable const expression::ExpressionProgram* lastProgram_;
+		mutable std::vector<std::unique_ptr<LoadContext>> loadContexts_;
+
+		static expression::number LoadStateNum(const void* context)
+		{
+			auto loadContext = static_cast<const LoadContext*>(context);
+			return static_cast<expression::number>(loadContext->state->Num(*loadContext->simInfo));
+		}
+		static expression::number LoadSimpleStateNum(const void* context)
+		{
+			// Non-virtual call for the most common type of state.
+			auto loadContext = static_cast<const LoadContext*>(context);
+			return static_cast<expression::number>(static_cast<const State*>(loadContext->state)->State::Num(*loadContext->simInfo));
+		}
+		static expression::number LoadTime(const void* context)
+		{
+			auto loadContext = static_cast<const LoadContext*>(context);
+			return static_cast<expression::number>(loadContext->simInfo->GetSimTime());
+		}
+		static expression::number LoadRand(const void* context)
+		{
+			auto loadContext = static_cast<const LoadContext*>(context);
+			return static_cast<expression::number>(loadContext->simInfo->Rand());
+		}
+		/// <summary>
+		/// Returns the context to load the molecular number of the given state, or the simulation time or a random number if state is null. Contexts are shared by all programs of this holder.
+		/// </summary>
+		const LoadContext* getLoadContext(const IState* state, ISimInfo& simInfo) const
+		{
+			for (auto& loadContext : loadContexts_)
+			{
+				if (loadContext->state == state && loadContext->simInfo == &simInfo)
+					return loadContext.get();
+			}
+			loadContexts_.push_back(std::unique_ptr<LoadContext>(new LoadContext{ state, &simInfo }));
+			return loadContexts_.back().get();
+		}
+
+		/// <summary>
+		/// Compiles the bound expression for the given variables. Variables of the expression are resolved in the same order as in bindVariables, except that the given variables take precedence.
+		/// </summary>
+		expression::ExpressionProgram compile(ISimInfo& simInfo, const Variables& variables) const
+		{
+			expression::SlotRegister slotRegister = [this, &simInfo, &variables](const expression::identifier& name, expression::ExpressionProgram::Instruction& instruction) -> bool
+			{
+				if (name == "rand()")
+				{
+					instruction.code = expression::ExpressionProgram::op_load_external;
+					instruction.external = &LoadRand;
+					instruction.context = getLoadContext(nullptr, simInfo);
+					return true;
+				}
+				if (name.empty() || name[name.size() - 1] == ')')
+					return false;
+				size_t slot = variables.Find(name);
+				if (slot != Variables::npos)
+				{
+					instruction.code = expression::ExpressionProgram::op_load;
+					instruction.variable = variables.GetLocation(slot);
+					return true;
+				}
+				for (auto& state : simInfo.GetStates())
+				{
+					if (state->GetName() == name)
+					{
+						instruction.code = expression::ExpressionProgram::op_load_external;
+						instruction.external = typeid(*state) == typeid(State) ? &LoadSimpleStateNum : &LoadStateNum;
+						instruction.context = getLoadContext(state.get(), simInfo);
+						return true;
+					}
+				}
+				if (name == "time")
+				{
+					instruction.code = expression::ExpressionProgram::op_load_external;
+					instruction.external = &LoadTime;
+					instruction.context = getLoadContext(nullptr, simInfo);
+					return true;
+				}
+				return false;
+			};
+			expression::ExpressionCompiler compiler;
+			return compiler.Compile(*boundExpession_, slotRegister);
+		}
 
 		void bindVariables(ISimInfo& simInfo)
 		{
@@ -120,16 +285,6 @@ namespace stochsim
 				}
 				else
 				{
-					auto search = temporaryVariables_.find(name);
-					if (search != temporaryVariables_.end())
-					{
-						auto valuePointer = search->second.get();
-						std::function<expression::number()> holder = [valuePointer]() -> expression::number
-						{
-							return *valuePointer;
-						};
-						return expression::makeFunctionHolder(holder, true);
-					}
 					for (auto& state : simInfo.GetStates())
 					{
 						if (state->GetName() == name)
@@ -162,24 +317,6 @@ namespace stochsim
 			};
 			boundExpession_->Bind(bindings);
 		}
-		void rebindTemporaryVariables() const
-		{
-			expression::BindingRegister bindings = [this](const expression::identifier name) -> std::unique_ptr<expression::IFunctionHolder>
-			{
-				auto search = temporaryVariables_.find(name);
-				if (search != temporaryVariables_.end())
-				{
-					auto valuePointer = search->second.get();
-					std::function<expression::number()> holder = [valuePointer]() -> expression::number
-					{
-						return *valuePointer;
-					};
-					return expression::makeFunctionHolder(holder, true);
-				}
-				return nullptr;
-			};
-			boundExpession_->Bind(bindings);
-		}
 	};
 }
 
@@ -0,0 +1,298 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <map>
+#include <list>
+#include <string>
+#include <sstream>
+#include "stochsim_common.h"
+namespace stochsim
+{
+	/// <summary>
+	/// A state whose molecules have properties, but which only stores how many molecules have each distinct combination of property values (a sparse histogram), instead of storing each molecule individually.
+	/// Memory thus scales with the number of distinct property values instead of with the number of molecules, which is favorable when the properties only take a few distinct values, e.g. small integers counting how often a molecule was modified.
+	/// Removing, peaking or transforming a molecule samples a value with a probability proportional to the number of molecules having it, which takes time linear in the number of distinct values.
+	/// Since the creation times of the molecules are not stored, the state cannot be used as the reactant of a DelayReaction.
+	/// </summary>
+	class HistogramState :
+		public IState
+	{
+	private:
+		struct Bucket
+		{
+			/// <summary>
+			/// The property values shared by all molecules in the bucket.
+			/// </summary>
+			Molecule molecule;
+			/// <summary>
+			/// Number of molecules having these property values.
+			/// </summary>
+			size_t count;
+		};
+	public:
+		/// <summary>
+		/// Constructor.
+		/// </summary>
+		/// <param name="name">Name of the state.</param>
+		/// <param name="initialCondition">Initial number of molecules which are there when the simulation starts. All of them have all properties set to zero.</param>
+		/// <param name="numProperties">Number of properties which distinguish the molecules. Must be smaller or equal to Molecule::size_. Properties with a higher index are always zero, and changes to them are discarded.</param>
+		HistogramState(std::string name, size_t initialCondition, size_t numProperties = Molecule::size_) : name_(name), initialCondition_(initialCondition), numProperties_(numProperties), numInBuckets_(0)
+		{
+			if (numProperties_ > Molecule::size_)
+			{
+				std::stringstream errorMessage;
+				errorMessage << "Histogram state " << name_ << " cannot distinguish " << numProperties_ << " properties per molecule (maximally allowed " << Molecule::size_ << ").";
+				throw std::exception(errorMessage.str().c_str());
+			}
+		}
+		virtual void Initialize(ISimInfo& simInfo) override
+		{
+			Clear();
+			AddToBucket(defaultMolecule, GetInitialCondition());
+		}
+		virtual void Uninitialize(ISimInfo& simInfo) override
+		{
+			Clear();
+		}
+		virtual inline size_t Num(ISimInfo& simInfo) const override
+		{
+			return numInBuckets_ + transformed_.size();
+		}
+		virtual inline void AddDecreaseListener(StateListener stateListener) override
+		{
+			removeListeners_.push_back(std::move(stateListener));
+		}
+		virtual inline void AddIncreaseListener(StateListener stateListener) override
+		{
+			addListeners_.push_back(std::move(stateListener));
+		}
+		virtual void Add(ISimInfo& simInfo, const Molecule& molecule = defaultMolecule, const Variables& variables = {}) override
+		{
+			FlushTransformed();
+			if (!addListeners_.empty())
+			{
+				double time = simInfo.GetSimTime();
+				for (auto& addListener : addListeners_)
+				{
+					addListener(molecule, time, 1);
+				}
+			}
+			AddToBucket(molecule, 1);
+		}
+		virtual Molecule Remove(ISimInfo& simInfo, const Variables& variables = {}) override
+		{
+			FlushTransformed();
+			const size_t bucket = RandomBucket(simInfo.Rand(0, numInBuckets_ - 1));
+			Molecule molecule = buckets_[bucket].molecule;
+			RemoveFromBucket(bucket, 1);
+			if (!removeListeners_.empty())
+			{
+				double time = simInfo.GetSimTime();
+				for (auto& removeListener : removeListeners_)
+				{
+					removeListener(molecule, time, 1);
+				}
+			}
+			return molecule;
+		}
+		virtual void AddN(ISimInfo& simInfo, size_t num, const Molecule& molecule = defaultMolecule, const Variables& variables = {}) override
+		{
+			if (num == 0)
+				return;
+			FlushTransformed();
+			if (!addListeners_.empty())
+			{
+				double time = simInfo.GetSimTime();
+				for (auto& addListener : addListeners_)
+				{
+					addListener(molecule, time, num);
+				}
+			}
+			AddToBucket(molecule, num);
+		}
+		virtual void RemoveN(ISimInfo& simInfo, size_t num, const Variables& variables = {}) override
+		{
+			for (size_t i = 0; i < num; i++)
+			{
+				Remove(simInfo, variables);
+			}
+		}
+		virtual const Molecule& Peak(ISimInfo& simInfo) const override
+		{
+			const size_t index = simInfo.Rand(0, Num(simInfo) - 1);
+			// Molecules which are currently transformed are not part of any bucket until they are written back.
+			if (index >= numInBuckets_)
+				return transformed_[index - numInBuckets_];
+			return buckets_[RandomBucket(index)].molecule;
+		}
+		/// <summary>
+		/// Takes a random molecule out of its bucket and returns it. Changes to the molecule are taken into account, i.e. the molecule is put into the bucket corresponding to its new
+		/// properties, before the next call to any other function modifying the molecules of this state. The returned reference stays valid at least until then.
+		/// </summary>
+		virtual Molecule& Transform(ISimInfo& simInfo, const Variables& variables = {}) override
+		{
+			FlushTransformed();
+			return TransformNext(simInfo);
+		}
+		virtual void TransformN(ISimInfo& simInfo, size_t num, std::vector<Molecule*>& molecules, const Variables& variables = {}) override
+		{
+			// The molecules of the previous firing are put back first, such that transformed_ never holds more molecules than the stochiometry of a single firing.
+			FlushTransformed();
+			for (size_t i = 0; i < num; i++)
+			{
+				molecules[i] = &TransformNext(simInfo);
+			}
+		}
+		virtual std::string GetName() const noexcept override
+		{
+			return name_;
+		}
+		/// <summary>
+		///  Returns the initial condition of the state. It holds that at t=0, Num()==GetInitialCondition().
+		/// </summary>
+		/// <returns>Initial condition of the state.</returns>
+		size_t GetInitialCondition() const
+		{
+			return initialCondition_;
+		}
+		/// <summary>
+		/// Sets the initial condition of the state. It holds that at t=0, Num()==GetInitialCondition().
+		/// </summary>
+		/// <param name="initialCondition">initial condition</param>
+		void SetInitialCondition(size_t initialCondition)
+		{
+			initialCondition_ = initialCondition;
+		}
+		/// <summary>
+		/// Returns the number of properties which distinguish the molecules.
+		/// </summary>
+		/// <returns>Number of properties per molecule.</returns>
+		size_t GetNumProperties() const noexcept
+		{
+			return numProperties_;
+		}
+		/// <summary>
+		/// Calls the given function once for every distinct combination of property values currently present, in no particular order, with a molecule having these property values and the number of molecules having them.
+		/// </summary>
+		/// <param name="function">Function taking a const Molecule&amp; and a size_t.</param>
+		template<typename Function> void ForEachValue(Function function) const
+		{
+			for (const auto& bucket : buckets_)
+			{
+				function(bucket.molecule, bucket.count);
+			}
+			for (const auto& molecule : transformed_)
+			{
+				function(molecule, static_cast<size_t>(1));
+			}
+		}
+	private:
+		typedef Molecule::PropertyValues Key;
+
+		/// <summary>
+		/// Returns the property values distinguishing the given molecule.
+		/// </summary>
+		inline Key KeyOf(const Molecule& molecule) const noexcept
+		{
+			Key key{};
+			for (size_t p = 0; p < numProperties_; p++)
+			{
+				key[p] = molecule[p];
+			}
+			return key;
+		}
+		/// <summary>
+		/// Returns the bucket containing the index-th molecule when counting the molecules bucket by bucket. index must be smaller than numInBuckets_.
+		/// </summary>
+		inline size_t RandomBucket(size_t index) const noexcept
+		{
+			size_t bucket = 0;
+			while (index >= buckets_[bucket].count)
+			{
+				index -= buckets_[bucket].count;
+				bucket++;
+			}
+			return bucket;
+		}
+		void AddToBucket(const Molecule& molecule, size_t num)
+		{
+			if (num == 0)
+				return;
+			Key key = KeyOf(molecule);
+			auto result = bucketIndices_.emplace(key, buckets_.size());
+			if (result.second)
+				buckets_.push_back(Bucket{ Molecule(key), num });
+			else
+				buckets_[result.first->second].count += num;
+			numInBuckets_ += num;
+		}
+		/// <summary>
+		/// Removes num molecules from the given bucket. Empty buckets are discarded by moving the last bucket into their place, such that the number of buckets stays bounded by the number of distinct property values present.
+		/// </summary>
+		void RemoveFromBucket(size_t bucket, size_t num)
+		{
+			numInBuckets_ -= num;
+			buckets_[bucket].count -= num;
+			if (buckets_[bucket].count > 0)
+				return;
+			bucketIndices_.erase(KeyOf(buckets_[bucket].molecule));
+			const size_t last = buckets_.size() - 1;
+			if (bucket != last)
+			{
+				buckets_[bucket] = buckets_[last];
+				bucketIndices_[KeyOf(buckets_[bucket].molecule)] = bucket;
+			}
+			buckets_.pop_back();
+		}
+		/// <summary>
+		/// Takes a random molecule out of its bucket and returns it, without putting the molecules transformed before back into their buckets. If a molecule which is currently transformed is chosen
+		/// again, the same molecule is returned such that both transformations are applied to it.
+		/// </summary>
+		Molecule& TransformNext(ISimInfo& simInfo)
+		{
+			const size_t index = simInfo.Rand(0, Num(simInfo) - 1);
+			if (index >= numInBuckets_)
+				return transformed_[index - numInBuckets_];
+			const size_t bucket = RandomBucket(index);
+			transformed_.push_back(buckets_[bucket].molecule);
+			RemoveFromBucket(bucket, 1);
+			return transformed_.back();
+		}
+		/// <summary>
+		/// Puts the molecules returned by Transform back into the buckets corresponding to their current properties.
+		/// </summary>
+		inline void FlushTransformed()
+		{
+			if (transformed_.empty())
+				return;
+			for (const auto& molecule : transformed_)
+			{
+				AddToBucket(molecule, 1);
+			}
+			transformed_.clear();
+		}
+		inline void Clear() noexcept
+		{
+			buckets_.clear();
+			bucketIndices_.clear();
+			transformed_.clear();
+			numInBuckets_ = 0;
+		}
+
+		std::vector<Bucket> buckets_;
+		/// <summary>
+		/// Index into buckets_ for each distinct combination of property values present.
+		/// </summary>
+		std::map<Key, size_t> bucketIndices_;
+		/// <summary>
+		/// Molecules returned by Transform which still have to be put back into a bucket. A deque such that references to its elements stay valid when further molecules are transformed.
+		/// </summary>
+		std::deque<Molecule> transformed_;
+		std::list<StateListener> removeListeners_;
+		std::list<StateListener> addListeners_;
+		const std::string name_;
+		size_t initialCondition_;
+		const size_t numProperties_;
+		size_t numInBuckets_;
+	};
+}
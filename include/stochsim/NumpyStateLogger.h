@@ -0,0 +1,481 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include "stochsim_common.h"
+namespace stochsim
+{
+	/// <summary>
+	/// A logger task which writes the concentration of all its supplied states directly in the file formats of NumPy, such that the results can be loaded in Python without parsing text.
+	/// If the file name ends with ".npy", the file contains a single float64 matrix with one row per log time, the first column containing the time and the other columns the molecular numbers of the states,
+	/// and can be loaded by numpy.load(fileName). If the file name ends with ".npz", the file is an (uncompressed) archive which additionally contains the column names and the log period:
+	/// <code>
+	///		with numpy.load("states.npz") as file:
+	///			data = file["data"]                 # the same matrix as in the .npy file
+	///			columns = file["columns"]           # "Time", followed by the names of the states
+	///			logPeriod = float(file["log_period"])
+	/// </code>
+	/// The rows are collected in memory and written in large chunks directly into the file. Since the number of rows is not known in advance, the header of the matrix is patched when the simulation finished.
+	/// </summary>
+	class NumpyStateLogger :
+		public ISnapshotLogger
+	{
+	public:
+		/// <summary>
+		/// Constructor.
+		/// </summary>
+		/// <param name="fileName">Name of the file, relative to the save folder of the simulation. Must end with ".npy" or ".npz".</param>
+		NumpyStateLogger(std::string fileName) : fileName_(fileName), bundle_(false), numRows_(0), numBufferedRows_(0), rowsPerChunk_(1), dataCrc_(0), dataHeaderOffset_(0), logPeriod_(0)
+		{
+			auto endsWith = [&fileName](const char* extension)
+			{
+				const size_t length = std::strlen(extension);
+				return fileName.size() >= length && fileName.compare(fileName.size() - length, length, extension) == 0;
+			};
+			if (endsWith(".npz"))
+				bundle_ = true;
+			else if (!endsWith(".npy"))
+				throw std::exception(("File name " + fileName + " of NumPy logger must end with .npy or .npz.").c_str());
+		}
+		template <typename... T> NumpyStateLogger(std::string fileName, std::shared_ptr<IState> state, T... others) : NumpyStateLogger(fileName)
+		{
+			AddState(state, others...);
+		}
+		virtual ~NumpyStateLogger()
+		{
+			if (file_)
+			{
+				file_->close();
+				file_.reset();
+			}
+		}
+		virtual bool WritesToDisk() const override
+		{
+			return true;
+		}
+		virtual void WriteLog(ISimInfo& simInfo, double time) override
+		{
+			double* row = buffer_.data() + numBufferedRows_ * (states_.size() + 1);
+			row[0] = time;
+			for (size_t s = 0; s < states_.size(); s++)
+			{
+				row[s + 1] = static_cast<double>(states_[s]->Num(simInfo));
+			}
+			if (++numBufferedRows_ == rowsPerChunk_)
+				WriteRows();
+		}
+		virtual void WriteLog(double time, const size_t* values) override
+		{
+			double* row = buffer_.data() + numBufferedRows_ * (states_.size() + 1);
+			row[0] = time;
+			for (size_t s = 0; s < states_.size(); s++)
+			{
+				row[s + 1] = static_cast<double>(values[s]);
+			}
+			if (++numBufferedRows_ == rowsPerChunk_)
+				WriteRows();
+		}
+		virtual std::vector<std::shared_ptr<IState>> GetLoggedStates() const override
+		{
+			return states_;
+		}
+		std::string GetFileName() const
+		{
+			return fileName_;
+		}
+		void AddState(std::shared_ptr<IState> state)
+		{
+			states_.push_back(std::move(state));
+		}
+		template <typename... T> void AddState(std::shared_ptr<IState> state, T... others)
+		{
+			AddState(state);
+			AddState(others...);
+		}
+		virtual void Initialize(ISimInfo& simInfo) override
+		{
+			if (file_)
+			{
+				file_->close();
+				file_.reset();
+			}
+			std::string fileName = simInfo.GetSaveFolder();
+			fileName += "/";
+			fileName += fileName_;
+
+			file_ = std::make_unique<std::fstream>();
+			file_->open(fileName, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+			if (!file_->is_open())
+			{
+				std::string errorMessage = "Could not open file ";
+				errorMessage += fileName;
+				throw std::exception(errorMessage.c_str());
+			}
+
+			rowsPerChunk_ = defaultChunkBytes_ / (sizeof(double) * (states_.size() + 1));
+			if (rowsPerChunk_ == 0)
+				rowsPerChunk_ = 1;
+			buffer_.assign(rowsPerChunk_ * (states_.size() + 1), 0);
+			numRows_ = 0;
+			numBufferedRows_ = 0;
+			dataCrc_ = 0;
+			logPeriod_ = simInfo.GetLogPeriod();
+			entries_.clear();
+
+			// The header of the matrix has a fixed size, such that the number of rows can be patched in later without moving the data.
+			if (bundle_)
+				WriteLocalHeader("data.npy", 0, 0);
+			dataHeaderOffset_ = static_cast<uint64_t>(file_->tellp());
+			const std::string header = MatrixHeader(0);
+			file_->write(header.data(), header.size());
+		}
+		virtual void Uninitialize(ISimInfo& simInfo) override
+		{
+			if (!file_)
+				return;
+			if (numBufferedRows_ > 0)
+				WriteRows();
+			const std::string header = MatrixHeader(numRows_);
+			const uint64_t dataSize = numRows_ * (states_.size() + 1) * sizeof(double);
+			file_->seekp(dataHeaderOffset_);
+			file_->write(header.data(), header.size());
+			if (bundle_)
+			{
+				// The checksum of the data was computed while writing it, and only has to be combined with the checksum of the final header.
+				const uint32_t crc = Crc32Combine(Crc32(0, header.data(), header.size()), dataCrc_, dataSize);
+				file_->seekp(0);
+				WriteLocalHeader("data.npy", crc, header.size() + dataSize);
+				entries_.push_back(Entry{ "data.npy", crc, header.size() + dataSize, 0 });
+				file_->seekp(0, std::ios::end);
+
+				std::vector<std::string> columns{ "Time" };
+				for (const auto& state : states_)
+				{
+					columns.push_back(state->GetName());
+				}
+				WriteEntry("columns.npy", StringArray(columns));
+				WriteEntry("log_period.npy", Scalar(logPeriod_));
+				WriteCentralDirectory();
+			}
+			if (!*file_)
+				throw std::exception(("Could not write to file " + fileName_ + ".").c_str());
+			file_->close();
+			file_.reset();
+		}
+
+	private:
+		/// <summary>
+		/// Entry of the archive, as needed for the central directory.
+		/// </summary>
+		struct Entry
+		{
+			std::string name;
+			uint32_t crc;
+			uint64_t size;
+			uint64_t offset;
+		};
+		/// <summary>
+		/// Default size of the chunks of rows written at once.
+		/// </summary>
+		static constexpr size_t defaultChunkBytes_ = 1 << 20;
+		/// <summary>
+		/// Size of the header of the matrix, including the magic string and version. Large enough for any number of rows, and a multiple of 64 as recommended by NumPy.
+		/// </summary>
+		static constexpr size_t matrixHeaderSize_ = 128;
+
+		/// <summary>
+		/// Writes the buffered rows to the file.
+		/// </summary>
+		void WriteRows()
+		{
+			const size_t numBytes = numBufferedRows_ * (states_.size() + 1) * sizeof(double);
+			const char* bytes = reinterpret_cast<const char*>(buffer_.data());
+			file_->write(bytes, numBytes);
+			if (!*file_)
+				throw std::exception(("Could not write to file " + fileName_ + ".").c_str());
+			if (bundle_)
+				dataCrc_ = Crc32(dataCrc_, bytes, numBytes);
+			numRows_ += numBufferedRows_;
+			numBufferedRows_ = 0;
+		}
+
+		/// <summary>
+		/// Returns the type description of NumPy for the given type code and element size in the byte order of this machine, e.g. "&lt;f8".
+		/// </summary>
+		static std::string TypeDescription(char type, size_t size)
+		{
+			const uint16_t one = 1;
+			const bool littleEndian = *reinterpret_cast<const char*>(&one) == 1;
+			return std::string(1, littleEndian ? '<' : '>') + type + std::to_string(size);
+		}
+		/// <summary>
+		/// Returns the header of a .npy file for an array with the given type and shape, padded with spaces to at least the given size and to a multiple of 64 bytes.
+		/// </summary>
+		static std::string NpyHeader(const std::string& type, const std::string& shape, size_t minSize = 0)
+		{
+			std::string dictionary = "{'descr': '" + type + "', 'fortran_order': False, 'shape': " + shape + ", }";
+			// Magic string, version 1.0, and header length, followed by the dictionary, which is terminated by a newline.
+			const size_t prefixSize = 10;
+			size_t size = prefixSize + dictionary.size() + 1;
+			if (size < minSize)
+				size = minSize;
+			size = (size + 63) / 64 * 64;
+			dictionary.resize(size - prefixSize - 1, ' ');
+			dictionary += '\n';
+
+			std::string header("\x93NUMPY\x01\x00", 8);
+			const uint16_t dictionarySize = static_cast<uint16_t>(dictionary.size());
+			header += static_cast<char>(dictionarySize & 0xFF);
+			header += static_cast<char>(dictionarySize >> 8);
+			return header + dictionary;
+		}
+		std::string MatrixHeader(uint64_t numRows) const
+		{
+			return NpyHeader(TypeDescription('f', sizeof(double)), "(" + std::to_string(numRows) + ", " + std::to_string(states_.size() + 1) + ")", matrixHeaderSize_);
+		}
+		/// <summary>
+		/// Returns the content of a .npy file containing the given strings as a one dimensional array of unicode strings. Only ASCII characters are represented correctly.
+		/// </summary>
+		static std::string StringArray(const std::vector<std::string>& strings)
+		{
+			size_t length = 1;
+			for (const auto& string : strings)
+			{
+				if (string.size() > length)
+					length = string.size();
+			}
+			std::string content = NpyHeader(TypeDescription('U', length), "(" + std::to_string(strings.size()) + ",)");
+			for (const auto& string : strings)
+			{
+				for (size_t i = 0; i < length; i++)
+				{
+					const uint32_t character = i < string.size() ? static_cast<unsigned char>(string[i]) : 0;
+					content.append(reinterpret_cast<const char*>(&character), sizeof(character));
+				}
+			}
+			return content;
+		}
+		/// <summary>
+		/// Returns the content of a .npy file containing the given value as a zero dimensional array.
+		/// </summary>
+		static std::string Scalar(double value)
+		{
+			std::string content = NpyHeader(TypeDescription('f', sizeof(double)), "()");
+			content.append(reinterpret_cast<const char*>(&value), sizeof(value));
+			return content;
+		}
+
+		template<typename T> void Write(T value)
+		{
+			file_->write(reinterpret_cast<const char*>(&value), sizeof(T));
+		}
+		/// <summary>
+		/// Writes the local header of an uncompressed entry of the archive at the current position. The sizes are always stored in the ZIP64 extra field, such that entries can exceed 4 GB.
+		/// </summary>
+		void WriteLocalHeader(const std::string& name, uint32_t crc, uint64_t size)
+		{
+			Write<uint32_t>(0x04034b50);
+			Write<uint16_t>(zipVersion_);
+			Write<uint16_t>(0); // flags
+			Write<uint16_t>(0); // stored without compression
+			Write<uint16_t>(0); // modification time
+			Write<uint16_t>(dosDate_);
+			Write<uint32_t>(crc);
+			Write<uint32_t>(0xFFFFFFFF); // sizes in ZIP64 extra field
+			Write<uint32_t>(0xFFFFFFFF);
+			Write<uint16_t>(static_cast<uint16_t>(name.size()));
+			Write<uint16_t>(20);
+			file_->write(name.data(), name.size());
+			Write<uint16_t>(0x0001); // ZIP64 extra field
+			Write<uint16_t>(16);
+			Write<uint64_t>(size);
+			Write<uint64_t>(size);
+		}
+		/// <summary>
+		/// Writes a complete entry of the archive at the current position.
+		/// </summary>
+		void WriteEntry(const std::string& name, const std::string& content)
+		{
+			const uint64_t offset = static_cast<uint64_t>(file_->tellp());
+			const uint32_t crc = Crc32(0, content.data(), content.size());
+			WriteLocalHeader(name, crc, content.size());
+			file_->write(content.data(), content.size());
+			entries_.push_back(Entry{ name, crc, content.size(), offset });
+		}
+		/// <summary>
+		/// Writes the central directory of the archive, which has to be at its end, and lists all entries.
+		/// </summary>
+		void WriteCentralDirectory()
+		{
+			const uint64_t directoryOffset = static_cast<uint64_t>(file_->tellp());
+			for (const auto& entry : entries_)
+			{
+				Write<uint32_t>(0x02014b50);
+				Write<uint16_t>(zipVersion_); // version made by
+				Write<uint16_t>(zipVersion_); // version needed to extract
+				Write<uint16_t>(0); // flags
+				Write<uint16_t>(0); // stored without compression
+				Write<uint16_t>(0); // modification time
+				Write<uint16_t>(dosDate_);
+				Write<uint32_t>(entry.crc);
+				Write<uint32_t>(0xFFFFFFFF); // sizes and offset in ZIP64 extra field
+				Write<uint32_t>(0xFFFFFFFF);
+				Write<uint16_t>(static_cast<uint16_t>(entry.name.size()));
+				Write<uint16_t>(28);
+				Write<uint16_t>(0); // comment length
+				Write<uint16_t>(0); // disk number
+				Write<uint16_t>(0); // internal attributes
+				Write<uint32_t>(0); // external attributes
+				Write<uint32_t>(0xFFFFFFFF);
+				file_->write(entry.name.data(), entry.name.size());
+				Write<uint16_t>(0x0001); // ZIP64 extra field
+				Write<uint16_t>(24);
+				Write<uint64_t>(entry.size);
+				Write<uint64_t>(entry.size);
+				Write<uint64_t>(entry.offset);
+			}
+			const uint64_t endOffset = static_cast<uint64_t>(file_->tellp());
+
+			// ZIP64 end of central directory record and locator
+			Write<uint32_t>(0x06064b50);
+			Write<uint64_t>(44);
+			Write<uint16_t>(zipVersion_);
+			Write<uint16_t>(zipVersion_);
+			Write<uint32_t>(0);
+			Write<uint32_t>(0);
+			Write<uint64_t>(entries_.size());
+			Write<uint64_t>(entries_.size());
+			Write<uint64_t>(endOffset - directoryOffset);
+			Write<uint64_t>(directoryOffset);
+			Write<uint32_t>(0x07064b50);
+			Write<uint32_t>(0);
+			Write<uint64_t>(endOffset);
+			Write<uint32_t>(1);
+
+			// End of central directory record
+			Write<uint32_t>(0x06054b50);
+			Write<uint16_t>(0);
+			Write<uint16_t>(0);
+			Write<uint16_t>(static_cast<uint16_t>(entries_.size()));
+			Write<uint16_t>(static_cast<uint16_t>(entries_.size()));
+			Write<uint32_t>(0xFFFFFFFF);
+			Write<uint32_t>(0xFFFFFFFF);
+			Write<uint16_t>(0);
+		}
+
+		/// <summary>
+		/// Continues the CRC-32 checksum (as used by ZIP) crc of some data with the given bytes.
+		/// </summary>
+		static uint32_t Crc32(uint32_t crc, const char* bytes, size_t numBytes)
+		{
+			static const std::vector<uint32_t> table = []()
+			{
+				std::vector<uint32_t> table(256);
+				for (uint32_t i = 0; i < 256; i++)
+				{
+					uint32_t value = i;
+					for (int bit = 0; bit < 8; bit++)
+					{
+						value = value & 1 ? crcPolynomial_ ^ (value >> 1) : value >> 1;
+					}
+					table[i] = value;
+				}
+				return table;
+			}();
+			crc = ~crc;
+			for (size_t i = 0; i < numBytes; i++)
+			{
+				crc = table[(crc ^ static_cast<unsigned char>(bytes[i])) & 0xFF] ^ (crc >> 8);
+			}
+			return ~crc;
+		}
+		/// <summary>
+		/// Returns the CRC-32 checksum of the concatenation of two byte sequences, given the checksums of both sequences and the length of the second one.
+		/// Appending bytes is a linear operation on the checksum, and appending numBytes2 zero bytes is evaluated by repeatedly squaring the matrix which appends a single zero bit.
+		/// </summary>
+		static uint32_t Crc32Combine(uint32_t crc1, uint32_t crc2, uint64_t numBytes2)
+		{
+			if (numBytes2 == 0)
+				return crc1;
+			uint32_t even[32];
+			uint32_t odd[32];
+			odd[0] = crcPolynomial_;
+			for (int n = 1; n < 32; n++)
+			{
+				odd[n] = 1u << (n - 1);
+			}
+			MatrixSquare(even, odd); // two zero bits
+			MatrixSquare(odd, even); // four zero bits
+			do
+			{
+				// Apply a zero byte, then two, four and so on for each bit set in numBytes2.
+				MatrixSquare(even, odd);
+				if (numBytes2 & 1)
+					crc1 = MatrixTimes(even, crc1);
+				numBytes2 >>= 1;
+				if (numBytes2 == 0)
+					break;
+				MatrixSquare(odd, even);
+				if (numBytes2 & 1)
+					crc1 = MatrixTimes(odd, crc1);
+				numBytes2 >>= 1;
+			} while (numBytes2 != 0);
+			return crc1 ^ crc2;
+		}
+		static uint32_t MatrixTimes(const uint32_t* matrix, uint32_t vector)
+		{
+			uint32_t sum = 0;
+			for (; vector != 0; vector >>= 1, matrix++)
+			{
+				if (vector & 1)
+					sum ^= *matrix;
+			}
+			return sum;
+		}
+		static void MatrixSquare(uint32_t* square, const uint32_t* matrix)
+		{
+			for (int n = 0; n < 32; n++)
+			{
+				square[n] = MatrixTimes(matrix, matrix[n]);
+			}
+		}
+
+		static constexpr uint32_t crcPolynomial_ = 0xEDB88320;
+		/// <summary>
+		/// Version 4.5 of the ZIP specification, which introduced ZIP64.
+		/// </summary>
+		static constexpr uint16_t zipVersion_ = 45;
+		/// <summary>
+		/// Modification date of all entries, 1980-01-01, since the date is irrelevant.
+		/// </summary>
+		static constexpr uint16_t dosDate_ = (1 << 5) | 1;
+
+		std::vector<std::shared_ptr<IState>> states_;
+		std::unique_ptr<std::fstream> file_;
+		std::string fileName_;
+		/// <summary>
+		/// True if writing an .npz archive, false if writing an .npy file.
+		/// </summary>
+		bool bundle_;
+		/// <summary>
+		/// Rows which were not yet written to the file, one after the other.
+		/// </summary>
+		std::vector<double> buffer_;
+		uint64_t numRows_;
+		size_t numBufferedRows_;
+		size_t rowsPerChunk_;
+		/// <summary>
+		/// CRC-32 checksum of the rows written so far, when writing an archive.
+		/// </summary>
+		uint32_t dataCrc_;
+		uint64_t dataHeaderOffset_;
+		double logPeriod_;
+		/// <summary>
+		/// Entries of the archive written so far.
+		/// </summary>
+		std::vector<Entry> entries_;
+	};
+}
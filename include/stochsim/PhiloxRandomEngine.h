@@ -0,0 +1,145 @@
+#pragma once
+#include <math.h>
+#include <stdint.h>
+#include "stochsim_common.h"
+namespace stochsim
+{
+	/// <summary>
+	/// Counter-based random engine Philox4x32-10, as described in
+	/// Salmon, John K., et al. "Parallel random numbers: as easy as 1, 2, 3." Proceedings of 2011 International Conference for High Performance Computing, Networking, Storage and Analysis. ACM, 2011.
+	/// The n-th block of four random 32 bit integers is obtained by encrypting the 128 bit counter (n, stream) with the 64 bit key given by the seed. Thus, every stream is a
+	/// non-overlapping sequence of 2^64 blocks, the state of the engine is only the counter, and random numbers can be generated in batches without any dependency between them.
+	/// </summary>
+	class PhiloxRandomEngine : public IRandomEngine
+	{
+	public:
+		PhiloxRandomEngine(unsigned long long seed = 0, unsigned long long stream = 0)
+		{
+			Seed(seed, stream);
+		}
+		virtual void Seed(unsigned long long seed, unsigned long long stream) override
+		{
+			key_[0] = static_cast<uint32_t>(seed);
+			key_[1] = static_cast<uint32_t>(seed >> 32);
+			stream_ = stream;
+			counter_ = 0;
+			position_ = bufferSize_;
+			exponentialPosition_ = bufferSize_;
+		}
+		virtual unsigned long long Next() override
+		{
+			if (position_ >= bufferSize_)
+			{
+				Generate(buffer_, bufferSize_);
+				position_ = 0;
+			}
+			return buffer_[position_++];
+		}
+		virtual double Uniform() override
+		{
+			return ToUniform(Next());
+		}
+		virtual double Exponential() override
+		{
+			if (exponentialPosition_ >= bufferSize_)
+			{
+				Exponentials(exponentialBuffer_, bufferSize_);
+				exponentialPosition_ = 0;
+			}
+			return exponentialBuffer_[exponentialPosition_++];
+		}
+		virtual void Uniforms(double* values, size_t num) override
+		{
+			uint64_t block[bufferSize_];
+			while (num > 0)
+			{
+				size_t batch = num < bufferSize_ ? num : bufferSize_;
+				Generate(block, batch);
+				for (size_t i = 0; i < batch; i++)
+				{
+					values[i] = ToUniform(block[i]);
+				}
+				values += batch;
+				num -= batch;
+			}
+		}
+		virtual void Exponentials(double* values, size_t num) override
+		{
+			Uniforms(values, num);
+			for (size_t i = 0; i < num; i++)
+			{
+				values[i] = -log(values[i]);
+			}
+		}
+		/// <summary>
+		/// Applies the Philox4x32-10 bijection to the counter, using the given key.
+		/// </summary>
+		/// <param name="counter">Counter to encrypt. Replaced by the result.</param>
+		/// <param name="key">Key.</param>
+		static inline void Philox(uint32_t counter[4], const uint32_t key[2])
+		{
+			uint32_t k0 = key[0];
+			uint32_t k1 = key[1];
+			for (int round = 0; round < 10; round++)
+			{
+				uint64_t product0 = static_cast<uint64_t>(multiplier0_) * counter[0];
+				uint64_t product1 = static_cast<uint64_t>(multiplier1_) * counter[2];
+				uint32_t c0 = static_cast<uint32_t>(product1 >> 32) ^ counter[1] ^ k0;
+				uint32_t c1 = static_cast<uint32_t>(product1);
+				uint32_t c2 = static_cast<uint32_t>(product0 >> 32) ^ counter[3] ^ k1;
+				uint32_t c3 = static_cast<uint32_t>(product0);
+				counter[0] = c0;
+				counter[1] = c1;
+				counter[2] = c2;
+				counter[3] = c3;
+				k0 += weyl0_;
+				k1 += weyl1_;
+			}
+		}
+	private:
+		static constexpr uint32_t multiplier0_ = 0xD2511F53;
+		static constexpr uint32_t multiplier1_ = 0xCD9E8D57;
+		static constexpr uint32_t weyl0_ = 0x9E3779B9;
+		static constexpr uint32_t weyl1_ = 0xBB67AE85;
+		/// <summary>
+		/// Number of 64 bit random integers generated at once. Must be even, since every block yields two of them.
+		/// </summary>
+		static constexpr size_t bufferSize_ = 64;
+
+		uint32_t key_[2];
+		unsigned long long stream_;
+		/// <summary>
+		/// Index of the next block of the stream.
+		/// </summary>
+		uint64_t counter_;
+		uint64_t buffer_[bufferSize_];
+		size_t position_;
+		double exponentialBuffer_[bufferSize_];
+		size_t exponentialPosition_;
+
+		/// <summary>
+		/// Converts the upper 53 bits of the random integer to a double in (0, 1), i.e. to the centers of 2^53 equally sized intervals.
+		/// </summary>
+		static inline double ToUniform(uint64_t value)
+		{
+			return (static_cast<double>(value >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+		}
+		/// <summary>
+		/// Generates the next num random 64 bit integers. If num is odd, the last half of the last block is discarded.
+		/// </summary>
+		void Generate(uint64_t* values, size_t num)
+		{
+			for (size_t i = 0; i < num; i += 2)
+			{
+				uint32_t block[4] = {
+					static_cast<uint32_t>(counter_), static_cast<uint32_t>(counter_ >> 32),
+					static_cast<uint32_t>(stream_), static_cast<uint32_t>(stream_ >> 32) };
+				counter_++;
+				Philox(block, key_);
+				values[i] = static_cast<uint64_t>(block[0]) | (static_cast<uint64_t>(block[1]) << 32);
+				if (i + 1 < num)
+					values[i + 1] = static_cast<uint64_t>(block[2]) | (static_cast<uint64_t>(block[3]) << 32);
+			}
+		}
+	};
+}
@@ -27,16 +27,17 @@ namespace stochsim
 			Stochiometry stochiometry_;
 			const std::shared_ptr<IState> state_;
 			const Molecule::PropertyNames propertyNames_;
+			PropertySlots propertySlots_;
 			Reactant(std::shared_ptr<IState> state, Stochiometry stochiometry, Molecule::PropertyNames propertyNames) noexcept : stochiometry_(stochiometry), state_(std::move(state)), propertyNames_(std::move(propertyNames))
 			{
 			}
-			inline void Initialize(ISimInfo& simInfo)
+			inline void Initialize(ISimInfo& simInfo, Variables& variables)
 			{
-				// do nothing.
+				propertySlots_.Declare(variables, propertyNames_, stochiometry_);
 			}
 			inline void Uninitialize(ISimInfo& simInfo)
 			{
-				// do nothing.
+				propertySlots_.Clear();
 			}
 		};
 		class Modifier
@@ -45,16 +46,17 @@ namespace stochsim
 			Stochiometry stochiometry_;
 			const std::shared_ptr<IState> state_;
 			const Molecule::PropertyNames propertyNames_;
+			PropertySlots propertySlots_;
 			Modifier(std::shared_ptr<IState> state, Stochiometry stochiometry, Molecule::PropertyNames propertyNames) noexcept : stochiometry_(stochiometry), state_(std::move(state)), propertyNames_(std::move(propertyNames))
 			{
 			}
-			inline void Initialize(ISimInfo& simInfo)
+			inline void Initialize(ISimInfo& simInfo, Variables& variables)
 			{
-				// do nothing.
+				propertySlots_.Declare(variables, propertyNames_, stochiometry_);
 			}
 			inline void Uninitialize(ISimInfo& simInfo)
 			{
-				// do nothing.
+				propertySlots_.Clear();
 			}
 		};
 		class Product
@@ -70,12 +72,15 @@ namespace stochsim
 					propertyExpressions_[i].SetExpression(std::move(propertyExpressions[i]));
 				}
 			}
-			inline void Initialize(ISimInfo& simInfo)
+			inline void Initialize(ISimInfo& simInfo, const Variables& variables)
 			{
 				for (auto& propertyExpression : propertyExpressions_)
 				{
 					if (propertyExpression)
+					{
 						propertyExpression.Initialize(simInfo);
+						propertyExpression.Prepare(simInfo, variables);
+					}
 				}
 			}
 			inline void Uninitialize(ISimInfo& simInfo)
@@ -86,7 +91,7 @@ namespace stochsim
 						propertyExpression.Uninitialize(simInfo);
 				}
 			}
-			inline Molecule operator() (ISimInfo& simInfo, const std::vector<Variable>& variables = {}) const
+			inline Molecule operator() (ISimInfo& simInfo, const Variables& variables = {}) const
 			{
 				Molecule molecule;
 				for (size_t i = 0; i < Molecule::size_; i++)
@@ -104,6 +109,20 @@ namespace stochsim
 			const std::shared_ptr<IState> state_;
 			std::array<ExpressionHolder, Molecule::size_> propertyExpressions_;
 			const Molecule::PropertyNames propertyNames_;
+			PropertySlots propertySlots_;
+			/// <summary>
+			/// If the stochiometry is bigger than one, the variables of the reaction together with variables named like the properties, which denote the properties of the molecule currently transformed.
+			/// The latter are only visible to the expressions of this transformee, and not to the products or other transformees.
+			/// </summary>
+			Variables currentVariables_;
+			/// <summary>
+			/// Slots of the variables named like the properties in currentVariables_.
+			/// </summary>
+			PropertySlots currentPropertySlots_;
+			/// <summary>
+			/// Molecules currently transformed.
+			/// </summary>
+			std::vector<Molecule*> molecules_;
 			Transformee(std::shared_ptr<IState> state, Stochiometry stochiometry, Molecule::PropertyExpressions propertyExpressions, Molecule::PropertyNames propertyNames) noexcept : stochiometry_(stochiometry), state_(std::move(state)), propertyNames_(std::move(propertyNames))
 			{
 				for (size_t i = 0; i < Molecule::size_; i++)
@@ -111,13 +130,31 @@ namespace stochsim
 					propertyExpressions_[i].SetExpression(std::move(propertyExpressions[i]));
 				}
 			}
-			inline void Initialize(ISimInfo& simInfo)
+			inline void Initialize(ISimInfo& simInfo, Variables& variables)
 			{
 				for (auto& propertyExpression : propertyExpressions_)
 				{
 					if (propertyExpression)
 						propertyExpression.Initialize(simInfo);
 				}
+				propertySlots_.Declare(variables, propertyNames_, stochiometry_);
+				molecules_.assign(stochiometry_, nullptr);
+			}
+			/// <summary>
+			/// Declares the variables denoting the properties of the molecule currently transformed, and compiles the expressions for the variables they are evaluated with. Must be called after all variables of the reaction are declared.
+			/// </summary>
+			inline void Prepare(ISimInfo& simInfo, const Variables& variables)
+			{
+				if (stochiometry_ > 1)
+				{
+					currentVariables_ = variables;
+					currentPropertySlots_.Declare(currentVariables_, propertyNames_, 1);
+				}
+				for (auto& propertyExpression : propertyExpressions_)
+				{
+					if (propertyExpression)
+						propertyExpression.Prepare(simInfo, stochiometry_ > 1 ? currentVariables_ : variables);
+				}
 			}
 			inline void Uninitialize(ISimInfo& simInfo)
 			{
@@ -126,8 +163,12 @@ namespace stochsim
 					if (propertyExpression)
 						propertyExpression.Uninitialize(simInfo);
 				}
+				propertySlots_.Clear();
+				currentPropertySlots_.Clear();
+				currentVariables_.Clear();
+				molecules_.clear();
 			}
-			inline Molecule& operator() (Molecule& molecule, ISimInfo& simInfo, const std::vector<Variable>& variables = {}) const
+			inline Molecule& operator() (Molecule& molecule, ISimInfo& simInfo, const Variables& variables = {}) const
 			{
 				for (size_t i = 0; i < Molecule::size_; i++)
 				{
@@ -359,23 +400,18 @@ namespace stochsim
 		}
 		virtual void Fire(ISimInfo& simInfo) override
 		{
-			Variables variables;
 			for (const auto& reactant : reactants_)
 			{
+				// The removed molecules are only needed if any of their properties is read.
+				if (!reactant.propertySlots_.IsUsed())
+				{
+					reactant.state_->RemoveN(simInfo, reactant.stochiometry_, variables_);
+					continue;
+				}
 				for (size_t i = 0; i < reactant.stochiometry_; i++)
 				{
 					Molecule molecule = reactant.state_->Remove(simInfo);
-					for (size_t p = 0; p < molecule.Size(); p++)
-					{
-						if (!reactant.propertyNames_[p].empty())
-						{
-							if(reactant.stochiometry_ > 1)
-								variables.push_back(Variable(reactant.propertyNames_[p] + "[" + std::to_string(i) + "]", molecule[p]));
-							else
-								variables.push_back(Variable(reactant.propertyNames_[p], molecule[p]));
-							
-						}
-					}
+					reactant.propertySlots_.Set(variables_, i, molecule);
 				}
 			}
 			for (const auto& modifier : modifiers_)
@@ -383,72 +419,35 @@ namespace stochsim
 				for (size_t i = 0; i < modifier.stochiometry_; i++)
 				{
 					const Molecule& molecule = modifier.state_->Peak(simInfo);
-					for (size_t p = 0; p < molecule.Size(); p++)
-					{
-						if (!modifier.propertyNames_[p].empty())
-						{
-							if(modifier.stochiometry_ > 1)
-								variables.push_back(Variable(modifier.propertyNames_[p] + "[" + std::to_string(i) + "]", molecule[p]));
-							else
-								variables.push_back(Variable(modifier.propertyNames_[p], molecule[p]));
-						}
-					}
+					modifier.propertySlots_.Set(variables_, i, molecule);
 				}
 			}
 			for (auto& transformee : transformees_)
 			{
-				std::vector<Molecule*> molecules;
+				transformee.state_->TransformN(simInfo, transformee.stochiometry_, transformee.molecules_, variables_);
 				for (size_t i = 0; i < transformee.stochiometry_; i++)
 				{
-					molecules.push_back(&transformee.state_->Transform(simInfo));
-					for (size_t p = 0; p < molecules[i]->Size(); p++)
-					{
-						if (!transformee.propertyNames_[p].empty())
-						{
-							if (transformee.stochiometry_ > 1)
-								variables.push_back(Variable(transformee.propertyNames_[p] + "[" + std::to_string(i) + "]", (*molecules[i])[p]));
-							else
-								variables.push_back(Variable(transformee.propertyNames_[p], (*molecules[i])[p]));
-						}
-					}
+					transformee.propertySlots_.Set(variables_, i, *transformee.molecules_[i]);
 				}
 
-				for (auto molecule : molecules)
+				if (transformee.stochiometry_ <= 1)
 				{
-					if (transformee.stochiometry_ > 1)
-					{
-						// For simplicity, if the stochiometry is bigger than one, the property name without array notation temporarily denotes the respective property of the
-						// current molecule.
-						for (size_t p = 0; p < molecule->Size(); p++)
-						{
-							if (!transformee.propertyNames_[p].empty())
-							{
-								variables.push_back(Variable(transformee.propertyNames_[p], (*molecule)[p]));
-							}
-						}
-					}
-					transformee(*molecule, simInfo, variables);
-
-					if (transformee.stochiometry_ > 1)
-					{
-						// remove all temporarily added variables
-						for (size_t p = 0; p < molecule->Size(); p++)
-						{
-							if (!transformee.propertyNames_[p].empty())
-							{
-								variables.pop_back();
-							}
-						}
-					}
+					transformee(*transformee.molecules_[0], simInfo, variables_);
+					continue;
+				}
+				// For simplicity, if the stochiometry is bigger than one, the property name without array notation temporarily denotes the respective property of the
+				// current molecule.
+				transformee.currentVariables_.CopyValues(variables_);
+				for (auto molecule : transformee.molecules_)
+				{
+					transformee.currentPropertySlots_.Set(transformee.currentVariables_, 0, *molecule);
+					transformee(*molecule, simInfo, transformee.currentVariables_);
 				}
 			}
 			for (auto& product : products_)
 			{
-				Molecule molecule = product(simInfo, variables);
-				for (size_t i = 0; i < product.stochiometry_; i++)
-				{
-					product.state_->Add(simInfo, molecule, variables);
-				}
+				Molecule molecule = product(simInfo, variables_);
+				product.state_->AddN(simInfo, product.stochiometry_, molecule, variables_);
 			}
 		}
 		virtual double ComputeRate(ISimInfo& simInfo) const override
@@ -516,21 +515,28 @@ namespace stochsim
 				customRate_.Initialize(simInfo);
 			}
 
+			// Resolve the names of the molecule properties to slots, such that firing the reaction only has to copy the property values.
+			variables_.Clear();
 			for (auto& reactant : reactants_)
 			{
-				reactant.Initialize(simInfo);
+				reactant.Initialize(simInfo, variables_);
 			}
-			for (auto& product : products_)
+			for (auto& modifier : modifiers_)
 			{
-				product.Initialize(simInfo);
+				modifier.Initialize(simInfo, variables_);
 			}
-			for (auto& modifier : modifiers_)
+			for (auto& transformee : transformees_)
 			{
-				modifier.Initialize(simInfo);
+				transformee.Initialize(simInfo, variables_);
 			}
+			// Expressions are compiled for the variables once all of them are declared.
 			for (auto& transformee : transformees_)
 			{
-				transformee.Initialize(simInfo);
+				transformee.Prepare(simInfo, variables_);
+			}
+			for (auto& product : products_)
+			{
+				product.Initialize(simInfo, variables_);
 			}
 		}
 		virtual void Uninitialize(ISimInfo& simInfo) override
@@ -553,6 +559,7 @@ namespace stochsim
 			}
 
 			customRate_.Uninitialize(simInfo);
+			variables_.Clear();
 		}
 		/// <summary>
 		/// Returns the rate constant of this reaction. If this reaction depends on a custom rate equation instead of a rate constant, returns -1.
@@ -584,6 +591,19 @@ namespace stochsim
 			return customRate_.GetExpression();
 		}
 		/// <summary>
+		/// Compiles the custom rate equation for the evaluation of bounds of the rate in interval arithmetic, given intervals containing the molecular numbers of the states (see ExpressionHolder::CompileInterval).
+		/// Returns an empty program if the reaction follows mass action kinetics, or if the rate cannot be bounded. Must be called after Initialize.
+		/// </summary>
+		/// <param name="simInfo">Simulation context.</param>
+		/// <param name="stateInterval">Returns the interval containing the molecular number of the given state, or nullptr if unknown.</param>
+		/// <returns>Program evaluating the bounds of the rate, or an empty program.</returns>
+		expression::ExpressionProgram CompileRateInterval(ISimInfo& simInfo, const std::function<const expression::Interval*(const IState* state)>& stateInterval) const
+		{
+			if (!customRate_)
+				return expression::ExpressionProgram();
+			return customRate_.CompileInterval(simInfo, stateInterval);
+		}
+		/// <summary>
 		/// Sets a custom rate equation for this reaction. If a custom rate equation is defined, the rate of the equation is not determined by standard mass action kinetics.
 		/// Instead, the rate is dynamically calculated by solving the mathematical formula provided as an argument. This formula can contain standard math functions like
 		/// min, sin and similar, as well as variables having the name of the reactants of this reaction, which are dynamically replaced by the molcular numbers of these reactants
@@ -615,5 +635,9 @@ namespace stochsim
 		std::vector<Modifier> modifiers_;
 		std::vector<Product> products_;
 		std::vector<Transformee> transformees_;
+		/// <summary>
+		/// Variables representing the named properties of the molecules taking part in the reaction when it fires.
+		/// </summary>
+		Variables variables_;
 	};
 }
\ No newline at end of file
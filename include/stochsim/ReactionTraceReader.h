@@ -0,0 +1,178 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+namespace stochsim
+{
+	/// <summary>
+	/// Layout of the reaction traces written by the simulation (see Simulation::SetReactionTrace) and read by ReactionTraceReader. All numbers in the header are stored in the byte order of the machine which wrote the file.
+	/// The file starts with a header:
+	///     char[8]   magic_ (without terminating zero)
+	///     uint32    version_
+	///     uint32    number of propensity reactions
+	///     uint32    number of event reactions
+	///     double    runtime of the simulation
+	///     for each propensity reaction, followed by each event reaction: uint32 length of the name, followed by the characters of the name (not zero terminated)
+	/// The header is followed by one record per firing of a reaction, until the end of the file:
+	///     varint    2 * index of the reaction, plus one if the reaction fired more than once at the same time (only for approximate engines). Event reactions are indexed after the propensity reactions.
+	///     varint    number of firings, only present if the reaction fired more than once
+	///     varint    time of the firing minus the time of the previous record (respectively minus zero), both interpreted as the 64 bit integers of their bit patterns
+	/// A varint stores seven bits per byte, starting with the least significant bits, and the highest bit of each byte is set if further bytes follow. Since the bit patterns of non-negative doubles
+	/// are ordered like the doubles themselves, the difference between the times of consecutive firings is a small integer taking only a few bytes, and the times are restored without rounding errors.
+	/// </summary>
+	struct ReactionTraceFormat
+	{
+		static constexpr const char* magic_ = "STOCHEVT";
+		static constexpr size_t magicLength_ = 8;
+		static constexpr uint32_t version_ = 1;
+		/// <summary>
+		/// Maximal number of bytes of a varint, respectively of a record.
+		/// </summary>
+		static constexpr size_t maxVarintSize_ = 10;
+		static constexpr size_t maxRecordSize_ = 3 * maxVarintSize_;
+
+		static inline uint64_t TimeToBits(double time) noexcept
+		{
+			uint64_t bits;
+			std::memcpy(&bits, &time, sizeof(bits));
+			return bits;
+		}
+		static inline double BitsToTime(uint64_t bits) noexcept
+		{
+			double time;
+			std::memcpy(&time, &bits, sizeof(time));
+			return time;
+		}
+		/// <summary>
+		/// Writes the given value as a varint.
+		/// </summary>
+		/// <param name="value">Value to write.</param>
+		/// <param name="out">Buffer with room for at least maxVarintSize_ bytes.</param>
+		/// <returns>Pointer behind the last written byte.</returns>
+		static inline char* WriteVarint(uint64_t value, char* out) noexcept
+		{
+			while (value >= 0x80)
+			{
+				*out++ = static_cast<char>(value | 0x80);
+				value >>= 7;
+			}
+			*out++ = static_cast<char>(value);
+			return out;
+		}
+	};
+
+	/// <summary>
+	/// A single record of a reaction trace.
+	/// </summary>
+	struct ReactionFiring
+	{
+		/// <summary>
+		/// Simulation time when the reaction fired.
+		/// </summary>
+		double time;
+		/// <summary>
+		/// Index of the reaction, where the event reactions are indexed after the propensity reactions (see ReactionTraceReader::GetReactionNames).
+		/// </summary>
+		size_t reaction;
+		/// <summary>
+		/// Number of times the reaction fired at this time. Only larger than one for approximate engines.
+		/// </summary>
+		size_t count;
+	};
+
+	/// <summary>
+	/// Reads reaction traces (see ReactionTraceFormat and Simulation::SetReactionTrace) record by record. Since traces can become much larger than the memory, the file is read in chunks.
+	/// Usage:
+	/// <code>
+	///		ReactionTraceReader reader("simulations/reactions.trace");
+	///		ReactionFiring firing;
+	///		while (reader.Next(firing))
+	///			std::cout << firing.time << ": " << reader.GetReactionNames()[firing.reaction] << std::endl;
+	/// </code>
+	/// To reconstruct the trajectories of the states from a trace, see Simulation::Replay.
+	/// </summary>
+	class ReactionTraceReader
+	{
+	public:
+		/// <summary>
+		/// Opens the given file and reads its header. Throws an exception if the file cannot be opened or is not a valid reaction trace.
+		/// </summary>
+		/// <param name="fileName">Path of the file.</param>
+		explicit ReactionTraceReader(const std::string& fileName);
+		ReactionTraceReader(const ReactionTraceReader&) = delete;
+		ReactionTraceReader& operator=(const ReactionTraceReader&) = delete;
+
+		/// <summary>
+		/// Returns the names of all reactions, starting with the propensity reactions and followed by the event reactions. Indices of the reactions in the records refer to this vector.
+		/// </summary>
+		/// <returns>Names of the reactions.</returns>
+		const std::vector<std::string>& GetReactionNames() const noexcept
+		{
+			return reactionNames_;
+		}
+		/// <summary>
+		/// Returns the number of propensity reactions. Reactions with a larger or equal index are event reactions.
+		/// </summary>
+		/// <returns>Number of propensity reactions.</returns>
+		size_t GetNumPropensityReactions() const noexcept
+		{
+			return numPropensityReactions_;
+		}
+		/// <summary>
+		/// Returns the number of event reactions.
+		/// </summary>
+		/// <returns>Number of event reactions.</returns>
+		size_t GetNumEventReactions() const noexcept
+		{
+			return reactionNames_.size() - numPropensityReactions_;
+		}
+		/// <summary>
+		/// Returns the runtime of the simulation which wrote the trace.
+		/// </summary>
+		/// <returns>Runtime of the simulation.</returns>
+		double GetRunTime() const noexcept
+		{
+			return runtime_;
+		}
+		/// <summary>
+		/// Reads the next record. A last record which was only partially written, e.g. because the simulation was aborted, is ignored.
+		/// </summary>
+		/// <param name="firing">Set to the next record.</param>
+		/// <returns>False if the end of the trace was reached, in which case firing is not changed.</returns>
+		bool Next(ReactionFiring& firing);
+
+	private:
+		/// <summary>
+		/// Number of bytes read from the file at once.
+		/// </summary>
+		static constexpr size_t bufferSize_ = 1 << 16;
+
+		/// <summary>
+		/// Moves the unread bytes to the beginning of the buffer, and fills the remaining buffer from the file.
+		/// </summary>
+		void Fill();
+		/// <summary>
+		/// Reads a varint at position_. Returns false if the buffer ends before the varint.
+		/// </summary>
+		bool ReadVarint(uint64_t& value);
+
+		std::ifstream file_;
+		std::string fileName_;
+		std::vector<std::string> reactionNames_;
+		size_t numPropensityReactions_;
+		double runtime_;
+		std::vector<char> buffer_;
+		/// <summary>
+		/// Position of the next unread byte, and end of the valid bytes in the buffer.
+		/// </summary>
+		size_t position_;
+		size_t end_;
+		bool endOfFile_;
+		/// <summary>
+		/// Bit pattern of the time of the last record.
+		/// </summary>
+		uint64_t lastTimeBits_;
+	};
+}
@@ -10,6 +10,44 @@ namespace stochsim
 	class Simulation
 	{
 	public:
+		/// <summary>
+		/// Algorithms which can be used to determine which propensity reaction fires next, and when.
+		/// engine_direct: Direct method of Gillespie. Efficient for small systems.
+		/// engine_next_reaction: Next reaction method of Gibson and Bruck. Efficient for systems with many propensity reactions, of which only a few are affected by each event.
+		/// engine_composition_rejection: Composition-rejection method of Slepoy et al. Selects reactions in constant time, and is thus efficient for very large systems.
+		/// engine_tau_leaping: Tau-leaping with the step size selection of Cao et al. Fires many reactions at once, and is thus efficient for systems with large molecular numbers.
+		/// Different to the other engines, the results are only approximate.
+		/// engine_rejection_based: Rejection-based SSA of Thanh et al. Only recomputes propensity bounds when molecular numbers leave their fluctuation intervals, and is thus efficient for
+		/// reactions with expensive custom rate equations.
+		/// engine_hybrid: Hybrid method treating reactions between abundant species deterministically, and all other reactions stochastically. Efficient for systems in which
+		/// few species have very large molecular numbers. The results are only approximate.
+		/// engine_partial_propensity: Partial-propensity direct method of Ramaswamy et al. The cost per reaction scales with the number of species instead of the number of reactions, and is thus
+		/// efficient for strongly coupled networks of elementary reactions. Falls back to the direct method if any reaction is not elementary.
+		/// </summary>
+		enum engine
+		{
+			engine_direct,
+			engine_next_reaction,
+			engine_composition_rejection,
+			engine_tau_leaping,
+			engine_rejection_based,
+			engine_hybrid,
+			engine_partial_propensity
+		};
+		/// <summary>
+		/// Ways in which the loggers are called.
+		/// logging_synchronous: All loggers are called by the simulation whenever the state should be logged, such that the simulation waits until each row is formatted and written.
+		/// logging_asynchronous_block: Loggers implementing ISnapshotLogger, e.g. StateLogger, are called by a background thread. The simulation only copies the molecular numbers of the logged states into a buffer.
+		/// If the buffer is full, the simulation waits until the background thread has written at least one row.
+		/// logging_asynchronous_grow: Same as logging_asynchronous_block, but the buffer grows if it is full, such that the simulation never waits for the loggers at the cost of memory.
+		/// The logged values are identical in all modes, and all rows are written when Run returns.
+		/// </summary>
+		enum logging_mode
+		{
+			logging_synchronous,
+			logging_asynchronous_block,
+			logging_asynchronous_grow
+		};
 		explicit Simulation();
 		virtual ~Simulation();
 		/// <summary>
@@ -17,6 +55,15 @@ namespace stochsim
 		/// </summary>
 		/// <param name="maxTime">Simulation time when simulation should stop. Simulation starts at simulation time zero.</param>
 		virtual void Run(double maxTime);
+		/// <summary>
+		/// Reconstructs a run of the simulation from a reaction trace (see SetReactionTrace) instead of simulating it: starting from the initial conditions, the reactions are fired in the order
+		/// and at the times recorded in the trace, and all loggers are called as if the simulation was run. Thus, trajectories can be derived at any log period, or with loggers which were not
+		/// used when the trace was recorded. The simulation must contain the same reactions as the simulation which recorded the trace, and the runtime is taken from the trace.
+		/// The result is identical to the recorded run if the effect of each reaction is fully determined by the reaction, e.g. for reactions of states without molecule properties and
+		/// without choices. Otherwise, random decisions of the reactions are taken anew.
+		/// </summary>
+		/// <param name="traceFile">Path of the reaction trace.</param>
+		virtual void Replay(const std::string& traceFile);
 
 		/// <summary>
 		/// Creates a state of the given type and adds it to the set of states managed by this simulation. Equivalent to
@@ -150,6 +197,64 @@ namespace stochsim
 		/// <returns>True if sub-folder is created, false if results are saved directly in the base folder.</returns>
 		virtual bool IsUniqueSubfolder() const;
 		/// <summary>
+		/// Sets whether loggers are called by the simulation or by a background thread. Default = logging_synchronous.
+		/// </summary>
+		/// <param name="loggingMode">Logging mode to use.</param>
+		virtual void SetLoggingMode(logging_mode loggingMode);
+		/// <summary>
+		/// Returns whether loggers are called by the simulation or by a background thread. Default = logging_synchronous.
+		/// </summary>
+		/// <returns>Logging mode used.</returns>
+		virtual logging_mode GetLoggingMode() const;
+		/// <summary>
+		/// Sets the number of rows which can be buffered when logging asynchronously before the buffer is full. Rounded up to a power of two. Default = 1024.
+		/// </summary>
+		/// <param name="logBufferCapacity">Capacity of the log buffer in rows.</param>
+		virtual void SetLogBufferCapacity(size_t logBufferCapacity);
+		/// <summary>
+		/// Returns the number of rows which can be buffered when logging asynchronously before the buffer is full. Default = 1024.
+		/// </summary>
+		/// <returns>Capacity of the log buffer in rows.</returns>
+		virtual size_t GetLogBufferCapacity() const;
+		/// <summary>
+		/// Sets the file, relative to the save folder, to which every firing of a reaction is recorded when the simulation runs (see ReactionTraceFormat), or an empty string to record nothing.
+		/// The firings are encoded compactly and written by a background thread, such that recording costs only a few nanoseconds per firing. Default = "".
+		/// </summary>
+		/// <param name="fileName">File name of the reaction trace.</param>
+		virtual void SetReactionTrace(std::string fileName);
+		/// <summary>
+		/// Returns the file, relative to the save folder, to which every firing of a reaction is recorded when the simulation runs, or an empty string if nothing is recorded. Default = "".
+		/// </summary>
+		/// <returns>File name of the reaction trace.</returns>
+		virtual std::string GetReactionTrace() const;
+		/// <summary>
+		/// Sets the algorithm used to determine which propensity reaction fires next, and when. All engines except engine_tau_leaping and engine_hybrid are exact, i.e. they only differ in their performance. Default = engine_direct.
+		/// </summary>
+		/// <param name="engine">Simulation engine to use.</param>
+		virtual void SetEngine(engine engine);
+		/// <summary>
+		/// Returns the algorithm used to determine which propensity reaction fires next, and when. Default = engine_direct.
+		/// </summary>
+		/// <returns>Simulation engine used.</returns>
+		virtual engine GetEngine() const;
+		/// <summary>
+		/// Seeds the random engine of the simulation. Runs with the same seed and stream produce identical results, while runs with different streams
+		/// use non-overlapping random number sequences and are thus statistically independent. If never called, the random engine is seeded non-deterministically.
+		/// </summary>
+		/// <param name="seed">Seed of the random engine.</param>
+		/// <param name="stream">Index of the random number stream, e.g. the index of a replicate in an ensemble of simulations.</param>
+		virtual void SetSeed(unsigned long long seed, unsigned long long stream = 0);
+		/// <summary>
+		/// Sets the random engine from which all random numbers of the simulation are drawn. Default = PhiloxRandomEngine.
+		/// </summary>
+		/// <param name="randomEngine">Random engine to use.</param>
+		virtual void SetRandomEngine(std::shared_ptr<IRandomEngine> randomEngine);
+		/// <summary>
+		/// Returns the random engine from which all random numbers of the simulation are drawn. Default = PhiloxRandomEngine.
+		/// </summary>
+		/// <returns>Random engine used.</returns>
+		virtual std::shared_ptr<IRandomEngine> GetRandomEngine() const;
+		/// <summary>
 		/// Creates a logger monitoring the state of the simulation and adds it to this simulation. Same as
 		/// <code>
 		/// Simulation sim;
@@ -10,12 +10,12 @@ namespace stochsim
 		public IState
 	{
 	public:
-		State(std::string name, size_t initialCondition) : num_(0), name_(name), initialCondition_(initialCondition)
+		State(std::string name, size_t initialCondition) : ownNum_(0), num_(&ownNum_), name_(name), initialCondition_(initialCondition)
 		{
 		}
 		virtual size_t Num(ISimInfo& simInfo) const override
 		{
-			return num_;
+			return *num_;
 		}
 		virtual void Add(ISimInfo& simInfo, const Molecule& molecule = defaultMolecule, const Variables& variables = {}) override
 		{
@@ -24,10 +24,10 @@ namespace stochsim
 				double time = simInfo.GetSimTime();
 				for (auto& addListener : addListeners_)
 				{
-					addListener(molecule, time);
+					addListener(molecule, time, 1);
 				}
 			}
-			num_ ++;
+			(*num_)++;
 		}
 		virtual Molecule Remove(ISimInfo& simInfo, const Variables& variables = {}) override
 		{
@@ -36,17 +36,53 @@ namespace stochsim
 				double time = simInfo.GetSimTime();
 				for (auto& removeListener : removeListeners_)
 				{
-					removeListener(defaultMolecule, time);
+					removeListener(defaultMolecule, time, 1);
 				}
 			}
-			num_ --;
+			(*num_)--;
 			return defaultMolecule;
 		}
+		virtual void AddN(ISimInfo& simInfo, size_t num, const Molecule& molecule = defaultMolecule, const Variables& variables = {}) override
+		{
+			if (num == 0)
+				return;
+			if (!addListeners_.empty())
+			{
+				double time = simInfo.GetSimTime();
+				for (auto& addListener : addListeners_)
+				{
+					addListener(molecule, time, num);
+				}
+			}
+			*num_ += num;
+		}
+		virtual void RemoveN(ISimInfo& simInfo, size_t num, const Variables& variables = {}) override
+		{
+			if (num == 0)
+				return;
+			if (!removeListeners_.empty())
+			{
+				double time = simInfo.GetSimTime();
+				for (auto& removeListener : removeListeners_)
+				{
+					removeListener(defaultMolecule, time, num);
+				}
+			}
+			*num_ -= num;
+		}
 		virtual Molecule& Transform(ISimInfo& simInfo, const Variables& variables = {}) override
 		{
-			static Molecule molecule;
-			molecule.Reset();
-			return molecule;
+			transformed_.Reset();
+			return transformed_;
+		}
+		virtual void TransformN(ISimInfo& simInfo, size_t num, std::vector<Molecule*>& molecules, const Variables& variables = {}) override
+		{
+			// All molecules are indistinguishable, such that the same dummy molecule can be returned for all of them.
+			Molecule* molecule = &Transform(simInfo, variables);
+			for (size_t i = 0; i < num; i++)
+			{
+				molecules[i] = molecule;
+			}
 		}
 		virtual const Molecule& Peak(ISimInfo& simInfo) const
 		{
@@ -54,11 +90,11 @@ namespace stochsim
 		}
 		virtual void Initialize(ISimInfo& simInfo) override
 		{
-			num_ = GetInitialCondition();
+			*num_ = GetInitialCondition();
 		}
 		virtual void Uninitialize(ISimInfo& simInfo) override
 		{
-			num_ = 0;
+			*num_ = 0;
 		}
 		virtual std::string GetName() const noexcept override
 		{
@@ -80,6 +116,26 @@ namespace stochsim
 		{
 			initialCondition_ = initialCondition;
 		}
+		/// <summary>
+		/// Lets the molecular number of this state be stored at the given location instead of inside the state, such that the molecular numbers of several states can be kept in one contiguous array
+		/// and be changed directly (see CompiledReactionNetwork). The current molecular number is copied to the new location. Passing nullptr moves the molecular number back into the state.
+		/// The location must stay valid until this method is called again with nullptr.
+		/// </summary>
+		/// <param name="storage">Location where the molecular number should be stored, or nullptr.</param>
+		void SetNumStorage(size_t* storage) noexcept
+		{
+			size_t* target = storage ? storage : &ownNum_;
+			*target = *num_;
+			num_ = target;
+		}
+		/// <summary>
+		/// Returns true if any listener was added to this state, i.e. if changes of the molecular number cannot bypass Add and Remove.
+		/// </summary>
+		/// <returns>True if the state has listeners.</returns>
+		bool HasListeners() const noexcept
+		{
+			return !addListeners_.empty() || !removeListeners_.empty();
+		}
 		virtual inline void AddDecreaseListener(StateListener stateListener) override
 		{
 			removeListeners_.push_back(std::move(stateListener));
@@ -89,10 +145,19 @@ namespace stochsim
 			addListeners_.push_back(std::move(stateListener));
 		}
 	private:
-		size_t num_;
+		// Make this object be non-copyable, since num_ might point to ownNum_.
+		State(const State&) = delete;
+		State& operator=(const State&) = delete;
+
+		size_t ownNum_;
+		size_t* num_;
 		const std::string name_;
 		size_t initialCondition_;
 		std::list<StateListener> removeListeners_;
 		std::list<StateListener> addListeners_;
+		/// <summary>
+		/// Dummy molecule returned by Transform. Changes to it are discarded, since the molecules of this state have no properties.
+		/// </summary>
+		Molecule transformed_;
 	};
 }
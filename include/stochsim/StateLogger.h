@@ -2,14 +2,14 @@
 #include <memory>
 #include <vector>
 #include "stochsim_common.h"
-#include <fstream>
+#include "CsvWriter.h"
 namespace stochsim
 {
 	/// <summary>
 	/// A logger task which writes the concentration of all its supplied states to the disk in form of a table.
 	/// </summary>
 	class StateLogger :
-		public ILogger
+		public ISnapshotLogger
 	{
 	public:
 		StateLogger(std::string fileName) : fileName_(fileName), shouldLog_(true)
@@ -21,11 +21,6 @@ namespace stochsim
 		}
 		virtual ~StateLogger()
 		{
-			if (file_)
-			{
-				file_->close();
-				file_.reset();
-			}
 		}
 		virtual bool WritesToDisk() const override
 		{
@@ -35,12 +30,27 @@ namespace stochsim
 		{
 			if (!shouldLog_)
 				return;
-			(*file_) << time;
+			file_.Write(time);
 			for (const auto& state : states_)
 			{
-				(*file_) << "," << state->Num(simInfo);
+				file_.Write(',').Write(state->Num(simInfo));
 			}
-			(*file_) << std::endl;
+			file_.EndLine();
+		}
+		virtual void WriteLog(double time, const size_t* values) override
+		{
+			if (!shouldLog_)
+				return;
+			file_.Write(time);
+			for (size_t i = 0; i < states_.size(); i++)
+			{
+				file_.Write(',').Write(values[i]);
+			}
+			file_.EndLine();
+		}
+		virtual std::vector<std::shared_ptr<IState>> GetLoggedStates() const override
+		{
+			return states_;
 		}
 
 		void SetShouldLog(bool shouldLog)
@@ -76,43 +86,26 @@ namespace stochsim
 		{
 			if (!shouldLog_)
 				return;
-			if (file_)
-			{
-				file_->close();
-				file_.reset();
-			}
 			std::string fileName = simInfo.GetSaveFolder();
 			fileName += "/";
 			fileName += fileName_;
+			file_.Open(fileName);
 
-			file_ = std::make_unique<std::ofstream>();
-			file_->open(fileName);
-			if (!file_->is_open())
-			{
-				std::string errorMessage = "Could not open file ";
-				errorMessage += fileName;
-				throw new std::exception(errorMessage.c_str());
-			}
-
-			(*file_) << "Time";
+			file_.Write("Time");
 			for (const auto& state : states_)
 			{
-				(*file_) << ',' << state->GetName();
+				file_.Write(',').Write(state->GetName());
 			}
-			(*file_) << std::endl;
+			file_.EndLine();
 		}
 		virtual void Uninitialize(ISimInfo& simInfo) override
 		{
-			if (file_)
-			{
-				file_->close();
-				file_.reset();
-			}
+			file_.Close();
 		}
 
 	private:
 		std::vector<std::shared_ptr<IState>> states_;
-		std::unique_ptr<std::ofstream> file_;
+		CsvWriter file_;
 		std::string fileName_;
 		bool shouldLog_;
 	};
@@ -1,10 +1,11 @@
 #pragma once
 #include "stochsim_common.h"
 #include <memory>
-#include <fstream>
 #include <vector>
 #include <functional>
 #include "DelayReaction.h"
+#include "HistogramState.h"
+#include "CsvWriter.h"
 namespace stochsim
 {
 	class StatePropertyLogger :
@@ -15,79 +16,84 @@ namespace stochsim
 		StatePropertyLogger(std::string fileName, LoggerFunction loggerFunction = [](const Molecule& molecule)->size_t {return static_cast<size_t>(molecule[0]+0.5); }, size_t initialMaxValue = 10) : valueCounter_(initialMaxValue +1), fileName_(fileName), loggerFunction_(loggerFunction)
 		{
 		}
+		/// <summary>
+		/// Constructor for a logger which, instead of counting the molecules passed to LogProperty, logs how many molecules currently in the given state have each value. The counts are read directly from the histogram of the state,
+		/// such that no listener has to be added to the state.
+		/// </summary>
+		/// <param name="fileName">Name of the file, relative to the save folder of the simulation.</param>
+		/// <param name="state">State whose molecules should be counted.</param>
+		/// <param name="loggerFunction">Function mapping a molecule to its value.</param>
+		/// <param name="initialMaxValue">Estimate of the maximal value. Increased automatically if a higher value is encountered.</param>
+		StatePropertyLogger(std::string fileName, std::shared_ptr<HistogramState> state, LoggerFunction loggerFunction = [](const Molecule& molecule)->size_t {return static_cast<size_t>(molecule[0] + 0.5); }, size_t initialMaxValue = 10) : valueCounter_(initialMaxValue + 1), fileName_(fileName), loggerFunction_(loggerFunction), state_(std::move(state))
+		{
+		}
 
 		virtual ~StatePropertyLogger()
 		{
-			if (file_)
-			{
-				file_->close();
-				file_.reset();
-			}
 		}
 		virtual bool WritesToDisk() const override
 		{
 			return true;
 		}
-		void LogProperty(const Molecule& molecule, double time)
+		void LogProperty(const Molecule& molecule, double time, size_t num)
 		{
-			auto id = loggerFunction_(molecule);
-			while (id >= valueCounter_.size())
-			{
-				valueCounter_.resize(2 * valueCounter_.size());
-			}
-			valueCounter_[id]++;
+			Count(molecule, num);
 		}
 		virtual void WriteLog(ISimInfo& simInfo, double time) override
 		{
-			*file_ << time;
+			if (state_)
+			{
+				state_->ForEachValue([this](const Molecule& molecule, size_t num)
+				{
+					Count(molecule, num);
+				});
+			}
+			file_.Write(time);
 			for (auto& numMolecules : valueCounter_)
 			{
-				*file_ << ", " << numMolecules;
+				file_.Write(", ").Write(static_cast<size_t>(numMolecules));
 				numMolecules = 0;
 			}
-			*file_ << std::endl;
+			file_.EndLine();
 		}
 		virtual void Initialize(ISimInfo& simInfo) override
 		{
-			if (file_)
-			{
-				file_->close();
-				file_.reset();
-			}
 			std::string fileName = simInfo.GetSaveFolder();
 			fileName += "/";
 			fileName += fileName_;
+			file_.Open(fileName);
 
-			file_ = std::make_unique<std::ofstream>();
-			file_->open(fileName);
-			if (!file_->is_open())
-			{
-				std::string errorMessage = "Could not open file ";
-				errorMessage += fileName;
-				throw new std::exception(errorMessage.c_str());
-			}
-
-			*file_ << "Time";
+			file_.Write("Time");
 			for (std::vector<unsigned long>::size_type i = 0; i < valueCounter_.size(); i++)
 			{
 				valueCounter_[i] = 0;
-				*file_ << ", value" << i;
+				file_.Write(", value").Write(static_cast<size_t>(i));
 			}
-			*file_ << std::endl;
+			file_.EndLine();
 		}
 		virtual void Uninitialize(ISimInfo& simInfo) override
 		{
-			if (file_)
+			file_.Close();
+		}
+
+	private:
+		inline void Count(const Molecule& molecule, size_t num)
+		{
+			auto id = loggerFunction_(molecule);
+			while (id >= valueCounter_.size())
 			{
-				file_->close();
-				file_.reset();
+				valueCounter_.resize(2 * valueCounter_.size());
 			}
+			valueCounter_[id] += static_cast<unsigned long>(num);
 		}
 
-	private:
-		std::unique_ptr<std::ofstream> file_;
+		CsvWriter file_;
 		std::string fileName_;
 		std::vector<unsigned long> valueCounter_;
 		LoggerFunction loggerFunction_;
+		/// <summary>
+		/// State whose histogram is logged, or nullptr if the molecules passed to LogProperty are counted.
+		/// </summary>
+		std::shared_ptr<HistogramState> state_;
 	};
 }
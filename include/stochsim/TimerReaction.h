@@ -42,7 +42,7 @@ namespace stochsim
 						propertyExpression.Uninitialize(simInfo);
 				}
 			}
-			inline Molecule operator() (ISimInfo& simInfo, const std::vector<Variable>& variables = {}) const
+			inline Molecule operator() (ISimInfo& simInfo, const Variables& variables = {}) const
 			{
 				Molecule molecule;
 				for (size_t i = 0; i < Molecule::size_; i++)
@@ -84,10 +84,7 @@ namespace stochsim
 			for (auto& product : products_)
 			{
 				Molecule molecule = product(simInfo);
-				for (size_t i = 0; i < product.stochiometry_; i++)
-				{
-					product.state_->Add(simInfo, molecule);
-				}
+				product.state_->AddN(simInfo, product.stochiometry_, molecule);
 			}
 			hasFired_ = true;
 		}
@@ -0,0 +1,240 @@
+#pragma once
+#include <list>
+#include <string>
+#include <limits>
+#include "stochsim_common.h"
+#include "CircularBuffer.h"
+namespace stochsim
+{
+	/// <summary>
+	/// A state whose molecules have no properties, but of which it is known when each molecule was created. Only the creation times are stored, in the order the molecules were created,
+	/// such that the state needs only a fraction of the memory of a ComposedState. Typically used as the reactant of a DelayReaction when no reaction reads or writes the properties of the molecules.
+	/// Randomly removed molecules are only marked as removed, and the marked molecules are discarded when they make up half of the buffer, such that removing a random molecule takes amortized constant time.
+	/// </summary>
+	class TimestampQueueState :
+		public ITimedState
+	{
+	public:
+		/// <summary>
+		/// Constructor.
+		/// </summary>
+		/// <param name="name">Name of the state.</param>
+		/// <param name="initialCondition">Initial number of molecules which are there when the simulation starts.</param>
+		/// <param name="initialCapacity">Initial maximum amount of molecules which are expected to be hold by this state. If the number of molecules increases over the maximum, the buffer grows which requires reallocation of space.</param>
+		TimestampQueueState(std::string name, size_t initialCondition, size_t initialCapacity = 1000) : buffer_(initialCapacity > initialCondition ? initialCapacity : initialCondition), name_(name), initialCondition_(initialCondition), size_(0)
+		{
+		}
+		virtual void Initialize(ISimInfo& simInfo) override
+		{
+			buffer_.Clear();
+			size_ = GetInitialCondition();
+			double time = simInfo.GetSimTime();
+			for (size_t i = 0; i < size_; i++)
+			{
+				buffer_.PushTail() = time;
+			}
+		}
+		virtual void Uninitialize(ISimInfo& simInfo) override
+		{
+			buffer_.Clear();
+			size_ = 0;
+		}
+		virtual inline size_t Num(ISimInfo& simInfo) const override
+		{
+			return size_;
+		}
+		virtual inline void AddDecreaseListener(StateListener stateListener) override
+		{
+			removeListeners_.push_back(std::move(stateListener));
+		}
+		virtual inline void AddIncreaseListener(StateListener stateListener) override
+		{
+			addListeners_.push_back(std::move(stateListener));
+		}
+		virtual void Add(ISimInfo& simInfo, const Molecule& molecule = defaultMolecule, const Variables& variables = {}) override
+		{
+			double time = simInfo.GetSimTime();
+			for (auto& addListener : addListeners_)
+			{
+				addListener(defaultMolecule, time, 1);
+			}
+			buffer_.PushTail() = time;
+			size_++;
+		}
+		virtual Molecule Remove(ISimInfo& simInfo, const Variables& variables = {}) override
+		{
+			size_t idx = RandomBufferIndex(simInfo);
+			if (idx == 0)
+				return RemoveFirst(simInfo, variables);
+			NotifyRemove(simInfo);
+			buffer_[idx] = removed_;
+			size_--;
+			return defaultMolecule;
+		}
+		virtual Molecule RemoveFirst(ISimInfo& simInfo, const Variables& variables = {}) override
+		{
+			NotifyRemove(simInfo);
+			// First element guaranteed to be valid.
+			buffer_.PopTop();
+			size_--;
+			// Remove new first element if it happens to be removed already to guarantee that first element is always valid.
+			while (buffer_.Size() > 0 && buffer_[0] == removed_)
+			{
+				buffer_.PopTop();
+			}
+			return defaultMolecule;
+		}
+		virtual void AddN(ISimInfo& simInfo, size_t num, const Molecule& molecule = defaultMolecule, const Variables& variables = {}) override
+		{
+			if (num == 0)
+				return;
+			double time = simInfo.GetSimTime();
+			for (auto& addListener : addListeners_)
+			{
+				addListener(defaultMolecule, time, num);
+			}
+			for (size_t i = 0; i < num; i++)
+			{
+				buffer_.PushTail() = time;
+			}
+			size_ += num;
+		}
+		virtual void RemoveN(ISimInfo& simInfo, size_t num, const Variables& variables = {}) override
+		{
+			if (num == 0)
+				return;
+			// For only a few molecules, removing them one by one is cheaper than iterating over the whole buffer.
+			if (num * bulkRemoveFactor_ < size_)
+			{
+				for (size_t i = 0; i < num; i++)
+				{
+					Remove(simInfo, variables);
+				}
+				return;
+			}
+			// Iterate backwards over the buffer and select each valid molecule with probability (molecules still to remove)/(valid molecules not yet visited), which
+			// selects exactly num molecules uniformly at random (selection sampling). At the same time, compact the buffer by moving all molecules which are kept towards its end.
+			size_t toRemove = num;
+			size_t remaining = size_;
+			size_t write = buffer_.Size();
+			for (size_t read = buffer_.Size(); read > 0; read--)
+			{
+				double creationTime = buffer_[read - 1];
+				if (creationTime == removed_)
+					continue;
+				if (toRemove > 0 && simInfo.Rand() * remaining < toRemove)
+				{
+					toRemove--;
+				}
+				else if (--write != read - 1)
+				{
+					buffer_[write] = creationTime;
+				}
+				remaining--;
+			}
+			buffer_.PopTop(write);
+			size_ -= num;
+			NotifyRemove(simInfo, num);
+		}
+		virtual inline double PeakFirstCreationTime(ISimInfo& simInfo) const override
+		{
+			return buffer_[0];
+		}
+		virtual const Molecule& Peak(ISimInfo& simInfo) const override
+		{
+			return defaultMolecule;
+		}
+		virtual Molecule& Transform(ISimInfo& simInfo, const Variables& variables = {}) override
+		{
+			// Molecules of this state have no properties, such that transforming them has no effect.
+			transformed_.Reset();
+			return transformed_;
+		}
+		virtual void TransformN(ISimInfo& simInfo, size_t num, std::vector<Molecule*>& molecules, const Variables& variables = {}) override
+		{
+			Molecule* molecule = &Transform(simInfo, variables);
+			for (size_t i = 0; i < num; i++)
+			{
+				molecules[i] = molecule;
+			}
+		}
+		virtual std::string GetName() const noexcept override
+		{
+			return name_;
+		}
+		/// <summary>
+		///  Returns the initial condition of the state. It holds that at t=0, Num()==GetInitialCondition().
+		/// </summary>
+		/// <returns>Initial condition of the state.</returns>
+		size_t GetInitialCondition() const
+		{
+			return initialCondition_;
+		}
+		/// <summary>
+		/// Sets the initial condition of the state. It holds that at t=0, Num()==GetInitialCondition().
+		/// </summary>
+		/// <param name="initialCondition">initial condition</param>
+		void SetInitialCondition(size_t initialCondition)
+		{
+			initialCondition_ = initialCondition;
+		}
+	private:
+		/// <summary>
+		/// Creation time marking a molecule as removed.
+		/// </summary>
+		static constexpr double removed_ = -std::numeric_limits<double>::infinity();
+		/// <summary>
+		/// RemoveN removes molecules one by one if less than 1/bulkRemoveFactor_ of all molecules are removed.
+		/// </summary>
+		static constexpr size_t bulkRemoveFactor_ = 16;
+
+		inline void NotifyRemove(ISimInfo& simInfo, size_t num = 1)
+		{
+			if (removeListeners_.empty())
+				return;
+			double time = simInfo.GetSimTime();
+			for (auto& removeListener : removeListeners_)
+			{
+				removeListener(defaultMolecule, time, num);
+			}
+		}
+		/// <summary>
+		/// Returns a uniform random index of a molecule which is not removed. If at least half of the buffer consists of removed molecules, they are discarded first, such that
+		/// the expected number of trials is at most two.
+		/// </summary>
+		/// <returns>A uniform random index to a valid buffer element.</returns>
+		inline size_t RandomBufferIndex(ISimInfo& simInfo)
+		{
+			if (buffer_.Size() >= 2 * size_)
+				Compact();
+			while (true)
+			{
+				size_t idx = simInfo.Rand(0, buffer_.Size() - 1);
+				if (buffer_[idx] != removed_)
+					return idx;
+			}
+		}
+		/// <summary>
+		/// Discards all removed molecules, keeping the order of the other molecules.
+		/// </summary>
+		void Compact()
+		{
+			size_t write = buffer_.Size();
+			for (size_t read = buffer_.Size(); read > 0; read--)
+			{
+				double creationTime = buffer_[read - 1];
+				if (creationTime != removed_ && --write != read - 1)
+					buffer_[write] = creationTime;
+			}
+			buffer_.PopTop(write);
+		}
+
+		CircularBuffer<double> buffer_;
+		std::list<StateListener> removeListeners_;
+		std::list<StateListener> addListeners_;
+		Molecule transformed_;
+		const std::string name_;
+		size_t initialCondition_;
+		size_t size_;
+	};
+}
@@ -8,6 +8,8 @@
 #include <initializer_list>
 #include <tuple>			
 #include <functional>
+#include <atomic>
+#include <algorithm>
 #include "expression_common.h"
 namespace stochsim
 {
@@ -25,17 +27,128 @@ namespace stochsim
 	/// </summary>
 	template <class T> using Collection = std::vector<T>;
 	/// <summary>
-	/// Name value pair, used to pass named variables having double values around.
+	/// Named variables having double values, e.g. the properties of the molecules taking part in a reaction, which a reaction passes to the states and expressions it involves.
+	/// The names of the variables are declared once, typically when the reaction is initialized, which assigns each variable a slot. When the reaction fires, the values are then set by their slots,
+	/// without constructing names and without allocating memory. Expressions evaluated with a given object are compiled once for its layout (see GetLayout), and then read the values directly from the slots.
 	/// </summary>
-	typedef std::pair<std::string, double> Variable;
-	/// <summary>
-	/// Array of name value pairs representing defined variables and their values.
-	/// </summary>
-	typedef std::vector<Variable> Variables;
-	/// <summary>
-	/// Creates a variable with the given name.
-	/// </summary>
-	constexpr auto make_variable = std::make_pair<std::string, double>;
+	class Variables
+	{
+	public:
+		/// <summary>
+		/// Slot returned by Find if no variable with the given name is declared.
+		/// </summary>
+		static constexpr size_t npos = std::numeric_limits<size_t>::max();
+
+		Variables() noexcept : layout_(0)
+		{
+		}
+		Variables(const Variables& other) : names_(other.names_), values_(other.values_), layout_(other.names_.empty() ? 0 : NewLayout())
+		{
+		}
+		Variables& operator=(const Variables& other)
+		{
+			names_ = other.names_;
+			values_ = other.values_;
+			layout_ = names_.empty() ? 0 : NewLayout();
+			return *this;
+		}
+		/// <summary>
+		/// Declares a variable with the given name and an initial value of zero, and returns its slot. If a variable with the same name is already declared, returns its slot instead.
+		/// </summary>
+		/// <param name="name">Name of the variable.</param>
+		/// <returns>Slot of the variable.</returns>
+		size_t Declare(const std::string& name)
+		{
+			size_t slot = Find(name);
+			if (slot != npos)
+				return slot;
+			names_.push_back(name);
+			values_.push_back(0);
+			layout_ = NewLayout();
+			return names_.size() - 1;
+		}
+		/// <summary>
+		/// Removes all declared variables.
+		/// </summary>
+		void Clear() noexcept
+		{
+			names_.clear();
+			values_.clear();
+			layout_ = 0;
+		}
+		/// <summary>
+		/// Returns the slot of the variable with the given name, or npos if no such variable is declared.
+		/// </summary>
+		/// <param name="name">Name of the variable.</param>
+		/// <returns>Slot of the variable, or npos.</returns>
+		size_t Find(const std::string& name) const noexcept
+		{
+			for (size_t slot = 0; slot < names_.size(); slot++)
+			{
+				if (names_[slot] == name)
+					return slot;
+			}
+			return npos;
+		}
+		/// <summary>
+		/// Returns the number of declared variables.
+		/// </summary>
+		/// <returns>Number of variables.</returns>
+		inline size_t Size() const noexcept
+		{
+			return names_.size();
+		}
+		inline const std::string& GetName(size_t slot) const noexcept
+		{
+			return names_[slot];
+		}
+		inline void Set(size_t slot, double value) noexcept
+		{
+			values_[slot] = value;
+		}
+		inline double Get(size_t slot) const noexcept
+		{
+			return values_[slot];
+		}
+		/// <summary>
+		/// Returns the memory location where the value of the variable in the given slot is stored. The location stays valid until the next variable is declared, or until this object is destroyed or cleared,
+		/// which is signalled by a change of the layout.
+		/// </summary>
+		/// <param name="slot">Slot of the variable.</param>
+		/// <returns>Location of the value of the variable.</returns>
+		/// <summary>
+		/// Copies the values of all variables of other to the variables with the same slots. The variables of other must be declared in the same order at the beginning of this object,
+		/// which is the case if this object was copied from other before further variables were declared.
+		/// </summary>
+		/// <param name="other">Variables whose values are copied.</param>
+		inline void CopyValues(const Variables& other) noexcept
+		{
+			std::copy(other.values_.begin(), other.values_.end(), values_.begin());
+		}
+		inline const double* GetLocation(size_t slot) const noexcept
+		{
+			return &values_[slot];
+		}
+		/// <summary>
+		/// Returns a number identifying the names of the declared variables, as well as the memory locations of their values. The number changes whenever a variable is declared, and no two objects share the same number,
+		/// such that it can be used as a key to cache expressions compiled for a given set of variables. Zero if no variable is declared.
+		/// </summary>
+		/// <returns>Identifier of the layout.</returns>
+		inline size_t GetLayout() const noexcept
+		{
+			return layout_;
+		}
+	private:
+		std::vector<std::string> names_;
+		std::vector<double> values_;
+		size_t layout_;
+
+		static size_t NewLayout() noexcept
+		{
+			static std::atomic<size_t> lastLayout(0);
+			return ++lastLayout;
+		}
+	};
 	
 	/// <summary>
 	/// A molecule is one element of a state. In stochsim, each molecule itself can have an individuality, represented by a certain set of properties (double values).
@@ -45,9 +158,9 @@ namespace stochsim
 	{
 	public:
 		/// <summary>
-		/// Number of different properties a molecule can have.
+		/// Maximal number of different properties a molecule can have. States may store less properties per molecule, see e.g. ComposedState.
 		/// </summary>
-		static constexpr size_t size_ = 2;
+		static constexpr size_t size_ = 4;
 		/// <summary>
 		/// Returns number of different properties a molecule can have. Always same as variable size_.
 		/// </summary>
@@ -62,7 +175,7 @@ namespace stochsim
 	private:
 		std::array<double, size_> properties_;
 	public: 
-		Molecule() : properties_({ 0.,0.})
+		Molecule() : properties_()
 		{
 		};
 		Molecule(PropertyValues&& properties) : properties_(std::move(properties))
@@ -96,9 +209,119 @@ namespace stochsim
 	/// </summary>
 	const Molecule defaultMolecule;
 
+	/// <summary>
+	/// Slots of the variables representing the named properties of the molecules of one reaction component, e.g. of a reactant. If the stochiometry of the component is one, the variables
+	/// have the same names as the properties. Otherwise, the variable of property x of the i-th molecule is named x[i].
+	/// </summary>
+	class PropertySlots
+	{
+	public:
+		/// <summary>
+		/// Declares the variables for the properties of the molecules of a reaction component. Typically called when the respective reaction is initialized.
+		/// </summary>
+		/// <param name="variables">Variables of the reaction.</param>
+		/// <param name="propertyNames">Names of the properties. Properties without name are not represented by variables.</param>
+		/// <param name="stochiometry">Stochiometry of the component.</param>
+		void Declare(Variables& variables, const Molecule::PropertyNames& propertyNames, Stochiometry stochiometry)
+		{
+			used_ = false;
+			for (const auto& propertyName : propertyNames)
+			{
+				used_ = used_ || !propertyName.empty();
+			}
+			slots_.resize(stochiometry * Molecule::size_);
+			for (size_t i = 0; i < stochiometry; i++)
+			{
+				for (size_t p = 0; p < Molecule::size_; p++)
+				{
+					if (propertyNames[p].empty())
+						slots_[i * Molecule::size_ + p] = Variables::npos;
+					else if (stochiometry > 1)
+						slots_[i * Molecule::size_ + p] = variables.Declare(propertyNames[p] + "[" + std::to_string(i) + "]");
+					else
+						slots_[i * Molecule::size_ + p] = variables.Declare(propertyNames[p]);
+				}
+			}
+		}
+		/// <summary>
+		/// Sets the variables representing the properties of the i-th molecule of the component.
+		/// </summary>
+		/// <param name="variables">Variables of the reaction.</param>
+		/// <param name="i">Index of the molecule, which must be smaller than the stochiometry.</param>
+		/// <param name="molecule">Molecule whose properties are assigned to the variables.</param>
+		inline void Set(Variables& variables, size_t i, const Molecule& molecule) const noexcept
+		{
+			const size_t* slots = slots_.data() + i * Molecule::size_;
+			for (size_t p = 0; p < Molecule::size_; p++)
+			{
+				if (slots[p] != Variables::npos)
+					variables.Set(slots[p], molecule[p]);
+			}
+		}
+		/// <summary>
+		/// Returns true if any property of the molecules is represented by a variable, i.e. if the molecules of the component must be set with Set.
+		/// </summary>
+		/// <returns>True if any property is named.</returns>
+		inline bool IsUsed() const noexcept
+		{
+			return used_;
+		}
+		void Clear() noexcept
+		{
+			slots_.clear();
+			used_ = false;
+		}
+	private:
+		std::vector<size_t> slots_;
+		bool used_ = false;
+	};
+
 	// Forward declaration.
 	class IState;
 
+	/// <summary>
+	/// Source of the random numbers of a simulation. A random engine is seeded by a pair of a seed and a stream index. Engines seeded with the same pair must produce identical sequences
+	/// of random numbers, while engines seeded with the same seed but different streams must produce statistically independent sequences.
+	/// </summary>
+	class IRandomEngine
+	{
+	public:
+		virtual ~IRandomEngine() {};
+		/// <summary>
+		/// Seeds the random engine, and resets it to the first random number of the given stream.
+		/// </summary>
+		/// <param name="seed">Seed of the random engine.</param>
+		/// <param name="stream">Index of the random number stream.</param>
+		virtual void Seed(unsigned long long seed, unsigned long long stream) = 0;
+		/// <summary>
+		/// Generates a uniformly distributed random 64 bit integer.
+		/// </summary>
+		/// <returns>Random integer.</returns>
+		virtual unsigned long long Next() = 0;
+		/// <summary>
+		/// Generates a uniformly distributed random double number in the open interval (0, 1).
+		/// </summary>
+		/// <returns>Random number in (0, 1).</returns>
+		virtual double Uniform() = 0;
+		/// <summary>
+		/// Generates an exponentially distributed random number with rate one.
+		/// </summary>
+		/// <returns>Positive random number.</returns>
+		virtual double Exponential() = 0;
+		/// <summary>
+		/// Fills the array with uniformly distributed random double numbers in the open interval (0, 1).
+		/// </summary>
+		/// <param name="values">Array to fill.</param>
+		/// <param name="num">Number of elements of the array.</param>
+		virtual void Uniforms(double* values, size_t num) = 0;
+		/// <summary>
+		/// Fills the array with exponentially distributed random numbers with rate one.
+		/// </summary>
+		/// <param name="values">Array to fill.</param>
+		/// <param name="num">Number of elements of the array.</param>
+		virtual void Exponentials(double* values, size_t num) = 0;
+	};
+
 	/// <summary>
 	/// Provides information about the current global state of the simulation, e.g. the current simulation time.
 	/// Also provides some helper functions to e.g. calculate random numbers. Random numbers should only be calculated given these numbers,
@@ -129,11 +352,21 @@ namespace stochsim
 		/// <returns></returns>
 		virtual size_t Rand(size_t lower, size_t upper) = 0;
 		/// <summary>
-		/// Generates a uniformly distributed random double number between zero and one.
+		/// Generates a uniformly distributed random double number between zero and one (both excluded).
 		/// </summary>
 		/// <returns></returns>
 		virtual double Rand() = 0;
 		/// <summary>
+		/// Generates an exponentially distributed random number with rate one, e.g. to determine the time until the next reaction.
+		/// </summary>
+		/// <returns></returns>
+		virtual double RandExponential() = 0;
+		/// <summary>
+		/// Returns the random engine of the simulation, e.g. to generate many random numbers at once.
+		/// </summary>
+		/// <returns>Random engine of the simulation.</returns>
+		virtual IRandomEngine& GetRandomEngine() = 0;
+		/// <summary>
 		/// Returns the folder under which the results of the simulation should be saved.
 		/// </summary>
 		/// <returns>Folder where simulation results are saved.</returns>
@@ -144,6 +377,12 @@ namespace stochsim
 		/// <returns>Log period in simulation time units</returns>
 		virtual double GetLogPeriod() const = 0;
 		/// <summary>
+		/// Returns the next time, strictly after the current simulation time, at which the state of the simulation is logged.
+		/// Engines which advance the simulation in steps must not step over this time.
+		/// </summary>
+		/// <returns>Next log time.</returns>
+		virtual double GetNextLogTime() const = 0;
+		/// <summary>
 		/// Returns a collection of all states defined in the simulation.
 		/// </summary>
 		/// <returns>States defined in the simulation.</returns>
@@ -157,9 +396,10 @@ namespace stochsim
 	{
 	public:
 		/// <summary>
-		/// Typedef for listener with which modifications of the state can be detected..
+		/// Typedef for listener with which modifications of the state can be detected. When several molecules with the same properties are added or removed at once, the listener may be
+		/// invoked only once, with num set to the number of molecules.
 		/// </summary>
-		typedef std::function<void(const Molecule& molecule, double time)> StateListener;
+		typedef std::function<void(const Molecule& molecule, double time, size_t num)> StateListener;
 		/// <summary>
 		/// Virtual destructor.
 		/// </summary>
@@ -200,6 +440,29 @@ namespace stochsim
 		/// <returns>Molecule which can be transformed.</returns>
 		virtual Molecule& Transform(ISimInfo& simInfo, const Variables& variables = {}) = 0;
 		/// <summary>
+		/// Increases the value of the state by num molecules, all having the same properties. Equivalent to, but typically faster than, calling Add num times.
+		/// </summary>
+		/// <param name="simInfo">Simulation context.</param>
+		/// <param name="num">Number of molecules to add.</param>
+		/// <param name="molecule">The molecule which should be added num times.</param>
+		/// <param name="variables">Variables which are currently defined.</param>
+		virtual void AddN(ISimInfo& simInfo, size_t num, const Molecule& molecule = defaultMolecule, const Variables& variables = {}) = 0;
+		/// <summary>
+		/// Decreases the value of the state by num uniformly chosen molecules. Equivalent to, but typically faster than, calling Remove num times.
+		/// </summary>
+		/// <param name="simInfo">Simulation context.</param>
+		/// <param name="num">Number of molecules to remove. Must be smaller or equal to Num().</param>
+		/// <param name="variables">Variables which are currently defined.</param>
+		virtual void RemoveN(ISimInfo& simInfo, size_t num, const Variables& variables = {}) = 0;
+		/// <summary>
+		/// Chooses num molecules to be transformed. Equivalent to calling Transform num times.
+		/// </summary>
+		/// <param name="simInfo">Simulation context.</param>
+		/// <param name="num">Number of molecules to transform.</param>
+		/// <param name="molecules">Receives pointers to the molecules which can be transformed. Must have at least num elements.</param>
+		/// <param name="variables">Variables which are currently defined.</param>
+		virtual void TransformN(ISimInfo& simInfo, size_t num, std::vector<Molecule*>& molecules, const Variables& variables = {}) = 0;
+		/// <summary>
 		/// Called by the simulation before the simulation starts. Should ensure that e.g. the current value of the state equals the initial condition.
 		/// </summary>
 		/// <param name="simInfo">Simulation context</param>
@@ -226,6 +489,31 @@ namespace stochsim
 		virtual void AddIncreaseListener(StateListener stateListener) = 0;
 	};
 
+	/// <summary>
+	/// Base class of all states which keep their molecules ordered by the time they were created, such that the oldest molecule can be accessed and removed directly, e.g. by a DelayReaction.
+	/// </summary>
+	class ITimedState : public IState
+	{
+	public:
+		/// <summary>
+		/// Virtual destructor.
+		/// </summary>
+		virtual ~ITimedState() {};
+		/// <summary>
+		/// Returns the creation time of the first, that is, oldest molecule. Behavior undefined if Num() is zero.
+		/// </summary>
+		/// <param name="simInfo">Simulation context.</param>
+		/// <returns>Creation time of the oldest molecule.</returns>
+		virtual double PeakFirstCreationTime(ISimInfo& simInfo) const = 0;
+		/// <summary>
+		/// Removes the first, that is, oldest molecule. Behavior undefined if Num() is zero.
+		/// </summary>
+		/// <param name="simInfo">Simulation context.</param>
+		/// <param name="variables">Variables which are currently defined.</param>
+		/// <returns>The molecule which was removed.</returns>
+		virtual Molecule RemoveFirst(ISimInfo& simInfo, const Variables& variables = {}) = 0;
+	};
+
 	/// <summary>
 	/// Base class of all reactions which are propensity based, i.e. the probability that a given reaction fires in a given infinitisemal time period is proportional to the length of the time unit,
 	/// and only depends on the current state. That is, the next firing time is exponentially distributed.
@@ -329,6 +617,28 @@ namespace stochsim
 		virtual bool WritesToDisk() const  = 0;
 	};
 
+	/// <summary>
+	/// A logger which only logs the molecular numbers of a fixed set of states. Instead of being called by the simulation itself, such a logger can be called by a background thread with copies of the molecular numbers
+	/// taken by the simulation at the log times (see Simulation::SetLoggingMode), such that formatting and writing the values does not slow down the simulation.
+	/// </summary>
+	class ISnapshotLogger : public ILogger
+	{
+	public:
+		virtual ~ISnapshotLogger() {}
+		/// <summary>
+		/// Returns the states whose molecular numbers are logged. Called after Initialize, and the states must not change until Uninitialize.
+		/// </summary>
+		/// <returns>States which are logged.</returns>
+		virtual std::vector<std::shared_ptr<IState>> GetLoggedStates() const = 0;
+		/// <summary>
+		/// Called instead of WriteLog(ISimInfo&amp;, double) when logging asynchronously, potentially from a different thread than the one running the simulation.
+		/// </summary>
+		/// <param name="time">Time of logging.</param>
+		/// <param name="values">Molecular numbers of the states returned by GetLoggedStates() at the time of logging, in the same order.</param>
+		virtual void WriteLog(double time, const size_t* values) = 0;
+		using ILogger::WriteLog;
+	};
+
 	/// <summary>
 	/// A reaction left element is either a reactant or a modifier of a reaction, i.e. an element standing on the left of the reaction arrow.
 	/// </summary>
@@ -6,6 +6,7 @@
 #include "cmdl_symbols.h"
 #include "CmdlParseTree.h"
 #include "ComposedState.h"
+#include "TimestampQueueState.h"
 #include "State.h"
 #include "Choice.h"
 #include "PropensityReaction.h"
@@ -62,10 +63,10 @@ namespace cmdlparser
 				type_composed,
 				type_choice
 			};
-			state_definition() noexcept: type_(type_simple)
+			state_definition() noexcept: type_(type_simple), numProperties_(0)
 			{
 			}
-			state_definition(type type) noexcept : type_(type)
+			state_definition(type type) noexcept : type_(type), numProperties_(0)
 			{
 			}
 			bool require_type(type type) noexcept
@@ -90,7 +91,23 @@ namespace cmdlparser
 						return false;
 				}
 			}
+			/// <summary>
+			/// Requires the state to be composed since the property with the given index of its molecules is read or written.
+			/// </summary>
+			bool require_property(size_t index) noexcept
+			{
+				if (!require_type(type_composed))
+					return false;
+				if (index >= numProperties_)
+					numProperties_ = index + 1;
+				return true;
+			}
 			type type_;
+			/// <summary>
+			/// One plus the highest index of a property of the molecules of the state which is read or written by any reaction or choice, or zero if no property is used.
+			/// Composed states without properties only have to keep track of the creation times of their molecules, and composed states with properties only store the used ones.
+			/// </summary>
+			size_t numProperties_;
 		};
 		// get all state names used in reactions.
 		std::unordered_map<expression::identifier, state_definition> states;
@@ -105,18 +122,14 @@ namespace cmdlparser
 				// define state if yet not existent.
 				states[elem.first];
 
-				for (auto& expression : elem.second->GetPropertyExpressions())
+				auto& expressions = elem.second->GetPropertyExpressions();
+				for (size_t p = 0; p < expressions.size(); p++)
 				{
-					if (expression)
+					if (expressions[p] && !states[elem.first].require_property(p))
 					{
-						if (!states[elem.first].require_type(state_definition::type_composed))
-						{
-							std::stringstream errorMessage;
-							errorMessage << "Cannot initialize state '" << elem.first << "': In one reaction it is used as the species having properties, and in another as a choice, which is invalid.";
-							throw std::exception(errorMessage.str().c_str());
-						}
-						else
-							break;
+						std::stringstream errorMessage;
+						errorMessage << "Cannot initialize state '" << elem.first << "': In one reaction it is used as the species having properties, and in another as a choice, which is invalid.";
+						throw std::exception(errorMessage.str().c_str());
 					}
 				}		
 			} 
@@ -124,18 +137,14 @@ namespace cmdlparser
 			{
 				// define state if yet not existent.
 				states[elem.first];
-				for (auto& expression : elem.second->GetPropertyExpressions())
+				auto& expressions = elem.second->GetPropertyExpressions();
+				for (size_t p = 0; p < expressions.size(); p++)
 				{
-					if (expression)
+					if (expressions[p] && !states[elem.first].require_property(p))
 					{
-						if (!states[elem.first].require_type(state_definition::type_composed))
-						{
-							std::stringstream errorMessage;
-							errorMessage << "Cannot initialize state '" << elem.first << "': In one reaction it is used as the species having properties, and in another as a choice, which is invalid.";
-							throw std::exception(errorMessage.str().c_str());
-						}
-						else
-							break;
+						std::stringstream errorMessage;
+						errorMessage << "Cannot initialize state '" << elem.first << "': In one reaction it is used as the species having properties, and in another as a choice, which is invalid.";
+						throw std::exception(errorMessage.str().c_str());
 					}
 				}
 			}
@@ -154,18 +163,14 @@ namespace cmdlparser
 					errorMessage << "Cannot initialize state '" << name << "': In one reaction it is used as the species determining the delay of a reaction and in another as a choice, which is invalid.";
 					throw std::exception(errorMessage.str().c_str());
 				}
-				for (auto& propertyName : elem.second->GetPropertyNames())
+				auto& propertyNames = elem.second->GetPropertyNames();
+				for (size_t p = 0; p < propertyNames.size(); p++)
 				{
-					if (!propertyName.empty())
+					if (!propertyNames[p].empty() && !states[elem.first].require_property(p))
 					{
-						if (!states[elem.first].require_type(state_definition::type_composed))
-						{
-							std::stringstream errorMessage;
-							errorMessage << "Cannot initialize state '" << elem.first << "': In one reaction it is used as the species having properties, and in another as a choice, which is invalid.";
-							throw std::exception(errorMessage.str().c_str());
-						}
-						else
-							break;
+						std::stringstream errorMessage;
+						errorMessage << "Cannot initialize state '" << elem.first << "': In one reaction it is used as the species having properties, and in another as a choice, which is invalid.";
+						throw std::exception(errorMessage.str().c_str());
 					}
 				}
 			}
@@ -174,18 +179,14 @@ namespace cmdlparser
 				// define state if yet not existent, or get it if already existent.
 				auto name = elem.first;
 				state_definition& state = states[name];
-				for (auto& expression : elem.second->GetPropertyExpressions())
+				auto& expressions = elem.second->GetPropertyExpressions();
+				for (size_t p = 0; p < expressions.size(); p++)
 				{
-					if (expression)
+					if (expressions[p] && !states[elem.first].require_property(p))
 					{
-						if (!states[elem.first].require_type(state_definition::type_composed))
-						{
-							std::stringstream errorMessage;
-							errorMessage << "Cannot initialize state '" << elem.first << "': In one reaction it is used as the species having properties, and in another as a choice, which is invalid.";
-							throw std::exception(errorMessage.str().c_str());
-						}
-						else
-							break;
+						std::stringstream errorMessage;
+						errorMessage << "Cannot initialize state '" << elem.first << "': In one reaction it is used as the species having properties, and in another as a choice, which is invalid.";
+						throw std::exception(errorMessage.str().c_str());
 					}
 				}
 			}
@@ -207,8 +208,10 @@ namespace cmdlparser
 			}
 			if (state.second.type_ == state_definition::type_simple)
 				sim.CreateState<stochsim::State>(state.first, static_cast<size_t>(initialCondition + 0.5));
+			else if (state.second.type_ == state_definition::type_composed && state.second.numProperties_ > 0)
+				sim.CreateState<stochsim::ComposedState>(state.first, static_cast<size_t>(initialCondition + 0.5), 1000, state.second.numProperties_);
 			else if (state.second.type_ == state_definition::type_composed)
-				sim.CreateState<stochsim::ComposedState>(state.first, static_cast<size_t>(initialCondition + 0.5));
+				sim.CreateState<stochsim::TimestampQueueState>(state.first, static_cast<size_t>(initialCondition + 0.5));
 			else
 			{
 				std::stringstream errorMessage;
@@ -340,7 +343,7 @@ namespace cmdlparser
 					throw std::exception(errorMessage.str().c_str());
 				}
 				auto stateBase = sim.GetState(reactant.GetState());
-				auto state = std::dynamic_pointer_cast<stochsim::ComposedState>(stateBase);
+				auto state = std::dynamic_pointer_cast<stochsim::ITimedState>(stateBase);
 				if (!state)
 				{
 					std::stringstream errorMessage;
@@ -625,9 +628,12 @@ namespace cmdlparser
 			exception = std::exception("Unknown error");
 		}
 #ifndef NDEBUG
-		cmdl_internal_ParseTrace(0, "cmdl_");
+		// The trace file is global to the parser. Only reset it if we set it, such that several models can be parsed concurrently when not logging.
 		if (logFile)
+		{
+			cmdl_internal_ParseTrace(0, "cmdl_");
 			fclose(logFile);
+		}
 #endif
 		if (isError)
 			throw exception;
@@ -4,7 +4,10 @@
 #include <vector>
 #include "CmdlParser.h"
 #include "StateLogger.h"
+#include "BinaryStateLogger.h"
+#include "NumpyStateLogger.h"
 #include "ProgressLogger.h"
+#include "EnsembleRunner.h"
 
 std::string cmdGetOption(int &argc, char **argv, const std::string & option)
 {
@@ -43,28 +46,121 @@ void cmdHelp(std::ostream& stream, int &argc, char **argv)
 
 	stream << "         -dt   stepsize of saving state to disk" << std::endl;
 	stream << "               default: 1" << std::endl;
+
+	stream << "         -f    format of the saved states, either \"csv\" (text, states.csv), \"bin\" (chunked columnar binary, states.bin)," << std::endl;
+	stream << "               \"npy\" (NumPy matrix of time and states, states.npy) or \"npz\" (NumPy archive additionally containing" << std::endl;
+	stream << "               the state names and the log period, states.npz)" << std::endl;
+	stream << "               default: \"csv\"" << std::endl;
+
+	stream << "         -a    asynchronous saving of the states in a background thread, either \"off\", \"block\" (simulation waits" << std::endl;
+	stream << "               if the buffer of unsaved states is full) or \"grow\" (buffer grows if full)" << std::endl;
+	stream << "               default: \"off\"" << std::endl;
+
+	stream << "         -r    save every firing of a reaction to reactions.trace, from which the states can be reconstructed with -p" << std::endl;
+
+	stream << "         -p    path of a reaction trace saved with -r. Instead of simulating, the states are reconstructed from the" << std::endl;
+	stream << "               initial conditions and the trace, and saved as specified by -dt and -f. The runtime is taken from the trace" << std::endl;
+
+	stream << "         -e    simulation engine, either \"direct\" (direct method), \"nrm\" (next reaction method)," << std::endl;
+	stream << "               \"cr\" (composition-rejection method), \"rssa\" (rejection-based method), \"tau\" (tau-leaping, approximate)" << std::endl;
+	stream << "               \"pdm\" (partial-propensity direct method) or \"hybrid\" (deterministic treatment of abundant species, approximate)" << std::endl;
+	stream << "               default: \"direct\"" << std::endl;
+
+	stream << "         -n    number of replicates. If larger than one, the replicates are run in parallel, and the mean" << std::endl;
+	stream << "               and standard deviation of all states are saved in addition" << std::endl;
+	stream << "               default: 1" << std::endl;
+
+	stream << "         -j    number of threads used to run the replicates" << std::endl;
+	stream << "               default: number of cores" << std::endl;
+
+	stream << "         -s    seed of the random number generator" << std::endl;
+	stream << "               default: random" << std::endl;
 	stream << "         -h,-? display this help" << std::endl;
 }
 
-void runCustomModel(std::string modelPath, std::string folder, double runtime, double stepTime)
+/// <summary>
+/// Creates a logger saving all states of the simulation in the given format, i.e. "csv", "bin", "npy" or "npz". Must be called after the model was parsed.
+/// </summary>
+void createStatesLogger(stochsim::Simulation& sim, const std::string& format)
+{
+	auto addStates = [&sim](auto logger)
+	{
+		for (auto& state : sim.GetStates())
+		{
+			logger->AddState(state);
+		}
+	};
+	if (format == "bin")
+		addStates(sim.CreateLogger<stochsim::BinaryStateLogger>("states.bin"));
+	else if (format == "npy" || format == "npz")
+		addStates(sim.CreateLogger<stochsim::NumpyStateLogger>("states." + format));
+	else
+		addStates(sim.CreateLogger<stochsim::StateLogger>("states.csv"));
+}
+
+void runCustomModel(std::string modelPath, std::string folder, double runtime, double stepTime, stochsim::Simulation::engine engine, const std::string& seedStr, const std::string& format, stochsim::Simulation::logging_mode loggingMode, bool reactionTrace)
 {
 	// Construct simulation
 	stochsim::Simulation sim;
 	sim.SetBaseFolder(folder);
 	sim.SetLogPeriod(stepTime);
+	sim.SetEngine(engine);
+	sim.SetLoggingMode(loggingMode);
+	if (reactionTrace)
+		sim.SetReactionTrace("reactions.trace");
+	if (!seedStr.empty())
+		sim.SetSeed(std::stoull(seedStr));
+
+	// Display simulation progress in console
+	sim.CreateLogger<stochsim::ProgressLogger>();
+	cmdlparser::CmdlParser cmdlParser;
+	cmdlParser.Parse(modelPath, sim);
 
 	// Logging state values
-	auto logger = sim.CreateLogger<stochsim::StateLogger>("states.csv");
+	createStatesLogger(sim, format);
+	sim.Run(runtime);
+}
 
-	// Display simulation progress in console
+void replayCustomModel(std::string modelPath, std::string folder, double stepTime, const std::string& format, const std::string& tracePath)
+{
+	stochsim::Simulation sim;
+	sim.SetBaseFolder(folder);
+	sim.SetLogPeriod(stepTime);
 	sim.CreateLogger<stochsim::ProgressLogger>();
 	cmdlparser::CmdlParser cmdlParser;
 	cmdlParser.Parse(modelPath, sim);
-	for (auto& state : sim.GetStates())
+	createStatesLogger(sim, format);
+	sim.Replay(tracePath);
+}
+
+void runCustomModelEnsemble(std::string modelPath, std::string folder, double runtime, double stepTime, stochsim::Simulation::engine engine, const std::string& seedStr, const std::string& format, stochsim::Simulation::logging_mode loggingMode, bool reactionTrace, size_t numReplicates, size_t numThreads)
+{
+	stochsim::EnsembleRunner runner([&modelPath, &format, loggingMode, reactionTrace](stochsim::Simulation& sim)
 	{
-		logger->AddState(state);
-	}
-	sim.Run(runtime);
+		cmdlparser::CmdlParser cmdlParser;
+		cmdlParser.Parse(modelPath, sim);
+		sim.SetLoggingMode(loggingMode);
+		if (reactionTrace)
+			sim.SetReactionTrace("reactions.trace");
+		// The runner only saves replicates as CSV files, such that other formats have to be written by the replicates themselves.
+		if (format != "csv")
+			createStatesLogger(sim, format);
+	});
+	runner.SetBaseFolder(folder);
+	runner.SetLogPeriod(stepTime);
+	runner.SetEngine(engine);
+	runner.SetNumThreads(numThreads);
+	runner.SetSaveReplicates(format == "csv");
+	if (!seedStr.empty())
+		runner.SetSeed(std::stoull(seedStr));
+
+	// Display progress of the ensemble in console
+	runner.SetReplicateListener([](size_t replicate, size_t numFinished, size_t numReplicates)
+	{
+		std::cout << "\rSimulating ensemble: " << numFinished << "/" << numReplicates << " replicates finished" << std::flush;
+	});
+	runner.Run(numReplicates, runtime);
+	std::cout << std::endl;
 }
 
 
@@ -116,11 +212,70 @@ int main(int argc, char *argv[])
 		}
 	}
 
+	std::string engineStr = cmdGetOption(argc, argv, "-e");
+	stochsim::Simulation::engine engine;
+	if (engineStr.empty() || engineStr == "direct")
+		engine = stochsim::Simulation::engine_direct;
+	else if (engineStr == "nrm")
+		engine = stochsim::Simulation::engine_next_reaction;
+	else if (engineStr == "cr")
+		engine = stochsim::Simulation::engine_composition_rejection;
+	else if (engineStr == "tau")
+		engine = stochsim::Simulation::engine_tau_leaping;
+	else if (engineStr == "rssa")
+		engine = stochsim::Simulation::engine_rejection_based;
+	else if (engineStr == "hybrid")
+		engine = stochsim::Simulation::engine_hybrid;
+	else if (engineStr == "pdm")
+		engine = stochsim::Simulation::engine_partial_propensity;
+	else
+	{
+		std::cerr << "Unknown simulation engine \"" << engineStr << "\"." << std::endl;
+		return 1;
+	}
+
+	std::string numReplicatesStr = cmdGetOption(argc, argv, "-n");
+	size_t numReplicates = numReplicatesStr.empty() ? 1 : std::stoul(numReplicatesStr);
+	std::string numThreadsStr = cmdGetOption(argc, argv, "-j");
+	size_t numThreads = numThreadsStr.empty() ? 0 : std::stoul(numThreadsStr);
+	std::string seedStr = cmdGetOption(argc, argv, "-s");
+
+	std::string formatStr = cmdGetOption(argc, argv, "-f");
+	if (formatStr.empty())
+		formatStr = "csv";
+	else if (formatStr != "csv" && formatStr != "bin" && formatStr != "npy" && formatStr != "npz")
+	{
+		std::cerr << "Unknown output format \"" << formatStr << "\"." << std::endl;
+		return 1;
+	}
+
+	std::string loggingModeStr = cmdGetOption(argc, argv, "-a");
+	stochsim::Simulation::logging_mode loggingMode;
+	if (loggingModeStr.empty() || loggingModeStr == "off")
+		loggingMode = stochsim::Simulation::logging_synchronous;
+	else if (loggingModeStr == "block")
+		loggingMode = stochsim::Simulation::logging_asynchronous_block;
+	else if (loggingModeStr == "grow")
+		loggingMode = stochsim::Simulation::logging_asynchronous_grow;
+	else
+	{
+		std::cerr << "Unknown asynchronous saving mode \"" << loggingModeStr << "\"." << std::endl;
+		return 1;
+	}
+
+	bool reactionTrace = cmdOptionExists(argc, argv, "-r");
+	std::string tracePath = cmdGetOption(argc, argv, "-p");
+
 	// The last parameter must be the model path
 	std::string model(argv[argc - 1]);
 	try
 	{
-		runCustomModel(model, outputFolder, endTime, stepTime);
+		if (!tracePath.empty())
+			replayCustomModel(model, outputFolder, stepTime, formatStr, tracePath);
+		else if (numReplicates > 1)
+			runCustomModelEnsemble(model, outputFolder, endTime, stepTime, engine, seedStr, formatStr, loggingMode, reactionTrace, numReplicates, numThreads);
+		else
+			runCustomModel(model, outputFolder, endTime, stepTime, engine, seedStr, formatStr, loggingMode, reactionTrace);
 	}
 	catch (const std::runtime_error& re)
 	{
@@ -1,8 +1,15 @@
 #include <random>
 #include "expression_common.h"
 #include "NumberExpression.h"
+#include "ExpressionProgram.h"
+#include "Interval.h"
 namespace expression
 {
+	void IExpression::Compile(ExpressionCompiler& compiler) const
+	{
+		compiler.EmitEvaluate(*this);
+	}
+
 	std::unordered_map<identifier, number> makeDefaultVariables() noexcept
 	{
 		std::unordered_map<identifier, number> defaultVariables;
@@ -85,8 +92,8 @@ namespace expression
 			static_cast<std::function<number()>>(
 				[]() -> number
 		{
-			static std::default_random_engine randomEngine(std::random_device{}());
-			static std::uniform_real<number> randomUniform;
+			static thread_local std::default_random_engine randomEngine(std::random_device{}());
+			static thread_local std::uniform_real<number> randomUniform;
 			return randomUniform(randomEngine);
 		}
 		), true));
@@ -94,4 +101,49 @@ namespace expression
 	}
 
 
+	Interval evalInterval(number(*function)(number), const Interval& argument) noexcept
+	{
+		if (argument.IsPoint())
+			return Interval(function(argument.lower));
+		typedef number(*UnaryFunction)(number);
+		// Functions which are monotonically increasing on their domain.
+		static const UnaryFunction increasingFunctions[] = {
+			(number(*)(number))(&asin), (number(*)(number))&atan, (number(*)(number))(&sinh), (number(*)(number))&tanh,
+			(number(*)(number))(&asinh), (number(*)(number))&acosh, (number(*)(number))&atanh, (number(*)(number))&ceil,
+			(number(*)(number))&floor, (number(*)(number))&round, (number(*)(number))&erf, (number(*)(number))&exp,
+			(number(*)(number))&exp2, (number(*)(number))&log, (number(*)(number))&log10, (number(*)(number))&log2,
+			(number(*)(number))&sqrt };
+		for (auto increasingFunction : increasingFunctions)
+		{
+			if (function == increasingFunction)
+				return Interval::Hull(function(argument.lower), function(argument.upper), function(argument.lower), function(argument.upper));
+		}
+		if (function == (number(*)(number))&acos)
+			return Interval::Hull(function(argument.upper), function(argument.lower), function(argument.upper), function(argument.lower));
+		// abs and cosh are decreasing for negative, and increasing for positive arguments.
+		if (function == (number(*)(number))&abs || function == (number(*)(number))&cosh)
+		{
+			if (argument.lower >= 0 || argument.upper <= 0)
+				return Interval::Hull(function(argument.lower), function(argument.upper), function(argument.lower), function(argument.upper));
+			return Interval::Hull(function(0), function(argument.lower), function(argument.upper), function(0));
+		}
+		if (function == (number(*)(number))(&sin) || function == (number(*)(number))&cos)
+		{
+			if (std::isnan(argument.lower) || std::isnan(argument.upper) || std::isinf(argument.lower) || std::isinf(argument.upper))
+				return Interval::Entire();
+			return Interval(-1, 1);
+		}
+		return Interval::Entire();
+	}
+	Interval evalInterval(number(*function)(number, number), const Interval& first, const Interval& second) noexcept
+	{
+		if (first.IsPoint() && second.IsPoint())
+			return Interval(function(first.lower, second.lower));
+		// min and max are monotonically increasing in both arguments.
+		if (function == (number(*)(number, number))(&fmin) || function == (number(*)(number, number))(&fmax))
+			return Interval(function(first.lower, second.lower), function(first.upper, second.upper));
+		if (function == (number(*)(number, number))&pow)
+			return power(first, second);
+		return Interval::Entire();
+	}
 }
\ No newline at end of file
@@ -9,7 +9,8 @@
 std::string GetStateReference(const std::shared_ptr<stochsim::IState>& state)
 {
 	std::string stateRef;
-	if (dynamic_cast<stochsim::ComposedState*>(state.get()))
+	// States created by the parser for delay-only species behave like composed states without properties, and histogram states like composed states without creation times.
+	if (dynamic_cast<stochsim::ITimedState*>(state.get()) || dynamic_cast<stochsim::HistogramState*>(state.get()))
 	{
 		stateRef = SimulationWrapper::composedStatePrefix_;
 	}
@@ -183,7 +184,13 @@ void SimulationWrapper::ParseSimulationCommand(const std::string & methodName, M
 		std::string name = params.Get<std::string>(0);
 		unsigned long initialCondition = params.Get<unsigned long>(1);
 		std::shared_ptr<stochsim::ComposedState> state;
-		if (params.NumParams() >= 3)
+		if (params.NumParams() >= 4)
+		{
+			unsigned long capacity = params.Get<unsigned long>(2);
+			unsigned long numProperties = params.Get<unsigned long>(3);
+			state = CreateState<stochsim::ComposedState>(name, initialCondition, capacity, numProperties);
+		}
+		else if (params.NumParams() >= 3)
 		{
 			unsigned long capacity = params.Get<unsigned long>(2);
 			state = CreateState<stochsim::ComposedState>(name, initialCondition, capacity);
@@ -192,6 +199,20 @@ void SimulationWrapper::ParseSimulationCommand(const std::string & methodName, M
 			state = CreateState<stochsim::ComposedState>(name, initialCondition);
 		params.Set(0, GetStateReference(state));
 	}
+	else if (methodName == "CreateHistogramState")
+	{
+		std::string name = params.Get<std::string>(0);
+		unsigned long initialCondition = params.Get<unsigned long>(1);
+		std::shared_ptr<stochsim::HistogramState> state;
+		if (params.NumParams() >= 3)
+		{
+			unsigned long numProperties = params.Get<unsigned long>(2);
+			state = CreateState<stochsim::HistogramState>(name, initialCondition, numProperties);
+		}
+		else
+			state = CreateState<stochsim::HistogramState>(name, initialCondition);
+		params.Set(0, GetStateReference(state));
+	}
 	else if (methodName == "CreatePropensityReaction")
 	{
 		std::string name = params.Get<std::string>(0);
@@ -220,7 +241,7 @@ void SimulationWrapper::ParseSimulationCommand(const std::string & methodName, M
 			errorMessage << "State with name " << stateName << " not defined in simulation.";
 			throw std::exception(errorMessage.str().c_str());
 		}
-		auto composedState = std::dynamic_pointer_cast<stochsim::ComposedState>(state);
+		auto composedState = std::dynamic_pointer_cast<stochsim::ITimedState>(state);
 		if (!composedState)
 		{
 			std::stringstream errorMessage;
@@ -449,7 +470,7 @@ void SimulationWrapper::ParseStateCommand(std::shared_ptr<stochsim::State>& stat
 			}
 			return static_cast<size_t>(sum + 0.5);
 		}, initialMaxModified);
-		state->AddDecreaseListener(std::bind(&stochsim::StatePropertyLogger::LogProperty, logger, std::placeholders::_1, std::placeholders::_2));
+		state->AddDecreaseListener(std::bind(&stochsim::StatePropertyLogger::LogProperty, logger, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
 	}
 	else if (methodName == "LogIncreaseToFile")
 	{
@@ -479,7 +500,7 @@ void SimulationWrapper::ParseStateCommand(std::shared_ptr<stochsim::State>& stat
 			}
 			return static_cast<size_t>(sum + 0.5);
 		}, initialMaxModified);
-		state->AddIncreaseListener(std::bind(&stochsim::StatePropertyLogger::LogProperty, logger, std::placeholders::_1, std::placeholders::_2));
+		state->AddIncreaseListener(std::bind(&stochsim::StatePropertyLogger::LogProperty, logger, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
 	}
 	else
 	{
@@ -488,11 +509,31 @@ void SimulationWrapper::ParseStateCommand(std::shared_ptr<stochsim::State>& stat
 		throw std::exception(errorMessage.str().c_str());
 	}
 }
-void SimulationWrapper::ParseComposedStateCommand(std::shared_ptr<stochsim::ComposedState>& state, const std::string & methodName, MatlabParams & params)
+void SimulationWrapper::ParseComposedStateCommand(std::shared_ptr<stochsim::IState>& state, const std::string & methodName, MatlabParams & params)
 {
 	if (methodName == "GetInitialCondition")
 	{
-		params.Set(0, state->GetInitialCondition());
+		auto composedState = std::dynamic_pointer_cast<stochsim::ComposedState>(state);
+		if (composedState)
+		{
+			params.Set(0, composedState->GetInitialCondition());
+			return;
+		}
+		auto timestampState = std::dynamic_pointer_cast<stochsim::TimestampQueueState>(state);
+		if (timestampState)
+		{
+			params.Set(0, timestampState->GetInitialCondition());
+			return;
+		}
+		auto histogramState = std::dynamic_pointer_cast<stochsim::HistogramState>(state);
+		if (histogramState)
+		{
+			params.Set(0, histogramState->GetInitialCondition());
+			return;
+		}
+		std::stringstream errorMessage;
+		errorMessage << "State " << state->GetName() << " is not a ComposedState, TimestampQueueState or HistogramState.";
+		throw std::exception(errorMessage.str().c_str());
 	}
 	else if(methodName == "SetInitialCondition")
 	{
@@ -503,14 +544,20 @@ void SimulationWrapper::ParseComposedStateCommand(std::shared_ptr<stochsim::Comp
 			composedState->SetInitialCondition(static_cast<size_t>(initialCondition));
 			return;
 		}
-		auto simpleState = std::dynamic_pointer_cast<stochsim::State>(state);
-		if (simpleState)
+		auto timestampState = std::dynamic_pointer_cast<stochsim::TimestampQueueState>(state);
+		if (timestampState)
 		{
-			simpleState->SetInitialCondition(static_cast<size_t>(initialCondition));
+			timestampState->SetInitialCondition(static_cast<size_t>(initialCondition));
+			return;
+		}
+		auto histogramState = std::dynamic_pointer_cast<stochsim::HistogramState>(state);
+		if (histogramState)
+		{
+			histogramState->SetInitialCondition(static_cast<size_t>(initialCondition));
 			return;
 		}
 		std::stringstream errorMessage;
-		errorMessage << "State " << state->GetName() << " is not a State nor a ComposedState.";
+		errorMessage << "State " << state->GetName() << " is not a ComposedState, TimestampQueueState or HistogramState.";
 		throw std::exception(errorMessage.str().c_str());
 	}
 	else if (methodName == "GetName")
@@ -545,7 +592,7 @@ void SimulationWrapper::ParseComposedStateCommand(std::shared_ptr<stochsim::Comp
 				}
 				return static_cast<size_t>(sum + 0.5);
 			}, initialMaxModified);
-		state->AddDecreaseListener(std::bind(&stochsim::StatePropertyLogger::LogProperty, logger, std::placeholders::_1, std::placeholders::_2));
+		state->AddDecreaseListener(std::bind(&stochsim::StatePropertyLogger::LogProperty, logger, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
 	}
 	else if (methodName == "LogIncreaseToFile")
 	{
@@ -575,7 +622,43 @@ void SimulationWrapper::ParseComposedStateCommand(std::shared_ptr<stochsim::Comp
 			}
 			return static_cast<size_t>(sum + 0.5);
 		}, initialMaxModified);
-		state->AddIncreaseListener(std::bind(&stochsim::StatePropertyLogger::LogProperty, logger, std::placeholders::_1, std::placeholders::_2));
+		state->AddIncreaseListener(std::bind(&stochsim::StatePropertyLogger::LogProperty, logger, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+	}
+	else if (methodName == "LogToFile")
+	{
+		auto histogramState = std::dynamic_pointer_cast<stochsim::HistogramState>(state);
+		if (!histogramState)
+		{
+			std::stringstream errorMessage;
+			errorMessage << "State " << state->GetName() << " is not a HistogramState. Only the property values of the molecules of histogram states can be logged directly.";
+			throw std::exception(errorMessage.str().c_str());
+		}
+		std::string fileName = params.Get<std::string>(0);
+		std::vector<size_t> property_idx;
+		if (params.NumParams() > 1)
+		{
+			auto temp = params.Get<std::vector<double>>(1);
+			for (auto val : temp)
+			{
+				property_idx.push_back(static_cast<size_t>(val + 0.5));
+			}
+		}
+		else
+			property_idx.push_back(static_cast<size_t>(0));
+		size_t initialMaxModified;
+		if (params.NumParams() > 2)
+			initialMaxModified = params.Get<size_t>(2);
+		else
+			initialMaxModified = 20;
+		CreateLogger<stochsim::StatePropertyLogger>(fileName, histogramState, [property_idx](const stochsim::Molecule& molecule)->size_t
+		{
+			double sum = 0;
+			for (auto i : property_idx)
+			{
+				sum += molecule[i];
+			}
+			return static_cast<size_t>(sum + 0.5);
+		}, initialMaxModified);
 	}
 	else
 	{
@@ -932,7 +1015,7 @@ void SimulationWrapper::ParseChoiceCommand(std::shared_ptr<stochsim::Choice>& ch
 			}
 			return static_cast<size_t>(sum + 0.5);
 		}, initialMaxModified);
-		choice->AddIncreaseListener(std::bind(&stochsim::StatePropertyLogger::LogProperty, logger, std::placeholders::_1, std::placeholders::_2));
+		choice->AddIncreaseListener(std::bind(&stochsim::StatePropertyLogger::LogProperty, logger, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
 	}
 	else
 	{
@@ -1009,14 +1092,13 @@ void SimulationWrapper::ParseCommand(const std::string & command, MatlabParams&
 			errorMessage << "Composed state (or any state) with name " << stateName << " not defined in simulation.";
 			throw std::exception(errorMessage.str().c_str());
 		}
-		auto stateObj = std::dynamic_pointer_cast<stochsim::ComposedState>(state);
-		if (!stateObj)
+		if (!std::dynamic_pointer_cast<stochsim::ITimedState>(state) && !std::dynamic_pointer_cast<stochsim::HistogramState>(state))
 		{
 			std::stringstream errorMessage;
 			errorMessage << "State with name " << stateName << " is not a composed state.";
 			throw std::exception(errorMessage.str().c_str());
 		}
-		ParseComposedStateCommand(stateObj, methodName, params.ShiftInputs(1));
+		ParseComposedStateCommand(state, methodName, params.ShiftInputs(1));
 	}
 	else if (className == choicePrefix_)
 	{
@@ -9,6 +9,8 @@
 
 #include "State.h"
 #include "ComposedState.h"
+#include "TimestampQueueState.h"
+#include "HistogramState.h"
 #include "Choice.h"
 
 #include "PropensityReaction.h"
@@ -36,7 +38,7 @@ public:
 private:
 	void ParseSimulationCommand(const std::string& methodName, MatlabParams& params);
 	void ParseStateCommand(std::shared_ptr<stochsim::State>& state, const std::string& methodName, MatlabParams& params);
-	void ParseComposedStateCommand(std::shared_ptr<stochsim::ComposedState>& state, const std::string& methodName, MatlabParams& params);
+	void ParseComposedStateCommand(std::shared_ptr<stochsim::IState>& state, const std::string& methodName, MatlabParams& params);
 	void ParsePropensityReactionCommand(std::shared_ptr<stochsim::PropensityReaction>& simpleReaction, const std::string& methodName, MatlabParams& params); 
 	void ParseDelayReactionCommand(std::shared_ptr<stochsim::DelayReaction>& reaction, const std::string & methodName, MatlabParams & params);
 	void ParseTimerReactionCommand(std::shared_ptr<stochsim::TimerReaction>& reaction, const std::string & methodName, MatlabParams & params);
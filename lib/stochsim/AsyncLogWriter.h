@@ -0,0 +1,221 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <exception>
+#include "stochsim_common.h"
+namespace stochsim
+{
+	/// <summary>
+	/// Calls a set of snapshot loggers from a background thread. The simulation thread only copies the molecular numbers of the logged states into a lock-free single-producer single-consumer queue (Push),
+	/// and the background thread takes the rows out of the queue and passes them to the loggers. The queue consists of a linked list of ring buffers ("segments") with preallocated rows.
+	/// If the queue is full, the simulation thread either waits until the background thread has written at least one row, or appends a new segment of twice the capacity,
+	/// such that the simulation never waits for the disk.
+	/// </summary>
+	class AsyncLogWriter
+	{
+	private:
+		struct Segment
+		{
+			Segment(size_t capacity, size_t rowSize) : times(capacity), values(capacity * rowSize), mask(capacity - 1), head(0), tail(0), next(nullptr)
+			{
+			}
+			std::vector<double> times;
+			std::vector<size_t> values;
+			/// <summary>
+			/// The capacity is a power of two, such that the slot of a row is its index modulo the capacity, i.e. index &amp; mask.
+			/// </summary>
+			const size_t mask;
+			/// <summary>
+			/// Index of the next row to read, only written by the background thread.
+			/// </summary>
+			std::atomic<size_t> head;
+			/// <summary>
+			/// Index of the next row to write, only written by the simulation thread.
+			/// </summary>
+			std::atomic<size_t> tail;
+			/// <summary>
+			/// Segment into which the simulation thread writes after this segment became full. Set only after the last row was written to this segment.
+			/// </summary>
+			std::atomic<Segment*> next;
+		};
+	public:
+		/// <summary>
+		/// Constructor. Queries the logged states of the loggers, such that the loggers must already be initialized.
+		/// </summary>
+		/// <param name="loggers">Loggers to call from the background thread.</param>
+		/// <param name="capacity">Number of rows which can be queued before the queue is full. Rounded up to a power of two.</param>
+		/// <param name="grow">True if the queue should grow if it is full, false if the simulation thread should wait.</param>
+		AsyncLogWriter(std::vector<std::shared_ptr<ISnapshotLogger>> loggers, size_t capacity, bool grow) : loggers_(std::move(loggers)), grow_(grow), stopping_(false), failed_(false)
+		{
+			for (const auto& logger : loggers_)
+			{
+				offsets_.push_back(states_.size());
+				for (auto& state : logger->GetLoggedStates())
+				{
+					states_.push_back(std::move(state));
+				}
+			}
+			size_t roundedCapacity = 1;
+			while (roundedCapacity < capacity)
+				roundedCapacity <<= 1;
+			headSegment_ = tailSegment_ = new Segment(roundedCapacity, states_.size());
+			thread_ = std::thread(&AsyncLogWriter::Run, this);
+		}
+		~AsyncLogWriter()
+		{
+			if (thread_.joinable())
+			{
+				stopping_.store(true, std::memory_order_release);
+				thread_.join();
+			}
+			Segment* segment = headSegment_;
+			while (segment)
+			{
+				Segment* next = segment->next.load(std::memory_order_relaxed);
+				delete segment;
+				segment = next;
+			}
+		}
+		AsyncLogWriter(const AsyncLogWriter&) = delete;
+		AsyncLogWriter& operator=(const AsyncLogWriter&) = delete;
+
+		/// <summary>
+		/// Copies the current molecular numbers of the logged states into the queue. Must only be called by the simulation thread.
+		/// Re-throws the exception if any logger threw an exception in the background thread.
+		/// </summary>
+		/// <param name="simInfo">Simulation context.</param>
+		/// <param name="time">Time of logging.</param>
+		void Push(ISimInfo& simInfo, double time)
+		{
+			Segment* segment = tailSegment_;
+			size_t tail = segment->tail.load(std::memory_order_relaxed);
+			while (tail - segment->head.load(std::memory_order_acquire) > segment->mask)
+			{
+				ThrowIfFailed();
+				if (grow_)
+				{
+					Segment* next = new Segment(2 * (segment->mask + 1), states_.size());
+					segment->next.store(next, std::memory_order_release);
+					tailSegment_ = segment = next;
+					tail = 0;
+					break;
+				}
+				std::this_thread::yield();
+			}
+			ThrowIfFailed();
+			const size_t slot = tail & segment->mask;
+			segment->times[slot] = time;
+			size_t* values = segment->values.data() + slot * states_.size();
+			for (size_t i = 0; i < states_.size(); i++)
+			{
+				values[i] = states_[i]->Num(simInfo);
+			}
+			segment->tail.store(tail + 1, std::memory_order_release);
+			wakeUp_.notify_one();
+		}
+		/// <summary>
+		/// Waits until the background thread has passed all queued rows to the loggers, and stops it. Re-throws the exception if any logger threw an exception in the background thread.
+		/// </summary>
+		void Stop()
+		{
+			if (thread_.joinable())
+			{
+				stopping_.store(true, std::memory_order_release);
+				wakeUp_.notify_one();
+				thread_.join();
+			}
+			ThrowIfFailed();
+		}
+	private:
+		inline void ThrowIfFailed()
+		{
+			if (failed_.load(std::memory_order_acquire))
+				std::rethrow_exception(error_);
+		}
+		/// <summary>
+		/// Main function of the background thread.
+		/// </summary>
+		void Run()
+		{
+			try
+			{
+				while (true)
+				{
+					if (WriteNext())
+						continue;
+					// The simulation thread pushes no rows after setting stopping_, such that all rows are written once the queue is empty afterwards.
+					if (stopping_.load(std::memory_order_acquire))
+					{
+						while (WriteNext())
+						{
+						}
+						break;
+					}
+					// The simulation thread notifies without holding the mutex, such that a notification can get lost. The timeout bounds the delay in this case.
+					std::unique_lock<std::mutex> lock(mutex_);
+					wakeUp_.wait_for(lock, std::chrono::milliseconds(1));
+				}
+			}
+			catch (...)
+			{
+				error_ = std::current_exception();
+				failed_.store(true, std::memory_order_release);
+			}
+		}
+		/// <summary>
+		/// Passes the next row in the queue to the loggers, or switches to the next segment if the current one is exhausted.
+		/// </summary>
+		/// <returns>False if the queue was empty.</returns>
+		bool WriteNext()
+		{
+			Segment* segment = headSegment_;
+			const size_t head = segment->head.load(std::memory_order_relaxed);
+			if (head == segment->tail.load(std::memory_order_acquire))
+			{
+				Segment* next = segment->next.load(std::memory_order_acquire);
+				if (!next)
+					return false;
+				// The next segment is only linked after the last row was written to this segment, but this row might not have been seen by the check above.
+				if (head == segment->tail.load(std::memory_order_acquire))
+				{
+					headSegment_ = next;
+					delete segment;
+					return true;
+				}
+			}
+			const size_t slot = head & segment->mask;
+			const double time = segment->times[slot];
+			const size_t* values = segment->values.data() + slot * states_.size();
+			for (size_t i = 0; i < loggers_.size(); i++)
+			{
+				loggers_[i]->WriteLog(time, values + offsets_[i]);
+			}
+			segment->head.store(head + 1, std::memory_order_release);
+			return true;
+		}
+
+		std::vector<std::shared_ptr<ISnapshotLogger>> loggers_;
+		/// <summary>
+		/// States logged by all loggers, one after the other, and the index of the first state of each logger.
+		/// </summary>
+		std::vector<std::shared_ptr<IState>> states_;
+		std::vector<size_t> offsets_;
+		/// <summary>
+		/// Segment read by the background thread, respectively written by the simulation thread.
+		/// </summary>
+		Segment* headSegment_;
+		Segment* tailSegment_;
+		const bool grow_;
+		std::thread thread_;
+		std::mutex mutex_;
+		std::condition_variable wakeUp_;
+		std::atomic<bool> stopping_;
+		std::atomic<bool> failed_;
+		std::exception_ptr error_;
+	};
+}
@@ -0,0 +1,186 @@
+#include "BinaryTrajectoryReader.h"
+#include <cstring>
+#include <exception>
+#include <sstream>
+#if defined(_WIN32)
+// Exclude rarely-used stuff from Windows headers
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+namespace stochsim
+{
+	BinaryTrajectoryReader::BinaryTrajectoryReader(const std::string& fileName) : data_(nullptr), size_(0), fileHandle_(nullptr), mappingHandle_(nullptr), logPeriod_(0), rowsPerChunk_(1), dataOffset_(0), numRows_(0)
+	{
+		Map(fileName);
+		try
+		{
+			ReadHeader(fileName);
+		}
+		catch (...)
+		{
+			Unmap();
+			throw;
+		}
+	}
+	BinaryTrajectoryReader::~BinaryTrajectoryReader()
+	{
+		Unmap();
+	}
+	size_t BinaryTrajectoryReader::GetStateIndex(const std::string& name) const
+	{
+		for (size_t s = 0; s < stateNames_.size(); s++)
+		{
+			if (stateNames_[s] == name)
+				return s;
+		}
+		std::string errorMessage = "Trajectory does not contain a state with name " + name + ".";
+		throw std::exception(errorMessage.c_str());
+	}
+	void BinaryTrajectoryReader::Map(const std::string& fileName)
+	{
+		std::string errorMessage = "Could not map file " + fileName + " into memory.";
+#if defined(_WIN32)
+		HANDLE file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (file == INVALID_HANDLE_VALUE)
+			throw std::exception(("Could not open file " + fileName + ".").c_str());
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize))
+		{
+			CloseHandle(file);
+			throw std::exception(errorMessage.c_str());
+		}
+		fileHandle_ = file;
+		size_ = static_cast<size_t>(fileSize.QuadPart);
+		// Empty files cannot be mapped, but are rejected when reading the header anyways.
+		if (size_ == 0)
+			return;
+		HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mapping == NULL)
+		{
+			Unmap();
+			throw std::exception(errorMessage.c_str());
+		}
+		mappingHandle_ = mapping;
+		data_ = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+		if (data_ == nullptr)
+		{
+			Unmap();
+			throw std::exception(errorMessage.c_str());
+		}
+#else
+		int file = open(fileName.c_str(), O_RDONLY);
+		if (file < 0)
+			throw std::exception(("Could not open file " + fileName + ".").c_str());
+		struct stat fileStat;
+		if (fstat(file, &fileStat) != 0)
+		{
+			close(file);
+			throw std::exception(errorMessage.c_str());
+		}
+		size_ = static_cast<size_t>(fileStat.st_size);
+		if (size_ == 0)
+		{
+			close(file);
+			return;
+		}
+		void* data = mmap(nullptr, size_, PROT_READ, MAP_SHARED, file, 0);
+		// The mapping stays valid after the file is closed.
+		close(file);
+		if (data == MAP_FAILED)
+		{
+			size_ = 0;
+			throw std::exception(errorMessage.c_str());
+		}
+		data_ = static_cast<const char*>(data);
+#endif
+	}
+	void BinaryTrajectoryReader::Unmap() noexcept
+	{
+#if defined(_WIN32)
+		if (data_)
+			UnmapViewOfFile(data_);
+		if (mappingHandle_)
+			CloseHandle(static_cast<HANDLE>(mappingHandle_));
+		if (fileHandle_)
+			CloseHandle(static_cast<HANDLE>(fileHandle_));
+#else
+		if (data_)
+			munmap(const_cast<char*>(data_), size_);
+#endif
+		data_ = nullptr;
+		size_ = 0;
+		fileHandle_ = nullptr;
+		mappingHandle_ = nullptr;
+	}
+	void BinaryTrajectoryReader::ReadHeader(const std::string& fileName)
+	{
+		size_t position = 0;
+		auto read = [this, &position, &fileName](void* target, size_t numBytes)
+		{
+			if (position + numBytes > size_)
+			{
+				std::string errorMessage = "File " + fileName + " is not a valid trajectory file: header is truncated.";
+				throw std::exception(errorMessage.c_str());
+			}
+			std::memcpy(target, data_ + position, numBytes);
+			position += numBytes;
+		};
+
+		char magic[BinaryTrajectoryFormat::magicLength_];
+		read(magic, sizeof(magic));
+		if (std::memcmp(magic, BinaryTrajectoryFormat::magic_, sizeof(magic)) != 0)
+		{
+			std::string errorMessage = "File " + fileName + " is not a valid trajectory file.";
+			throw std::exception(errorMessage.c_str());
+		}
+		uint32_t version;
+		read(&version, sizeof(version));
+		if (version != BinaryTrajectoryFormat::version_)
+		{
+			std::stringstream errorMessage;
+			errorMessage << "Trajectory file " << fileName << " has version " << version << ", but only version " << BinaryTrajectoryFormat::version_ << " is supported.";
+			throw std::exception(errorMessage.str().c_str());
+		}
+		uint32_t numStates;
+		read(&numStates, sizeof(numStates));
+		read(&logPeriod_, sizeof(logPeriod_));
+		uint64_t rowsPerChunk;
+		read(&rowsPerChunk, sizeof(rowsPerChunk));
+		if (rowsPerChunk == 0)
+		{
+			std::string errorMessage = "File " + fileName + " is not a valid trajectory file: chunks must contain at least one row.";
+			throw std::exception(errorMessage.c_str());
+		}
+		rowsPerChunk_ = static_cast<size_t>(rowsPerChunk);
+		stateNames_.clear();
+		stateNames_.reserve(numStates);
+		for (uint32_t s = 0; s < numStates; s++)
+		{
+			uint32_t length;
+			read(&length, sizeof(length));
+			std::string name(length, '\0');
+			read(&name[0], length);
+			stateNames_.push_back(std::move(name));
+		}
+		dataOffset_ = (position + 7) / 8 * 8;
+
+		// All chunks but the last are full. Count the rows, ignoring a trailing chunk which was not written completely.
+		const size_t fullChunkSize = ChunkOffset(1) - ChunkOffset(0);
+		numRows_ = 0;
+		for (size_t offset = dataOffset_; offset + sizeof(uint64_t) <= size_; offset += fullChunkSize)
+		{
+			uint64_t chunkRows;
+			std::memcpy(&chunkRows, data_ + offset, sizeof(chunkRows));
+			if (chunkRows == 0 || chunkRows > rowsPerChunk_ || offset + sizeof(uint64_t) + chunkRows * (GetNumStates() + 1) * sizeof(uint64_t) > size_)
+				break;
+			numRows_ += static_cast<size_t>(chunkRows);
+			if (chunkRows < rowsPerChunk_)
+				break;
+		}
+	}
+}
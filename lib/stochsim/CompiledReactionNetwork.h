@@ -0,0 +1,377 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <limits>
+#include "stochsim_common.h"
+#include "State.h"
+#include "PropensityReaction.h"
+#include "PropensityKernel.h"
+namespace stochsim
+{
+	/// <summary>
+	/// Propensity reactions of a simulation, of which all pure mass-action reactions are lowered into flat tables.
+	/// A reaction is compiled if it is a PropensityReaction with a rate constant (no custom rate equation) and without transformees, and if all its reactants, modifiers and products are of type State,
+	/// have no listeners, and neither have named properties nor property expressions. The molecular numbers of all states taking part in compiled reactions are moved into one contiguous array
+	/// (see State::SetNumStorage), and the stochiometries of the compiled reactions are stored in compressed sparse row format. Compiled reactions are then evaluated and fired directly on these
+	/// tables, without virtual function calls, without following shared pointers, and without constructing variables. All other reactions are evaluated and fired as usual.
+	/// Since the states read and write the same array, generic reactions, loggers and engines changing states in bulk stay consistent with the compiled reactions.
+	/// Compiled reactions of order at most two are additionally stored in a structure-of-arrays table, such that the propensities of all of them can be computed in one pass by a vectorized
+	/// kernel (see PropensityKernel) whenever all propensities have to be refreshed.
+	/// </summary>
+	class CompiledReactionNetwork
+	{
+	public:
+		CompiledReactionNetwork()
+		{
+		}
+		~CompiledReactionNetwork()
+		{
+			Uninitialize();
+		}
+		/// <summary>
+		/// Compiles the given propensity reactions. Should be called after all states and reactions were initialized.
+		/// </summary>
+		/// <param name="reactions">Propensity reactions of the simulation. The indices of the reactions are kept.</param>
+		void Initialize(const std::vector<std::shared_ptr<IPropensityReaction>>& reactions)
+		{
+			Uninitialize();
+			reactions_ = reactions;
+			compiledIndices_.assign(reactions_.size(), notCompiled_);
+			rateOffsets_.assign(1, 0);
+			changeOffsets_.assign(1, 0);
+
+			std::unordered_map<State*, size_t> speciesIndices;
+			auto getSpecies = [this, &speciesIndices](State* state) -> size_t
+			{
+				auto search = speciesIndices.find(state);
+				if (search != speciesIndices.end())
+					return search->second;
+				states_.push_back(state);
+				speciesIndices.emplace(state, states_.size() - 1);
+				return states_.size() - 1;
+			};
+			for (size_t i = 0; i < reactions_.size(); i++)
+			{
+				auto reaction = dynamic_cast<PropensityReaction*>(reactions_[i].get());
+				if (!reaction || !IsCompilable(*reaction))
+					continue;
+
+				// Species and stochiometries determining the propensity.
+				for (auto& reactant : reaction->GetReactants())
+				{
+					rateSpecies_.push_back(getSpecies(static_cast<State*>(reactant.state_.get())));
+					rateStochiometries_.push_back(reactant.stochiometry_);
+				}
+				for (auto& modifier : reaction->GetModifiers())
+				{
+					rateSpecies_.push_back(getSpecies(static_cast<State*>(modifier.state_.get())));
+					rateStochiometries_.push_back(modifier.stochiometry_);
+				}
+				rateOffsets_.push_back(rateSpecies_.size());
+
+				// Net changes of the molecular numbers when the reaction fires.
+				std::vector<std::pair<size_t, long long>> changes;
+				auto addChange = [&changes](size_t species, long long change)
+				{
+					for (auto& existing : changes)
+					{
+						if (existing.first == species)
+						{
+							existing.second += change;
+							return;
+						}
+					}
+					changes.emplace_back(species, change);
+				};
+				for (auto& reactant : reaction->GetReactants())
+				{
+					addChange(getSpecies(static_cast<State*>(reactant.state_.get())), -static_cast<long long>(reactant.stochiometry_));
+				}
+				for (auto& product : reaction->GetProducts())
+				{
+					addChange(getSpecies(static_cast<State*>(product.state_.get())), static_cast<long long>(product.stochiometry_));
+				}
+				for (auto& change : changes)
+				{
+					if (change.second == 0)
+						continue;
+					changeSpecies_.push_back(change.first);
+					changeAmounts_.push_back(change.second);
+				}
+				changeOffsets_.push_back(changeSpecies_.size());
+
+				rateConstants_.push_back(reaction->GetRateConstant());
+				compiledIndices_[i] = rateConstants_.size() - 1;
+			}
+
+			// Move the molecular numbers of all species into the contiguous array. The array must not be resized afterwards.
+			// The additional last element is always one, and is used as a factor by reactions of order zero or one in the low-order table.
+			counts_.assign(states_.size() + 1, 0);
+			counts_.back() = 1;
+			for (size_t s = 0; s < states_.size(); s++)
+			{
+				states_[s]->SetNumStorage(&counts_[s]);
+			}
+
+			CompileLowOrderReactions();
+		}
+		/// <summary>
+		/// Moves the molecular numbers back into the states and clears all tables.
+		/// </summary>
+		void Uninitialize() noexcept
+		{
+			for (auto state : states_)
+			{
+				state->SetNumStorage(nullptr);
+			}
+			states_.clear();
+			counts_.clear();
+			reactions_.clear();
+			compiledIndices_.clear();
+			rateConstants_.clear();
+			rateOffsets_.clear();
+			rateSpecies_.clear();
+			rateStochiometries_.clear();
+			changeOffsets_.clear();
+			changeSpecies_.clear();
+			changeAmounts_.clear();
+			lowOrderReactions_.clear();
+			lowOrderSpecies0_.clear();
+			lowOrderSpecies1_.clear();
+			lowOrderShifts_.clear();
+			lowOrderRateConstants_.clear();
+			lowOrderRates_.clear();
+			otherReactions_.clear();
+		}
+		/// <summary>
+		/// Returns the number of propensity reactions.
+		/// </summary>
+		/// <returns>Number of propensity reactions.</returns>
+		size_t Size() const noexcept
+		{
+			return reactions_.size();
+		}
+		/// <summary>
+		/// Returns the propensity reactions, in the order in which they were passed to Initialize.
+		/// </summary>
+		/// <returns>Propensity reactions.</returns>
+		const std::vector<std::shared_ptr<IPropensityReaction>>& GetReactions() const noexcept
+		{
+			return reactions_;
+		}
+		/// <summary>
+		/// Returns true if the reaction with the given index is evaluated and fired on the flat tables.
+		/// </summary>
+		/// <param name="reaction">Index of the reaction.</param>
+		/// <returns>True if the reaction is compiled.</returns>
+		bool IsCompiled(size_t reaction) const noexcept
+		{
+			return compiledIndices_[reaction] != notCompiled_;
+		}
+		/// <summary>
+		/// Returns the number of compiled reactions.
+		/// </summary>
+		/// <returns>Number of compiled reactions.</returns>
+		size_t NumCompiled() const noexcept
+		{
+			return rateConstants_.size();
+		}
+		/// <summary>
+		/// Computes the propensity of the reaction with the given index. Equivalent to, but for compiled reactions faster than, calling IPropensityReaction::ComputeRate.
+		/// </summary>
+		/// <param name="simInfo">Simulation context.</param>
+		/// <param name="reaction">Index of the reaction.</param>
+		/// <returns>Propensity of the reaction.</returns>
+		inline double ComputeRate(ISimInfo& simInfo, size_t reaction) const
+		{
+			const size_t compiled = compiledIndices_[reaction];
+			if (compiled == notCompiled_)
+				return reactions_[reaction]->ComputeRate(simInfo);
+			double rate = rateConstants_[compiled];
+			const size_t end = rateOffsets_[compiled + 1];
+			for (size_t e = rateOffsets_[compiled]; e < end; e++)
+			{
+				const size_t num = counts_[rateSpecies_[e]];
+				const size_t stoch = rateStochiometries_[e];
+				for (size_t s = 0; s < stoch; s++)
+				{
+					rate *= num - s;
+				}
+			}
+			return rate;
+		}
+		/// <summary>
+		/// Computes the propensities of all reactions, and returns their sum (see PropensityKernel::Sum). The propensities of the compiled reactions of order at most two are computed by the
+		/// vectorized kernel. The propensities are identical to the ones returned by ComputeRate.
+		/// </summary>
+		/// <param name="simInfo">Simulation context.</param>
+		/// <param name="rates">Array of size Size() where the propensities are stored.</param>
+		/// <returns>Sum of all propensities.</returns>
+		double ComputeRates(ISimInfo& simInfo, double* rates)
+		{
+			PropensityKernel::ComputeMassActionRates(counts_.data(), lowOrderSpecies0_.data(), lowOrderSpecies1_.data(), lowOrderShifts_.data(), lowOrderRateConstants_.data(), lowOrderRates_.data(), lowOrderRates_.size());
+			for (size_t j = 0; j < lowOrderReactions_.size(); j++)
+			{
+				rates[lowOrderReactions_[j]] = lowOrderRates_[j];
+			}
+			for (auto reaction : otherReactions_)
+			{
+				rates[reaction] = ComputeRate(simInfo, reaction);
+			}
+			return PropensityKernel::Sum(rates, reactions_.size());
+		}
+		/// <summary>
+		/// Fires the reaction with the given index. Equivalent to, but for compiled reactions faster than, calling IPropensityReaction::Fire.
+		/// </summary>
+		/// <param name="simInfo">Simulation context.</param>
+		/// <param name="reaction">Index of the reaction.</param>
+		inline void Fire(ISimInfo& simInfo, size_t reaction)
+		{
+			const size_t compiled = compiledIndices_[reaction];
+			if (compiled == notCompiled_)
+			{
+				reactions_[reaction]->Fire(simInfo);
+				return;
+			}
+			const size_t end = changeOffsets_[compiled + 1];
+			for (size_t e = changeOffsets_[compiled]; e < end; e++)
+			{
+				counts_[changeSpecies_[e]] += changeAmounts_[e];
+			}
+		}
+	private:
+		// Make this object be non-copyable, since the states point into counts_.
+		CompiledReactionNetwork(const CompiledReactionNetwork&) = delete;
+		CompiledReactionNetwork& operator=(const CompiledReactionNetwork&) = delete;
+
+		static constexpr size_t notCompiled_ = std::numeric_limits<size_t>::max();
+
+		/// <summary>
+		/// Stores all compiled reactions of order at most two in the low-order table, padded to a multiple of the block size of the kernel.
+		/// </summary>
+		void CompileLowOrderReactions()
+		{
+			const size_t one = counts_.size() - 1;
+			for (size_t i = 0; i < reactions_.size(); i++)
+			{
+				const size_t compiled = compiledIndices_[i];
+				if (compiled == notCompiled_)
+				{
+					otherReactions_.push_back(i);
+					continue;
+				}
+				// The factors num-s of the propensity, in the order in which ComputeRate multiplies them.
+				std::vector<std::pair<size_t, size_t>> factors;
+				for (size_t e = rateOffsets_[compiled]; e < rateOffsets_[compiled + 1]; e++)
+				{
+					for (size_t s = 0; s < rateStochiometries_[e]; s++)
+					{
+						factors.emplace_back(rateSpecies_[e], s);
+					}
+				}
+				if (factors.size() > 2)
+				{
+					otherReactions_.push_back(i);
+					continue;
+				}
+				while (factors.size() < 2)
+				{
+					factors.emplace_back(one, 0);
+				}
+				lowOrderReactions_.push_back(i);
+				lowOrderSpecies0_.push_back(factors[0].first);
+				lowOrderSpecies1_.push_back(factors[1].first);
+				lowOrderShifts_.push_back(static_cast<double>(factors[1].second));
+				lowOrderRateConstants_.push_back(rateConstants_[compiled]);
+			}
+			while (lowOrderSpecies0_.size() % PropensityKernel::blockSize_ != 0)
+			{
+				lowOrderSpecies0_.push_back(one);
+				lowOrderSpecies1_.push_back(one);
+				lowOrderShifts_.push_back(0);
+				lowOrderRateConstants_.push_back(0);
+			}
+			lowOrderRates_.assign(lowOrderSpecies0_.size(), 0);
+		}
+		static bool IsCompilable(const PropensityReaction& reaction)
+		{
+			if (reaction.GetRateEquation() || !reaction.GetTransformees().empty())
+				return false;
+			auto isSimpleState = [](const std::shared_ptr<IState>& state) -> bool
+			{
+				auto simpleState = dynamic_cast<State*>(state.get());
+				return simpleState && !simpleState->HasListeners();
+			};
+			for (auto& reactant : reaction.GetReactants())
+			{
+				if (!isSimpleState(reactant.state_))
+					return false;
+				for (auto& name : reactant.propertyNames_)
+				{
+					if (!name.empty())
+						return false;
+				}
+			}
+			for (auto& modifier : reaction.GetModifiers())
+			{
+				if (!isSimpleState(modifier.state_))
+					return false;
+				for (auto& name : modifier.propertyNames_)
+				{
+					if (!name.empty())
+						return false;
+				}
+			}
+			for (auto& product : reaction.GetProducts())
+			{
+				if (!isSimpleState(product.state_))
+					return false;
+				for (auto& expression : product.propertyExpressions_)
+				{
+					if (expression)
+						return false;
+				}
+			}
+			return true;
+		}
+
+		std::vector<std::shared_ptr<IPropensityReaction>> reactions_;
+		/// <summary>
+		/// Index of every reaction in the tables of the compiled reactions, or notCompiled_.
+		/// </summary>
+		std::vector<size_t> compiledIndices_;
+		/// <summary>
+		/// States whose molecular numbers are stored in counts_, in the same order.
+		/// </summary>
+		std::vector<State*> states_;
+		std::vector<size_t> counts_;
+		std::vector<double> rateConstants_;
+		/// <summary>
+		/// Species and stochiometries determining the propensity of compiled reaction j are stored at the indices rateOffsets_[j] to rateOffsets_[j+1]-1.
+		/// </summary>
+		std::vector<size_t> rateOffsets_;
+		std::vector<size_t> rateSpecies_;
+		std::vector<size_t> rateStochiometries_;
+		/// <summary>
+		/// Net changes of the molecular numbers when compiled reaction j fires are stored at the indices changeOffsets_[j] to changeOffsets_[j+1]-1.
+		/// </summary>
+		std::vector<size_t> changeOffsets_;
+		std::vector<size_t> changeSpecies_;
+		std::vector<long long> changeAmounts_;
+		/// <summary>
+		/// Compiled reactions of order at most two, in structure-of-arrays layout (see PropensityKernel::ComputeMassActionRates). Entry j corresponds to reaction lowOrderReactions_[j].
+		/// The remaining entries are padding with a rate constant of zero.
+		/// </summary>
+		std::vector<size_t> lowOrderReactions_;
+		std::vector<size_t> lowOrderSpecies0_;
+		std::vector<size_t> lowOrderSpecies1_;
+		std::vector<double> lowOrderShifts_;
+		std::vector<double> lowOrderRateConstants_;
+		std::vector<double> lowOrderRates_;
+		/// <summary>
+		/// Reactions not contained in the low-order table.
+		/// </summary>
+		std::vector<size_t> otherReactions_;
+	};
+}
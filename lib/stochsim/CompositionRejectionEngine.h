@@ -0,0 +1,235 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <math.h>
+#include <float.h>
+#include "stochsim_common.h"
+#include "SimulationEngine.h"
+#include "DependencyGraph.h"
+#include "CompiledReactionNetwork.h"
+namespace stochsim
+{
+	/// <summary>
+	/// Composition-rejection method, as described in
+	/// Slepoy, Alexander, Aidan P. Thompson, and Steven J. Plimpton. "A constant-time kinetic Monte Carlo algorithm for simulation of large biochemical reaction networks." The journal of chemical physics 128.20 (2008): 205101.
+	/// The propensity reactions are grouped into bins, with bin k containing all reactions with propensities in [2^(k-1), 2^k). The next reaction is selected by first
+	/// selecting a bin proportional to the sum of the propensities of its reactions (composition), and then by repeatedly choosing a random reaction in the bin until
+	/// one is accepted with a probability proportional to its propensity (rejection). Since the propensities in a bin differ at most by a factor of two, on average
+	/// less than two trials are necessary. The cost of selecting a reaction thus only depends on the number of non-empty bins, and not on the number of reactions.
+	/// Bins are updated incrementally when the propensity of a reaction changes.
+	/// </summary>
+	class CompositionRejectionEngine : public ISimulationEngine
+	{
+	public:
+		CompositionRejectionEngine() : network_(nullptr), dependencyGraph_(nullptr), numActive_(0), minBin_(numBins_), maxBin_(0), a0_(0), stepsSinceResum_(0)
+		{
+		}
+		virtual void Initialize(ISimInfo& simInfo, CompiledReactionNetwork& network, const DependencyGraph& dependencyGraph) override
+		{
+			network_ = &network;
+			dependencyGraph_ = &dependencyGraph;
+			firedReactions_.assign(1, 0);
+			ai_.assign(network_->Size(), 0);
+			binOfReaction_.assign(network_->Size(), noBin_);
+			positionInBin_.assign(network_->Size(), 0);
+			bins_.assign(numBins_, Bin());
+			numActive_ = 0;
+			minBin_ = numBins_;
+			maxBin_ = 0;
+			std::vector<double> rates(network_->Size());
+			network_->ComputeRates(simInfo, rates.data());
+			for (size_t i = 0; i < network_->Size(); i++)
+			{
+				SetRate(i, rates[i]);
+			}
+			Resum();
+		}
+		virtual void Uninitialize(ISimInfo& simInfo) override
+		{
+			network_ = nullptr;
+			ai_.clear();
+			binOfReaction_.clear();
+			positionInBin_.clear();
+			bins_.clear();
+			dependencyGraph_ = nullptr;
+		}
+		virtual double NextReactionTime(ISimInfo& simInfo, double nextEventTime) override
+		{
+			if (a0_ <= 0 || numActive_ == 0)
+				return stochsim::inf;
+			return simInfo.GetSimTime() + simInfo.RandExponential() / a0_;
+		}
+		virtual const std::vector<size_t>& Fire(ISimInfo& simInfo) override
+		{
+			// Composition: select bin proportional to its aggregated propensity.
+			double afraction = simInfo.Rand() * a0_;
+			double asum = 0;
+			size_t binIndex = maxBin_;
+			// Start with the bins containing the reactions with the highest propensities, since they are most likely to be selected.
+			for (size_t k = maxBin_ + 1; k > minBin_; k--)
+			{
+				const Bin& bin = bins_[k - 1];
+				if (bin.reactions.empty())
+					continue;
+				// due to rounding errors, asum might never reach afraction. Thus, default to the last non-empty bin.
+				binIndex = k - 1;
+				asum += bin.sum;
+				if (asum >= afraction)
+					break;
+			}
+
+			// Rejection: select reaction in bin uniformly, and accept it with a probability proportional to its propensity.
+			const Bin& bin = bins_[binIndex];
+			double maxRate = ldexp(1.0, static_cast<int>(binIndex) + minExponent_);
+			size_t reactionIndex;
+			while (true)
+			{
+				reactionIndex = bin.reactions[simInfo.Rand(0, bin.reactions.size() - 1)];
+				if (simInfo.Rand() * maxRate < ai_[reactionIndex])
+					break;
+			}
+			network_->Fire(simInfo, reactionIndex);
+			Update(simInfo, dependencyGraph_->GetPropensityDependents(reactionIndex));
+			firedReactions_[0] = reactionIndex;
+			return firedReactions_;
+		}
+		virtual void Update(ISimInfo& simInfo, const std::vector<size_t>& dependents) override
+		{
+			for (auto i : dependents)
+			{
+				double rate = network_->ComputeRate(simInfo, i);
+				a0_ += rate - ai_[i];
+				SetRate(i, rate);
+			}
+			// To prevent the accumulation of rounding errors, the aggregated propensities are resummed periodically.
+			if (++stepsSinceResum_ >= resumPeriod_ || a0_ <= 0)
+				Resum();
+		}
+	private:
+		/// <summary>
+		/// Set of reactions whose propensities are in [2^(k-1), 2^k), with k the exponent associated to the bin.
+		/// </summary>
+		struct Bin
+		{
+			std::vector<size_t> reactions;
+			double sum = 0;
+		};
+		/// <summary>
+		/// Exponent of the bin with index zero, i.e. smallest exponent frexp can return for a positive (subnormal) double.
+		/// </summary>
+		static constexpr int minExponent_ = DBL_MIN_EXP - DBL_MANT_DIG + 1;
+		static constexpr size_t numBins_ = DBL_MAX_EXP - minExponent_ + 1;
+		static constexpr size_t noBin_ = static_cast<size_t>(-1);
+		/// <summary>
+		/// Number of propensity updates after which the aggregated propensities are resummed from scratch.
+		/// </summary>
+		static constexpr size_t resumPeriod_ = 1000;
+
+		CompiledReactionNetwork* network_;
+		const DependencyGraph* dependencyGraph_;
+		std::vector<size_t> firedReactions_;
+		/// <summary>
+		/// Propensities of the reactions.
+		/// </summary>
+		std::vector<double> ai_;
+		/// <summary>
+		/// Index of the bin a reaction is in, or noBin_ if its propensity is zero.
+		/// </summary>
+		std::vector<size_t> binOfReaction_;
+		/// <summary>
+		/// Position of a reaction in the reaction list of its bin.
+		/// </summary>
+		std::vector<size_t> positionInBin_;
+		std::vector<Bin> bins_;
+		/// <summary>
+		/// Number of reactions with a positive propensity.
+		/// </summary>
+		size_t numActive_;
+		/// <summary>
+		/// Range of bins which might be non-empty.
+		/// </summary>
+		size_t minBin_;
+		size_t maxBin_;
+		/// <summary>
+		/// Aggregated propensity of all reactions.
+		/// </summary>
+		double a0_;
+		size_t stepsSinceResum_;
+
+		static inline size_t GetBinIndex(double rate)
+		{
+			if (rate <= 0)
+				return noBin_;
+			int exponent;
+			frexp(rate, &exponent);
+			return static_cast<size_t>(exponent - minExponent_);
+		}
+		/// <summary>
+		/// Sets the propensity of the reaction and moves it to the respective bin. Does not update a0_.
+		/// </summary>
+		void SetRate(size_t reaction, double rate)
+		{
+			size_t oldBin = binOfReaction_[reaction];
+			size_t newBin = GetBinIndex(rate);
+			if (oldBin != noBin_)
+				bins_[oldBin].sum -= ai_[reaction];
+			ai_[reaction] = rate;
+			if (oldBin != newBin)
+			{
+				if (oldBin != noBin_)
+				{
+					// swap-remove reaction from old bin
+					auto& reactions = bins_[oldBin].reactions;
+					size_t position = positionInBin_[reaction];
+					reactions[position] = reactions.back();
+					positionInBin_[reactions[position]] = position;
+					reactions.pop_back();
+					numActive_--;
+				}
+				if (newBin != noBin_)
+				{
+					auto& reactions = bins_[newBin].reactions;
+					positionInBin_[reaction] = reactions.size();
+					reactions.push_back(reaction);
+					numActive_++;
+					if (newBin < minBin_)
+						minBin_ = newBin;
+					if (newBin > maxBin_)
+						maxBin_ = newBin;
+				}
+				binOfReaction_[reaction] = newBin;
+			}
+			if (newBin != noBin_)
+				bins_[newBin].sum += rate;
+		}
+		/// <summary>
+		/// Recalculates the aggregated propensities of all bins and of all reactions, and shrinks the range of possibly non-empty bins.
+		/// </summary>
+		void Resum()
+		{
+			size_t minBin = numBins_;
+			size_t maxBin = 0;
+			a0_ = 0;
+			for (size_t k = minBin_; k <= maxBin_ && k < numBins_; k++)
+			{
+				Bin& bin = bins_[k];
+				bin.sum = 0;
+				for (auto reaction : bin.reactions)
+				{
+					bin.sum += ai_[reaction];
+				}
+				a0_ += bin.sum;
+				if (!bin.reactions.empty())
+				{
+					if (k < minBin)
+						minBin = k;
+					if (k > maxBin)
+						maxBin = k;
+				}
+			}
+			minBin_ = minBin;
+			maxBin_ = maxBin;
+			stepsSinceResum_ = 0;
+		}
+	};
+}
@@ -0,0 +1,399 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include "stochsim_common.h"
+#include "expression_common.h"
+#include "State.h"
+#include "ComposedState.h"
+#include "TimestampQueueState.h"
+#include "Choice.h"
+#include "PropensityReaction.h"
+#include "DelayReaction.h"
+#include "TimerReaction.h"
+namespace stochsim
+{
+	/// <summary>
+	/// Dependency graph between the states and reactions of a simulation. For every reaction, the graph stores the set of propensity reactions whose rates
+	/// might change when the reaction fires. This allows the simulation to only recompute the propensities of affected reactions after each event, instead of
+	/// recomputing the propensities of all reactions. Similarly, the graph stores for every reaction the set of event reactions whose next firing time might change.
+	/// The graph is constructed from the reactants, modifiers, transformees and products of the reactions, as well as from the variables referenced by custom rate equations.
+	/// For reactions or states of unknown type, the graph conservatively assumes that they depend on, respectively change, every state. Reactions whose rate depends
+	/// on the simulation time or on random numbers are recomputed after every event.
+	/// </summary>
+	class DependencyGraph
+	{
+	public:
+		/// <summary>
+		/// Constructs the dependency graph for the given states and reactions. Should be called after all states and reactions were initialized.
+		/// </summary>
+		/// <param name="states">States of the simulation.</param>
+		/// <param name="propensityReactions">Propensity reactions of the simulation.</param>
+		/// <param name="eventReactions">Event reactions of the simulation.</param>
+		void Initialize(const std::vector<std::shared_ptr<IState>>& states, const std::vector<std::shared_ptr<IPropensityReaction>>& propensityReactions, const std::vector<std::shared_ptr<IEventReaction>>& eventReactions)
+		{
+			Uninitialize();
+			for (auto& state : states)
+			{
+				stateNames_.emplace(state->GetName(), GetStateIndex(state.get()));
+			}
+
+			// Determine which states influence the rate of which propensity reaction.
+			std::vector<size_t> volatileReactions;
+			for (size_t i = 0; i < propensityReactions.size(); i++)
+			{
+				if (!CollectRateDependencies(propensityReactions[i].get(), i))
+					volatileReactions.push_back(i);
+			}
+
+			// Determine which states influence the firing time of which event reaction.
+			std::vector<size_t> volatileEvents;
+			for (size_t i = 0; i < eventReactions.size(); i++)
+			{
+				if (!CollectTimeDependencies(eventReactions[i].get(), i))
+					volatileEvents.push_back(i);
+			}
+
+			// Determine which reactions are affected when a given reaction fires.
+			for (auto& reaction : propensityReactions)
+			{
+				auto changes = CollectChanges(reaction.get());
+				propensityChangedStates_.push_back(ComputeChangedStates(changes, states));
+				propensityDependents_.push_back(ComputeDependents(changes, propensityReactions.size(), volatileReactions, readers_));
+				propensityEventDependents_.push_back(ComputeDependents(changes, eventReactions.size(), volatileEvents, eventReaders_));
+			}
+			for (size_t i = 0; i < eventReactions.size(); i++)
+			{
+				auto changes = CollectChanges(eventReactions[i].get());
+				eventDependents_.push_back(ComputeDependents(changes, propensityReactions.size(), volatileReactions, readers_));
+				// The firing time of an event reaction always has to be updated after it fired.
+				eventEventDependents_.push_back(ComputeDependents(changes, eventReactions.size(), volatileEvents, eventReaders_, i));
+			}
+			stateIndices_.clear();
+			stateList_.clear();
+			stateNames_.clear();
+			readers_.clear();
+			eventReaders_.clear();
+		}
+		/// <summary>
+		/// Frees all memory associated with the graph.
+		/// </summary>
+		void Uninitialize()
+		{
+			propensityChangedStates_.clear();
+			propensityDependents_.clear();
+			eventDependents_.clear();
+			propensityEventDependents_.clear();
+			eventEventDependents_.clear();
+			stateIndices_.clear();
+			stateList_.clear();
+			stateNames_.clear();
+			readers_.clear();
+			eventReaders_.clear();
+		}
+		/// <summary>
+		/// Returns the indices of all propensity reactions whose rate might have changed after the propensity reaction with the given index fired.
+		/// </summary>
+		/// <param name="reaction">Index of the propensity reaction which fired.</param>
+		/// <returns>Sorted indices of affected propensity reactions.</returns>
+		inline const std::vector<size_t>& GetPropensityDependents(size_t reaction) const
+		{
+			return propensityDependents_[reaction];
+		}
+		/// <summary>
+		/// Returns all states whose molecular number might have changed after the propensity reaction with the given index fired. Contains all states if the reaction might change any state.
+		/// </summary>
+		/// <param name="reaction">Index of the propensity reaction which fired.</param>
+		/// <returns>Changed states.</returns>
+		inline const std::vector<const IState*>& GetPropensityChangedStates(size_t reaction) const
+		{
+			return propensityChangedStates_[reaction];
+		}
+		/// <summary>
+		/// Returns the indices of all propensity reactions whose rate might have changed after the event reaction with the given index fired.
+		/// </summary>
+		/// <param name="reaction">Index of the event reaction which fired.</param>
+		/// <returns>Sorted indices of affected propensity reactions.</returns>
+		inline const std::vector<size_t>& GetEventDependents(size_t reaction) const
+		{
+			return eventDependents_[reaction];
+		}
+		/// <summary>
+		/// Returns the indices of all event reactions whose next firing time might have changed after the propensity reaction with the given index fired.
+		/// </summary>
+		/// <param name="reaction">Index of the propensity reaction which fired.</param>
+		/// <returns>Sorted indices of affected event reactions.</returns>
+		inline const std::vector<size_t>& GetPropensityEventDependents(size_t reaction) const
+		{
+			return propensityEventDependents_[reaction];
+		}
+		/// <summary>
+		/// Returns the indices of all event reactions whose next firing time might have changed after the event reaction with the given index fired. Always contains the event reaction itself.
+		/// </summary>
+		/// <param name="reaction">Index of the event reaction which fired.</param>
+		/// <returns>Sorted indices of affected event reactions.</returns>
+		inline const std::vector<size_t>& GetEventEventDependents(size_t reaction) const
+		{
+			return eventEventDependents_[reaction];
+		}
+	private:
+		/// <summary>
+		/// Set of states which are changed when a reaction fires.
+		/// </summary>
+		static constexpr size_t noReaction_ = static_cast<size_t>(-1);
+		struct Changes
+		{
+			std::vector<size_t> states;
+			/// <summary>
+			/// True if the reaction might change any state (e.g. since it is of an unknown type).
+			/// </summary>
+			bool all = false;
+		};
+
+		std::vector<std::vector<const IState*>> propensityChangedStates_;
+		std::vector<std::vector<size_t>> propensityDependents_;
+		std::vector<std::vector<size_t>> eventDependents_;
+		std::vector<std::vector<size_t>> propensityEventDependents_;
+		std::vector<std::vector<size_t>> eventEventDependents_;
+
+		// Only used during construction of the graph.
+		std::unordered_map<const IState*, size_t> stateIndices_;
+		std::vector<const IState*> stateList_;
+		std::unordered_map<std::string, size_t> stateNames_;
+		std::vector<std::vector<size_t>> readers_;
+		std::vector<std::vector<size_t>> eventReaders_;
+
+		size_t GetStateIndex(const IState* state)
+		{
+			auto search = stateIndices_.find(state);
+			if (search != stateIndices_.end())
+				return search->second;
+			size_t index = readers_.size();
+			stateIndices_.emplace(state, index);
+			stateList_.push_back(state);
+			readers_.emplace_back();
+			eventReaders_.emplace_back();
+			return index;
+		}
+		static bool IsPlainState(const IState* state)
+		{
+			return dynamic_cast<const State*>(state) || dynamic_cast<const ComposedState*>(state) || dynamic_cast<const TimestampQueueState*>(state);
+		}
+		/// <summary>
+		/// Registers the reaction as a reader of the given state. Returns false if the molecular number of the state might change without the state being modified by a reaction.
+		/// </summary>
+		bool AddReader(const IState* state, size_t reaction)
+		{
+			if (IsPlainState(state))
+			{
+				readers_[GetStateIndex(state)].push_back(reaction);
+				return true;
+			}
+			// The molecular number of a choice is always zero.
+			return dynamic_cast<const Choice*>(state) != nullptr;
+		}
+		/// <summary>
+		/// Registers the reaction as a reader of all states its rate depends on. Returns false if the rate of the reaction might change at any time, e.g. since
+		/// it depends on the simulation time, on random numbers or since the reaction is of unknown type.
+		/// </summary>
+		bool CollectRateDependencies(const IPropensityReaction* reaction, size_t index)
+		{
+			auto propensityReaction = dynamic_cast<const PropensityReaction*>(reaction);
+			if (!propensityReaction)
+				return false;
+			bool isDeterministic = true;
+			auto rateEquation = propensityReaction->GetRateEquation();
+			if (rateEquation)
+			{
+				// Bind a copy of the expression with a register which only records the names of all variables and functions, without binding anything.
+				std::vector<expression::identifier> names;
+				auto copy = rateEquation->Clone();
+				copy->Bind([&names](const expression::identifier name) -> std::unique_ptr<expression::IFunctionHolder>
+				{
+					names.push_back(name);
+					return nullptr;
+				});
+				auto defaultFunctions = expression::makeDefaultFunctions();
+				auto defaultVariables = expression::makeDefaultVariables();
+				for (auto& name : names)
+				{
+					if (name.size() >= 2 && name[name.size() - 1] == ')' && name[name.size() - 2] == '(')
+					{
+						if (name == "rand()" || defaultFunctions.find(name.substr(0, name.size() - 2)) == defaultFunctions.end())
+							isDeterministic = false;
+						continue;
+					}
+					auto search = stateNames_.find(name);
+					if (search != stateNames_.end())
+						readers_[search->second].push_back(index);
+					else if (defaultVariables.find(name) == defaultVariables.end())
+						isDeterministic = false;
+				}
+			}
+			else
+			{
+				for (auto& reactant : propensityReaction->GetReactants())
+				{
+					isDeterministic = AddReader(reactant.state_.get(), index) && isDeterministic;
+				}
+				for (auto& modifier : propensityReaction->GetModifiers())
+				{
+					isDeterministic = AddReader(modifier.state_.get(), index) && isDeterministic;
+				}
+				for (auto& transformee : propensityReaction->GetTransformees())
+				{
+					isDeterministic = AddReader(transformee.state_.get(), index) && isDeterministic;
+				}
+			}
+			return isDeterministic;
+		}
+		/// <summary>
+		/// Registers the event reaction as a reader of all states its firing time depends on. Returns false if the firing time of the reaction might change at any time, e.g.
+		/// since the reaction is of unknown type.
+		/// </summary>
+		bool CollectTimeDependencies(const IEventReaction* reaction, size_t index)
+		{
+			if (auto delayReaction = dynamic_cast<const DelayReaction*>(reaction))
+			{
+				// The firing time only depends on the oldest molecule of the reactant.
+				eventReaders_[GetStateIndex(delayReaction->GetReactant().state_.get())].push_back(index);
+				return true;
+			}
+			// The firing time of a timer is fixed.
+			return dynamic_cast<const TimerReaction*>(reaction) != nullptr;
+		}
+		/// <summary>
+		/// Adds the state to the set of changed states. If the state is a choice, adds instead all of its products.
+		/// </summary>
+		void AddChangedState(const IState* state, Changes& changes, std::unordered_set<const IState*>& visited)
+		{
+			if (!visited.insert(state).second)
+				return;
+			if (IsPlainState(state))
+			{
+				changes.states.push_back(GetStateIndex(state));
+			}
+			else if (auto choice = dynamic_cast<const Choice*>(state))
+			{
+				for (auto& product : choice->GetProductsIfTrue())
+				{
+					AddChangedState(product.state_.get(), changes, visited);
+				}
+				for (auto& product : choice->GetProductsIfFalse())
+				{
+					AddChangedState(product.state_.get(), changes, visited);
+				}
+			}
+			else
+			{
+				changes.all = true;
+			}
+		}
+		Changes CollectChanges(const IPropensityReaction* reaction)
+		{
+			Changes changes;
+			std::unordered_set<const IState*> visited;
+			auto propensityReaction = dynamic_cast<const PropensityReaction*>(reaction);
+			if (!propensityReaction)
+			{
+				changes.all = true;
+				return changes;
+			}
+			for (auto& reactant : propensityReaction->GetReactants())
+			{
+				AddChangedState(reactant.state_.get(), changes, visited);
+			}
+			for (auto& product : propensityReaction->GetProducts())
+			{
+				AddChangedState(product.state_.get(), changes, visited);
+			}
+			// Transformations do not change the molecular numbers of plain states.
+			for (auto& transformee : propensityReaction->GetTransformees())
+			{
+				if (!IsPlainState(transformee.state_.get()))
+					changes.all = true;
+			}
+			return changes;
+		}
+		Changes CollectChanges(const IEventReaction* reaction)
+		{
+			Changes changes;
+			std::unordered_set<const IState*> visited;
+			if (auto delayReaction = dynamic_cast<const DelayReaction*>(reaction))
+			{
+				AddChangedState(delayReaction->GetReactant().state_.get(), changes, visited);
+				for (auto& product : delayReaction->GetProducts())
+				{
+					AddChangedState(product.state_.get(), changes, visited);
+				}
+			}
+			else if (auto timerReaction = dynamic_cast<const TimerReaction*>(reaction))
+			{
+				for (auto& product : timerReaction->GetProducts())
+				{
+					AddChangedState(product.state_.get(), changes, visited);
+				}
+			}
+			else
+			{
+				changes.all = true;
+			}
+			return changes;
+		}
+		/// <summary>
+		/// Returns the states corresponding to the given changes.
+		/// </summary>
+		std::vector<const IState*> ComputeChangedStates(const Changes& changes, const std::vector<std::shared_ptr<IState>>& states) const
+		{
+			std::vector<const IState*> changedStates;
+			if (changes.all)
+			{
+				for (auto& state : states)
+				{
+					changedStates.push_back(state.get());
+				}
+				return changedStates;
+			}
+			for (auto state : changes.states)
+			{
+				changedStates.push_back(stateList_[state]);
+			}
+			return changedStates;
+		}
+		/// <summary>
+		/// Returns the sorted indices of all reactions which are affected by the given changes, given the readers of each state.
+		/// </summary>
+		/// <param name="changes">States changed by a reaction.</param>
+		/// <param name="numReactions">Total number of reactions.</param>
+		/// <param name="volatileReactions">Reactions which are affected by any change.</param>
+		/// <param name="readers">Reactions affected by changes of the respective state.</param>
+		/// <param name="self">Index of a reaction always affected, or noReaction_.</param>
+		/// <returns>Indices of affected reactions.</returns>
+		std::vector<size_t> ComputeDependents(const Changes& changes, size_t numReactions, const std::vector<size_t>& volatileReactions, const std::vector<std::vector<size_t>>& readers, size_t self = noReaction_) const
+		{
+			std::vector<size_t> dependents;
+			if (changes.all)
+			{
+				dependents.resize(numReactions);
+				for (size_t i = 0; i < numReactions; i++)
+				{
+					dependents[i] = i;
+				}
+				return dependents;
+			}
+			dependents = volatileReactions;
+			if (self != noReaction_)
+				dependents.push_back(self);
+			for (auto state : changes.states)
+			{
+				dependents.insert(dependents.end(), readers[state].begin(), readers[state].end());
+			}
+			std::sort(dependents.begin(), dependents.end());
+			dependents.erase(std::unique(dependents.begin(), dependents.end()), dependents.end());
+			return dependents;
+		}
+	};
+}
@@ -0,0 +1,108 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <math.h>
+#include "stochsim_common.h"
+#include "SimulationEngine.h"
+#include "DependencyGraph.h"
+#include "CompiledReactionNetwork.h"
+namespace stochsim
+{
+	/// <summary>
+	/// Direct method of Gillespie, as described in
+	/// Gillespie, Daniel T. "Exact stochastic simulation of coupled chemical reactions." The journal of physical chemistry 81.25 (1977): 2340-2361.
+	/// After each event, only the propensities of the reactions affected by the event are recomputed, and the aggregated propensity is updated incrementally.
+	/// The next reaction is selected by a linear search over the cumulative propensities.
+	/// </summary>
+	class DirectMethodEngine : public ISimulationEngine
+	{
+	public:
+		DirectMethodEngine() : network_(nullptr), dependencyGraph_(nullptr), a0_(0), stepsSinceResum_(0)
+		{
+		}
+		virtual void Initialize(ISimInfo& simInfo, CompiledReactionNetwork& network, const DependencyGraph& dependencyGraph) override
+		{
+			network_ = &network;
+			dependencyGraph_ = &dependencyGraph;
+			firedReactions_.assign(1, 0);
+			ai_.resize(network_->Size());
+			a0_ = network_->ComputeRates(simInfo, ai_.data());
+			stepsSinceResum_ = 0;
+		}
+		virtual void Uninitialize(ISimInfo& simInfo) override
+		{
+			network_ = nullptr;
+			ai_.clear();
+			dependencyGraph_ = nullptr;
+		}
+		virtual double NextReactionTime(ISimInfo& simInfo, double nextEventTime) override
+		{
+			if (a0_ <= 0)
+				return stochsim::inf;
+			return simInfo.GetSimTime() + simInfo.RandExponential() / a0_;
+		}
+		virtual const std::vector<size_t>& Fire(ISimInfo& simInfo) override
+		{
+			// decide on identity of next reaction event and fire this event
+			const size_t reactionIndex = SelectReaction(ai_, simInfo.Rand() * a0_);
+			network_->Fire(simInfo, reactionIndex);
+			Update(simInfo, dependencyGraph_->GetPropensityDependents(reactionIndex));
+			firedReactions_[0] = reactionIndex;
+			return firedReactions_;
+		}
+		virtual void Update(ISimInfo& simInfo, const std::vector<size_t>& dependents) override
+		{
+			for (auto i : dependents)
+			{
+				double rate = network_->ComputeRate(simInfo, i);
+				a0_ += rate - ai_[i];
+				ai_[i] = rate;
+			}
+			// To prevent the accumulation of rounding errors, a0 is resummed periodically.
+			if (++stepsSinceResum_ >= resumPeriod_ || a0_ <= 0)
+			{
+				a0_ = PropensityKernel::Sum(ai_.data(), ai_.size());
+				stepsSinceResum_ = 0;
+			}
+		}
+		/// <summary>
+		/// Selects a reaction with a probability proportional to its propensity, by a linear search over the cumulative propensities.
+		/// </summary>
+		/// <param name="ai">Propensities of the reactions.</param>
+		/// <param name="afraction">Uniformly distributed random number between zero and the sum of the propensities.</param>
+		/// <returns>Index of the selected reaction.</returns>
+		static size_t SelectReaction(const std::vector<double>& ai, double afraction)
+		{
+			double asum = 0;
+			size_t reactionIndex = 0;
+			for (size_t i = 0; i < ai.size(); i++)
+			{
+				if (ai[i] <= 0)
+					continue;
+				// due to rounding errors, asum might never reach afraction. Thus, default to the last reaction with a positive propensity.
+				reactionIndex = i;
+				asum += ai[i];
+				if (asum >= afraction)
+					break;
+			}
+			return reactionIndex;
+		}
+	private:
+		/// <summary>
+		/// Number of propensity updates after which the aggregated propensity is resummed from scratch.
+		/// </summary>
+		static constexpr size_t resumPeriod_ = 1000;
+		CompiledReactionNetwork* network_;
+		const DependencyGraph* dependencyGraph_;
+		std::vector<size_t> firedReactions_;
+		/// <summary>
+		/// Propensities of the reactions.
+		/// </summary>
+		std::vector<double> ai_;
+		/// <summary>
+		/// Aggregated propensity of all reactions.
+		/// </summary>
+		double a0_;
+		size_t stepsSinceResum_;
+	};
+}
@@ -0,0 +1,294 @@
+#include "EnsembleRunner.h"
+#include "StateLogger.h"
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <exception>
+#include <fstream>
+#include <random>
+#include <string>
+#include <math.h>
+namespace stochsim
+{
+	std::string CreateSaveFolder(const std::string& baseFolder, bool uniqueSubFolder);
+
+	/// <summary>
+	/// Logger which keeps the molecule numbers of all states at all log times of a single run in memory.
+	/// </summary>
+	class TrajectoryRecorder : public ILogger
+	{
+	public:
+		virtual void WriteLog(ISimInfo& simInfo, double time) override
+		{
+			times_.push_back(time);
+			for (const auto& state : states_)
+			{
+				values_.push_back(static_cast<double>(state->Num(simInfo)));
+			}
+		}
+		virtual void Initialize(ISimInfo& simInfo) override
+		{
+			times_.clear();
+			values_.clear();
+		}
+		virtual void Uninitialize(ISimInfo& simInfo) override
+		{
+		}
+		virtual bool WritesToDisk() const override
+		{
+			return false;
+		}
+		void AddState(std::shared_ptr<IState> state)
+		{
+			states_.push_back(std::move(state));
+		}
+		std::vector<std::string> GetStateNames() const
+		{
+			std::vector<std::string> names;
+			for (const auto& state : states_)
+			{
+				names.push_back(state->GetName());
+			}
+			return names;
+		}
+		const std::vector<double>& GetTimes() const
+		{
+			return times_;
+		}
+		/// <summary>
+		/// Molecule numbers, row-wise with one row per log time and one column per state.
+		/// </summary>
+		const std::vector<double>& GetValues() const
+		{
+			return values_;
+		}
+	private:
+		std::vector<std::shared_ptr<IState>> states_;
+		std::vector<double> times_;
+		std::vector<double> values_;
+	};
+
+	class EnsembleRunner::Impl
+	{
+	public:
+		Impl(ModelBuilder modelBuilder) : modelBuilder_(std::move(modelBuilder)), numThreads_(0), seed_(std::random_device{}()), logPeriod_(1.0), engine_(Simulation::engine_direct),
+			baseFolder_("simulations"), uniqueSubFolder_(true), saveReplicates_(false), saveStatistics_(true)
+		{
+		}
+		void Run(size_t numReplicates, double runtime)
+		{
+			statistics_ = EnsembleStatistics();
+			if (numReplicates == 0)
+				return;
+			std::string saveFolder;
+			if (saveReplicates_ || saveStatistics_)
+				saveFolder = CreateSaveFolder(baseFolder_, uniqueSubFolder_);
+
+			size_t numThreads = numThreads_ > 0 ? numThreads_ : std::thread::hardware_concurrency();
+			if (numThreads == 0)
+				numThreads = 1;
+			if (numThreads > numReplicates)
+				numThreads = numReplicates;
+
+			// Replicates are handed out one by one, such that threads which happen to get fast replicates do not idle at the end.
+			std::atomic<size_t> nextReplicate(0);
+			std::atomic<bool> cancelled(false);
+			std::mutex mutex;
+			size_t numFinished = 0;
+			std::exception_ptr error;
+			std::vector<EnsembleStatistics> threadStatistics(numThreads);
+			auto work = [&](size_t threadIndex)
+			{
+				try
+				{
+					Simulation sim;
+					modelBuilder_(sim);
+					sim.SetLogPeriod(logPeriod_);
+					sim.SetEngine(engine_);
+					sim.SetUniqueSubfolder(false);
+					auto recorder = sim.CreateLogger<TrajectoryRecorder>();
+					std::shared_ptr<StateLogger> stateLogger = saveReplicates_ ? sim.CreateLogger<StateLogger>("states.csv") : nullptr;
+					for (auto& state : sim.GetStates())
+					{
+						recorder->AddState(state);
+						if (stateLogger)
+							stateLogger->AddState(state);
+					}
+					EnsembleStatistics& statistics = threadStatistics[threadIndex];
+					while (!cancelled)
+					{
+						size_t replicate = nextReplicate++;
+						if (replicate >= numReplicates)
+							break;
+						sim.SetSeed(seed_, replicate);
+						sim.SetBaseFolder(saveFolder + "/replicate_" + std::to_string(replicate));
+						sim.Run(runtime);
+
+						if (statistics.GetNumReplicates() == 0)
+							statistics.Initialize(recorder->GetStateNames(), recorder->GetTimes());
+						if (recorder->GetValues().size() != statistics.GetTimes().size() * statistics.GetStateNames().size())
+							throw std::exception("Replicates of the ensemble were logged at different times.");
+						statistics.Add(recorder->GetValues());
+
+						std::lock_guard<std::mutex> lock(mutex);
+						numFinished++;
+						if (listener_)
+							listener_(replicate, numFinished, numReplicates);
+					}
+				}
+				catch (...)
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					if (!error)
+						error = std::current_exception();
+					cancelled = true;
+				}
+			};
+			std::vector<std::thread> threads;
+			for (size_t i = 0; i < numThreads; i++)
+			{
+				threads.emplace_back(work, i);
+			}
+			for (auto& thread : threads)
+			{
+				thread.join();
+			}
+			if (error)
+				std::rethrow_exception(error);
+
+			for (const auto& statistics : threadStatistics)
+			{
+				statistics_.Add(statistics);
+			}
+			if (saveStatistics_)
+				WriteStatistics(saveFolder + "/statistics.csv");
+		}
+
+		ModelBuilder modelBuilder_;
+		size_t numThreads_;
+		unsigned long long seed_;
+		double logPeriod_;
+		Simulation::engine engine_;
+		std::string baseFolder_;
+		bool uniqueSubFolder_;
+		bool saveReplicates_;
+		bool saveStatistics_;
+		ReplicateListener listener_;
+		EnsembleStatistics statistics_;
+
+	private:
+		void WriteStatistics(const std::string& fileName) const
+		{
+			std::ofstream file;
+			file.open(fileName);
+			if (!file.is_open())
+			{
+				std::string errorMessage = "Could not open file ";
+				errorMessage += fileName;
+				throw std::exception(errorMessage.c_str());
+			}
+			const auto& stateNames = statistics_.GetStateNames();
+			const auto& times = statistics_.GetTimes();
+			file << "Time";
+			for (const auto& name : stateNames)
+			{
+				file << ',' << name << "_mean," << name << "_std";
+			}
+			file << std::endl;
+			for (size_t row = 0; row < times.size(); row++)
+			{
+				file << times[row];
+				for (size_t column = 0; column < stateNames.size(); column++)
+				{
+					file << ',' << statistics_.GetMean(row, column) << ',' << sqrt(statistics_.GetVariance(row, column));
+				}
+				file << std::endl;
+			}
+			file.close();
+		}
+	};
+
+	EnsembleRunner::EnsembleRunner(ModelBuilder modelBuilder) : impl_(new EnsembleRunner::Impl(std::move(modelBuilder)))
+	{
+	}
+	EnsembleRunner::~EnsembleRunner()
+	{
+		delete impl_;
+	}
+	void EnsembleRunner::Run(size_t numReplicates, double maxTime)
+	{
+		impl_->Run(numReplicates, maxTime);
+	}
+	void EnsembleRunner::SetNumThreads(size_t numThreads)
+	{
+		impl_->numThreads_ = numThreads;
+	}
+	size_t EnsembleRunner::GetNumThreads() const
+	{
+		return impl_->numThreads_;
+	}
+	void EnsembleRunner::SetSeed(unsigned long long seed)
+	{
+		impl_->seed_ = seed;
+	}
+	unsigned long long EnsembleRunner::GetSeed() const
+	{
+		return impl_->seed_;
+	}
+	void EnsembleRunner::SetLogPeriod(double logPeriod)
+	{
+		impl_->logPeriod_ = logPeriod;
+	}
+	double EnsembleRunner::GetLogPeriod() const
+	{
+		return impl_->logPeriod_;
+	}
+	void EnsembleRunner::SetEngine(Simulation::engine engine)
+	{
+		impl_->engine_ = engine;
+	}
+	Simulation::engine EnsembleRunner::GetEngine() const
+	{
+		return impl_->engine_;
+	}
+	void EnsembleRunner::SetBaseFolder(std::string baseFolder)
+	{
+		impl_->baseFolder_ = std::move(baseFolder);
+	}
+	std::string EnsembleRunner::GetBaseFolder() const
+	{
+		return impl_->baseFolder_;
+	}
+	void EnsembleRunner::SetUniqueSubfolder(bool uniqueSubFolder)
+	{
+		impl_->uniqueSubFolder_ = uniqueSubFolder;
+	}
+	bool EnsembleRunner::IsUniqueSubfolder() const
+	{
+		return impl_->uniqueSubFolder_;
+	}
+	void EnsembleRunner::SetSaveReplicates(bool saveReplicates)
+	{
+		impl_->saveReplicates_ = saveReplicates;
+	}
+	bool EnsembleRunner::IsSaveReplicates() const
+	{
+		return impl_->saveReplicates_;
+	}
+	void EnsembleRunner::SetSaveStatistics(bool saveStatistics)
+	{
+		impl_->saveStatistics_ = saveStatistics;
+	}
+	bool EnsembleRunner::IsSaveStatistics() const
+	{
+		return impl_->saveStatistics_;
+	}
+	void EnsembleRunner::SetReplicateListener(ReplicateListener listener)
+	{
+		impl_->listener_ = std::move(listener);
+	}
+	const EnsembleStatistics& EnsembleRunner::GetStatistics() const
+	{
+		return impl_->statistics_;
+	}
+}
@@ -0,0 +1,744 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <algorithm>
+#include <math.h>
+#include "stochsim_common.h"
+#include "SimulationEngine.h"
+#include "DependencyGraph.h"
+#include "CompiledReactionNetwork.h"
+#include "PropensityKernel.h"
+#include "DirectMethodEngine.h"
+#include "State.h"
+#include "Choice.h"
+#include "PropensityReaction.h"
+namespace stochsim
+{
+	/// <summary>
+	/// Hybrid stochastic/deterministic simulation, similar to
+	/// Salis, Howard, and Yiannis Kaznessis. "Accurate hybrid stochastic simulation of a system of coupled chemical or biochemical reactions." The Journal of chemical physics 122.5 (2005): 054103.
+	/// Propensity reactions whose reactants, modifiers and products are all abundant (fast reactions) are treated deterministically, i.e. the number of times they fire is obtained by integrating
+	/// their propensities with an adaptive Runge-Kutta method (Bogacki-Shampine 3(2)). All other reactions (slow reactions) are simulated stochastically. Since the fast reactions change the molecular numbers
+	/// continuously, the slow reactions fire when their integrated aggregated propensity reaches an exponentially distributed threshold, where their propensities are considered to be constant during each
+	/// integration step. The fractional parts of the number of firings of the fast reactions are carried over to the next step, such that every molecule is conserved.
+	/// A species becomes abundant when its molecular number reaches abundanceThreshold, and stops being abundant when it drops below half of this threshold. Before each step, only the species changed since the
+	/// previous step are checked, and only the reactions involving a species which became, or stopped being, abundant are repartitioned. The propensities of the slow reactions are updated incrementally as in
+	/// the direct method (DirectMethodEngine), such that an event only costs as much as in the direct method if no reaction is fast.
+	/// Only propensity reactions following mass-action kinetics whose reactants, modifiers and products are of type State, ComposedState or TimestampQueueState, and which neither transform molecules nor use molecule properties,
+	/// can be fast. All other reactions are always slow.
+	/// Note that the deterministic treatment is an approximation, such that the results of simulations using this engine are not exact.
+	/// </summary>
+	class HybridEngine : public ISimulationEngine
+	{
+	public:
+		/// <summary>
+		/// Constructor.
+		/// </summary>
+		/// <param name="abundanceThreshold">Molecular number from which on a species is abundant.</param>
+		/// <param name="relativeTolerance">Relative tolerance of the local error of the integration of the fast reactions, with respect to the molecular numbers of the species.</param>
+		/// <param name="absoluteTolerance">Absolute tolerance of the local error of the integration of the fast reactions, in molecules.</param>
+		HybridEngine(size_t abundanceThreshold = 1000, double relativeTolerance = 1e-4, double absoluteTolerance = 0.1) :
+			abundanceThreshold_(abundanceThreshold), relativeTolerance_(relativeTolerance), absoluteTolerance_(absoluteTolerance),
+			network_(nullptr), dependencyGraph_(nullptr), a0Slow_(0), stepsSinceResum_(0), threshold_(-1), stepSize_(0), slowScheduled_(false), checkAllSpecies_(true)
+		{
+		}
+		virtual void Initialize(ISimInfo& simInfo, CompiledReactionNetwork& network, const DependencyGraph& dependencyGraph) override
+		{
+			network_ = &network;
+			dependencyGraph_ = &dependencyGraph;
+			CompileReactions();
+			ai_.resize(network_->Size());
+			fastIndices_.assign(network_->Size(), none_);
+			numScarce_.resize(network_->Size());
+			for (size_t j = 0; j < network_->Size(); j++)
+			{
+				numScarce_[j] = hybridReactions_[j].species.size();
+			}
+			extents_.assign(network_->Size(), 0);
+			firings_.assign(network_->Size(), 0);
+			additions_.assign(species_.size(), 0);
+			removals_.assign(species_.size(), 0);
+			y_.assign(species_.size(), 0);
+			yStart_.assign(species_.size(), 0);
+			speciesError_.assign(species_.size(), 0);
+			fastReactions_.clear();
+			changedSpecies_.clear();
+			checkAllSpecies_ = true;
+			threshold_ = -1;
+			stepSize_ = 0;
+			slowScheduled_ = false;
+			network_->ComputeRates(simInfo, ai_.data());
+			a0Slow_ = PropensityKernel::Sum(ai_.data(), ai_.size());
+			stepsSinceResum_ = 0;
+			// Reactions not involving any species are fast independent of the molecular numbers.
+			for (size_t j = 0; j < network_->Size(); j++)
+			{
+				if (hybridReactions_[j].continuous && numScarce_[j] == 0)
+					SetFast(simInfo, j, true);
+			}
+		}
+		virtual void Uninitialize(ISimInfo& simInfo) override
+		{
+			network_ = nullptr;
+			dependencyGraph_ = nullptr;
+			hybridReactions_.clear();
+			species_.clear();
+			speciesChanges_.clear();
+			changedSpecies_.clear();
+			ai_.clear();
+			fastIndices_.clear();
+			numScarce_.clear();
+			extents_.clear();
+			firings_.clear();
+			additions_.clear();
+			removals_.clear();
+			fastReactions_.clear();
+			firedReactions_.clear();
+			firingCounts_.clear();
+			y_.clear();
+			yStart_.clear();
+			speciesError_.clear();
+			e0_.clear();
+			e1_.clear();
+			k1_.clear();
+			k2_.clear();
+			k3_.clear();
+			k4_.clear();
+			stage_.clear();
+		}
+		virtual double NextReactionTime(ISimInfo& simInfo, double nextEventTime) override
+		{
+			slowScheduled_ = false;
+			Partition(simInfo);
+			const double time = simInfo.GetSimTime();
+			if (threshold_ < 0)
+				threshold_ = simInfo.RandExponential();
+			if (fastReactions_.empty())
+			{
+				// Pure stochastic step (direct method).
+				if (a0Slow_ <= 0)
+					return stochsim::inf;
+				slowScheduled_ = true;
+				return time + threshold_ / a0Slow_;
+			}
+
+			// An integration step must neither skip the next event, the next time the state is logged, nor the end of the simulation.
+			double maxTime = nextEventTime < simInfo.GetRunTime() ? nextEventTime : simInfo.GetRunTime();
+			const double nextLogTime = simInfo.GetNextLogTime();
+			if (nextLogTime < maxTime)
+				maxTime = nextLogTime;
+			const double maxStep = maxTime - time;
+			// The next log time always lies after the current time. Thus, the step can only be empty if an event fires at the current time, or if the simulation ends, which both come first.
+			if (!(maxStep > 0))
+				return stochsim::inf;
+
+			for (size_t s = 0; s < species_.size(); s++)
+			{
+				y_[s] = static_cast<double>(species_[s].state->Num(simInfo));
+			}
+			yStart_ = y_;
+			e0_.resize(fastReactions_.size());
+			for (size_t k = 0; k < fastReactions_.size(); k++)
+			{
+				e0_[k] = extents_[fastReactions_[k]];
+			}
+			ComputeFastRates(e0_, k1_);
+			if (stepSize_ <= 0)
+				stepSize_ = InitialStepSize();
+			double step = stepSize_ < maxStep ? stepSize_ : maxStep;
+			while (true)
+			{
+				double error = Integrate(step);
+				if (error > 1)
+				{
+					step *= StepFactor(error);
+					continue;
+				}
+				double nextStep = step * StepFactor(error);
+				// A slow reaction fires during the step. Then, the step is shortened to end when the slow reaction fires.
+				if (a0Slow_ * step >= threshold_)
+				{
+					step = threshold_ / a0Slow_;
+					Integrate(step);
+					slowScheduled_ = true;
+				}
+				if (!ComputeFirings(simInfo))
+				{
+					// The step would result in negative molecular numbers.
+					step /= 2;
+					slowScheduled_ = false;
+					continue;
+				}
+				if (!slowScheduled_)
+					threshold_ -= a0Slow_ * step;
+				stepSize_ = nextStep;
+				return time + step;
+			}
+		}
+		virtual const std::vector<size_t>& Fire(ISimInfo& simInfo) override
+		{
+			firedReactions_.clear();
+			firingCounts_.clear();
+			if (!fastReactions_.empty())
+			{
+				// Apply the whole firings of the fast reactions at once, and keep the fractional parts.
+				for (size_t k = 0; k < fastReactions_.size(); k++)
+				{
+					const size_t j = fastReactions_[k];
+					extents_[j] = e1_[k] - static_cast<double>(firings_[j]);
+					if (firings_[j] == 0)
+						continue;
+					firedReactions_.push_back(j);
+					firingCounts_.push_back(firings_[j]);
+					for (auto& change : hybridReactions_[j].changes)
+					{
+						if (change.second < 0)
+							removals_[change.first] += static_cast<size_t>(-change.second) * firings_[j];
+						else
+							additions_[change.first] += static_cast<size_t>(change.second) * firings_[j];
+					}
+					firings_[j] = 0;
+				}
+				for (size_t s = 0; s < species_.size(); s++)
+				{
+					if (additions_[s] == 0 && removals_[s] == 0)
+						continue;
+					Species& species = species_[s];
+					if (species.simpleState)
+					{
+						if (additions_[s] > removals_[s])
+							species.simpleState->AddN(simInfo, additions_[s] - removals_[s]);
+						else if (removals_[s] > additions_[s])
+							species.simpleState->RemoveN(simInfo, removals_[s] - additions_[s]);
+					}
+					else
+					{
+						// Molecules removed by the step must be chosen from the molecules which existed before the step.
+						species.state->RemoveN(simInfo, removals_[s]);
+						species.state->AddN(simInfo, additions_[s]);
+					}
+					MarkChanged(s);
+					additions_[s] = 0;
+					removals_[s] = 0;
+				}
+				for (auto j : firedReactions_)
+				{
+					UpdateRates(simInfo, dependencyGraph_->GetPropensityDependents(j));
+				}
+			}
+			if (slowScheduled_)
+			{
+				slowScheduled_ = false;
+				threshold_ = -1;
+				if (a0Slow_ > 0)
+				{
+					// The propensities of the fast reactions are zero, such that the slow reaction is selected as in the direct method.
+					const size_t reactionIndex = DirectMethodEngine::SelectReaction(ai_, simInfo.Rand() * a0Slow_);
+					network_->Fire(simInfo, reactionIndex);
+					firedReactions_.push_back(reactionIndex);
+					firingCounts_.push_back(1);
+					for (auto s : speciesChanges_[reactionIndex])
+					{
+						MarkChanged(s);
+					}
+					UpdateRates(simInfo, dependencyGraph_->GetPropensityDependents(reactionIndex));
+				}
+			}
+			return firedReactions_;
+		}
+		virtual const std::vector<size_t>* GetFiringCounts() const override
+		{
+			return &firingCounts_;
+		}
+		virtual void Update(ISimInfo& simInfo, const std::vector<size_t>& dependents) override
+		{
+			UpdateRates(simInfo, dependents);
+			// The engine does not know which event fired, and thus which species it changed.
+			checkAllSpecies_ = true;
+			// Due to the memorylessness of the exponential distribution, the threshold can be redrawn after every change of the propensities by an event.
+			threshold_ = -1;
+		}
+	private:
+		/// <summary>
+		/// Bounds for the factor by which the step size changes from one step to the next.
+		/// </summary>
+		static constexpr double minStepFactor_ = 0.2;
+		static constexpr double maxStepFactor_ = 5;
+		static constexpr double safetyFactor_ = 0.9;
+		/// <summary>
+		/// Number of propensity updates after which the aggregated propensity of the slow reactions is resummed from scratch.
+		/// </summary>
+		static constexpr size_t resumPeriod_ = 1000;
+		/// <summary>
+		/// Index marking that a reaction is slow.
+		/// </summary>
+		static constexpr size_t none_ = static_cast<size_t>(-1);
+		/// <summary>
+		/// A state whose molecular number is read or changed by a reaction which can be fast.
+		/// </summary>
+		struct Species
+		{
+			IState* state = nullptr;
+			State* simpleState = nullptr;
+			bool abundant = false;
+			/// <summary>
+			/// True if the species is in changedSpecies_.
+			/// </summary>
+			bool changed = false;
+			/// <summary>
+			/// Reactions which can be fast and which read or change the species.
+			/// </summary>
+			std::vector<size_t> reactions;
+		};
+		/// <summary>
+		/// Information about a propensity reaction required for its deterministic treatment.
+		/// </summary>
+		struct HybridReaction
+		{
+			/// <summary>
+			/// True if the reaction can be treated deterministically. If false, the reaction is always slow.
+			/// </summary>
+			bool continuous = false;
+			double rateConstant = 0;
+			/// <summary>
+			/// Species whose molecular number determines the propensity, and their stochiometry.
+			/// </summary>
+			std::vector<std::pair<size_t, size_t>> factors;
+			/// <summary>
+			/// Net change of the molecular numbers of all species changed by the reaction.
+			/// </summary>
+			std::vector<std::pair<size_t, long long>> changes;
+			/// <summary>
+			/// All species read or changed by the reaction, without duplicates, which all have to be abundant for the reaction to be fast.
+			/// </summary>
+			std::vector<size_t> species;
+		};
+
+		const size_t abundanceThreshold_;
+		const double relativeTolerance_;
+		const double absoluteTolerance_;
+
+		CompiledReactionNetwork* network_;
+		const DependencyGraph* dependencyGraph_;
+		std::vector<HybridReaction> hybridReactions_;
+		std::vector<Species> species_;
+		/// <summary>
+		/// Species whose molecular number might change when the respective reaction fires.
+		/// </summary>
+		std::vector<std::vector<size_t>> speciesChanges_;
+		/// <summary>
+		/// Species whose molecular number might have changed since they were last checked for abundance. If checkAllSpecies_ is true, all species have to be checked.
+		/// </summary>
+		std::vector<size_t> changedSpecies_;
+		bool checkAllSpecies_;
+		/// <summary>
+		/// Propensities of the slow reactions. Zero for fast reactions.
+		/// </summary>
+		std::vector<double> ai_;
+		/// <summary>
+		/// Aggregated propensity of all slow reactions.
+		/// </summary>
+		double a0Slow_;
+		size_t stepsSinceResum_;
+		/// <summary>
+		/// Value the integrated aggregated propensity of the slow reactions has to reach until the next slow reaction fires, or negative if it has to be redrawn.
+		/// </summary>
+		double threshold_;
+		/// <summary>
+		/// Step size proposed for the next integration step.
+		/// </summary>
+		double stepSize_;
+		/// <summary>
+		/// True if a slow reaction fires at the end of the scheduled step.
+		/// </summary>
+		bool slowScheduled_;
+		std::vector<size_t> fastReactions_;
+		/// <summary>
+		/// Index of each reaction in fastReactions_, or none_ if the reaction is slow.
+		/// </summary>
+		std::vector<size_t> fastIndices_;
+		/// <summary>
+		/// Number of species of each reaction which are not abundant. A reaction which can be fast is fast if this number is zero.
+		/// </summary>
+		std::vector<size_t> numScarce_;
+		/// <summary>
+		/// Fractional number of times each fast reaction fired, which was not yet applied to the states.
+		/// </summary>
+		std::vector<double> extents_;
+		/// <summary>
+		/// Number of times each fast reaction fires in the scheduled step.
+		/// </summary>
+		std::vector<size_t> firings_;
+		std::vector<size_t> additions_;
+		std::vector<size_t> removals_;
+		std::vector<size_t> firedReactions_;
+		/// <summary>
+		/// Number of times each reaction in firedReactions_ fired.
+		/// </summary>
+		std::vector<size_t> firingCounts_;
+		// Working memory of the integration. Vectors indexed by k refer to the k-th fast reaction.
+		std::vector<double> y_;
+		std::vector<double> yStart_;
+		std::vector<double> speciesError_;
+		std::vector<double> e0_;
+		std::vector<double> e1_;
+		std::vector<double> k1_;
+		std::vector<double> k2_;
+		std::vector<double> k3_;
+		std::vector<double> k4_;
+		std::vector<double> stage_;
+
+		/// <summary>
+		/// Determines which reactions can be treated deterministically, and how they change the molecular numbers of the states.
+		/// </summary>
+		void CompileReactions()
+		{
+			std::unordered_map<const IState*, size_t> speciesIndices;
+			species_.clear();
+			hybridReactions_.assign(network_->Size(), HybridReaction());
+			auto getSpecies = [this, &speciesIndices](const std::shared_ptr<IState>& state) -> size_t
+			{
+				auto search = speciesIndices.find(state.get());
+				if (search != speciesIndices.end())
+					return search->second;
+				Species species;
+				species.state = state.get();
+				species.simpleState = dynamic_cast<State*>(state.get());
+				species_.push_back(species);
+				speciesIndices.emplace(state.get(), species_.size() - 1);
+				return species_.size() - 1;
+			};
+			auto isBulkState = [](const std::shared_ptr<IState>& state) -> bool
+			{
+				// Choices have no molecular number, and their products can only be determined by evaluating the choice for every molecule.
+				return !dynamic_cast<Choice*>(state.get());
+			};
+			for (size_t j = 0; j < network_->Size(); j++)
+			{
+				auto reaction = dynamic_cast<PropensityReaction*>(network_->GetReactions()[j].get());
+				if (!reaction || reaction->GetRateEquation() || !reaction->GetTransformees().empty())
+					continue;
+				bool continuous = true;
+				for (auto& reactant : reaction->GetReactants())
+				{
+					continuous = continuous && isBulkState(reactant.state_);
+					for (auto& name : reactant.propertyNames_)
+					{
+						continuous = continuous && name.empty();
+					}
+				}
+				for (auto& modifier : reaction->GetModifiers())
+				{
+					continuous = continuous && isBulkState(modifier.state_);
+					for (auto& name : modifier.propertyNames_)
+					{
+						continuous = continuous && name.empty();
+					}
+				}
+				for (auto& product : reaction->GetProducts())
+				{
+					continuous = continuous && isBulkState(product.state_);
+					for (auto& expression : product.propertyExpressions_)
+					{
+						continuous = continuous && !expression;
+					}
+				}
+				if (!continuous)
+					continue;
+
+				HybridReaction& hybridReaction = hybridReactions_[j];
+				hybridReaction.continuous = true;
+				hybridReaction.rateConstant = reaction->GetRateConstant();
+				std::unordered_map<size_t, long long> changes;
+				for (auto& reactant : reaction->GetReactants())
+				{
+					size_t species = getSpecies(reactant.state_);
+					hybridReaction.factors.emplace_back(species, reactant.stochiometry_);
+					hybridReaction.species.push_back(species);
+					changes[species] -= reactant.stochiometry_;
+				}
+				for (auto& modifier : reaction->GetModifiers())
+				{
+					size_t species = getSpecies(modifier.state_);
+					hybridReaction.factors.emplace_back(species, modifier.stochiometry_);
+					hybridReaction.species.push_back(species);
+				}
+				for (auto& product : reaction->GetProducts())
+				{
+					size_t species = getSpecies(product.state_);
+					hybridReaction.species.push_back(species);
+					changes[species] += product.stochiometry_;
+				}
+				for (auto& change : changes)
+				{
+					if (change.second != 0)
+						hybridReaction.changes.emplace_back(change.first, change.second);
+				}
+				std::sort(hybridReaction.species.begin(), hybridReaction.species.end());
+				hybridReaction.species.erase(std::unique(hybridReaction.species.begin(), hybridReaction.species.end()), hybridReaction.species.end());
+				for (auto species : hybridReaction.species)
+				{
+					species_[species].reactions.push_back(j);
+				}
+			}
+
+			speciesChanges_.assign(network_->Size(), std::vector<size_t>());
+			for (size_t j = 0; j < network_->Size(); j++)
+			{
+				for (auto state : dependencyGraph_->GetPropensityChangedStates(j))
+				{
+					auto search = speciesIndices.find(state);
+					if (search != speciesIndices.end())
+						speciesChanges_[j].push_back(search->second);
+				}
+			}
+		}
+		/// <summary>
+		/// Updates which species are abundant, and which reactions are fast. Only the species whose molecular number might have changed since the last call are checked.
+		/// </summary>
+		void Partition(ISimInfo& simInfo)
+		{
+			bool repartitioned = false;
+			if (checkAllSpecies_)
+			{
+				for (size_t s = 0; s < species_.size(); s++)
+				{
+					repartitioned = UpdateAbundance(simInfo, s) || repartitioned;
+				}
+				checkAllSpecies_ = false;
+			}
+			else
+			{
+				for (auto s : changedSpecies_)
+				{
+					repartitioned = UpdateAbundance(simInfo, s) || repartitioned;
+				}
+			}
+			for (auto s : changedSpecies_)
+			{
+				species_[s].changed = false;
+			}
+			changedSpecies_.clear();
+			// Removing the propensities of reactions becoming fast might leave rounding errors, which are removed such that the aggregated propensity is exactly zero if all slow reactions are exhausted.
+			if (repartitioned)
+			{
+				a0Slow_ = PropensityKernel::Sum(ai_.data(), ai_.size());
+				stepsSinceResum_ = 0;
+			}
+		}
+		/// <summary>
+		/// Updates whether the species with the given index is abundant, and, if this changed, which of its reactions are fast. Returns true if the species became, or stopped being, abundant.
+		/// </summary>
+		bool UpdateAbundance(ISimInfo& simInfo, size_t s)
+		{
+			Species& species = species_[s];
+			const size_t num = species.state->Num(simInfo);
+			if (species.abundant ? num >= abundanceThreshold_ / 2 : num < abundanceThreshold_)
+				return false;
+			species.abundant = !species.abundant;
+			for (auto j : species.reactions)
+			{
+				if (species.abundant)
+				{
+					if (--numScarce_[j] == 0)
+						SetFast(simInfo, j, true);
+				}
+				else if (numScarce_[j]++ == 0)
+					SetFast(simInfo, j, false);
+			}
+			return true;
+		}
+		/// <summary>
+		/// Makes the given reaction fast or slow.
+		/// </summary>
+		void SetFast(ISimInfo& simInfo, size_t j, bool fast)
+		{
+			if (fast)
+			{
+				a0Slow_ -= ai_[j];
+				ai_[j] = 0;
+				fastIndices_[j] = fastReactions_.size();
+				fastReactions_.push_back(j);
+				return;
+			}
+			const size_t k = fastIndices_[j];
+			fastReactions_[k] = fastReactions_.back();
+			fastIndices_[fastReactions_[k]] = k;
+			fastReactions_.pop_back();
+			fastIndices_[j] = none_;
+			// The propensity of fast reactions is not kept up to date. Fractional firings are dropped.
+			ai_[j] = network_->ComputeRate(simInfo, j);
+			a0Slow_ += ai_[j];
+			extents_[j] = 0;
+		}
+		/// <summary>
+		/// Marks that the molecular number of the species with the given index might have changed.
+		/// </summary>
+		inline void MarkChanged(size_t s)
+		{
+			if (species_[s].changed)
+				return;
+			species_[s].changed = true;
+			changedSpecies_.push_back(s);
+		}
+		/// <summary>
+		/// Returns the factor by which the step size is changed given the norm of the local error of the last step.
+		/// </summary>
+		static double StepFactor(double error)
+		{
+			if (error <= 0)
+				return maxStepFactor_;
+			double factor = safetyFactor_ * pow(error, -1.0 / 3);
+			if (factor < minStepFactor_)
+				return minStepFactor_;
+			else if (factor > maxStepFactor_)
+				return maxStepFactor_;
+			return factor;
+		}
+		void UpdateRates(ISimInfo& simInfo, const std::vector<size_t>& dependents)
+		{
+			for (auto j : dependents)
+			{
+				if (fastIndices_[j] != none_)
+					continue;
+				double rate = network_->ComputeRate(simInfo, j);
+				a0Slow_ += rate - ai_[j];
+				ai_[j] = rate;
+			}
+			// To prevent the accumulation of rounding errors, a0Slow is resummed periodically.
+			if (++stepsSinceResum_ >= resumPeriod_)
+			{
+				a0Slow_ = PropensityKernel::Sum(ai_.data(), ai_.size());
+				stepsSinceResum_ = 0;
+			}
+		}
+		/// <summary>
+		/// Computes the propensities of the fast reactions when they fired extents[k] times since the beginning of the step, with fractional molecular numbers.
+		/// </summary>
+		void ComputeFastRates(const std::vector<double>& extents, std::vector<double>& rates)
+		{
+			y_ = yStart_;
+			for (size_t k = 0; k < fastReactions_.size(); k++)
+			{
+				for (auto& change : hybridReactions_[fastReactions_[k]].changes)
+				{
+					y_[change.first] += static_cast<double>(change.second) * (extents[k] - e0_[k]);
+				}
+			}
+			rates.resize(fastReactions_.size());
+			for (size_t k = 0; k < fastReactions_.size(); k++)
+			{
+				const HybridReaction& reaction = hybridReactions_[fastReactions_[k]];
+				double rate = reaction.rateConstant;
+				for (auto& factor : reaction.factors)
+				{
+					for (size_t s = 0; s < factor.second; s++)
+					{
+						rate *= std::max(y_[factor.first] - static_cast<double>(s), 0.0);
+					}
+				}
+				rates[k] = rate;
+			}
+		}
+		/// <summary>
+		/// Returns an initial step size for which the molecular numbers change by about the relative tolerance.
+		/// </summary>
+		double InitialStepSize()
+		{
+			std::fill(speciesError_.begin(), speciesError_.end(), 0.0);
+			for (size_t k = 0; k < fastReactions_.size(); k++)
+			{
+				for (auto& change : hybridReactions_[fastReactions_[k]].changes)
+				{
+					speciesError_[change.first] += static_cast<double>(change.second) * k1_[k];
+				}
+			}
+			double step = stochsim::inf;
+			for (size_t s = 0; s < species_.size(); s++)
+			{
+				if (speciesError_[s] == 0)
+					continue;
+				double candidate = (absoluteTolerance_ + relativeTolerance_ * fabs(yStart_[s])) / fabs(speciesError_[s]);
+				if (candidate < step)
+					step = candidate;
+			}
+			return step;
+		}
+		/// <summary>
+		/// Integrates the extents of the fast reactions over the given step, starting from e0_ with the rates k1_. Stores the result in e1_, and returns the norm of the estimated local error,
+		/// which is at most one if the error is within the tolerances.
+		/// </summary>
+		double Integrate(double step)
+		{
+			const size_t num = fastReactions_.size();
+			stage_.resize(num);
+			e1_.resize(num);
+			for (size_t k = 0; k < num; k++)
+			{
+				stage_[k] = e0_[k] + step * 0.5 * k1_[k];
+			}
+			ComputeFastRates(stage_, k2_);
+			for (size_t k = 0; k < num; k++)
+			{
+				stage_[k] = e0_[k] + step * 0.75 * k2_[k];
+			}
+			ComputeFastRates(stage_, k3_);
+			for (size_t k = 0; k < num; k++)
+			{
+				e1_[k] = e0_[k] + step * (2.0 / 9 * k1_[k] + 1.0 / 3 * k2_[k] + 4.0 / 9 * k3_[k]);
+			}
+			ComputeFastRates(e1_, k4_);
+
+			// The error is measured with respect to the molecular numbers.
+			std::fill(speciesError_.begin(), speciesError_.end(), 0.0);
+			for (size_t k = 0; k < num; k++)
+			{
+				const double error = step * (-5.0 / 72 * k1_[k] + 1.0 / 12 * k2_[k] + 1.0 / 9 * k3_[k] - 1.0 / 8 * k4_[k]);
+				for (auto& change : hybridReactions_[fastReactions_[k]].changes)
+				{
+					speciesError_[change.first] += static_cast<double>(change.second) * error;
+				}
+			}
+			// y_ contains the molecular numbers at the end of the step.
+			double norm = 0;
+			for (size_t s = 0; s < species_.size(); s++)
+			{
+				const double scale = absoluteTolerance_ + relativeTolerance_ * std::max(fabs(yStart_[s]), fabs(y_[s]));
+				const double error = fabs(speciesError_[s]) / scale;
+				if (error > norm)
+					norm = error;
+			}
+			return norm;
+		}
+		/// <summary>
+		/// Determines how many times each fast reaction fires in the integrated step. Returns false if this would result in negative molecular numbers.
+		/// </summary>
+		bool ComputeFirings(ISimInfo& simInfo)
+		{
+			bool valid = true;
+			for (size_t k = 0; k < fastReactions_.size(); k++)
+			{
+				const size_t j = fastReactions_[k];
+				firings_[j] = e1_[k] > 0 ? static_cast<size_t>(floor(e1_[k])) : 0;
+				for (auto& change : hybridReactions_[j].changes)
+				{
+					if (change.second < 0)
+						removals_[change.first] += static_cast<size_t>(-change.second) * firings_[j];
+					else
+						additions_[change.first] += static_cast<size_t>(change.second) * firings_[j];
+				}
+			}
+			for (size_t s = 0; s < species_.size(); s++)
+			{
+				const size_t num = species_[s].state->Num(simInfo);
+				// For composed states, the removed molecules must already exist before the step.
+				if (species_[s].simpleState ? num + additions_[s] < removals_[s] : num < removals_[s])
+					valid = false;
+				additions_[s] = 0;
+				removals_[s] = 0;
+			}
+			return valid;
+		}
+	};
+}
@@ -0,0 +1,139 @@
+#pragma once
+#include <vector>
+#include <utility>
+#include "stochsim_common.h"
+namespace stochsim
+{
+	/// <summary>
+	/// A binary min-heap over a fixed set of elements, each identified by its index, and each associated with a key (typically a time).
+	/// Different to std::priority_queue, the key of any element can be changed in logarithmic time, which is required e.g. by the next reaction method of Gibson and Bruck.
+	/// </summary>
+	class IndexedPriorityQueue
+	{
+	public:
+		/// <summary>
+		/// Initializes the queue with one element for every key, with element i being associated with keys[i]. Runs in linear time.
+		/// </summary>
+		/// <param name="keys">Initial keys of the elements.</param>
+		void Initialize(std::vector<double> keys)
+		{
+			keys_ = std::move(keys);
+			heap_.resize(keys_.size());
+			positions_.resize(keys_.size());
+			for (size_t i = 0; i < keys_.size(); i++)
+			{
+				heap_[i] = i;
+				positions_[i] = i;
+			}
+			for (size_t i = heap_.size() / 2; i > 0; i--)
+			{
+				SiftDown(i - 1);
+			}
+		}
+		/// <summary>
+		/// Removes all elements from the queue.
+		/// </summary>
+		void Clear()
+		{
+			heap_.clear();
+			positions_.clear();
+			keys_.clear();
+		}
+		/// <summary>
+		/// Returns the number of elements in the queue.
+		/// </summary>
+		/// <returns>Number of elements.</returns>
+		inline size_t Size() const noexcept
+		{
+			return heap_.size();
+		}
+		/// <summary>
+		/// Returns the index of the element with the smallest key. Behavior undefined if the queue is empty.
+		/// </summary>
+		/// <returns>Index of element with smallest key.</returns>
+		inline size_t Top() const
+		{
+			return heap_[0];
+		}
+		/// <summary>
+		/// Returns the smallest key of all elements, or stochsim::inf if the queue is empty.
+		/// </summary>
+		/// <returns>Smallest key.</returns>
+		inline double TopKey() const
+		{
+			return heap_.empty() ? stochsim::inf : keys_[heap_[0]];
+		}
+		/// <summary>
+		/// Returns the current key of the given element.
+		/// </summary>
+		/// <param name="element">Index of the element.</param>
+		/// <returns>Key of the element.</returns>
+		inline double GetKey(size_t element) const
+		{
+			return keys_[element];
+		}
+		/// <summary>
+		/// Changes the key of the given element and restores the heap property. Runs in logarithmic time.
+		/// </summary>
+		/// <param name="element">Index of the element.</param>
+		/// <param name="key">New key of the element.</param>
+		void Update(size_t element, double key)
+		{
+			double oldKey = keys_[element];
+			keys_[element] = key;
+			if (key < oldKey)
+				SiftUp(positions_[element]);
+			else if (key > oldKey)
+				SiftDown(positions_[element]);
+		}
+	private:
+		/// <summary>
+		/// Maps positions in the heap to element indices.
+		/// </summary>
+		std::vector<size_t> heap_;
+		/// <summary>
+		/// Maps element indices to positions in the heap.
+		/// </summary>
+		std::vector<size_t> positions_;
+		/// <summary>
+		/// Keys of the elements, indexed by element index.
+		/// </summary>
+		std::vector<double> keys_;
+
+		inline void Swap(size_t pos1, size_t pos2)
+		{
+			std::swap(heap_[pos1], heap_[pos2]);
+			positions_[heap_[pos1]] = pos1;
+			positions_[heap_[pos2]] = pos2;
+		}
+		void SiftUp(size_t pos)
+		{
+			while (pos > 0)
+			{
+				size_t parent = (pos - 1) / 2;
+				if (keys_[heap_[parent]] <= keys_[heap_[pos]])
+					break;
+				Swap(pos, parent);
+				pos = parent;
+			}
+		}
+		void SiftDown(size_t pos)
+		{
+			const size_t size = heap_.size();
+			while (true)
+			{
+				size_t smallest = pos;
+				size_t left = 2 * pos + 1;
+				size_t right = left + 1;
+				if (left < size && keys_[heap_[left]] < keys_[heap_[smallest]])
+					smallest = left;
+				if (right < size && keys_[heap_[right]] < keys_[heap_[smallest]])
+					smallest = right;
+				if (smallest == pos)
+					break;
+				Swap(pos, smallest);
+				pos = smallest;
+			}
+		}
+	};
+}
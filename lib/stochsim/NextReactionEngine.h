@@ -0,0 +1,140 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <math.h>
+#include "stochsim_common.h"
+#include "SimulationEngine.h"
+#include "DependencyGraph.h"
+#include "CompiledReactionNetwork.h"
+#include "IndexedPriorityQueue.h"
+namespace stochsim
+{
+	/// <summary>
+	/// Next reaction method, as described in
+	/// Gibson, Michael A., and Jehoshua Bruck. "Efficient exact stochastic simulation of chemical systems with many species and many channels." The journal of physical chemistry A 104.9 (2000): 1876-1889.
+	/// Every propensity reaction has a putative firing time, which are stored in an indexed priority queue, such that the next reaction can be determined in logarithmic time.
+	/// When the propensity of a reaction changes due to an event of another reaction, its putative firing time is rescaled instead of drawing a new random number.
+	/// </summary>
+	class NextReactionEngine : public ISimulationEngine
+	{
+	public:
+		NextReactionEngine() : network_(nullptr), dependencyGraph_(nullptr)
+		{
+		}
+		virtual void Initialize(ISimInfo& simInfo, CompiledReactionNetwork& network, const DependencyGraph& dependencyGraph) override
+		{
+			network_ = &network;
+			dependencyGraph_ = &dependencyGraph;
+			firedReactions_.assign(1, 0);
+			ai_.resize(network_->Size());
+			residuals_.assign(network_->Size(), -1);
+			network_->ComputeRates(simInfo, ai_.data());
+			std::vector<double> firingTimes(network_->Size());
+			simInfo.GetRandomEngine().Exponentials(firingTimes.data(), firingTimes.size());
+			double time = simInfo.GetSimTime();
+			for (size_t i = 0; i < network_->Size(); i++)
+			{
+				firingTimes[i] = ai_[i] > 0 ? time + firingTimes[i] / ai_[i] : stochsim::inf;
+			}
+			firingTimes_.Initialize(std::move(firingTimes));
+		}
+		virtual void Uninitialize(ISimInfo& simInfo) override
+		{
+			network_ = nullptr;
+			ai_.clear();
+			residuals_.clear();
+			firingTimes_.Clear();
+			dependencyGraph_ = nullptr;
+		}
+		virtual double NextReactionTime(ISimInfo& simInfo, double nextEventTime) override
+		{
+			return firingTimes_.TopKey();
+		}
+		virtual const std::vector<size_t>& Fire(ISimInfo& simInfo) override
+		{
+			size_t reactionIndex = firingTimes_.Top();
+			network_->Fire(simInfo, reactionIndex);
+
+			bool firedUpdated = false;
+			for (auto i : dependencyGraph_->GetPropensityDependents(reactionIndex))
+			{
+				if (i == reactionIndex)
+				{
+					RescheduleFired(simInfo, i);
+					firedUpdated = true;
+				}
+				else
+					Reschedule(simInfo, i);
+			}
+			// The fired reaction always needs a new firing time, even if its propensity did not change (e.g. if it only has modifiers).
+			if (!firedUpdated)
+				RescheduleFired(simInfo, reactionIndex);
+			firedReactions_[0] = reactionIndex;
+			return firedReactions_;
+		}
+		virtual void Update(ISimInfo& simInfo, const std::vector<size_t>& dependents) override
+		{
+			for (auto i : dependents)
+			{
+				Reschedule(simInfo, i);
+			}
+		}
+	private:
+		CompiledReactionNetwork* network_;
+		const DependencyGraph* dependencyGraph_;
+		std::vector<size_t> firedReactions_;
+		/// <summary>
+		/// Propensities of the reactions.
+		/// </summary>
+		std::vector<double> ai_;
+		/// <summary>
+		/// For reactions whose propensity dropped to zero, the unused part of their exponentially distributed random number, such that it can be reused when the
+		/// propensity becomes positive again. Negative if not set.
+		/// </summary>
+		std::vector<double> residuals_;
+		/// <summary>
+		/// Putative (absolute) firing times of the reactions.
+		/// </summary>
+		IndexedPriorityQueue firingTimes_;
+
+		/// <summary>
+		/// Recomputes the propensity of the reaction which just fired, and draws a new firing time.
+		/// </summary>
+		void RescheduleFired(ISimInfo& simInfo, size_t reaction)
+		{
+			ai_[reaction] = network_->ComputeRate(simInfo, reaction);
+			residuals_[reaction] = -1;
+			firingTimes_.Update(reaction, ai_[reaction] > 0 ? simInfo.GetSimTime() + simInfo.RandExponential() / ai_[reaction] : stochsim::inf);
+		}
+		/// <summary>
+		/// Recomputes the propensity of a reaction which did not fire, and rescales its firing time according to the change in its propensity.
+		/// </summary>
+		void Reschedule(ISimInfo& simInfo, size_t reaction)
+		{
+			double aOld = ai_[reaction];
+			double aNew = network_->ComputeRate(simInfo, reaction);
+			ai_[reaction] = aNew;
+			if (aOld == aNew)
+				return;
+			double time = simInfo.GetSimTime();
+			double firingTime = firingTimes_.GetKey(reaction);
+			if (aNew <= 0)
+			{
+				// remember the remaining part of the exponential random number.
+				if (aOld > 0 && firingTime < stochsim::inf)
+					residuals_[reaction] = aOld * (firingTime - time);
+				firingTimes_.Update(reaction, stochsim::inf);
+			}
+			else if (aOld > 0 && firingTime < stochsim::inf)
+			{
+				firingTimes_.Update(reaction, time + aOld / aNew * (firingTime - time));
+			}
+			else
+			{
+				double residual = residuals_[reaction] >= 0 ? residuals_[reaction] : simInfo.RandExponential();
+				residuals_[reaction] = -1;
+				firingTimes_.Update(reaction, time + residual / aNew);
+			}
+		}
+	};
+}
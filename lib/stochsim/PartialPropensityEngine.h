@@ -0,0 +1,381 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <math.h>
+#include "stochsim_common.h"
+#include "SimulationEngine.h"
+#include "DirectMethodEngine.h"
+#include "DependencyGraph.h"
+#include "CompiledReactionNetwork.h"
+#include "State.h"
+#include "ComposedState.h"
+#include "TimestampQueueState.h"
+#include "PropensityReaction.h"
+namespace stochsim
+{
+	/// <summary>
+	/// Partial-propensity direct method, as described in
+	/// Ramaswamy, Rajesh, Nelido Gonzalez-Segredo, and Ivo F. Sbalzarini. "A new class of highly efficient exact stochastic simulation algorithms for chemical reaction networks." The Journal of chemical physics 130.24 (2009): 244104.
+	/// The propensity of every elementary reaction is factored into the molecular number of one of its reactants and a partial propensity depending on at most one other species. The partial propensities
+	/// are grouped by the factored out reactant, such that the next reaction is selected by a linear search over the groups, followed by a linear search within the selected group. After a reaction fired,
+	/// only the partial propensities depending on the species changed by the reaction are updated. Thus, the cost per reaction scales with the number of species, and not with the number of reactions,
+	/// which makes the method efficient for strongly coupled networks, e.g. combinatorial binding models.
+	/// The method is only applicable if all propensity reactions are PropensityReactions following mass-action kinetics (no custom rate equation) of order at most two, i.e. whose reactants, modifiers and
+	/// transformees have a total stochiometry of at most two, and if all their reactants, modifiers, transformees and products are of type State, ComposedState or TimestampQueueState. Otherwise, the engine falls back to the
+	/// direct method (see DirectMethodEngine).
+	/// </summary>
+	class PartialPropensityEngine : public ISimulationEngine
+	{
+	public:
+		PartialPropensityEngine() : network_(nullptr), a0_(0), stepsSinceResum_(0)
+		{
+		}
+		virtual void Initialize(ISimInfo& simInfo, CompiledReactionNetwork& network, const DependencyGraph& dependencyGraph) override
+		{
+			network_ = &network;
+			if (!CompileReactions())
+			{
+				fallback_ = std::make_unique<DirectMethodEngine>();
+				fallback_->Initialize(simInfo, network, dependencyGraph);
+				return;
+			}
+			firedReactions_.assign(1, 0);
+			for (size_t s = 1; s < species_.size(); s++)
+			{
+				num_[s] = static_cast<double>(species_[s]->Num(simInfo));
+			}
+			Resum();
+		}
+		virtual void Uninitialize(ISimInfo& simInfo) override
+		{
+			if (fallback_)
+			{
+				fallback_->Uninitialize(simInfo);
+				fallback_.reset();
+			}
+			network_ = nullptr;
+			species_.clear();
+			num_.clear();
+			groupOffsets_.clear();
+			entryReactions_.clear();
+			entryGroups_.clear();
+			entryRateConstants_.clear();
+			entryFactors_.clear();
+			entryOffsets_.clear();
+			pi_.clear();
+			lambda_.clear();
+			sigma_.clear();
+			dependentOffsets_.clear();
+			dependentEntries_.clear();
+			changeOffsets_.clear();
+			changedSpecies_.clear();
+			firedReactions_.clear();
+		}
+		virtual double NextReactionTime(ISimInfo& simInfo, double nextEventTime) override
+		{
+			if (fallback_)
+				return fallback_->NextReactionTime(simInfo, nextEventTime);
+			if (a0_ <= 0)
+				return stochsim::inf;
+			return simInfo.GetSimTime() + simInfo.RandExponential() / a0_;
+		}
+		virtual const std::vector<size_t>& Fire(ISimInfo& simInfo) override
+		{
+			if (fallback_)
+				return fallback_->Fire(simInfo);
+			// Select the group of the next reaction, i.e. the species factored out of its propensity.
+			double afraction = simInfo.Rand() * a0_;
+			double asum = 0;
+			size_t group = 0;
+			for (size_t i = 0; i < sigma_.size(); i++)
+			{
+				if (sigma_[i] <= 0)
+					continue;
+				// due to rounding errors, asum might never reach afraction. Thus, default to the last group with a positive propensity.
+				group = i;
+				asum += sigma_[i];
+				if (asum >= afraction)
+					break;
+			}
+			// Select the reaction within the group. The partial propensities have to be scaled by the molecular number of the species of the group.
+			afraction = (afraction - (asum - sigma_[group])) / num_[group];
+			asum = 0;
+			size_t entry = groupOffsets_[group];
+			for (size_t e = groupOffsets_[group]; e < groupOffsets_[group + 1]; e++)
+			{
+				if (pi_[e] <= 0)
+					continue;
+				entry = e;
+				asum += pi_[e];
+				if (asum >= afraction)
+					break;
+			}
+			const size_t reactionIndex = entryReactions_[entry];
+			network_->Fire(simInfo, reactionIndex);
+			for (size_t c = changeOffsets_[reactionIndex]; c < changeOffsets_[reactionIndex + 1]; c++)
+			{
+				UpdateSpecies(simInfo, changedSpecies_[c]);
+			}
+			if (++stepsSinceResum_ >= resumPeriod_ || a0_ <= 0)
+				Resum();
+			firedReactions_[0] = reactionIndex;
+			return firedReactions_;
+		}
+		virtual void Update(ISimInfo& simInfo, const std::vector<size_t>& dependents) override
+		{
+			if (fallback_)
+			{
+				fallback_->Update(simInfo, dependents);
+				return;
+			}
+			// Events might change any species. Checking all of them is still linear in the number of species.
+			for (size_t s = 1; s < species_.size(); s++)
+			{
+				UpdateSpecies(simInfo, s);
+			}
+			Resum();
+		}
+	private:
+		/// <summary>
+		/// Number of reactions after which all partial propensities are resummed from scratch, to prevent the accumulation of rounding errors.
+		/// </summary>
+		static constexpr size_t resumPeriod_ = 1000;
+		/// <summary>
+		/// Index of the pseudo-species whose molecular number is always one, and whose group contains all reactions without reactants.
+		/// </summary>
+		static constexpr size_t noSpecies_ = 0;
+
+		/// <summary>
+		/// Engine used instead if the network contains reactions which are not elementary.
+		/// </summary>
+		std::unique_ptr<ISimulationEngine> fallback_;
+		CompiledReactionNetwork* network_;
+		std::vector<size_t> firedReactions_;
+		/// <summary>
+		/// States taking part in any reaction. Index zero is the pseudo-species noSpecies_.
+		/// </summary>
+		std::vector<IState*> species_;
+		/// <summary>
+		/// Molecular numbers of the species, as last seen by the engine.
+		/// </summary>
+		std::vector<double> num_;
+
+		// Partial propensities, grouped by species in compressed sparse row format. The partial propensity of an entry is
+		// rateConstant * (num[factor] - offset) if factor is a species, and rateConstant otherwise.
+		std::vector<size_t> groupOffsets_;
+		std::vector<size_t> entryReactions_;
+		std::vector<size_t> entryGroups_;
+		std::vector<double> entryRateConstants_;
+		std::vector<size_t> entryFactors_;
+		std::vector<double> entryOffsets_;
+		std::vector<double> pi_;
+		/// <summary>
+		/// Sum of the partial propensities of each group.
+		/// </summary>
+		std::vector<double> lambda_;
+		/// <summary>
+		/// Sum of the propensities of each group, i.e. lambda times the molecular number of the species of the group.
+		/// </summary>
+		std::vector<double> sigma_;
+		/// <summary>
+		/// Aggregated propensity of all reactions.
+		/// </summary>
+		double a0_;
+		size_t stepsSinceResum_;
+		/// <summary>
+		/// Entries whose partial propensity depends on a given species, in compressed sparse row format.
+		/// </summary>
+		std::vector<size_t> dependentOffsets_;
+		std::vector<size_t> dependentEntries_;
+		/// <summary>
+		/// Species whose molecular numbers might change when a given reaction fires, in compressed sparse row format.
+		/// </summary>
+		std::vector<size_t> changeOffsets_;
+		std::vector<size_t> changedSpecies_;
+
+		/// <summary>
+		/// Factors the propensities of all reactions into partial propensities. Returns false if any reaction is not elementary.
+		/// </summary>
+		bool CompileReactions()
+		{
+			std::unordered_map<const IState*, size_t> speciesIndices;
+			species_.assign(1, nullptr);
+			auto getSpecies = [this, &speciesIndices](const std::shared_ptr<IState>& state) -> size_t
+			{
+				auto search = speciesIndices.find(state.get());
+				if (search != speciesIndices.end())
+					return search->second;
+				species_.push_back(state.get());
+				speciesIndices.emplace(state.get(), species_.size() - 1);
+				return species_.size() - 1;
+			};
+			auto isPlainState = [](const std::shared_ptr<IState>& state) -> bool
+			{
+				return dynamic_cast<State*>(state.get()) || dynamic_cast<ComposedState*>(state.get()) || dynamic_cast<TimestampQueueState*>(state.get());
+			};
+
+			// Group, factor and offset of the partial propensity of every reaction.
+			struct Factorization
+			{
+				size_t group = noSpecies_;
+				size_t factor = noSpecies_;
+				double offset = 0;
+				double rateConstant = 0;
+			};
+			std::vector<Factorization> factorizations(network_->Size());
+			changeOffsets_.assign(1, 0);
+			changedSpecies_.clear();
+			for (size_t j = 0; j < network_->Size(); j++)
+			{
+				auto reaction = dynamic_cast<PropensityReaction*>(network_->GetReactions()[j].get());
+				if (!reaction || reaction->GetRateEquation())
+					return false;
+				// Species determining the propensity, with one entry per molecule.
+				std::vector<size_t> reactants;
+				auto addChanged = [this, j](size_t species)
+				{
+					for (size_t c = changeOffsets_[j]; c < changedSpecies_.size(); c++)
+					{
+						if (changedSpecies_[c] == species)
+							return;
+					}
+					changedSpecies_.push_back(species);
+				};
+				for (auto& reactant : reaction->GetReactants())
+				{
+					if (!isPlainState(reactant.state_))
+						return false;
+					size_t species = getSpecies(reactant.state_);
+					reactants.insert(reactants.end(), reactant.stochiometry_, species);
+					addChanged(species);
+				}
+				for (auto& modifier : reaction->GetModifiers())
+				{
+					if (!isPlainState(modifier.state_))
+						return false;
+					reactants.insert(reactants.end(), modifier.stochiometry_, getSpecies(modifier.state_));
+				}
+				for (auto& transformee : reaction->GetTransformees())
+				{
+					if (!isPlainState(transformee.state_))
+						return false;
+					reactants.insert(reactants.end(), transformee.stochiometry_, getSpecies(transformee.state_));
+				}
+				for (auto& product : reaction->GetProducts())
+				{
+					if (!isPlainState(product.state_))
+						return false;
+					addChanged(getSpecies(product.state_));
+				}
+				changeOffsets_.push_back(changedSpecies_.size());
+				if (reactants.size() > 2)
+					return false;
+
+				Factorization& factorization = factorizations[j];
+				factorization.rateConstant = reaction->GetRateConstant();
+				if (reactants.size() >= 1)
+					factorization.group = reactants[0];
+				if (reactants.size() == 2)
+				{
+					factorization.factor = reactants[1];
+					// For two molecules of the same species, the propensity is rateConstant * n * (n-1).
+					factorization.offset = reactants[0] == reactants[1] ? 1 : 0;
+				}
+			}
+
+			// Sort the entries by group, and determine which entries depend on which species.
+			const size_t numSpecies = species_.size();
+			num_.assign(numSpecies, 1);
+			groupOffsets_.assign(numSpecies + 1, 0);
+			dependentOffsets_.assign(numSpecies + 1, 0);
+			for (auto& factorization : factorizations)
+			{
+				groupOffsets_[factorization.group + 1]++;
+				if (factorization.factor != noSpecies_)
+					dependentOffsets_[factorization.factor + 1]++;
+			}
+			for (size_t s = 0; s < numSpecies; s++)
+			{
+				groupOffsets_[s + 1] += groupOffsets_[s];
+				dependentOffsets_[s + 1] += dependentOffsets_[s];
+			}
+			const size_t numEntries = factorizations.size();
+			entryReactions_.assign(numEntries, 0);
+			entryGroups_.assign(numEntries, 0);
+			entryRateConstants_.assign(numEntries, 0);
+			entryFactors_.assign(numEntries, noSpecies_);
+			entryOffsets_.assign(numEntries, 0);
+			pi_.assign(numEntries, 0);
+			dependentEntries_.assign(dependentOffsets_.back(), 0);
+			std::vector<size_t> nextEntry(groupOffsets_.begin(), groupOffsets_.end() - 1);
+			std::vector<size_t> nextDependent(dependentOffsets_.begin(), dependentOffsets_.end() - 1);
+			for (size_t j = 0; j < numEntries; j++)
+			{
+				const Factorization& factorization = factorizations[j];
+				const size_t entry = nextEntry[factorization.group]++;
+				entryReactions_[entry] = j;
+				entryGroups_[entry] = factorization.group;
+				entryRateConstants_[entry] = factorization.rateConstant;
+				entryFactors_[entry] = factorization.factor;
+				entryOffsets_[entry] = factorization.offset;
+				if (factorization.factor != noSpecies_)
+					dependentEntries_[nextDependent[factorization.factor]++] = entry;
+			}
+			lambda_.assign(numSpecies, 0);
+			sigma_.assign(numSpecies, 0);
+			return true;
+		}
+		inline double PartialPropensity(size_t entry) const noexcept
+		{
+			const size_t factor = entryFactors_[entry];
+			if (factor == noSpecies_)
+				return entryRateConstants_[entry];
+			return entryRateConstants_[entry] * (num_[factor] - entryOffsets_[entry]);
+		}
+		/// <summary>
+		/// Updates all propensities depending on the molecular number of the given species, if it changed.
+		/// </summary>
+		void UpdateSpecies(ISimInfo& simInfo, size_t species)
+		{
+			const double num = static_cast<double>(species_[species]->Num(simInfo));
+			if (num == num_[species])
+				return;
+			num_[species] = num;
+			double sigma = num * lambda_[species];
+			a0_ += sigma - sigma_[species];
+			sigma_[species] = sigma;
+			for (size_t d = dependentOffsets_[species]; d < dependentOffsets_[species + 1]; d++)
+			{
+				const size_t entry = dependentEntries_[d];
+				const double pi = PartialPropensity(entry);
+				const size_t group = entryGroups_[entry];
+				lambda_[group] += pi - pi_[entry];
+				pi_[entry] = pi;
+				sigma = num_[group] * lambda_[group];
+				a0_ += sigma - sigma_[group];
+				sigma_[group] = sigma;
+			}
+		}
+		/// <summary>
+		/// Recomputes all partial propensities and their sums from scratch.
+		/// </summary>
+		void Resum()
+		{
+			a0_ = 0;
+			for (size_t group = 0; group < lambda_.size(); group++)
+			{
+				double lambda = 0;
+				for (size_t e = groupOffsets_[group]; e < groupOffsets_[group + 1]; e++)
+				{
+					pi_[e] = PartialPropensity(e);
+					lambda += pi_[e];
+				}
+				lambda_[group] = lambda;
+				sigma_[group] = num_[group] * lambda;
+				a0_ += sigma_[group];
+			}
+			stepsSinceResum_ = 0;
+		}
+	};
+}
@@ -0,0 +1,231 @@
+#include "PropensityKernel.h"
+#include <algorithm>
+#if defined(_M_X64) || defined(__x86_64__)
+#define STOCHSIM_KERNEL_X64
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define STOCHSIM_TARGET_AVX2
+#define STOCHSIM_TARGET_AVX512
+#else
+#include <cpuid.h>
+#define STOCHSIM_TARGET_AVX2 __attribute__((target("avx2")))
+#define STOCHSIM_TARGET_AVX512 __attribute__((target("avx512f,avx512dq")))
+#endif
+#endif
+namespace stochsim
+{
+	constexpr size_t PropensityKernel::blockSize_;
+
+	namespace
+	{
+		typedef void(*MassActionKernel)(const size_t* counts, const size_t* species0, const size_t* species1, const double* shifts, const double* rateConstants, double* rates, size_t num);
+		typedef double(*SumKernel)(const double* values, size_t num);
+
+		/// <summary>
+		/// Combines the partial sums in a fixed order.
+		/// </summary>
+		inline double CombineLanes(const double lanes[PropensityKernel::blockSize_])
+		{
+			return ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) + ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]));
+		}
+
+		void ComputeMassActionRatesScalar(const size_t* counts, const size_t* species0, const size_t* species1, const double* shifts, const double* rateConstants, double* rates, size_t num)
+		{
+			for (size_t j = 0; j < num; j++)
+			{
+				double factor1 = std::max(static_cast<double>(counts[species1[j]]) - shifts[j], 0.0);
+				rates[j] = rateConstants[j] * static_cast<double>(counts[species0[j]]) * factor1;
+			}
+		}
+		double SumScalar(const double* values, size_t num)
+		{
+			double lanes[PropensityKernel::blockSize_] = { 0 };
+			for (size_t i = 0; i < num; i++)
+			{
+				lanes[i % PropensityKernel::blockSize_] += values[i];
+			}
+			return CombineLanes(lanes);
+		}
+
+#if defined(STOCHSIM_KERNEL_X64)
+		/// <summary>
+		/// Converts integers smaller than 2^52 to doubles, using that 2^52 + x has the bit pattern of 2^52 with x in the mantissa.
+		/// </summary>
+		STOCHSIM_TARGET_AVX2 inline __m256d ToDouble(__m256i values)
+		{
+			const __m256i exponent = _mm256_set1_epi64x(0x4330000000000000LL);
+			return _mm256_sub_pd(_mm256_castsi256_pd(_mm256_or_si256(values, exponent)), _mm256_castsi256_pd(exponent));
+		}
+		STOCHSIM_TARGET_AVX2 void ComputeMassActionRatesAvx2(const size_t* counts, const size_t* species0, const size_t* species1, const double* shifts, const double* rateConstants, double* rates, size_t num)
+		{
+			const long long* base = reinterpret_cast<const long long*>(counts);
+			const __m256d zero = _mm256_setzero_pd();
+			for (size_t j = 0; j < num; j += 4)
+			{
+				__m256i indices0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(species0 + j));
+				__m256i indices1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(species1 + j));
+				__m256d factor0 = ToDouble(_mm256_i64gather_epi64(base, indices0, 8));
+				__m256d factor1 = ToDouble(_mm256_i64gather_epi64(base, indices1, 8));
+				factor1 = _mm256_max_pd(_mm256_sub_pd(factor1, _mm256_loadu_pd(shifts + j)), zero);
+				__m256d rate = _mm256_mul_pd(_mm256_mul_pd(_mm256_loadu_pd(rateConstants + j), factor0), factor1);
+				_mm256_storeu_pd(rates + j, rate);
+			}
+		}
+		STOCHSIM_TARGET_AVX2 double SumAvx2(const double* values, size_t num)
+		{
+			__m256d low = _mm256_setzero_pd();
+			__m256d high = _mm256_setzero_pd();
+			size_t i = 0;
+			for (; i + PropensityKernel::blockSize_ <= num; i += PropensityKernel::blockSize_)
+			{
+				low = _mm256_add_pd(low, _mm256_loadu_pd(values + i));
+				high = _mm256_add_pd(high, _mm256_loadu_pd(values + i + 4));
+			}
+			double lanes[PropensityKernel::blockSize_];
+			_mm256_storeu_pd(lanes, low);
+			_mm256_storeu_pd(lanes + 4, high);
+			for (size_t lane = 0; i < num; i++, lane++)
+			{
+				lanes[lane] += values[i];
+			}
+			return CombineLanes(lanes);
+		}
+		STOCHSIM_TARGET_AVX512 void ComputeMassActionRatesAvx512(const size_t* counts, const size_t* species0, const size_t* species1, const double* shifts, const double* rateConstants, double* rates, size_t num)
+		{
+			const __m512d zero = _mm512_setzero_pd();
+			for (size_t j = 0; j < num; j += 8)
+			{
+				__m512i indices0 = _mm512_loadu_si512(species0 + j);
+				__m512i indices1 = _mm512_loadu_si512(species1 + j);
+				__m512d factor0 = _mm512_cvtepu64_pd(_mm512_i64gather_epi64(indices0, counts, 8));
+				__m512d factor1 = _mm512_cvtepu64_pd(_mm512_i64gather_epi64(indices1, counts, 8));
+				factor1 = _mm512_max_pd(_mm512_sub_pd(factor1, _mm512_loadu_pd(shifts + j)), zero);
+				__m512d rate = _mm512_mul_pd(_mm512_mul_pd(_mm512_loadu_pd(rateConstants + j), factor0), factor1);
+				_mm512_storeu_pd(rates + j, rate);
+			}
+		}
+		STOCHSIM_TARGET_AVX512 double SumAvx512(const double* values, size_t num)
+		{
+			__m512d sum = _mm512_setzero_pd();
+			size_t i = 0;
+			for (; i + PropensityKernel::blockSize_ <= num; i += PropensityKernel::blockSize_)
+			{
+				sum = _mm512_add_pd(sum, _mm512_loadu_pd(values + i));
+			}
+			double lanes[PropensityKernel::blockSize_];
+			_mm512_storeu_pd(lanes, sum);
+			for (size_t lane = 0; i < num; i++, lane++)
+			{
+				lanes[lane] += values[i];
+			}
+			return CombineLanes(lanes);
+		}
+
+		void CpuId(int leaf, int subleaf, unsigned int registers[4])
+		{
+#if defined(_MSC_VER)
+			int values[4];
+			__cpuidex(values, leaf, subleaf);
+			for (int i = 0; i < 4; i++)
+			{
+				registers[i] = static_cast<unsigned int>(values[i]);
+			}
+#else
+			if (!__get_cpuid_count(leaf, subleaf, &registers[0], &registers[1], &registers[2], &registers[3]))
+				registers[0] = registers[1] = registers[2] = registers[3] = 0;
+#endif
+		}
+		/// <summary>
+		/// Returns the register state components enabled by the operating system.
+		/// </summary>
+		unsigned long long GetEnabledRegisters()
+		{
+#if defined(_MSC_VER)
+			return _xgetbv(0);
+#else
+			unsigned int low, high;
+			__asm__("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+			return (static_cast<unsigned long long>(high) << 32) | low;
+#endif
+		}
+#endif
+
+		PropensityKernel::instruction_set DetectInstructionSet()
+		{
+#if defined(STOCHSIM_KERNEL_X64)
+			static_assert(sizeof(size_t) == sizeof(long long), "The vectorized kernels require 64 bit molecular numbers.");
+			unsigned int registers[4];
+			CpuId(0, 0, registers);
+			const unsigned int maxLeaf = registers[0];
+			if (maxLeaf < 7)
+				return PropensityKernel::instruction_set_scalar;
+			CpuId(1, 0, registers);
+			const bool osxsave = (registers[2] & (1u << 27)) != 0;
+			const bool avx = (registers[2] & (1u << 28)) != 0;
+			if (!osxsave || !avx)
+				return PropensityKernel::instruction_set_scalar;
+			const unsigned long long enabled = GetEnabledRegisters();
+			// SSE and AVX registers must be saved by the operating system.
+			if ((enabled & 0x6) != 0x6)
+				return PropensityKernel::instruction_set_scalar;
+			CpuId(7, 0, registers);
+			const bool avx2 = (registers[1] & (1u << 5)) != 0;
+			const bool avx512f = (registers[1] & (1u << 16)) != 0;
+			const bool avx512dq = (registers[1] & (1u << 17)) != 0;
+			// Additionally, the opmask and upper ZMM registers must be saved by the operating system.
+			if (avx512f && avx512dq && (enabled & 0xE6) == 0xE6)
+				return PropensityKernel::instruction_set_avx512;
+			if (avx2)
+				return PropensityKernel::instruction_set_avx2;
+#endif
+			return PropensityKernel::instruction_set_scalar;
+		}
+
+		/// <summary>
+		/// Kernels selected for the CPU the program runs on.
+		/// </summary>
+		struct Kernels
+		{
+			PropensityKernel::instruction_set instructionSet;
+			MassActionKernel massActionKernel;
+			SumKernel sumKernel;
+			Kernels() : instructionSet(DetectInstructionSet()), massActionKernel(&ComputeMassActionRatesScalar), sumKernel(&SumScalar)
+			{
+#if defined(STOCHSIM_KERNEL_X64)
+				switch (instructionSet)
+				{
+				case PropensityKernel::instruction_set_avx512:
+					massActionKernel = &ComputeMassActionRatesAvx512;
+					sumKernel = &SumAvx512;
+					break;
+				case PropensityKernel::instruction_set_avx2:
+					massActionKernel = &ComputeMassActionRatesAvx2;
+					sumKernel = &SumAvx2;
+					break;
+				default:
+					break;
+				}
+#endif
+			}
+		};
+		const Kernels& GetKernels()
+		{
+			static const Kernels kernels;
+			return kernels;
+		}
+	}
+
+	PropensityKernel::instruction_set PropensityKernel::GetInstructionSet()
+	{
+		return GetKernels().instructionSet;
+	}
+	void PropensityKernel::ComputeMassActionRates(const size_t* counts, const size_t* species0, const size_t* species1, const double* shifts, const double* rateConstants, double* rates, size_t num)
+	{
+		GetKernels().massActionKernel(counts, species0, species1, shifts, rateConstants, rates, num);
+	}
+	double PropensityKernel::Sum(const double* values, size_t num)
+	{
+		return GetKernels().sumKernel(values, num);
+	}
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <stddef.h>
+namespace stochsim
+{
+	/// <summary>
+	/// Vectorized kernels to evaluate the propensities of many mass-action reactions at once. The kernels exist for AVX-512, AVX2 and as a scalar fallback, and the fastest one supported
+	/// by the CPU is selected at runtime, such that the same binary runs on all machines.
+	/// All kernels produce bit-identical results, such that simulations with the same seed do not depend on the CPU they run on.
+	/// </summary>
+	class PropensityKernel
+	{
+	public:
+		/// <summary>
+		/// Instruction sets for which kernels exist.
+		/// </summary>
+		enum instruction_set
+		{
+			instruction_set_scalar,
+			instruction_set_avx2,
+			instruction_set_avx512
+		};
+		/// <summary>
+		/// Number of reactions which are evaluated together. The number of reactions passed to ComputeMassActionRates must be a multiple of this block size.
+		/// </summary>
+		static constexpr size_t blockSize_ = 8;
+		/// <summary>
+		/// Returns the instruction set of the kernels used on this CPU.
+		/// </summary>
+		/// <returns>Instruction set used.</returns>
+		static instruction_set GetInstructionSet();
+		/// <summary>
+		/// Computes the propensities of reactions of order at most two, given in structure-of-arrays layout. The propensity of reaction j is
+		/// rateConstants[j] * counts[species0[j]] * max(counts[species1[j]] - shifts[j], 0). Reactions of order one or zero refer to an element of counts which is always one,
+		/// and a reaction consuming two molecules of the same species uses species0[j] == species1[j] and shifts[j] == 1. The counts must be smaller than 2^52.
+		/// </summary>
+		/// <param name="counts">Molecular numbers of all species.</param>
+		/// <param name="species0">Index of the first factor of each reaction.</param>
+		/// <param name="species1">Index of the second factor of each reaction.</param>
+		/// <param name="shifts">Number subtracted from the second factor of each reaction.</param>
+		/// <param name="rateConstants">Rate constants of the reactions.</param>
+		/// <param name="rates">Array where the propensities are stored.</param>
+		/// <param name="num">Number of reactions. Must be a multiple of blockSize_.</param>
+		static void ComputeMassActionRates(const size_t* counts, const size_t* species0, const size_t* species1, const double* shifts, const double* rateConstants, double* rates, size_t num);
+		/// <summary>
+		/// Returns the sum of the given values. The values are summed in blockSize_ interleaved partial sums, which are combined in a fixed order, such that the result is the same for all kernels.
+		/// </summary>
+		/// <param name="values">Values to sum.</param>
+		/// <param name="num">Number of values.</param>
+		/// <returns>Sum of the values.</returns>
+		static double Sum(const double* values, size_t num);
+	};
+}
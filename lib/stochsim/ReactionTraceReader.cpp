@@ -0,0 +1,108 @@
+#include "ReactionTraceReader.h"
+#include <cstring>
+#include <exception>
+#include <sstream>
+namespace stochsim
+{
+	ReactionTraceReader::ReactionTraceReader(const std::string& fileName) : fileName_(fileName), numPropensityReactions_(0), runtime_(0), buffer_(bufferSize_), position_(0), end_(0), endOfFile_(false), lastTimeBits_(0)
+	{
+		file_.open(fileName, std::ios::in | std::ios::binary);
+		if (!file_.is_open())
+			throw std::exception(("Could not open file " + fileName + ".").c_str());
+		auto read = [this, &fileName](void* target, size_t numBytes)
+		{
+			file_.read(static_cast<char*>(target), numBytes);
+			if (static_cast<size_t>(file_.gcount()) != numBytes)
+			{
+				std::string errorMessage = "File " + fileName + " is not a valid reaction trace: header is truncated.";
+				throw std::exception(errorMessage.c_str());
+			}
+		};
+
+		char magic[ReactionTraceFormat::magicLength_];
+		read(magic, sizeof(magic));
+		if (std::memcmp(magic, ReactionTraceFormat::magic_, sizeof(magic)) != 0)
+		{
+			std::string errorMessage = "File " + fileName + " is not a valid reaction trace.";
+			throw std::exception(errorMessage.c_str());
+		}
+		uint32_t version;
+		read(&version, sizeof(version));
+		if (version != ReactionTraceFormat::version_)
+		{
+			std::stringstream errorMessage;
+			errorMessage << "Reaction trace " << fileName << " has version " << version << ", but only version " << ReactionTraceFormat::version_ << " is supported.";
+			throw std::exception(errorMessage.str().c_str());
+		}
+		uint32_t numPropensityReactions;
+		uint32_t numEventReactions;
+		read(&numPropensityReactions, sizeof(numPropensityReactions));
+		read(&numEventReactions, sizeof(numEventReactions));
+		read(&runtime_, sizeof(runtime_));
+		numPropensityReactions_ = numPropensityReactions;
+		reactionNames_.reserve(static_cast<size_t>(numPropensityReactions) + numEventReactions);
+		for (size_t r = 0; r < static_cast<size_t>(numPropensityReactions) + numEventReactions; r++)
+		{
+			uint32_t length;
+			read(&length, sizeof(length));
+			std::string name(length, '\0');
+			read(&name[0], length);
+			reactionNames_.push_back(std::move(name));
+		}
+	}
+	bool ReactionTraceReader::Next(ReactionFiring& firing)
+	{
+		if (end_ - position_ < ReactionTraceFormat::maxRecordSize_ && !endOfFile_)
+			Fill();
+		// A record which is not completely contained in the buffer after filling it was truncated.
+		const size_t start = position_;
+		uint64_t reaction;
+		uint64_t count = 1;
+		uint64_t timeDifference;
+		if (!ReadVarint(reaction) || ((reaction & 1) && !ReadVarint(count)) || !ReadVarint(timeDifference))
+		{
+			position_ = start;
+			return false;
+		}
+		// Unsigned overflow is well defined, such that even decreasing times are restored exactly.
+		lastTimeBits_ += timeDifference;
+		firing.time = ReactionTraceFormat::BitsToTime(lastTimeBits_);
+		firing.reaction = static_cast<size_t>(reaction >> 1);
+		firing.count = static_cast<size_t>(count);
+		if (firing.reaction >= reactionNames_.size())
+		{
+			std::stringstream errorMessage;
+			errorMessage << "Reaction trace " << fileName_ << " is corrupt: record refers to reaction " << firing.reaction << ", but only " << reactionNames_.size() << " reactions exist.";
+			throw std::exception(errorMessage.str().c_str());
+		}
+		return true;
+	}
+	void ReactionTraceReader::Fill()
+	{
+		const size_t remaining = end_ - position_;
+		std::memmove(buffer_.data(), buffer_.data() + position_, remaining);
+		position_ = 0;
+		end_ = remaining;
+		file_.read(buffer_.data() + end_, buffer_.size() - end_);
+		end_ += static_cast<size_t>(file_.gcount());
+		if (end_ < buffer_.size())
+			endOfFile_ = true;
+	}
+	bool ReactionTraceReader::ReadVarint(uint64_t& value)
+	{
+		value = 0;
+		for (int shift = 0; position_ < end_; shift += 7)
+		{
+			const unsigned char byte = static_cast<unsigned char>(buffer_[position_++]);
+			if (shift >= 64)
+			{
+				std::string errorMessage = "Reaction trace " + fileName_ + " is corrupt: number is too large.";
+				throw std::exception(errorMessage.c_str());
+			}
+			value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+			if ((byte & 0x80) == 0)
+				return true;
+		}
+		return false;
+	}
+}
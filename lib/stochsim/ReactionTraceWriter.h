@@ -0,0 +1,201 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <string>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include "ReactionTraceReader.h"
+namespace stochsim
+{
+	/// <summary>
+	/// Writes a reaction trace (see ReactionTraceFormat) from a background thread. The simulation thread only encodes each firing into a block of memory (Record), which takes a few nanoseconds,
+	/// and hands the block to the background thread when it is full. Blocks written to the file are reused. If the disk cannot keep up with the simulation, the simulation waits once a bounded
+	/// number of blocks is queued.
+	/// </summary>
+	class ReactionTraceWriter
+	{
+	private:
+		struct Block
+		{
+			std::vector<char> data;
+			size_t size;
+		};
+	public:
+		/// <summary>
+		/// Constructor. Creates the file, writes the header and starts the background thread.
+		/// </summary>
+		/// <param name="fileName">Path of the file.</param>
+		/// <param name="reactionNames">Names of the propensity reactions, followed by the names of the event reactions.</param>
+		/// <param name="numPropensityReactions">Number of propensity reactions.</param>
+		/// <param name="runtime">Runtime of the simulation.</param>
+		ReactionTraceWriter(const std::string& fileName, const std::vector<std::string>& reactionNames, size_t numPropensityReactions, double runtime) : fileName_(fileName), lastTimeBits_(0), stopping_(false), failed_(false)
+		{
+			file_.open(fileName, std::ios::out | std::ios::binary | std::ios::trunc);
+			if (!file_.is_open())
+			{
+				std::string errorMessage = "Could not open file ";
+				errorMessage += fileName;
+				throw std::exception(errorMessage.c_str());
+			}
+			file_.write(ReactionTraceFormat::magic_, ReactionTraceFormat::magicLength_);
+			Write(ReactionTraceFormat::version_);
+			Write(static_cast<uint32_t>(numPropensityReactions));
+			Write(static_cast<uint32_t>(reactionNames.size() - numPropensityReactions));
+			Write(runtime);
+			for (const auto& name : reactionNames)
+			{
+				Write(static_cast<uint32_t>(name.size()));
+				file_.write(name.data(), name.size());
+			}
+			if (!file_)
+				throw std::exception(("Could not write to file " + fileName_ + ".").c_str());
+
+			block_.data.resize(blockSize_);
+			block_.size = 0;
+			thread_ = std::thread(&ReactionTraceWriter::Run, this);
+		}
+		~ReactionTraceWriter()
+		{
+			if (thread_.joinable())
+			{
+				{
+					std::lock_guard<std::mutex> lock(mutex_);
+					stopping_ = true;
+				}
+				blockAvailable_.notify_one();
+				thread_.join();
+			}
+		}
+		ReactionTraceWriter(const ReactionTraceWriter&) = delete;
+		ReactionTraceWriter& operator=(const ReactionTraceWriter&) = delete;
+
+		/// <summary>
+		/// Records that a reaction fired. Must only be called by the simulation thread. Re-throws the exception if writing to the file failed in the background thread.
+		/// </summary>
+		/// <param name="time">Time when the reaction fired.</param>
+		/// <param name="reaction">Index of the reaction. Event reactions are indexed after the propensity reactions.</param>
+		/// <param name="count">Number of times the reaction fired.</param>
+		inline void Record(double time, size_t reaction, size_t count = 1)
+		{
+			if (block_.data.size() - block_.size < ReactionTraceFormat::maxRecordSize_)
+				Submit();
+			char* out = block_.data.data() + block_.size;
+			if (count == 1)
+				out = ReactionTraceFormat::WriteVarint(static_cast<uint64_t>(reaction) << 1, out);
+			else
+			{
+				out = ReactionTraceFormat::WriteVarint((static_cast<uint64_t>(reaction) << 1) | 1, out);
+				out = ReactionTraceFormat::WriteVarint(count, out);
+			}
+			const uint64_t timeBits = ReactionTraceFormat::TimeToBits(time);
+			out = ReactionTraceFormat::WriteVarint(timeBits - lastTimeBits_, out);
+			lastTimeBits_ = timeBits;
+			block_.size = out - block_.data.data();
+		}
+		/// <summary>
+		/// Waits until all recorded firings are written, stops the background thread and closes the file. Re-throws the exception if writing to the file failed in the background thread.
+		/// </summary>
+		void Stop()
+		{
+			if (block_.size > 0)
+				Submit();
+			if (thread_.joinable())
+			{
+				{
+					std::lock_guard<std::mutex> lock(mutex_);
+					stopping_ = true;
+				}
+				blockAvailable_.notify_one();
+				thread_.join();
+			}
+			if (failed_)
+				std::rethrow_exception(error_);
+			file_.close();
+		}
+	private:
+		template<typename T> void Write(T value)
+		{
+			file_.write(reinterpret_cast<const char*>(&value), sizeof(T));
+		}
+		/// <summary>
+		/// Hands the current block to the background thread, and continues with an empty one.
+		/// </summary>
+		void Submit()
+		{
+			{
+				std::unique_lock<std::mutex> lock(mutex_);
+				spaceAvailable_.wait(lock, [this]() { return full_.size() < maxQueuedBlocks_ || failed_; });
+				if (failed_)
+					std::rethrow_exception(error_);
+				full_.push_back(std::move(block_));
+				if (!free_.empty())
+				{
+					block_ = std::move(free_.back());
+					free_.pop_back();
+				}
+				else
+					block_.data.assign(blockSize_, 0);
+				block_.size = 0;
+			}
+			blockAvailable_.notify_one();
+		}
+		/// <summary>
+		/// Main function of the background thread.
+		/// </summary>
+		void Run()
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			while (true)
+			{
+				blockAvailable_.wait(lock, [this]() { return !full_.empty() || stopping_; });
+				// The simulation thread submits no blocks after setting stopping_.
+				if (full_.empty())
+					break;
+				Block block = std::move(full_.front());
+				full_.pop_front();
+				lock.unlock();
+				spaceAvailable_.notify_one();
+				file_.write(block.data.data(), block.size);
+				lock.lock();
+				if (!file_)
+				{
+					error_ = std::make_exception_ptr(std::exception(("Could not write to file " + fileName_ + ".").c_str()));
+					failed_ = true;
+					full_.clear();
+					spaceAvailable_.notify_one();
+					break;
+				}
+				free_.push_back(std::move(block));
+			}
+		}
+
+		/// <summary>
+		/// Size of a block in bytes, and maximal number of blocks waiting to be written.
+		/// </summary>
+		static constexpr size_t blockSize_ = 1 << 16;
+		static constexpr size_t maxQueuedBlocks_ = 64;
+
+		std::ofstream file_;
+		std::string fileName_;
+		/// <summary>
+		/// Block into which the simulation thread records firings, and bit pattern of the time of the last recorded firing.
+		/// </summary>
+		Block block_;
+		uint64_t lastTimeBits_;
+		std::thread thread_;
+		/// <summary>
+		/// Blocks waiting to be written, and blocks which were written and can be reused. Guarded by mutex_, as are all following members.
+		/// </summary>
+		std::deque<Block> full_;
+		std::vector<Block> free_;
+		std::mutex mutex_;
+		std::condition_variable blockAvailable_;
+		std::condition_variable spaceAvailable_;
+		bool stopping_;
+		bool failed_;
+		std::exception_ptr error_;
+	};
+}
@@ -0,0 +1,428 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <algorithm>
+#include <math.h>
+#include "stochsim_common.h"
+#include "SimulationEngine.h"
+#include "DependencyGraph.h"
+#include "CompiledReactionNetwork.h"
+#include "PropensityKernel.h"
+#include "PropensityReaction.h"
+#include "ComposedState.h"
+#include "TimestampQueueState.h"
+#include "Interval.h"
+#include "ExpressionProgram.h"
+namespace stochsim
+{
+	/// <summary>
+	/// Rejection-based stochastic simulation algorithm (RSSA), as described in
+	/// Thanh, Vo Hong, Corrado Priami, and Roberto Zunino. "Efficient rejection-based simulation of biochemical reactions with stochastic noise and delays." The Journal of chemical physics 141.13 (2014): 134116.
+	/// For every species, a fluctuation interval around its current molecular number is maintained, and for every propensity reaction, lower and upper bounds of its propensity for all
+	/// molecular numbers in the fluctuation intervals. Candidate reactions are selected proportional to the upper bounds of their propensities, and accepted with a probability proportional to
+	/// their exact propensities. The exact propensity only has to be evaluated when a candidate cannot already be accepted based on its lower bound. The bounds of a reaction only have to be
+	/// recomputed when the molecular number of one of the species it depends on leaves its fluctuation interval, which makes this engine efficient for reactions with expensive custom rate equations.
+	/// Bounds of mass-action reactions are computed directly, and bounds of custom rate equations by evaluating them in interval arithmetic (see expression::ExpressionProgram::EvalInterval).
+	/// Reactions whose rates cannot be bounded, e.g. since they depend on the simulation time, use their exact propensity as both bounds and are updated after every change.
+	/// </summary>
+	class RejectionBasedEngine : public ISimulationEngine
+	{
+	public:
+		RejectionBasedEngine() : network_(nullptr), dependencyGraph_(nullptr), nextReaction_(0), upperSum_(0), stepsSinceResum_(0)
+		{
+		}
+		virtual void Initialize(ISimInfo& simInfo, CompiledReactionNetwork& network, const DependencyGraph& dependencyGraph) override
+		{
+			network_ = &network;
+			dependencyGraph_ = &dependencyGraph;
+			firedReactions_.assign(1, 0);
+			nextReaction_ = 0;
+
+			// Every state whose molecular number only changes when a reaction fires is a species with a fluctuation interval.
+			species_.clear();
+			std::unordered_map<const IState*, size_t> speciesIndices;
+			for (auto& state : simInfo.GetStates())
+			{
+				if (!dynamic_cast<const State*>(state.get()) && !dynamic_cast<const ComposedState*>(state.get()) && !dynamic_cast<const TimestampQueueState*>(state.get()))
+					continue;
+				speciesIndices.emplace(state.get(), species_.size());
+				species_.push_back(state.get());
+			}
+			// The programs of the custom rate equations point into this vector, which thus must not be resized afterwards.
+			speciesIntervals_.assign(species_.size(), expression::Interval());
+			speciesDirty_.assign(species_.size(), false);
+
+			const size_t numReactions = network_->Size();
+			kinds_.assign(numReactions, kind_exact);
+			programs_.assign(numReactions, expression::ExpressionProgram());
+			rateConstants_.assign(numReactions, 0);
+			factorOffsets_.assign(1, 0);
+			factorSpecies_.clear();
+			factorStochiometries_.clear();
+			speciesOffsets_.clear();
+			reactionSpecies_.clear();
+			std::vector<std::vector<size_t>> readers(species_.size());
+			std::vector<size_t> reactionSpecies;
+			for (size_t i = 0; i < numReactions; i++)
+			{
+				reactionSpecies.clear();
+				auto reaction = dynamic_cast<const PropensityReaction*>(network_->GetReactions()[i].get());
+				if (reaction && reaction->GetRateEquation())
+				{
+					auto program = reaction->CompileRateInterval(simInfo, [this, &speciesIndices, &reactionSpecies](const IState* state) -> const expression::Interval*
+					{
+						auto search = speciesIndices.find(state);
+						if (search == speciesIndices.end())
+							return nullptr;
+						reactionSpecies.push_back(search->second);
+						return &speciesIntervals_[search->second];
+					});
+					if (program)
+					{
+						kinds_[i] = kind_expression;
+						programs_[i] = std::move(program);
+					}
+				}
+				else if (reaction)
+				{
+					kinds_[i] = kind_mass_action;
+					rateConstants_[i] = reaction->GetRateConstant();
+					auto addFactor = [&](const IState* state, size_t stochiometry)
+					{
+						auto search = speciesIndices.find(state);
+						if (search == speciesIndices.end())
+						{
+							kinds_[i] = kind_exact;
+							return;
+						}
+						factorSpecies_.push_back(search->second);
+						factorStochiometries_.push_back(stochiometry);
+						reactionSpecies.push_back(search->second);
+					};
+					for (const auto& reactant : reaction->GetReactants())
+					{
+						addFactor(reactant.state_.get(), reactant.stochiometry_);
+					}
+					for (const auto& modifier : reaction->GetModifiers())
+					{
+						addFactor(modifier.state_.get(), modifier.stochiometry_);
+					}
+					for (const auto& transformee : reaction->GetTransformees())
+					{
+						addFactor(transformee.state_.get(), transformee.stochiometry_);
+					}
+					if (kinds_[i] == kind_exact)
+					{
+						factorSpecies_.resize(factorOffsets_.back());
+						factorStochiometries_.resize(factorOffsets_.back());
+					}
+				}
+				factorOffsets_.push_back(factorSpecies_.size());
+				if (kinds_[i] == kind_exact)
+					reactionSpecies.clear();
+				std::sort(reactionSpecies.begin(), reactionSpecies.end());
+				reactionSpecies.erase(std::unique(reactionSpecies.begin(), reactionSpecies.end()), reactionSpecies.end());
+				speciesOffsets_.push_back(reactionSpecies_.size());
+				reactionSpecies_.insert(reactionSpecies_.end(), reactionSpecies.begin(), reactionSpecies.end());
+				for (auto species : reactionSpecies)
+				{
+					readers[species].push_back(i);
+				}
+			}
+			speciesOffsets_.push_back(reactionSpecies_.size());
+			readerOffsets_.assign(1, 0);
+			readers_.clear();
+			for (auto& speciesReaders : readers)
+			{
+				readers_.insert(readers_.end(), speciesReaders.begin(), speciesReaders.end());
+				readerOffsets_.push_back(readers_.size());
+			}
+			reactionDirty_.assign(numReactions, false);
+			isExact_.assign(numReactions, true);
+
+			lower_.resize(numReactions);
+			upper_.resize(numReactions);
+			network_->ComputeRates(simInfo, lower_.data());
+			upper_ = lower_;
+			for (size_t s = 0; s < species_.size(); s++)
+			{
+				SetInterval(simInfo, s);
+			}
+			for (size_t i = 0; i < numReactions; i++)
+			{
+				if (kinds_[i] != kind_exact)
+					ComputeBounds(simInfo, i);
+			}
+			Resum();
+		}
+		virtual void Uninitialize(ISimInfo& simInfo) override
+		{
+			network_ = nullptr;
+			dependencyGraph_ = nullptr;
+			species_.clear();
+			speciesIntervals_.clear();
+			speciesDirty_.clear();
+			kinds_.clear();
+			isExact_.clear();
+			reactionDirty_.clear();
+			programs_.clear();
+			rateConstants_.clear();
+			factorOffsets_.clear();
+			factorSpecies_.clear();
+			factorStochiometries_.clear();
+			speciesOffsets_.clear();
+			reactionSpecies_.clear();
+			readerOffsets_.clear();
+			readers_.clear();
+			lower_.clear();
+			upper_.clear();
+		}
+		virtual double NextReactionTime(ISimInfo& simInfo, double nextEventTime) override
+		{
+			double time = simInfo.GetSimTime();
+			size_t numRejections = 0;
+			while (true)
+			{
+				if (upperSum_ <= 0)
+					return stochsim::inf;
+				// Every trial, accepted or not, advances the time, since the candidates are drawn from the reactions with the upper bounds as propensities.
+				time += simInfo.RandExponential() / upperSum_;
+				if (time > nextEventTime)
+					return time;
+
+				// Select candidate proportional to the upper bound of its propensity.
+				double afraction = simInfo.Rand() * upperSum_;
+				double asum = 0;
+				size_t candidate = 0;
+				for (size_t i = 0; i < upper_.size(); i++)
+				{
+					if (upper_[i] <= 0)
+						continue;
+					// due to rounding errors, asum might never reach afraction. Thus, default to the last reaction with a positive bound.
+					candidate = i;
+					asum += upper_[i];
+					if (asum >= afraction)
+						break;
+				}
+
+				// Accept the candidate with probability propensity / upper bound. The exact propensity is only computed if the lower bound is not sufficient to decide.
+				const double threshold = simInfo.Rand() * upper_[candidate];
+				if (threshold < lower_[candidate] || threshold < network_->ComputeRate(simInfo, candidate))
+				{
+					nextReaction_ = candidate;
+					return time;
+				}
+				// Bounds which are much larger than the propensities, e.g. for reactions requiring more molecules than currently present, might lead to a long series of rejections.
+				// Then, the fluctuation intervals are collapsed to the current molecular numbers, such that the bounds become exact.
+				if (++numRejections >= maxRejections_)
+				{
+					for (size_t s = 0; s < species_.size(); s++)
+					{
+						const double num = static_cast<double>(species_[s]->Num(simInfo));
+						speciesIntervals_[s] = expression::Interval(num);
+					}
+					for (size_t i = 0; i < kinds_.size(); i++)
+					{
+						if (kinds_[i] != kind_exact)
+							ComputeBounds(simInfo, i);
+					}
+					Resum();
+					numRejections = 0;
+				}
+			}
+		}
+		virtual const std::vector<size_t>& Fire(ISimInfo& simInfo) override
+		{
+			network_->Fire(simInfo, nextReaction_);
+			Update(simInfo, dependencyGraph_->GetPropensityDependents(nextReaction_));
+			firedReactions_[0] = nextReaction_;
+			return firedReactions_;
+		}
+		virtual void Update(ISimInfo& simInfo, const std::vector<size_t>& dependents) override
+		{
+			// Every species which might have changed is read by one of the dependents.
+			for (auto i : dependents)
+			{
+				for (size_t e = speciesOffsets_[i]; e < speciesOffsets_[i + 1]; e++)
+				{
+					const size_t species = reactionSpecies_[e];
+					if (speciesDirty_[species] || speciesIntervals_[species].Contains(static_cast<double>(species_[species]->Num(simInfo))))
+						continue;
+					speciesDirty_[species] = true;
+					dirtySpecies_.push_back(species);
+				}
+				if (isExact_[i])
+				{
+					const double rate = network_->ComputeRate(simInfo, i);
+					SetBounds(i, rate, rate);
+				}
+			}
+			// Only the bounds of reactions depending on species which left their fluctuation intervals have to be recomputed.
+			for (auto species : dirtySpecies_)
+			{
+				SetInterval(simInfo, species);
+				speciesDirty_[species] = false;
+				for (size_t e = readerOffsets_[species]; e < readerOffsets_[species + 1]; e++)
+				{
+					const size_t reaction = readers_[e];
+					if (reactionDirty_[reaction])
+						continue;
+					reactionDirty_[reaction] = true;
+					dirtyReactions_.push_back(reaction);
+				}
+			}
+			for (auto reaction : dirtyReactions_)
+			{
+				ComputeBounds(simInfo, reaction);
+				reactionDirty_[reaction] = false;
+			}
+			dirtySpecies_.clear();
+			dirtyReactions_.clear();
+			// To prevent the accumulation of rounding errors, the sum of the upper bounds is resummed periodically.
+			if (++stepsSinceResum_ >= resumPeriod_ || upperSum_ <= 0)
+				Resum();
+		}
+	private:
+		/// <summary>
+		/// How the bounds of the propensity of a reaction are computed.
+		/// </summary>
+		enum kind : unsigned char
+		{
+			// The exact propensity is used as both bounds.
+			kind_exact,
+			// Product of the falling factorials of the molecular numbers of the reactants, modifiers and transformees.
+			kind_mass_action,
+			// Interval evaluation of the custom rate equation.
+			kind_expression
+		};
+		/// <summary>
+		/// Relative size of the fluctuation intervals.
+		/// </summary>
+		static constexpr double fluctuationRate_ = 0.1;
+		/// <summary>
+		/// Relative amount by which the bounds are widened, such that they also contain propensities which are computed with different rounding errors.
+		/// </summary>
+		static constexpr double boundTolerance_ = 1e-12;
+		/// <summary>
+		/// Number of consecutive rejections after which the fluctuation intervals are collapsed.
+		/// </summary>
+		static constexpr size_t maxRejections_ = 1000;
+		/// <summary>
+		/// Number of bound updates after which the sum of the upper bounds is resummed from scratch.
+		/// </summary>
+		static constexpr size_t resumPeriod_ = 1000;
+
+		CompiledReactionNetwork* network_;
+		const DependencyGraph* dependencyGraph_;
+		std::vector<size_t> firedReactions_;
+		/// <summary>
+		/// Candidate accepted by the last call to NextReactionTime.
+		/// </summary>
+		size_t nextReaction_;
+
+		std::vector<const IState*> species_;
+		std::vector<expression::Interval> speciesIntervals_;
+		std::vector<bool> speciesDirty_;
+		std::vector<size_t> dirtySpecies_;
+
+		std::vector<kind> kinds_;
+		/// <summary>
+		/// True if the bounds of a reaction are its exact propensity, either since the reaction is of kind_exact, or since its bounds could not be computed for the current intervals.
+		/// </summary>
+		std::vector<bool> isExact_;
+		std::vector<bool> reactionDirty_;
+		std::vector<size_t> dirtyReactions_;
+		std::vector<expression::ExpressionProgram> programs_;
+		/// <summary>
+		/// Rate constants and factors of the mass-action reactions, with the factors of reaction i in [factorOffsets_[i], factorOffsets_[i+1]).
+		/// </summary>
+		std::vector<double> rateConstants_;
+		std::vector<size_t> factorOffsets_;
+		std::vector<size_t> factorSpecies_;
+		std::vector<size_t> factorStochiometries_;
+		/// <summary>
+		/// Species the bounds of reaction i depend on, in [speciesOffsets_[i], speciesOffsets_[i+1]).
+		/// </summary>
+		std::vector<size_t> speciesOffsets_;
+		std::vector<size_t> reactionSpecies_;
+		/// <summary>
+		/// Reactions whose bounds depend on species s, in [readerOffsets_[s], readerOffsets_[s+1]).
+		/// </summary>
+		std::vector<size_t> readerOffsets_;
+		std::vector<size_t> readers_;
+
+		/// <summary>
+		/// Lower and upper bounds of the propensities of the reactions.
+		/// </summary>
+		std::vector<double> lower_;
+		std::vector<double> upper_;
+		/// <summary>
+		/// Sum of the upper bounds of all reactions.
+		/// </summary>
+		double upperSum_;
+		size_t stepsSinceResum_;
+
+		/// <summary>
+		/// Centers the fluctuation interval of the species around its current molecular number.
+		/// </summary>
+		void SetInterval(ISimInfo& simInfo, size_t species)
+		{
+			const double num = static_cast<double>(species_[species]->Num(simInfo));
+			speciesIntervals_[species] = expression::Interval(floor(num * (1 - fluctuationRate_)), ceil(num * (1 + fluctuationRate_)));
+		}
+		/// <summary>
+		/// Sets the bounds of the propensity of the reaction. Updates the sum of the upper bounds.
+		/// </summary>
+		void SetBounds(size_t reaction, double lower, double upper)
+		{
+			upperSum_ += upper - upper_[reaction];
+			lower_[reaction] = lower;
+			upper_[reaction] = upper;
+		}
+		/// <summary>
+		/// Computes the bounds of the propensity of a reaction not of kind_exact for the current fluctuation intervals.
+		/// </summary>
+		void ComputeBounds(ISimInfo& simInfo, size_t reaction)
+		{
+			expression::Interval bounds;
+			if (kinds_[reaction] == kind_mass_action)
+			{
+				// Falling factorials are non-decreasing for non-negative integers. Thus, the bounds are attained at the bounds of the intervals.
+				double lower = rateConstants_[reaction];
+				double upper = rateConstants_[reaction];
+				for (size_t e = factorOffsets_[reaction]; e < factorOffsets_[reaction + 1]; e++)
+				{
+					const expression::Interval& interval = speciesIntervals_[factorSpecies_[e]];
+					const size_t lowerNum = static_cast<size_t>(interval.lower);
+					const size_t upperNum = static_cast<size_t>(interval.upper);
+					for (size_t s = 0; s < factorStochiometries_[e]; s++)
+					{
+						lower *= lowerNum - s;
+						upper *= upperNum - s;
+					}
+				}
+				bounds = expression::Interval(lower, upper);
+			}
+			else
+			{
+				bounds = programs_[reaction].EvalInterval();
+			}
+			if (!(bounds.upper < stochsim::inf) || !(bounds.lower <= bounds.upper))
+			{
+				// The bounds are unknown, e.g. due to a division by an interval containing zero.
+				isExact_[reaction] = true;
+				const double rate = network_->ComputeRate(simInfo, reaction);
+				SetBounds(reaction, rate, rate);
+				return;
+			}
+			isExact_[reaction] = false;
+			SetBounds(reaction, std::max(bounds.lower * (1 - boundTolerance_), 0.0), std::max(bounds.upper * (1 + boundTolerance_), 0.0));
+		}
+		void Resum()
+		{
+			upperSum_ = PropensityKernel::Sum(upper_.data(), upper_.size());
+			stepsSinceResum_ = 0;
+		}
+	};
+}
@@ -1,4 +1,18 @@
 #include "Simulation.h"
+#include "DependencyGraph.h"
+#include "CompiledReactionNetwork.h"
+#include "IndexedPriorityQueue.h"
+#include "DirectMethodEngine.h"
+#include "NextReactionEngine.h"
+#include "CompositionRejectionEngine.h"
+#include "TauLeapingEngine.h"
+#include "RejectionBasedEngine.h"
+#include "HybridEngine.h"
+#include "PartialPropensityEngine.h"
+#include "PhiloxRandomEngine.h"
+#include "AsyncLogWriter.h"
+#include "ReactionTraceWriter.h"
+#include "ReactionTraceReader.h"
 #include <math.h>    
 #include <cassert>
 #include <sstream> 
@@ -15,15 +29,17 @@
 // Windows Header Files:
 #include <SDKDDKVer.h>
 #include <windows.h>
+#include <intrin.h>
 #endif
 namespace stochsim
 {
 	std::string CreatePathRecursively(std::string rawPath);
+	std::string CreateSaveFolder(const std::string& baseFolder, bool uniqueSubFolder);
 
 	class LogManager
 	{
 	public:
-		LogManager() : logPeriod_(1.0), baseFolder_("simulations"), uniqueSubFolder_(true), saveFolder_("")
+		LogManager() : startTime_(0), numLogPeriods_(0), logPeriod_(1.0), logFrequency_(1.0), baseFolder_("simulations"), uniqueSubFolder_(true), saveFolder_(""), loggingMode_(Simulation::logging_synchronous), logBufferCapacity_(1024)
 		{
 		}
 		void SetUniqueSubfolder(bool uniqueSubFolder)
@@ -55,7 +71,7 @@ namespace stochsim
 		void Initialize(ISimInfo& simInfo)
 		{
 			// Test if any logger is writing anything to the disk, i.e. if we have to create a results folder at all...
-			bool shouldCreate = false;
+			bool shouldCreate = !reactionTrace_.empty();
 			for (auto& task : tasks_)
 			{
 				if (task->WritesToDisk())
@@ -65,25 +81,7 @@ namespace stochsim
 				}
 			}
 			if (shouldCreate)
-			{
-				time_t t = std::time(0);
-				struct tm now;
-				localtime_s(&now, &t);
-				std::stringstream buffer;
-				buffer << baseFolder_;
-				if (uniqueSubFolder_)
-				{
-					buffer << "/"
-						<< (now.tm_year + 1900) << '-'
-						<< (now.tm_mon + 1) << '-'
-						<< now.tm_mday << '_'
-						<< now.tm_hour << '-'
-						<< now.tm_min << '-'
-						<< now.tm_sec << '/';
-				}
-				saveFolder_ = buffer.str();
-				saveFolder_ = CreatePathRecursively(saveFolder_);
-			}
+				saveFolder_ = CreateSaveFolder(baseFolder_, uniqueSubFolder_);
 			else
 				saveFolder_ = "";
 
@@ -91,60 +89,163 @@ namespace stochsim
 			{
 				task->Initialize(simInfo);
 			}
+			// When logging asynchronously, snapshot loggers are called by the writer thread, and only the remaining loggers by the simulation.
+			synchronousTasks_.clear();
+			std::vector<std::shared_ptr<ISnapshotLogger>> asynchronousTasks;
+			for (auto& task : tasks_)
+			{
+				std::shared_ptr<ISnapshotLogger> snapshotTask = loggingMode_ == Simulation::logging_synchronous ? nullptr : std::dynamic_pointer_cast<ISnapshotLogger>(task);
+				if (snapshotTask)
+					asynchronousTasks.push_back(std::move(snapshotTask));
+				else
+					synchronousTasks_.push_back(task);
+			}
+			writer_.reset();
+			if (!asynchronousTasks.empty())
+				writer_ = std::make_unique<AsyncLogWriter>(std::move(asynchronousTasks), logBufferCapacity_, loggingMode_ == Simulation::logging_asynchronous_grow);
+
 			auto time = simInfo.GetSimTime();
 			WriteLog(simInfo, time);
-			lastLogTime_ = time;
+			startTime_ = time;
+			numLogPeriods_ = 0;
 		}
 		void Uninitialize(ISimInfo& simInfo)
 		{
 			auto time = simInfo.GetSimTime();
 			NotifyBeforeChange(simInfo);
 			WriteLog(simInfo, time);
-			lastLogTime_ = time;
+			// All rows have to be written before the loggers are uninitialized.
+			std::exception_ptr error;
+			if (writer_)
+			{
+				try
+				{
+					writer_->Stop();
+				}
+				catch (...)
+				{
+					error = std::current_exception();
+				}
+				writer_.reset();
+			}
 			for (auto& task : tasks_)
 			{
 				task->Uninitialize(simInfo);
 			}
+			if (error)
+				std::rethrow_exception(error);
 		}
 		void NotifyBeforeChange(ISimInfo& simInfo)
 		{
 			auto time = simInfo.GetSimTime();
-			while (lastLogTime_ + logPeriod_ < time)
+			// Log times are multiples of the log period instead of being summed up, such that they do not accumulate rounding errors.
+			while (LogTime(numLogPeriods_ + 1) < time)
 			{
-				lastLogTime_ += logPeriod_;
-				WriteLog(simInfo, lastLogTime_);
+				numLogPeriods_++;
+				WriteLog(simInfo, LogTime(numLogPeriods_));
 			}
 		}
+		/// <summary>
+		/// Returns the first log time strictly after the given time. Uses the same formula as the logging itself, such that engines stepping to this time hit it exactly.
+		/// </summary>
+		double GetNextLogTime(double time) const
+		{
+			size_t numLogPeriods = numLogPeriods_ + 1;
+			while (LogTime(numLogPeriods) <= time)
+			{
+				numLogPeriods++;
+			}
+			return LogTime(numLogPeriods);
+		}
 		void SetLogPeriod(double logPeriod)
 		{
 			assert(logPeriod > 0);
 			logPeriod_ = logPeriod;
+			const double frequency = std::round(1 / logPeriod);
+			logFrequency_ = frequency >= 1 && 1 / frequency == logPeriod ? frequency : 0;
 		}
 		void SetBaseFolder(std::string baseFolder)
 		{
 			baseFolder_ = std::move(baseFolder);
 		}
+		void SetLoggingMode(Simulation::logging_mode loggingMode)
+		{
+			loggingMode_ = loggingMode;
+		}
+		Simulation::logging_mode GetLoggingMode() const
+		{
+			return loggingMode_;
+		}
+		void SetLogBufferCapacity(size_t logBufferCapacity)
+		{
+			if (logBufferCapacity == 0)
+				throw std::exception("Log buffer must have room for at least one row.");
+			logBufferCapacity_ = logBufferCapacity;
+		}
+		size_t GetLogBufferCapacity() const
+		{
+			return logBufferCapacity_;
+		}
+		void SetReactionTrace(std::string fileName)
+		{
+			reactionTrace_ = std::move(fileName);
+		}
+		std::string GetReactionTrace() const
+		{
+			return reactionTrace_;
+		}
 	private:
+		/// <summary>
+		/// Returns the time when the given number of log periods passed. If the log period is the inverse of an integer, e.g. 0.01, dividing by this integer yields the double closest to
+		/// the exact time (e.g. 0.35 instead of 0.35000000000000003), such that the times are written with as few digits as possible.
+		/// </summary>
+		inline double LogTime(size_t numLogPeriods) const
+		{
+			if (logFrequency_ > 0)
+				return startTime_ + numLogPeriods / logFrequency_;
+			return startTime_ + numLogPeriods * logPeriod_;
+		}
 		inline void WriteLog(ISimInfo& simInfo, double time)
 		{
-			for (auto& task : tasks_)
+			for (auto& task : synchronousTasks_)
 			{
 				task->WriteLog(simInfo, time);
 			}
+			if (writer_)
+				writer_->Push(simInfo, time);
 		}
 		std::vector<std::shared_ptr<ILogger>> tasks_;
-		double lastLogTime_;
+		/// <summary>
+		/// Loggers called by the simulation thread during the current run, and the writer calling all other loggers.
+		/// </summary>
+		std::vector<std::shared_ptr<ILogger>> synchronousTasks_;
+		std::unique_ptr<AsyncLogWriter> writer_;
+		double startTime_;
+		size_t numLogPeriods_;
 		double logPeriod_;
+		/// <summary>
+		/// Inverse of the log period if it is an integer, and zero otherwise.
+		/// </summary>
+		double logFrequency_;
 		std::string baseFolder_;
 		bool uniqueSubFolder_;
 		std::string saveFolder_;
+		Simulation::logging_mode loggingMode_;
+		size_t logBufferCapacity_;
+		/// <summary>
+		/// File name of the reaction trace relative to the save folder, or empty if no trace is recorded.
+		/// </summary>
+		std::string reactionTrace_;
 	};
 	
 	class Simulation::Impl : public ISimInfo
 	{
 	public:
-		Impl() : randomEngine_(std::random_device{}()), time_(0), runtime_(0)
+		Impl() : time_(0), runtime_(0), engine_(engine_direct)
 		{
+			std::random_device randomDevice;
+			unsigned long long seed = (static_cast<unsigned long long>(randomDevice()) << 32) | randomDevice();
+			randomEngine_ = std::make_shared<PhiloxRandomEngine>(seed);
 		}
 		~Impl() {}
 		void Run(double runtime)
@@ -153,105 +254,80 @@ namespace stochsim
 			** Run a modified version of Gillespies algorithm. The base algorithm is implemented as outlined in
 			** Gillespie, Daniel T. "Exact stochastic simulation of coupled chemical reactions." The journal of physical chemistry 81.25 (1977): 2340-2361.
 			** What we added is the support of fixed time delays and other events happening at given times instead with continuous propensities.
+			** Which propensity reaction fires next, and when, is determined by the simulation engine (see Simulation::SetEngine).
 			**/
 			runtime_ = runtime;
 			time_ = 0;
 
 			// Initialize
-			for (auto& state : states_)
+			InitializeModel();
+			logger_.Initialize(*this);
+			dependencyGraph_.Initialize(states_, propensityReactions_, eventReactions_);
+			network_.Initialize(propensityReactions_);
+			std::unique_ptr<ISimulationEngine> engine = CreateEngine();
+			engine->Initialize(*this, network_, dependencyGraph_);
+			// Calendar of the event reactions. The firing time of an event reaction is only updated when a reaction fired which might have changed it.
+			std::vector<double> eventTimes(eventReactions_.size());
+			for (size_t i = 0; i < eventReactions_.size(); i++)
 			{
-				state->Initialize(*this);
+				eventTimes[i] = eventReactions_[i]->NextReactionTime(*this);
 			}
-			for (auto& reaction : propensityReactions_)
+			eventCalendar_.Initialize(std::move(eventTimes));
+
+			// iterate
+			// The loop is compiled separately with and without recording a trace of the reactions, such that the trace costs nothing if it is disabled.
+			std::unique_ptr<ReactionTraceWriter> trace;
+			const std::string reactionTrace = logger_.GetReactionTrace();
+			if (!reactionTrace.empty())
 			{
-				reaction->Initialize(*this);
+				trace = std::make_unique<ReactionTraceWriter>(logger_.GetSaveFolder() + "/" + reactionTrace, GetReactionNames(), propensityReactions_.size(), runtime);
+				Iterate<true>(*engine, trace.get());
+				trace->Stop();
 			}
-			for (auto& reaction : eventReactions_)
+			else
+				Iterate<false>(*engine, nullptr);
+
+			// Uninitialize
+			engine->Uninitialize(*this);
+			eventCalendar_.Clear();
+			dependencyGraph_.Uninitialize();
+			network_.Uninitialize();
+			logger_.Uninitialize(*this);
+			for (auto& state : states_)
 			{
-				reaction->Initialize(*this);
+				state->Uninitialize(*this);
 			}
-			logger_.Initialize(*this);
-
-			// propensities of reactions
-			std::vector<double> ai(propensityReactions_.size());
-
-			// iterate
-			while (time_ <= runtime)
+		}
+		void Replay(const std::string& traceFile)
+		{
+			ReactionTraceReader reader(traceFile);
+			if (reader.GetNumPropensityReactions() != propensityReactions_.size() || reader.GetReactionNames() != GetReactionNames())
 			{
-				// Calculate aggregated reaction probability
-				double a0 = 0;
-				for (size_t i = 0; i < propensityReactions_.size(); i++)
-				{
-					ai[i] = propensityReactions_[i]->ComputeRate(*this);
-					a0 += ai[i];
-				}
-
-				// Calculate time span to next propensity reaction event
-				double tau;
-				if (a0 > 0)
-				{
-					double r1 = randomUniform_(randomEngine_);
-					tau = 1 / a0 * log(1.0 / r1);
-				}
-				else
-				{
-					tau = stochsim::inf;
-				}
-
-				// Calculate time to next event reaction
-				size_t nextEventIndex = 0;
-				double nextEventT = stochsim::inf;
-				for (size_t i = 0; i < eventReactions_.size(); i++)
-				{
-					double temp = eventReactions_[i]->NextReactionTime(*this);
-					if (temp < nextEventT)
-					{
-						nextEventT = temp;
-						nextEventIndex = i;
-					}
-				}
-
-				// Fire either next event or next propensity reaction, whichever is earlier
-				if (nextEventT > time_ + tau)
-				{
-					// Fire a propensity reaction
-					time_ += tau;
-					if (time_ > runtime)
-					{
-						time_ = runtime;
-						break;
-					}
+				std::string errorMessage = "Reaction trace " + traceFile + " was not recorded for the reactions of this simulation.";
+				throw std::exception(errorMessage.c_str());
+			}
+			runtime_ = reader.GetRunTime();
+			time_ = 0;
 
-					// notify logger about the time of the next reaction event
-					logger_.NotifyBeforeChange(*this);
+			// Initialize
+			InitializeModel();
+			logger_.Initialize(*this);
 
-					// decide on identity of next reaction event and fire this event
-					double r2 = randomUniform_(randomEngine_);
-					double afraction = r2 * a0;
-					double asum = 0;
-					for (size_t i = 0; i < propensityReactions_.size(); i++)
-					{
-						asum += ai[i];
-						if (asum >= afraction)
-						{
-							propensityReactions_[i]->Fire(*this);
-							break;
-						}
-					}
-				}
-				else
+			// Fire the reactions in the order of the trace, without any engine.
+			ReactionFiring firing;
+			while (reader.Next(firing))
+			{
+				time_ = firing.time;
+				logger_.NotifyBeforeChange(*this);
+				for (size_t i = 0; i < firing.count; i++)
 				{
-					time_ = nextEventT;
-					if (time_ > runtime)
-					{
-						time_ = runtime;
-						break;
-					}
-					// notify logger about the time of the next reaction event
-					logger_.NotifyBeforeChange(*this);
-					eventReactions_[nextEventIndex]->Fire(*this);
+					if (firing.reaction < propensityReactions_.size())
+						propensityReactions_[firing.reaction]->Fire(*this);
+					else
+						eventReactions_[firing.reaction - propensityReactions_.size()]->Fire(*this);
 				}
 			}
+			time_ = runtime_;
 
 			// Uninitialize
 			logger_.Uninitialize(*this);
@@ -269,6 +345,10 @@ namespace stochsim
 		{
 			return logger_.GetLogPeriod();
 		}
+		virtual double GetNextLogTime() const override
+		{
+			return logger_.GetNextLogTime(time_);
+		}
 		virtual std::string GetSaveFolder() const override
 		{
 			return logger_.GetSaveFolder();
@@ -279,19 +359,62 @@ namespace stochsim
 		}
 		virtual size_t Rand(size_t lower, size_t upper) override
 		{
-			std::uniform_int_distribution<size_t> randomIndex(lower, upper);
-			return randomIndex(randomEngine_);
+			// Lemire's nearly divisionless method to map a random 64 bit integer without bias to the range.
+			unsigned long long range = static_cast<unsigned long long>(upper - lower) + 1;
+			if (range == 0)
+				return static_cast<size_t>(randomEngine_->Next());
+			unsigned long long high;
+			unsigned long long low = MultiplyHighLow(randomEngine_->Next(), range, high);
+			if (low < range)
+			{
+				unsigned long long threshold = (0 - range) % range;
+				while (low < threshold)
+				{
+					low = MultiplyHighLow(randomEngine_->Next(), range, high);
+				}
+			}
+			return lower + static_cast<size_t>(high);
 		}
 
 		virtual double Rand() override
 		{
-			return randomUniform_(randomEngine_);
+			return randomEngine_->Uniform();
+		}
+		virtual double RandExponential() override
+		{
+			return randomEngine_->Exponential();
+		}
+		virtual IRandomEngine& GetRandomEngine() override
+		{
+			return *randomEngine_;
 		}
 
 		LogManager& GetLogger()
 		{
 			return logger_;
 		}
+		void SetEngine(engine engine)
+		{
+			engine_ = engine;
+		}
+		engine GetEngine() const
+		{
+			return engine_;
+		}
+		void SetSeed(unsigned long long seed, unsigned long long stream)
+		{
+			randomEngine_->Seed(seed, stream);
+		}
+		void SetRandomEngine(std::shared_ptr<IRandomEngine> randomEngine)
+		{
+			if (!randomEngine)
+				throw std::exception("Random engine must not be null.");
+			randomEngine_ = std::move(randomEngine);
+		}
+		std::shared_ptr<IRandomEngine> GetRandomEngineShared() const
+		{
+			return randomEngine_;
+		}
 
 		void AddReaction(std::shared_ptr<IPropensityReaction> reaction)
 		{
@@ -365,15 +488,162 @@ namespace stochsim
 		}
 
 	private:
+		/// <summary>
+		/// Initializes all states and reactions.
+		/// </summary>
+		void InitializeModel()
+		{
+			for (auto& state : states_)
+			{
+				state->Initialize(*this);
+			}
+			for (auto& reaction : propensityReactions_)
+			{
+				reaction->Initialize(*this);
+			}
+			for (auto& reaction : eventReactions_)
+			{
+				reaction->Initialize(*this);
+			}
+		}
+		/// <summary>
+		/// Fires reactions until the runtime is reached. If tracing is true, every firing is recorded by trace.
+		/// </summary>
+		template<bool tracing> void Iterate(ISimulationEngine& engine, ReactionTraceWriter* trace)
+		{
+			while (time_ <= runtime_)
+			{
+				// Calculate time to next event reaction
+				double nextEventT = eventCalendar_.TopKey();
+
+				// Calculate time of next propensity reaction event
+				double nextReactionT = engine.NextReactionTime(*this, nextEventT);
+
+				// Fire either next event or next propensity reaction, whichever is earlier
+				if (nextEventT >= nextReactionT)
+				{
+					// Fire a propensity reaction
+					time_ = nextReactionT;
+					if (time_ > runtime_)
+					{
+						time_ = runtime_;
+						break;
+					}
+
+					// notify logger about the time of the next reaction event
+					logger_.NotifyBeforeChange(*this);
+					const std::vector<size_t>& firedReactions = engine.Fire(*this);
+					if (tracing)
+					{
+						const std::vector<size_t>* firingCounts = engine.GetFiringCounts();
+						for (size_t k = 0; k < firedReactions.size(); k++)
+						{
+							trace->Record(time_, firedReactions[k], firingCounts ? (*firingCounts)[k] : 1);
+						}
+					}
+					for (auto reactionIndex : firedReactions)
+					{
+						UpdateEventCalendar(dependencyGraph_.GetPropensityEventDependents(reactionIndex));
+					}
+				}
+				else
+				{
+					time_ = nextEventT;
+					if (time_ > runtime_)
+					{
+						time_ = runtime_;
+						break;
+					}
+					// notify logger about the time of the next reaction event
+					logger_.NotifyBeforeChange(*this);
+					size_t eventIndex = eventCalendar_.Top();
+					if (tracing)
+						trace->Record(time_, propensityReactions_.size() + eventIndex);
+					eventReactions_[eventIndex]->Fire(*this);
+					engine.Update(*this, dependencyGraph_.GetEventDependents(eventIndex));
+					UpdateEventCalendar(dependencyGraph_.GetEventEventDependents(eventIndex));
+				}
+			}
+		}
+		/// <summary>
+		/// Updates the firing times of the given event reactions in the calendar.
+		/// </summary>
+		inline void UpdateEventCalendar(const std::vector<size_t>& dependents)
+		{
+			for (auto i : dependents)
+			{
+				eventCalendar_.Update(i, eventReactions_[i]->NextReactionTime(*this));
+			}
+		}
+		/// <summary>
+		/// Returns the names of all propensity reactions, followed by the names of all event reactions, i.e. in the order in which reactions are indexed in reaction traces.
+		/// </summary>
+		std::vector<std::string> GetReactionNames() const
+		{
+			std::vector<std::string> names;
+			for (const auto& reaction : propensityReactions_)
+			{
+				names.push_back(reaction->GetName());
+			}
+			for (const auto& reaction : eventReactions_)
+			{
+				names.push_back(reaction->GetName());
+			}
+			return names;
+		}
+		/// <summary>
+		/// Returns the lower 64 bits of the 128 bit product of a and b, and sets high to the upper 64 bits.
+		/// </summary>
+		static inline unsigned long long MultiplyHighLow(unsigned long long a, unsigned long long b, unsigned long long& high)
+		{
+#if defined(_M_X64)
+			return _umul128(a, b, &high);
+#elif defined(__SIZEOF_INT128__)
+			unsigned __int128 product = static_cast<unsigned __int128>(a) * b;
+			high = static_cast<unsigned long long>(product >> 64);
+			return static_cast<unsigned long long>(product);
+#else
+			unsigned long long a0 = a & 0xFFFFFFFF, a1 = a >> 32, b0 = b & 0xFFFFFFFF, b1 = b >> 32;
+			unsigned long long p00 = a0 * b0, p01 = a0 * b1, p10 = a1 * b0, p11 = a1 * b1;
+			unsigned long long middle = (p00 >> 32) + (p01 & 0xFFFFFFFF) + (p10 & 0xFFFFFFFF);
+			high = p11 + (p01 >> 32) + (p10 >> 32) + (middle >> 32);
+			return (middle << 32) | (p00 & 0xFFFFFFFF);
+#endif
+		}
+		std::unique_ptr<ISimulationEngine> CreateEngine() const
+		{
+			switch (engine_)
+			{
+			case engine_direct:
+				return std::make_unique<DirectMethodEngine>();
+			case engine_next_reaction:
+				return std::make_unique<NextReactionEngine>();
+			case engine_composition_rejection:
+				return std::make_unique<CompositionRejectionEngine>();
+			case engine_tau_leaping:
+				return std::make_unique<TauLeapingEngine>();
+			case engine_rejection_based:
+				return std::make_unique<RejectionBasedEngine>();
+			case engine_hybrid:
+				return std::make_unique<HybridEngine>();
+			case engine_partial_propensity:
+				return std::make_unique<PartialPropensityEngine>();
+			default:
+				throw std::exception("Unknown simulation engine.");
+			}
+		}
+
 		std::vector<std::shared_ptr<IPropensityReaction>> propensityReactions_;
 		std::vector<std::shared_ptr<IEventReaction>> eventReactions_;
 		std::vector<std::shared_ptr<IState>> states_;
 		double time_;
 		double runtime_;
 		LogManager logger_;
-		std::default_random_engine randomEngine_;
-		// function to generate uniformly distributed random numbers in [0,1)
-		std::uniform_real<double> randomUniform_;
+		DependencyGraph dependencyGraph_;
+		CompiledReactionNetwork network_;
+		IndexedPriorityQueue eventCalendar_;
+		engine engine_;
+		std::shared_ptr<IRandomEngine> randomEngine_;
 	};
 
 	Simulation::Simulation() : impl_(new Simulation::Impl())
@@ -431,6 +701,10 @@ namespace stochsim
 	{
 		impl_->Run(maxTime);
 	}
+	void Simulation::Replay(const std::string& traceFile)
+	{
+		impl_->Replay(traceFile);
+	}
 
 	void Simulation::AddLogger(std::shared_ptr<ILogger> logger)
 	{
@@ -460,6 +734,50 @@ namespace stochsim
 	{
 		return impl_->GetLogger().IsUniqueSubfolder();
 	}
+	void Simulation::SetLoggingMode(logging_mode loggingMode)
+	{
+		impl_->GetLogger().SetLoggingMode(loggingMode);
+	}
+	Simulation::logging_mode Simulation::GetLoggingMode() const
+	{
+		return impl_->GetLogger().GetLoggingMode();
+	}
+	void Simulation::SetLogBufferCapacity(size_t logBufferCapacity)
+	{
+		impl_->GetLogger().SetLogBufferCapacity(logBufferCapacity);
+	}
+	size_t Simulation::GetLogBufferCapacity() const
+	{
+		return impl_->GetLogger().GetLogBufferCapacity();
+	}
+	void Simulation::SetReactionTrace(std::string fileName)
+	{
+		impl_->GetLogger().SetReactionTrace(std::move(fileName));
+	}
+	std::string Simulation::GetReactionTrace() const
+	{
+		return impl_->GetLogger().GetReactionTrace();
+	}
+	void Simulation::SetEngine(engine engine)
+	{
+		impl_->SetEngine(engine);
+	}
+	Simulation::engine Simulation::GetEngine() const
+	{
+		return impl_->GetEngine();
+	}
+	void Simulation::SetSeed(unsigned long long seed, unsigned long long stream)
+	{
+		impl_->SetSeed(seed, stream);
+	}
+	void Simulation::SetRandomEngine(std::shared_ptr<IRandomEngine> randomEngine)
+	{
+		impl_->SetRandomEngine(std::move(randomEngine));
+	}
+	std::shared_ptr<IRandomEngine> Simulation::GetRandomEngine() const
+	{
+		return impl_->GetRandomEngineShared();
+	}
 
 
 
@@ -479,6 +797,25 @@ namespace stochsim
 
 		return converterX.to_bytes(wstr);
 	}
+	std::string CreateSaveFolder(const std::string& baseFolder, bool uniqueSubFolder)
+	{
+		std::stringstream buffer;
+		buffer << baseFolder;
+		if (uniqueSubFolder)
+		{
+			time_t t = std::time(0);
+			struct tm now;
+			localtime_s(&now, &t);
+			buffer << "/"
+				<< (now.tm_year + 1900) << '-'
+				<< (now.tm_mon + 1) << '-'
+				<< now.tm_mday << '_'
+				<< now.tm_hour << '-'
+				<< now.tm_min << '-'
+				<< now.tm_sec << '/';
+		}
+		return CreatePathRecursively(buffer.str());
+	}
 	std::string CreatePathRecursively(std::string rawPath)
 	{
 #if defined(_WIN32)
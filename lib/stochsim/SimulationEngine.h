@@ -0,0 +1,61 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include "stochsim_common.h"
+#include "DependencyGraph.h"
+#include "CompiledReactionNetwork.h"
+namespace stochsim
+{
+	/// <summary>
+	/// Base class of all algorithms determining which propensity reaction fires next, and when. Event reactions are handled by the simulation itself,
+	/// such that an engine only has to be notified when an event reaction changed the state of the simulation.
+	/// </summary>
+	class ISimulationEngine
+	{
+	public:
+		virtual ~ISimulationEngine() {}
+		/// <summary>
+		/// Called by the simulation before the simulation starts, after all states and reactions were initialized.
+		/// </summary>
+		/// <param name="simInfo">Simulation context.</param>
+		/// <param name="network">Propensity reactions of the simulation. Rates should be computed and reactions be fired via the network, such that compiled mass-action reactions bypass the generic implementation.
+		/// The indices of the reactions correspond to the indices used by the dependency graph. Guaranteed to stay valid until Uninitialize is called.</param>
+		/// <param name="dependencyGraph">Dependency graph of the reactions. Guaranteed to stay valid until Uninitialize is called.</param>
+		virtual void Initialize(ISimInfo& simInfo, CompiledReactionNetwork& network, const DependencyGraph& dependencyGraph) = 0;
+		/// <summary>
+		/// Called by the simulation after the simulation finished. Can be used for cleanup.
+		/// </summary>
+		/// <param name="simInfo">Simulation context.</param>
+		virtual void Uninitialize(ISimInfo& simInfo) = 0;
+		/// <summary>
+		/// Returns the simulation time when the next propensity reaction fires, or stochsim::inf if no propensity reaction can fire anymore given the current state.
+		/// Called exactly once before each call to Fire or Update. Approximate engines which fire several reactions at once must not schedule them later than nextEventTime.
+		/// If a propensity reaction is scheduled at exactly nextEventTime, it fires before the event.
+		/// </summary>
+		/// <param name="simInfo">Simulation context.</param>
+		/// <param name="nextEventTime">Time when the next event reaction fires.</param>
+		/// <returns>Time of the next propensity reaction.</returns>
+		virtual double NextReactionTime(ISimInfo& simInfo, double nextEventTime) = 0;
+		/// <summary>
+		/// Fires the propensity reaction(s) scheduled by the last call to NextReactionTime. When called, the simulation time was already advanced to the respective time.
+		/// </summary>
+		/// <param name="simInfo">Simulation context.</param>
+		/// <returns>Indices of the propensity reactions which fired. Stays valid until the next call to any method of the engine.</returns>
+		virtual const std::vector<size_t>& Fire(ISimInfo& simInfo) = 0;
+		/// <summary>
+		/// Returns how often each propensity reaction returned by the last call to Fire fired, in the same order, or nullptr if each of them fired exactly once.
+		/// Only approximate engines, which fire several reactions at once, have to override this method. Stays valid until the next call to any method of the engine.
+		/// </summary>
+		/// <returns>Number of firings of the reactions which fired, or nullptr.</returns>
+		virtual const std::vector<size_t>* GetFiringCounts() const
+		{
+			return nullptr;
+		}
+		/// <summary>
+		/// Called after an event reaction fired instead of the propensity reaction scheduled by the last call to NextReactionTime.
+		/// </summary>
+		/// <param name="simInfo">Simulation context.</param>
+		/// <param name="dependents">Indices of all propensity reactions whose rates might have changed.</param>
+		virtual void Update(ISimInfo& simInfo, const std::vector<size_t>& dependents) = 0;
+	};
+}
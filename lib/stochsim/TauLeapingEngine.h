@@ -0,0 +1,647 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <math.h>
+#include "stochsim_common.h"
+#include "SimulationEngine.h"
+#include "DependencyGraph.h"
+#include "CompiledReactionNetwork.h"
+#include "State.h"
+#include "Choice.h"
+#include "PropensityReaction.h"
+namespace stochsim
+{
+	/// <summary>
+	/// Explicit tau-leaping with adaptive step size selection and critical reactions, as described in
+	/// Cao, Yang, Daniel T. Gillespie, and Linda R. Petzold. "Efficient step size selection for the tau-leaping simulation method." The Journal of chemical physics 124.4 (2006): 044109.
+	/// Instead of firing one reaction at a time, the engine advances the simulation by a time step tau, during which each non-critical reaction fires a Poisson distributed number of times.
+	/// Tau is chosen such that the relative change of the propensities during the step is expected to be bounded by epsilon. Reactions which are close to exhausting one of their reactants
+	/// (critical reactions) fire at most once per step. When the selected tau is not significantly larger than the expected time until the next reaction, the engine falls back to exact
+	/// stochastic simulation (direct method) for a number of steps.
+	/// Only propensity reactions whose reactants and products are of type State, ComposedState or TimestampQueueState, and which neither transform molecules nor use molecule properties, can be leaped. All other
+	/// reactions are always treated as critical, and are thus simulated exactly.
+	/// Note that tau-leaping is an approximation, such that the results of simulations using this engine are not exact.
+	/// </summary>
+	class TauLeapingEngine : public ISimulationEngine
+	{
+	public:
+		/// <summary>
+		/// Constructor.
+		/// </summary>
+		/// <param name="epsilon">Error control parameter. The relative change of the propensities during a step is expected to be bounded by epsilon.</param>
+		/// <param name="criticalThreshold">A reaction is critical if it can fire less than this number of times before exhausting one of its reactants.</param>
+		/// <param name="exactThreshold">If the selected step size is less than exactThreshold times the expected time until the next reaction, exact simulation is used instead.</param>
+		/// <param name="exactSteps">Number of exact simulation steps before trying to leap again.</param>
+		TauLeapingEngine(double epsilon = 0.03, size_t criticalThreshold = 10, double exactThreshold = 10, size_t exactSteps = 100) :
+			epsilon_(epsilon), criticalThreshold_(criticalThreshold), exactThreshold_(exactThreshold), exactSteps_(exactSteps),
+			network_(nullptr), dependencyGraph_(nullptr), a0_(0), exactStepsRemaining_(0), leaping_(false), criticalReaction_(noReaction_)
+		{
+		}
+		virtual void Initialize(ISimInfo& simInfo, CompiledReactionNetwork& network, const DependencyGraph& dependencyGraph) override
+		{
+			network_ = &network;
+			dependencyGraph_ = &dependencyGraph;
+			CompileReactions();
+			ai_.resize(network_->Size());
+			critical_.resize(network_->Size());
+			firings_.resize(network_->Size());
+			additions_.assign(species_.size(), 0);
+			removals_.assign(species_.size(), 0);
+			changed_.assign(species_.size(), false);
+			exactStepsRemaining_ = 0;
+			leaping_ = false;
+			ComputeAllRates(simInfo);
+		}
+		virtual void Uninitialize(ISimInfo& simInfo) override
+		{
+			network_ = nullptr;
+			leapReactions_.clear();
+			species_.clear();
+			ai_.clear();
+			critical_.clear();
+			firings_.clear();
+			additions_.clear();
+			removals_.clear();
+			changed_.clear();
+			changedSpecies_.clear();
+			firedReactions_.clear();
+			firingCounts_.clear();
+			dependencyGraph_ = nullptr;
+		}
+		virtual double NextReactionTime(ISimInfo& simInfo, double nextEventTime) override
+		{
+			leaping_ = false;
+			if (a0_ <= 0)
+				return stochsim::inf;
+			double time = simInfo.GetSimTime();
+			if (exactStepsRemaining_ > 0)
+			{
+				exactStepsRemaining_--;
+				return time + simInfo.RandExponential() / a0_;
+			}
+			// A leap must neither skip the next event, the next time the state is logged, nor the end of the simulation.
+			double maxTime = nextEventTime < simInfo.GetRunTime() ? nextEventTime : simInfo.GetRunTime();
+			const double nextLogTime = simInfo.GetNextLogTime();
+			if (nextLogTime < maxTime)
+				maxTime = nextLogTime;
+			double maxTau = maxTime - time;
+			if (maxTau * a0_ < exactThreshold_)
+				return time + simInfo.RandExponential() / a0_;
+
+			// Determine critical reactions, and the aggregated propensity of all critical reactions.
+			double a0Critical = 0;
+			for (size_t j = 0; j < network_->Size(); j++)
+			{
+				critical_[j] = ai_[j] > 0 && IsCritical(simInfo, j);
+				if (critical_[j])
+					a0Critical += ai_[j];
+			}
+			double tau1 = SelectTau(simInfo);
+			if (tau1 * a0_ < exactThreshold_)
+			{
+				// Leaping would not be more efficient than exact simulation.
+				exactStepsRemaining_ = exactSteps_ > 0 ? exactSteps_ - 1 : 0;
+				return time + simInfo.RandExponential() / a0_;
+			}
+			double tau2 = a0Critical > 0 ? simInfo.RandExponential() / a0Critical : stochsim::inf;
+			while (true)
+			{
+				double tau;
+				criticalReaction_ = noReaction_;
+				if (tau1 < tau2)
+				{
+					tau = tau1;
+				}
+				else
+				{
+					tau = tau2;
+					criticalReaction_ = SelectCriticalReaction(simInfo, a0Critical);
+				}
+				if (tau > maxTau)
+				{
+					// Since the putative firing time of the critical reactions is later than maxTau, no critical reaction fires during the step.
+					tau = maxTau;
+					criticalReaction_ = noReaction_;
+				}
+				if (SampleLeap(simInfo, tau))
+				{
+					leaping_ = true;
+					return time + tau;
+				}
+				// Leap would result in negative molecular numbers. Retry with smaller step size.
+				tau1 /= 2;
+				if (tau1 * a0_ < exactThreshold_)
+				{
+					exactStepsRemaining_ = exactSteps_ > 0 ? exactSteps_ - 1 : 0;
+					return time + simInfo.RandExponential() / a0_;
+				}
+			}
+		}
+		virtual const std::vector<size_t>& Fire(ISimInfo& simInfo) override
+		{
+			firedReactions_.clear();
+			firingCounts_.clear();
+			if (!leaping_)
+			{
+				// Exact simulation step (direct method).
+				double afraction = simInfo.Rand() * a0_;
+				double asum = 0;
+				size_t reactionIndex = 0;
+				for (size_t j = 0; j < ai_.size(); j++)
+				{
+					if (ai_[j] <= 0)
+						continue;
+					// due to rounding errors, asum might never reach afraction. Thus, default to the last reaction with a positive propensity.
+					reactionIndex = j;
+					asum += ai_[j];
+					if (asum >= afraction)
+						break;
+				}
+				network_->Fire(simInfo, reactionIndex);
+				firedReactions_.push_back(reactionIndex);
+				firingCounts_.push_back(1);
+				Update(simInfo, dependencyGraph_->GetPropensityDependents(reactionIndex));
+				return firedReactions_;
+			}
+
+			// Apply the changes of all non-critical reactions at once.
+			for (auto i : changedSpecies_)
+			{
+				Species& species = species_[i];
+				if (species.simpleState)
+				{
+					// Molecules of a simple state are indistinguishable, such that only the net change matters.
+					if (additions_[i] > removals_[i])
+						species.simpleState->AddN(simInfo, additions_[i] - removals_[i]);
+					else if (removals_[i] > additions_[i])
+						species.simpleState->RemoveN(simInfo, removals_[i] - additions_[i]);
+				}
+				else
+				{
+					// Molecules removed by the leap must be chosen from the molecules which existed before the leap.
+					species.state->RemoveN(simInfo, removals_[i]);
+					species.state->AddN(simInfo, additions_[i]);
+				}
+				additions_[i] = 0;
+				removals_[i] = 0;
+				changed_[i] = false;
+			}
+			changedSpecies_.clear();
+			for (size_t j = 0; j < network_->Size(); j++)
+			{
+				if (firings_[j] > 0)
+				{
+					firedReactions_.push_back(j);
+					firingCounts_.push_back(firings_[j]);
+				}
+			}
+			// At most one critical reaction fires per step.
+			if (criticalReaction_ != noReaction_)
+			{
+				network_->Fire(simInfo, criticalReaction_);
+				firedReactions_.push_back(criticalReaction_);
+				firingCounts_.push_back(1);
+				criticalReaction_ = noReaction_;
+			}
+			leaping_ = false;
+			ComputeAllRates(simInfo);
+			return firedReactions_;
+		}
+		virtual const std::vector<size_t>* GetFiringCounts() const override
+		{
+			return &firingCounts_;
+		}
+		virtual void Update(ISimInfo& simInfo, const std::vector<size_t>& dependents) override
+		{
+			for (auto j : dependents)
+			{
+				double rate = network_->ComputeRate(simInfo, j);
+				a0_ += rate - ai_[j];
+				ai_[j] = rate;
+			}
+			// To prevent the accumulation of rounding errors, a0 is resummed periodically.
+			if (++stepsSinceResum_ >= resumPeriod_ || a0_ <= 0)
+			{
+				a0_ = PropensityKernel::Sum(ai_.data(), ai_.size());
+				stepsSinceResum_ = 0;
+			}
+		}
+	private:
+		static constexpr size_t noReaction_ = static_cast<size_t>(-1);
+		/// <summary>
+		/// Number of propensity updates after which the aggregated propensity is resummed from scratch.
+		/// </summary>
+		static constexpr size_t resumPeriod_ = 1000;
+		/// <summary>
+		/// A state whose molecular number is read or changed by a leapable reaction.
+		/// </summary>
+		struct Species
+		{
+			IState* state = nullptr;
+			/// <summary>
+			/// Set if the state is of type State, whose molecules are indistinguishable such that only the net change of a leap matters.
+			/// </summary>
+			State* simpleState = nullptr;
+			/// <summary>
+			/// Highest order of all reactions in which the species influences the propensity.
+			/// </summary>
+			size_t highestOrder = 0;
+			/// <summary>
+			/// Highest stochiometry of the species in the reactions of highest order.
+			/// </summary>
+			size_t highestOrderStochiometry = 0;
+			// Only used during tau selection.
+			double mu = 0;
+			double sigma2 = 0;
+		};
+		/// <summary>
+		/// Information about a propensity reaction required for leaping.
+		/// </summary>
+		struct LeapReaction
+		{
+			/// <summary>
+			/// True if the reaction can be fired several times in bulk. If false, the reaction is always critical.
+			/// </summary>
+			bool leapable = false;
+			/// <summary>
+			/// Species consumed by the reaction, and their stochiometry.
+			/// </summary>
+			std::vector<std::pair<size_t, size_t>> reactants;
+			/// <summary>
+			/// Species produced by the reaction, and their stochiometry.
+			/// </summary>
+			std::vector<std::pair<size_t, size_t>> products;
+			/// <summary>
+			/// Net change of the molecular numbers of all species changed by the reaction.
+			/// </summary>
+			std::vector<std::pair<size_t, long long>> changes;
+		};
+
+		const double epsilon_;
+		const size_t criticalThreshold_;
+		const double exactThreshold_;
+		const size_t exactSteps_;
+
+		CompiledReactionNetwork* network_;
+		const DependencyGraph* dependencyGraph_;
+		std::vector<LeapReaction> leapReactions_;
+		std::vector<Species> species_;
+		/// <summary>
+		/// Propensities of the reactions.
+		/// </summary>
+		std::vector<double> ai_;
+		/// <summary>
+		/// Aggregated propensity of all reactions.
+		/// </summary>
+		double a0_;
+		size_t stepsSinceResum_ = 0;
+		size_t exactStepsRemaining_;
+		/// <summary>
+		/// True if the last call to NextReactionTime scheduled a leap, false if it scheduled a single exact step.
+		/// </summary>
+		bool leaping_;
+		std::vector<char> critical_;
+		/// <summary>
+		/// Number of times each reaction fires in the scheduled leap.
+		/// </summary>
+		std::vector<size_t> firings_;
+		/// <summary>
+		/// Number of molecules of each species added, respectively removed, in the scheduled leap.
+		/// </summary>
+		std::vector<size_t> additions_;
+		std::vector<size_t> removals_;
+		/// <summary>
+		/// Species changed in the scheduled leap. changed_[i] is true if changedSpecies_ contains species i.
+		/// </summary>
+		std::vector<size_t> changedSpecies_;
+		std::vector<char> changed_;
+		/// <summary>
+		/// Critical reaction firing at the end of the scheduled leap, or noReaction_.
+		/// </summary>
+		size_t criticalReaction_;
+		std::vector<size_t> firedReactions_;
+		/// <summary>
+		/// Number of times each reaction in firedReactions_ fired.
+		/// </summary>
+		std::vector<size_t> firingCounts_;
+
+		/// <summary>
+		/// Draws a Poisson distributed random number with the given mean, using inversion for small means and the transformed rejection method of
+		/// Hörmann, Wolfgang. "The transformed rejection method for generating Poisson random variables." Insurance: Mathematics and Economics 12.1 (1993): 39-45.
+		/// for large means.
+		/// </summary>
+		static size_t DrawPoisson(ISimInfo& simInfo, double mean)
+		{
+			if (mean <= 0)
+				return 0;
+			if (mean < 10)
+			{
+				double limit = exp(-mean);
+				double product = simInfo.Rand();
+				size_t k = 0;
+				while (product > limit)
+				{
+					product *= simInfo.Rand();
+					k++;
+				}
+				return k;
+			}
+			const double smu = sqrt(mean);
+			const double b = 0.931 + 2.53 * smu;
+			const double a = -0.059 + 0.02483 * b;
+			const double invAlpha = 1.1239 + 1.1328 / (b - 3.4);
+			const double vr = 0.9277 - 3.6224 / (b - 2);
+			const double logMean = log(mean);
+			while (true)
+			{
+				double u = simInfo.Rand() - 0.5;
+				double v = simInfo.Rand();
+				double us = 0.5 - fabs(u);
+				double k = floor((2 * a / us + b) * u + mean + 0.43);
+				if (us >= 0.07 && v <= vr)
+					return static_cast<size_t>(k);
+				if (k < 0 || (us < 0.013 && v > us))
+					continue;
+				if (log(v) + log(invAlpha) - log(a / (us * us) + b) <= -mean + k * logMean - lgamma(k + 1))
+					return static_cast<size_t>(k);
+			}
+		}
+		/// <summary>
+		/// Determines which reactions can be leaped, and how they change the molecular numbers of the states.
+		/// </summary>
+		void CompileReactions()
+		{
+			std::unordered_map<const IState*, size_t> speciesIndices;
+			species_.clear();
+			leapReactions_.assign(network_->Size(), LeapReaction());
+			auto getSpecies = [this, &speciesIndices](const std::shared_ptr<IState>& state) -> size_t
+			{
+				auto search = speciesIndices.find(state.get());
+				if (search != speciesIndices.end())
+					return search->second;
+				Species species;
+				species.state = state.get();
+				species.simpleState = dynamic_cast<State*>(state.get());
+				species_.push_back(species);
+				speciesIndices.emplace(state.get(), species_.size() - 1);
+				return species_.size() - 1;
+			};
+			auto isBulkState = [](const std::shared_ptr<IState>& state) -> bool
+			{
+				// Choices have no molecular number, and their products can only be determined by evaluating the choice for every molecule.
+				return !dynamic_cast<Choice*>(state.get());
+			};
+			for (size_t j = 0; j < network_->Size(); j++)
+			{
+				auto reaction = dynamic_cast<PropensityReaction*>(network_->GetReactions()[j].get());
+				if (!reaction)
+					continue;
+				LeapReaction& leapReaction = leapReactions_[j];
+				auto reactants = reaction->GetReactants();
+				auto products = reaction->GetProducts();
+				auto modifiers = reaction->GetModifiers();
+				bool leapable = reaction->GetTransformees().empty();
+				for (auto& reactant : reactants)
+				{
+					leapReaction.reactants.emplace_back(getSpecies(reactant.state_), reactant.stochiometry_);
+					leapable = leapable && isBulkState(reactant.state_);
+					for (auto& name : reactant.propertyNames_)
+					{
+						leapable = leapable && name.empty();
+					}
+				}
+				for (auto& product : products)
+				{
+					leapable = leapable && isBulkState(product.state_);
+					for (auto& expression : product.propertyExpressions_)
+					{
+						leapable = leapable && !expression;
+					}
+				}
+				for (auto& modifier : modifiers)
+				{
+					for (auto& name : modifier.propertyNames_)
+					{
+						leapable = leapable && name.empty();
+					}
+				}
+				leapReaction.leapable = leapable;
+				if (!leapable)
+					continue;
+				for (auto& product : products)
+				{
+					leapReaction.products.emplace_back(getSpecies(product.state_), product.stochiometry_);
+				}
+
+				// Net changes.
+				std::unordered_map<size_t, long long> changes;
+				for (auto& reactant : reactants)
+				{
+					changes[getSpecies(reactant.state_)] -= reactant.stochiometry_;
+				}
+				for (auto& product : products)
+				{
+					changes[getSpecies(product.state_)] += product.stochiometry_;
+				}
+				for (auto& change : changes)
+				{
+					if (change.second != 0)
+						leapReaction.changes.emplace_back(change.first, change.second);
+				}
+
+				// Order of the reaction, required for the step size selection.
+				// Species whose molecular number influences the propensity of the reaction, and their stochiometry.
+				std::vector<std::pair<size_t, size_t>> rateSpecies = leapReaction.reactants;
+				for (auto& modifier : modifiers)
+				{
+					rateSpecies.emplace_back(getSpecies(modifier.state_), modifier.stochiometry_);
+				}
+				size_t order = 0;
+				for (auto& element : rateSpecies)
+				{
+					order += element.second;
+				}
+				for (auto& element : rateSpecies)
+				{
+					Species& species = species_[element.first];
+					if (order > species.highestOrder)
+					{
+						species.highestOrder = order;
+						species.highestOrderStochiometry = element.second;
+					}
+					else if (order == species.highestOrder && element.second > species.highestOrderStochiometry)
+					{
+						species.highestOrderStochiometry = element.second;
+					}
+				}
+			}
+		}
+		void ComputeAllRates(ISimInfo& simInfo)
+		{
+			a0_ = network_->ComputeRates(simInfo, ai_.data());
+			stepsSinceResum_ = 0;
+		}
+		/// <summary>
+		/// Returns true if the reaction cannot be leaped, or if it would exhaust one of its reactants in less than criticalThreshold_ firings.
+		/// </summary>
+		bool IsCritical(ISimInfo& simInfo, size_t reaction) const
+		{
+			const LeapReaction& leapReaction = leapReactions_[reaction];
+			if (!leapReaction.leapable)
+				return true;
+			for (auto& reactant : leapReaction.reactants)
+			{
+				if (species_[reactant.first].state->Num(simInfo) / reactant.second < criticalThreshold_)
+					return true;
+			}
+			return false;
+		}
+		/// <summary>
+		/// Returns the value g_i of Cao et al. such that the relative change of the propensities is bounded by epsilon if the relative change of the species is bounded by epsilon/g_i.
+		/// </summary>
+		static double HighestOrderFactor(const Species& species, double num)
+		{
+			if (species.highestOrder <= 1)
+				return 1;
+			if (species.highestOrder == 2)
+			{
+				if (species.highestOrderStochiometry >= 2 && num > 1)
+					return 2 + 1 / (num - 1);
+				return 2;
+			}
+			if (species.highestOrder == 3)
+			{
+				if (species.highestOrderStochiometry >= 3 && num > 2)
+					return 3 + 1 / (num - 1) + 2 / (num - 2);
+				if (species.highestOrderStochiometry == 2 && num > 1)
+					return 1.5 * (2 + 1 / (num - 1));
+				return 3;
+			}
+			return static_cast<double>(species.highestOrder);
+		}
+		/// <summary>
+		/// Selects the largest step size for which the relative change of the propensities of the non-critical reactions is expected to be bounded by epsilon.
+		/// </summary>
+		double SelectTau(ISimInfo& simInfo)
+		{
+			for (auto& species : species_)
+			{
+				species.mu = 0;
+				species.sigma2 = 0;
+			}
+			bool anyNonCritical = false;
+			for (size_t j = 0; j < network_->Size(); j++)
+			{
+				if (critical_[j] || ai_[j] <= 0)
+					continue;
+				anyNonCritical = true;
+				for (auto& change : leapReactions_[j].changes)
+				{
+					double nu = static_cast<double>(change.second);
+					species_[change.first].mu += nu * ai_[j];
+					species_[change.first].sigma2 += nu * nu * ai_[j];
+				}
+			}
+			if (!anyNonCritical)
+				return stochsim::inf;
+			// Different to Cao et al., the relative change of all species is bounded, and not only of the reactants. Species which are not reactants might still
+			// influence custom rate equations, or the firing times of event reactions.
+			double tau = stochsim::inf;
+			for (auto& species : species_)
+			{
+				if (species.sigma2 <= 0)
+					continue;
+				double num = static_cast<double>(species.state->Num(simInfo));
+				double bound = epsilon_ * num / HighestOrderFactor(species, num);
+				if (bound < 1)
+					bound = 1;
+				if (species.mu != 0)
+				{
+					double candidate = bound / fabs(species.mu);
+					if (candidate < tau)
+						tau = candidate;
+				}
+				double candidate = bound * bound / species.sigma2;
+				if (candidate < tau)
+					tau = candidate;
+			}
+			return tau;
+		}
+		size_t SelectCriticalReaction(ISimInfo& simInfo, double a0Critical) const
+		{
+			double afraction = simInfo.Rand() * a0Critical;
+			double asum = 0;
+			size_t reactionIndex = noReaction_;
+			for (size_t j = 0; j < network_->Size(); j++)
+			{
+				if (!critical_[j])
+					continue;
+				reactionIndex = j;
+				asum += ai_[j];
+				if (asum >= afraction)
+					break;
+			}
+			return reactionIndex;
+		}
+		inline void MarkChanged(size_t species)
+		{
+			if (!changed_[species])
+			{
+				changed_[species] = true;
+				changedSpecies_.push_back(species);
+			}
+		}
+		/// <summary>
+		/// Samples how often each non-critical reaction fires during a step of length tau, and computes the resulting changes of the species.
+		/// Returns false if the step would result in negative molecular numbers.
+		/// </summary>
+		bool SampleLeap(ISimInfo& simInfo, double tau)
+		{
+			for (auto i : changedSpecies_)
+			{
+				additions_[i] = 0;
+				removals_[i] = 0;
+				changed_[i] = false;
+			}
+			changedSpecies_.clear();
+			for (size_t j = 0; j < network_->Size(); j++)
+			{
+				firings_[j] = 0;
+				if (critical_[j] || ai_[j] <= 0)
+					continue;
+				firings_[j] = DrawPoisson(simInfo, ai_[j] * tau);
+				if (firings_[j] == 0)
+					continue;
+				for (auto& reactant : leapReactions_[j].reactants)
+				{
+					MarkChanged(reactant.first);
+					removals_[reactant.first] += reactant.second * firings_[j];
+				}
+				for (auto& product : leapReactions_[j].products)
+				{
+					MarkChanged(product.first);
+					additions_[product.first] += product.second * firings_[j];
+				}
+			}
+			for (auto i : changedSpecies_)
+			{
+				size_t num = species_[i].state->Num(simInfo);
+				// For composed states, the removed molecules must already exist before the leap.
+				if (species_[i].simpleState ? num + additions_[i] < removals_[i] : num < removals_[i])
+					return false;
+			}
+			// The critical reaction fires after the leap, and thus needs its reactants to be still available.
+			if (criticalReaction_ != noReaction_)
+			{
+				for (auto& reactant : leapReactions_[criticalReaction_].reactants)
+				{
+					size_t num = species_[reactant.first].state->Num(simInfo);
+					if (num + additions_[reactant.first] < removals_[reactant.first] + reactant.second)
+						return false;
+				}
+			}
+			return true;
+		}
+	};
+}
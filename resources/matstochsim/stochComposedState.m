@@ -133,6 +133,34 @@ classdef stochComposedState < stochSimulationComponent & matlab.mixin.CustomDisp
             end
             this.call('LogIncreaseToFile', fileName, propertyIdx, maxValue);
         end
+        function logToFile(this, fileName, propertyIdx, maxValue)
+            % Specifies the name of a file where, at each log time, it is
+            % saved how many molecules currently represented by this state
+            % have each value of a given property. Only available for
+            % states created with createHistogramState. The file name has
+            % typically the ending CSV.
+            % Usage:
+            %   logToFile(this, fileName)
+			%   logToFile(this, fileName, propertyIdx)
+            %   logToFile(this, fileName, propertyIdx, maxValue)
+            % Parameters:
+            %   fileName      - Name of the file to save the number of
+            %                   molecules per property value.
+			%   propertyIdx   - ID of the molecule property (zero based). 
+			%                   Default = 0.
+            %   maxValue      - Estimate of the maximal value of the property. 
+			%                   The maximal value is automatically increased
+            %                   if a molecule has a higher property value.
+            %                   Default=20.
+            
+			 if nargin < 3 || isempty(propertyIdx)
+                propertyIdx = 0;
+            end
+            if nargin < 4 || isempty(maxValue)
+                maxValue = 20;
+            end
+            this.call('LogToFile', fileName, propertyIdx, maxValue);
+        end
         function cmdl = getCmdl(this)
             % Returns a string representing the cmdl command to
             % instantiate this state, e.g. 'A = 10;'. 
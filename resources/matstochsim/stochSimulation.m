@@ -277,7 +277,7 @@ classdef stochSimulation < handle & matlab.mixin.CustomDisplay
 			choice = this.toState(this.call('CreateChoice', name, choiceEquation));
         end
         
-        function state = createComposedState(this, name, initialCondition, capacity)
+        function state = createComposedState(this, name, initialCondition, capacity, numProperties)
             % Creates a composed state with the given name in the
             % simulation. Similar to a "normal" state, the state can
             % subsequently e.g. be added as a reactant or product of a
@@ -291,6 +291,7 @@ classdef stochSimulation < handle & matlab.mixin.CustomDisplay
             %   state = createComposedState(this, name)
             %   state = createComposedState(this, name, initialCondition)
             %   state = createComposedState(this, name, initialCondition, capacity)
+            %   state = createComposedState(this, name, initialCondition, capacity, numProperties)
             % Parameters:
             %   name             - Name of the state, e.g. 'GFP', used to
             %                      uniquely identify the state. 
@@ -303,6 +304,10 @@ classdef stochSimulation < handle & matlab.mixin.CustomDisplay
             %                      capacity is automatically increased,
             %                      which however slows down the simulation.
             %                      Default=1000;
+            %   numProperties    - Number of properties stored for each
+            %                      molecule of the state. Properties with
+            %                      a higher index are always zero.
+            %                      Default=2;
             % Returns:
             %   state            - The newly created composed state.
             if nargin < 3 || isempty(initialCondition)
@@ -311,7 +316,44 @@ classdef stochSimulation < handle & matlab.mixin.CustomDisplay
             if nargin < 4 || isempty(capacity)
                 capacity = 1000;
             end
-            state = this.toState(this.call('CreateComposedState', name, initialCondition, capacity));
+            if nargin < 5 || isempty(numProperties)
+                numProperties = 2;
+            end
+            state = this.toState(this.call('CreateComposedState', name, initialCondition, capacity, numProperties));
+        end
+        
+        function state = createHistogramState(this, name, initialCondition, numProperties)
+            % Creates a histogram state with the given name in the
+            % simulation. A histogram state behaves like a composed state,
+            % i.e. its molecules have properties, but it only stores how
+            % many molecules have each distinct combination of property
+            % values. It thus needs much less memory than a composed state
+            % if the properties only take a few distinct values, e.g. when
+            % counting how often a molecule was modified. Since the
+            % creation times of the molecules are not stored, a histogram
+            % state cannot be used in delay reactions.
+            % Usage:
+            %   state = createHistogramState(this, name)
+            %   state = createHistogramState(this, name, initialCondition)
+            %   state = createHistogramState(this, name, initialCondition, numProperties)
+            % Parameters:
+            %   name             - Name of the state, e.g. 'GFP', used to
+            %                      uniquely identify the state. 
+            %   initialCondition - Initial condition of the state.
+            %                      Default=0.
+            %   numProperties    - Number of properties distinguishing the
+            %                      molecules of the state. Properties with
+            %                      a higher index are always zero.
+            %                      Default=4;
+            % Returns:
+            %   state            - The newly created histogram state.
+            if nargin < 3 || isempty(initialCondition)
+                initialCondition = 0;
+            end
+            if nargin < 4 || isempty(numProperties)
+                numProperties = 4;
+            end
+            state = this.toState(this.call('CreateHistogramState', name, initialCondition, numProperties));
         end
         
         function state = getState(this, name)